@@ -0,0 +1,659 @@
+// Native code, compiled without /clr.
+
+#include "Batch3D.h"
+#include "GeometryKernels.h"
+#include "NativeMemory.h"
+#include "Renderer.h"
+
+#include <windows.h>
+#include <GL/gl.h>
+#include <math.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+namespace
+{
+	// Corners of a box are numbered by bit 0 for the positive half width, bit 1 for
+	// the positive half height and bit 2 for the end of the box
+	const unsigned char FaceCorners[6][4] =
+	{
+		{ 0, 4, 5, 1 },		// front
+		{ 1, 5, 7, 3 },		// right
+		{ 3, 7, 6, 2 },		// back
+		{ 2, 6, 4, 0 },		// left
+		{ 0, 2, 3, 1 },		// bottom
+		{ 4, 6, 7, 5 }		// top
+	};
+	// Face normals as a local axis and a sign
+	const signed char FaceNormals[6][2] =
+	{
+		{ 1, -1 }, { 0, 1 }, { 1, 1 }, { 0, -1 }, { 2, -1 }, { 2, 1 }
+	};
+	// Edges of a box as pairs of corners
+	const unsigned char Edges[12][2] =
+	{
+		{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 },
+		{ 0, 2 }, { 2, 3 }, { 3, 1 }, { 1, 0 },
+		{ 4, 6 }, { 6, 7 }, { 7, 5 }, { 5, 4 }
+	};
+
+	// The frame of a box: its start point and the local x, y and z axes scaled to
+	// the half width, the half height and the length
+	struct BoxFrame
+	{
+		float origin[3];
+		float ex[3], ey[3], ez[3];
+		float nx[3], ny[3], nz[3];
+	};
+
+	// Builds the frame the canvas used to obtain by rotating the z axis about the
+	// y axis and then about the z axis until it points from the start to the end
+	void Frame(BoxFrame & f, float x1, float y1, float z1, float x2, float y2, float z2, float width, float height)
+	{
+		float dx = x2 - x1, dy = y2 - y1, dz = z2 - z1;
+		float dxy = sqrtf(dx * dx + dy * dy);
+		float length = sqrtf(dxy * dxy + dz * dz);
+		float cz = (dxy > 0 ? dx / dxy : 1.0f), sz = (dxy > 0 ? dy / dxy : 0.0f);
+		float cy = (length > 0 ? dz / length : 1.0f), sy = (length > 0 ? dxy / length : 0.0f);
+
+		// Unit axes are kept for normals
+		f.nx[0] = cz * cy; f.nx[1] = sz * cy; f.nx[2] = -sy;
+		f.ny[0] = -sz; f.ny[1] = cz; f.ny[2] = 0.0f;
+		f.nz[0] = cz * sy; f.nz[1] = sz * sy; f.nz[2] = cy;
+		for (int i = 0; i < 3; i++)
+		{
+			f.ex[i] = f.nx[i] * width / 2;
+			f.ey[i] = f.ny[i] * height / 2;
+			f.ez[i] = f.nz[i] * length;
+		}
+		f.origin[0] = x1; f.origin[1] = y1; f.origin[2] = z1;
+	}
+
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	// Corners and axes of four boxes, one box in each lane
+	struct BoxCorners
+	{
+		__m128 corners[8][3];
+		__m128 axes[3][3];
+	};
+
+	// Builds the frames of four boxes at once, as Frame does for one box, and
+	// computes their corners
+	void Corners(const Box3D * boxes, BoxCorners & c)
+	{
+		__m128 x1 = _mm_loadu_ps(&boxes[0].x1), x2 = _mm_loadu_ps(&boxes[1].x1);
+		__m128 x3 = _mm_loadu_ps(&boxes[2].x1), x4 = _mm_loadu_ps(&boxes[3].x1);
+		__m128 y1 = _mm_loadu_ps(&boxes[0].y2), y2 = _mm_loadu_ps(&boxes[1].y2);
+		__m128 y3 = _mm_loadu_ps(&boxes[2].y2), y4 = _mm_loadu_ps(&boxes[3].y2);
+		_MM_TRANSPOSE4_PS(x1, x2, x3, x4);
+		_MM_TRANSPOSE4_PS(y1, y2, y3, y4);
+		// x1..x4 now hold the start x, y, z and end x; y1..y4 the end y, z, width and height
+		__m128 dx = _mm_sub_ps(x4, x1), dy = _mm_sub_ps(y1, x2), dz = _mm_sub_ps(y2, x3);
+		__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+		__m128 dxy = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dxy, dxy), _mm_mul_ps(dz, dz)));
+
+		// Lanes of zero length boxes divide by zero; the results are masked out
+		__m128 hasxy = _mm_cmpgt_ps(dxy, zero), haslength = _mm_cmpgt_ps(length, zero);
+		__m128 cz = Select(hasxy, _mm_div_ps(dx, dxy), one), sz = Select(hasxy, _mm_div_ps(dy, dxy), zero);
+		__m128 cy = Select(haslength, _mm_div_ps(dz, length), one), sy = Select(haslength, _mm_div_ps(dxy, length), zero);
+
+		__m128 (& n)[3][3] = c.axes;
+		n[0][0] = _mm_mul_ps(cz, cy); n[0][1] = _mm_mul_ps(sz, cy); n[0][2] = _mm_sub_ps(zero, sy);
+		n[1][0] = _mm_sub_ps(zero, sz); n[1][1] = cz; n[1][2] = zero;
+		n[2][0] = _mm_mul_ps(cz, sy); n[2][1] = _mm_mul_ps(sz, sy); n[2][2] = cy;
+
+		__m128 hw = _mm_mul_ps(y3, half), hh = _mm_mul_ps(y4, half);
+		__m128 origin[3] = { x1, x2, x3 };
+		for (int i = 0; i < 3; i++)
+		{
+			__m128 ex = _mm_mul_ps(n[0][i], hw), ey = _mm_mul_ps(n[1][i], hh), ez = _mm_mul_ps(n[2][i], length);
+			__m128 sum = _mm_add_ps(ex, ey), difference = _mm_sub_ps(ex, ey);
+			__m128 start = origin[i], end = _mm_add_ps(origin[i], ez);
+			c.corners[0][i] = _mm_sub_ps(start, sum);
+			c.corners[1][i] = _mm_add_ps(start, difference);
+			c.corners[2][i] = _mm_sub_ps(start, difference);
+			c.corners[3][i] = _mm_add_ps(start, sum);
+			c.corners[4][i] = _mm_sub_ps(end, sum);
+			c.corners[5][i] = _mm_add_ps(end, difference);
+			c.corners[6][i] = _mm_sub_ps(end, difference);
+			c.corners[7][i] = _mm_add_ps(end, sum);
+		}
+	}
+
+	inline void SetVertex(LitVertex & v, const float (& corners)[8][3][4], int corner, int lane, float nx, float ny, float nz, unsigned int color)
+	{
+		v.x = corners[corner][0][lane];
+		v.y = corners[corner][1][lane];
+		v.z = corners[corner][2][lane];
+		v.nx = nx; v.ny = ny; v.nz = nz;
+		v.color = color;
+	}
+
+	// Writes the triangles or edges of count boxes, at most four, from their corners
+	LitVertex * WriteBoxes(LitVertex * v, const Box3D * boxes, int count, const BoxCorners & c, bool wire)
+	{
+		const float (& corners)[8][3][4] = *(const float (*)[8][3][4])c.corners;
+		const float (& axes)[3][3][4] = *(const float (*)[3][3][4])c.axes;
+		const int order[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int lane = 0; lane < count; lane++)
+		{
+			unsigned int color = boxes[lane].color;
+			if (wire)
+			{
+				for (int i = 0; i < 12; i++)
+				{
+					SetVertex(*v++, corners, Edges[i][0], lane, 0.0f, 0.0f, 1.0f, color);
+					SetVertex(*v++, corners, Edges[i][1], lane, 0.0f, 0.0f, 1.0f, color);
+				}
+				continue;
+			}
+			for (int i = 0; i < 6; i++)
+			{
+				int axis = FaceNormals[i][0];
+				float sign = FaceNormals[i][1];
+				float nx = sign * axes[axis][0][lane], ny = sign * axes[axis][1][lane], nz = sign * axes[axis][2][lane];
+				for (int j = 0; j < 6; j++)
+					SetVertex(*v++, corners, FaceCorners[i][order[j]], lane, nx, ny, nz, color);
+			}
+		}
+		return v;
+	}
+
+	const double Pi = 3.14159265358979323846;
+
+	// Largest slice and stack count of cached meshes
+	const int MaxDivisions = 512;
+
+	enum MeshKind
+	{
+		SphereMesh,
+		CylinderMesh
+	};
+}
+
+/// <summary>
+/// A unit mesh and the instances drawn with it in the current batch.
+/// </summary>
+struct UnitMesh
+{
+	int kind, slices, stacks;
+	bool wire;
+	LitVertex * vertices;
+	int count;
+	MeshInstance * instances;
+	int instanceCount, instanceCapacity;
+};
+
+struct MeshCache
+{
+	UnitMesh * meshes;
+	int count, capacity;
+	int pending;
+	int last;
+	// Level of detail: largest segment size in pixels, or 0 for full detail
+	float detail;
+	float depthRow[4];		// row of the modelview matrix giving the eye depth
+	float pixelScale;		// pixels per unit at unit depth, or per unit for orthographic views
+	bool perspective;
+	// Objects smaller than the detail size, drawn as points
+	LitBuffer * dots;
+};
+
+namespace
+{
+	inline void Vertex(LitVertex * & v, float x, float y, float z, float nx, float ny, float nz)
+	{
+		v->x = x; v->y = y; v->z = z;
+		v->nx = nx; v->ny = ny; v->nz = nz;
+		v->color = 0xFFFFFFFF;
+		v++;
+	}
+
+	// Builds the sphere of radius 1 around the origin with its poles on the z axis,
+	// with the vertex layout of gluSphere. Filled spheres are triangle lists; wire
+	// spheres are line lists of the parallels and meridians.
+	void BuildSphere(UnitMesh & mesh)
+	{
+		int slices = mesh.slices, stacks = mesh.stacks;
+		float * sines = (float *)_Allocate(2 * (slices + 1) * sizeof(float));
+		float * cosines = sines + slices + 1;
+		for (int i = 0; i <= slices; i++)
+		{
+			double angle = 2.0 * Pi * (i == slices ? 0 : i) / slices;
+			sines[i] = (float)sin(angle);
+			cosines[i] = (float)cos(angle);
+		}
+
+		if (mesh.wire)
+			mesh.count = 2 * (slices * (stacks - 1) + slices * stacks);
+		else
+			mesh.count = 6 * slices * (stacks - 2) + 6 * slices;
+		mesh.vertices = (LitVertex *)_Allocate(mesh.count * sizeof(LitVertex));
+		LitVertex * v = mesh.vertices;
+
+		for (int j = 0; j < stacks; j++)
+		{
+			float s0 = (float)sin(Pi * j / stacks), c0 = (float)cos(Pi * j / stacks);
+			float s1 = (float)sin(Pi * (j + 1) / stacks), c1 = (float)cos(Pi * (j + 1) / stacks);
+			if (j == stacks - 1) { s1 = 0.0f; c1 = -1.0f; }
+			for (int i = 0; i < slices; i++)
+			{
+				float x00 = sines[i] * s0, y00 = cosines[i] * s0;
+				float x01 = sines[i + 1] * s0, y01 = cosines[i + 1] * s0;
+				float x10 = sines[i] * s1, y10 = cosines[i] * s1;
+				float x11 = sines[i + 1] * s1, y11 = cosines[i + 1] * s1;
+				if (mesh.wire)
+				{
+					// Meridian segment, and the parallel below it except at the pole
+					Vertex(v, x00, y00, c0, x00, y00, c0);
+					Vertex(v, x10, y10, c1, x10, y10, c1);
+					if (j != stacks - 1)
+					{
+						Vertex(v, x10, y10, c1, x10, y10, c1);
+						Vertex(v, x11, y11, c1, x11, y11, c1);
+					}
+					continue;
+				}
+				// The quads touching the poles degenerate to one triangle
+				if (j != 0)
+				{
+					Vertex(v, x00, y00, c0, x00, y00, c0);
+					Vertex(v, x10, y10, c1, x10, y10, c1);
+					Vertex(v, x01, y01, c0, x01, y01, c0);
+				}
+				if (j != stacks - 1)
+				{
+					Vertex(v, x01, y01, c0, x01, y01, c0);
+					Vertex(v, x10, y10, c1, x10, y10, c1);
+					Vertex(v, x11, y11, c1, x11, y11, c1);
+				}
+			}
+		}
+		_Free(sines);
+	}
+
+	// Builds the open cylinder of radius 1 from z = 0 to z = 1, with the vertex
+	// layout of gluCylinder. Wire cylinders are line lists of the rings and the
+	// lines along the cylinder.
+	void BuildCylinder(UnitMesh & mesh)
+	{
+		int slices = mesh.slices, stacks = mesh.stacks;
+		if (mesh.wire)
+			mesh.count = 2 * (slices * (stacks + 1) + slices * stacks);
+		else
+			mesh.count = 6 * slices * stacks;
+		mesh.vertices = (LitVertex *)_Allocate(mesh.count * sizeof(LitVertex));
+		LitVertex * v = mesh.vertices;
+
+		for (int i = 0; i < slices; i++)
+		{
+			double a0 = 2.0 * Pi * i / slices, a1 = 2.0 * Pi * (i + 1 == slices ? 0 : i + 1) / slices;
+			float x0 = (float)sin(a0), y0 = (float)cos(a0);
+			float x1 = (float)sin(a1), y1 = (float)cos(a1);
+			for (int j = 0; j <= stacks; j++)
+			{
+				float z0 = (float)j / stacks, z1 = (float)(j + 1) / stacks;
+				if (mesh.wire)
+				{
+					Vertex(v, x0, y0, z0, x0, y0, 0.0f);
+					Vertex(v, x1, y1, z0, x1, y1, 0.0f);
+					if (j != stacks)
+					{
+						Vertex(v, x0, y0, z0, x0, y0, 0.0f);
+						Vertex(v, x0, y0, z1, x0, y0, 0.0f);
+					}
+					continue;
+				}
+				if (j == stacks) break;
+				Vertex(v, x0, y0, z0, x0, y0, 0.0f);
+				Vertex(v, x1, y1, z0, x1, y1, 0.0f);
+				Vertex(v, x1, y1, z1, x1, y1, 0.0f);
+				Vertex(v, x0, y0, z0, x0, y0, 0.0f);
+				Vertex(v, x1, y1, z1, x1, y1, 0.0f);
+				Vertex(v, x0, y0, z1, x0, y0, 0.0f);
+			}
+		}
+	}
+
+	// Returns the cached mesh, building it on first use. The last mesh found is
+	// checked first, since consecutive calls usually draw the same kind of object.
+	UnitMesh & GetMesh(MeshCache * cache, int kind, int slices, int stacks, bool wire)
+	{
+		if (slices < 3) slices = 3;
+		if (slices > MaxDivisions) slices = MaxDivisions;
+		if (stacks < (kind == SphereMesh ? 2 : 1)) stacks = (kind == SphereMesh ? 2 : 1);
+		if (stacks > MaxDivisions) stacks = MaxDivisions;
+
+		if (cache->last < cache->count)
+		{
+			UnitMesh & mesh = cache->meshes[cache->last];
+			if (mesh.kind == kind && mesh.slices == slices && mesh.stacks == stacks && mesh.wire == wire) return mesh;
+		}
+		for (int i = 0; i < cache->count; i++)
+		{
+			UnitMesh & mesh = cache->meshes[i];
+			if (mesh.kind == kind && mesh.slices == slices && mesh.stacks == stacks && mesh.wire == wire)
+			{
+				cache->last = i;
+				return mesh;
+			}
+		}
+
+		if (cache->count == cache->capacity)
+		{
+			cache->capacity = (cache->capacity == 0 ? 8 : cache->capacity * 2);
+			cache->meshes = (UnitMesh *)_Reallocate(cache->meshes, cache->capacity * sizeof(UnitMesh));
+		}
+		UnitMesh & mesh = cache->meshes[cache->count];
+		memset(&mesh, 0, sizeof(UnitMesh));
+		mesh.kind = kind;
+		mesh.slices = slices;
+		mesh.stacks = stacks;
+		mesh.wire = wire;
+		if (kind == SphereMesh)
+			BuildSphere(mesh);
+		else
+			BuildCylinder(mesh);
+		cache->last = cache->count++;
+		return mesh;
+	}
+
+	// Returns the radius in pixels of a sphere of the given radius around (x, y, z).
+	// extent is the distance from the center to the nearest point of the object.
+	float ProjectedRadius(const MeshCache * cache, float x, float y, float z, float radius, float extent)
+	{
+		if (!cache->perspective) return radius * cache->pixelScale;
+
+		const float * r = cache->depthRow;
+		float depth = -(r[0] * x + r[1] * y + r[2] * z + r[3]) - extent;
+		if (depth <= 1e-6f) return 3.4e38f;
+		return radius * cache->pixelScale / depth;
+	}
+
+	// Returns the number of segments around a circle of the given radius in pixels, so
+	// that no segment is longer than the detail size. Counts are taken from the series
+	// 3, 4, 6, 8, 12, 16, 24, ... so that few distinct meshes are built.
+	int DetailSlices(const MeshCache * cache, float pixels, int slices)
+	{
+		float wanted = 2.0f * (float)Pi * pixels / cache->detail;
+		if (wanted >= (float)slices) return slices;
+		int n = 3;
+		while ((float)n < wanted)
+			n = ((n & (n - 1)) == 0 ? n + n / 2 : n / 3 * 4);
+		return (n < slices ? n : slices);
+	}
+
+	MeshInstance & AddInstance(MeshCache * cache, UnitMesh & mesh)
+	{
+		if (mesh.instanceCount == mesh.instanceCapacity)
+		{
+			mesh.instanceCapacity = (mesh.instanceCapacity < 64 ? 64 : mesh.instanceCapacity * 2);
+			mesh.instances = (MeshInstance *)_Reallocate(mesh.instances, mesh.instanceCapacity * sizeof(MeshInstance));
+		}
+		cache->pending++;
+		return mesh.instances[mesh.instanceCount++];
+	}
+}
+
+BoxList * _CreateBoxList()
+{
+	BoxList * list = (BoxList *)_Allocate(sizeof(BoxList));
+	list->data = 0;
+	list->count = 0;
+	list->capacity = 0;
+	return list;
+}
+
+void _DestroyBoxList(BoxList * list)
+{
+	if (list == 0) return;
+	_Free(list->data);
+	_Free(list);
+}
+
+void _ReserveBoxes(BoxList * list, int capacity)
+{
+	if (capacity <= list->capacity) return;
+
+	int grown = list->capacity * 2;
+	if (grown < 64) grown = 64;
+	if (grown < capacity) grown = capacity;
+	list->data = (Box3D *)_Reallocate(list->data, grown * sizeof(Box3D));
+	list->capacity = grown;
+}
+
+FaceList * _CreateFaceList()
+{
+	FaceList * list = (FaceList *)_Allocate(sizeof(FaceList));
+	list->indices = 0;
+	list->count = 0;
+	list->capacity = 0;
+	return list;
+}
+
+void _DestroyFaceList(FaceList * list)
+{
+	if (list == 0) return;
+	_Free(list->indices);
+	_Free(list);
+}
+
+void _ReserveFaces(FaceList * list, int capacity)
+{
+	if (capacity <= list->capacity) return;
+
+	int grown = list->capacity * 2;
+	if (grown < 64) grown = 64;
+	if (grown < capacity) grown = capacity;
+	list->indices = (unsigned int *)_Reallocate(list->indices, grown * 3 * sizeof(unsigned int));
+	list->capacity = grown;
+}
+
+void _SetFaceNormals3D(LitBuffer * triangles, const FaceList * faces)
+{
+	const int Chunk = 256;
+	float normals[Chunk * 3];
+	LitVertex * output = triangles->data + triangles->count - faces->count * 3;
+	for (int first = 0; first < faces->count; first += Chunk)
+	{
+		int count = (faces->count - first < Chunk ? faces->count - first : Chunk);
+		_FaceNormals3D(&triangles->data->x, sizeof(LitVertex), faces->indices + first * 3, count, normals);
+		for (int i = 0; i < count * 3; i++)
+		{
+			const float * n = normals + (i / 3) * 3;
+			output->nx = n[0];
+			output->ny = n[1];
+			output->nz = n[2];
+			output++;
+		}
+	}
+}
+
+void _ExpandBoxes3D(LitBuffer * output, const Box3D * boxes, int count, bool wire)
+{
+	if (count <= 0) return;
+	int perBox = (wire ? 24 : 36);
+	_ReserveLitVertices(output, output->count + count * perBox);
+	LitVertex * v = output->data + output->count;
+	output->count += count * perBox;
+
+	BoxCorners c;
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		Corners(boxes + i, c);
+		v = WriteBoxes(v, boxes + i, 4, c, wire);
+	}
+	if (i < count)
+	{
+		// The last boxes are padded with copies of the last one
+		Box3D last[4];
+		for (int j = 0; j < 4; j++)
+			last[j] = boxes[(i + j < count ? i + j : count - 1)];
+		Corners(last, c);
+		WriteBoxes(v, last, count - i, c, wire);
+	}
+}
+
+MeshCache * _CreateMeshCache()
+{
+	MeshCache * cache = (MeshCache *)_Allocate(sizeof(MeshCache));
+	memset(cache, 0, sizeof(MeshCache));
+	cache->dots = _CreateLitBuffer();
+	return cache;
+}
+
+void _DestroyMeshCache(MeshCache * cache)
+{
+	if (cache == 0) return;
+	for (int i = 0; i < cache->count; i++)
+	{
+		_Free(cache->meshes[i].vertices);
+		_Free(cache->meshes[i].instances);
+	}
+	_Free(cache->meshes);
+	_DestroyLitBuffer(cache->dots);
+	_Free(cache);
+}
+
+void _SetMeshDetail(MeshCache * cache, const float * projection, const float * modelview, float viewportHeight, float size)
+{
+	cache->detail = (size > 0.0f ? size : 0.0f);
+	for (int i = 0; i < 4; i++)
+		cache->depthRow[i] = modelview[4 * i + 2];
+	cache->perspective = (projection[11] != 0.0f);
+	cache->pixelScale = projection[5] * viewportHeight * 0.5f;
+}
+
+void _AddSphere3D(MeshCache * cache, float x, float y, float z, float radius, int slices, int stacks, bool wire, unsigned int color)
+{
+	if (cache->detail > 0.0f)
+	{
+		float pixels = ProjectedRadius(cache, x, y, z, radius, radius);
+		if (2.0f * pixels < cache->detail)
+		{
+			cache->pending++;
+			_AddLitVertex(cache->dots, x, y, z, 0.0f, 0.0f, 1.0f, color);
+			return;
+		}
+		int detailSlices = DetailSlices(cache, pixels, slices);
+		if (detailSlices < slices)
+		{
+			slices = detailSlices;
+			if (stacks > slices / 2) stacks = slices / 2;
+		}
+	}
+
+	MeshInstance & instance = AddInstance(cache, GetMesh(cache, SphereMesh, slices, stacks, wire));
+	float * t = instance.transform;
+	t[0] = radius; t[1] = 0.0f; t[2] = 0.0f; t[3] = x;
+	t[4] = 0.0f; t[5] = radius; t[6] = 0.0f; t[7] = y;
+	t[8] = 0.0f; t[9] = 0.0f; t[10] = radius; t[11] = z;
+	instance.color = color;
+}
+
+void _AddCylinder3D(MeshCache * cache, float x1, float y1, float z1, float x2, float y2, float z2, float radius, int slices, int stacks, bool wire, unsigned int color)
+{
+	// The frame of a box with a square cross section of twice the radius
+	BoxFrame f;
+	Frame(f, x1, y1, z1, x2, y2, z2, 2 * radius, 2 * radius);
+
+	if (cache->detail > 0.0f)
+	{
+		float x = (x1 + x2) * 0.5f, y = (y1 + y2) * 0.5f, z = (z1 + z2) * 0.5f;
+		float halfLength = 0.5f * sqrtf((x2 - x1) * (x2 - x1) + (y2 - y1) * (y2 - y1) + (z2 - z1) * (z2 - z1));
+		float extent = (halfLength > radius ? halfLength : radius);
+		if (2.0f * ProjectedRadius(cache, x, y, z, extent, extent) < cache->detail)
+		{
+			cache->pending++;
+			_AddLitVertex(cache->dots, x, y, z, 0.0f, 0.0f, 1.0f, color);
+			return;
+		}
+		// Stacks along the axis do not change the outline of a cylinder
+		int detailSlices = DetailSlices(cache, ProjectedRadius(cache, x, y, z, radius, extent), slices);
+		if (detailSlices < slices)
+		{
+			slices = detailSlices;
+			stacks = 1;
+		}
+	}
+
+	MeshInstance & instance = AddInstance(cache, GetMesh(cache, CylinderMesh, slices, stacks, wire));
+	float * t = instance.transform;
+	for (int i = 0; i < 3; i++)
+	{
+		t[4 * i] = f.ex[i];
+		t[4 * i + 1] = f.ey[i];
+		t[4 * i + 2] = f.ez[i];
+		t[4 * i + 3] = f.origin[i];
+	}
+	instance.color = color;
+}
+
+int _GetPendingInstances(const MeshCache * cache)
+{
+	return cache->pending;
+}
+
+void _FlushMeshCache(MeshCache * cache, Renderer * renderer, int * primitives, int * vertices)
+{
+	for (int i = 0; i < cache->count; i++)
+	{
+		UnitMesh & mesh = cache->meshes[i];
+		if (mesh.instanceCount == 0) continue;
+		_RenderInstances(renderer, mesh.wire ? GL_LINES : GL_TRIANGLES, mesh.vertices, mesh.count, mesh.instances, mesh.instanceCount);
+		*primitives += mesh.instanceCount * mesh.count / (mesh.wire ? 2 : 3);
+		*vertices += mesh.instanceCount * mesh.count;
+		mesh.instanceCount = 0;
+	}
+
+	// Objects smaller than the detail size are drawn as points of that size
+	if (cache->dots->count != 0)
+	{
+		glPointSize(cache->detail);
+		_RenderLitVertices(renderer, GL_POINTS, cache->dots->data, cache->dots->count);
+		glPointSize(1.0f);
+		*primitives += cache->dots->count;
+		*vertices += cache->dots->count;
+		cache->dots->count = 0;
+	}
+	cache->pending = 0;
+}
+
+void _ExpandMeshCache(MeshCache * cache, LitBuffer * triangles, LitBuffer * lines)
+{
+	for (int i = 0; i < cache->count; i++)
+	{
+		UnitMesh & mesh = cache->meshes[i];
+		if (mesh.instanceCount == 0) continue;
+		LitBuffer * output = (mesh.wire ? lines : triangles);
+		_ReserveLitVertices(output, output->count + mesh.instanceCount * mesh.count);
+		LitVertex * v = output->data + output->count;
+		output->count += mesh.instanceCount * mesh.count;
+		for (int j = 0; j < mesh.instanceCount; j++)
+		{
+			const float * t = mesh.instances[j].transform;
+			for (int k = 0; k < mesh.count; k++, v++)
+			{
+				const LitVertex & p = mesh.vertices[k];
+				v->x = t[0] * p.x + t[1] * p.y + t[2] * p.z + t[3];
+				v->y = t[4] * p.x + t[5] * p.y + t[6] * p.z + t[7];
+				v->z = t[8] * p.x + t[9] * p.y + t[10] * p.z + t[11];
+				float nx = t[0] * p.nx + t[1] * p.ny + t[2] * p.nz;
+				float ny = t[4] * p.nx + t[5] * p.ny + t[6] * p.nz;
+				float nz = t[8] * p.nx + t[9] * p.ny + t[10] * p.nz;
+				float length = sqrtf(nx * nx + ny * ny + nz * nz);
+				if (length > 0) { nx /= length; ny /= length; nz /= length; }
+				v->nx = nx; v->ny = ny; v->nz = nz;
+				v->color = mesh.instances[j].color;
+			}
+		}
+		mesh.instanceCount = 0;
+	}
+	cache->pending = 0;
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+// Native batching of 3D primitives into lit vertex buffers, which are drawn with
+// a few calls per frame. The implementation is compiled without /clr.
+
+#include "VertexBuffer.h"
+
+struct MeshCache;
+struct Renderer;
+
+/// <summary>
+/// Appends a lit vertex to a buffer.
+/// </summary>
+inline void _AddLitVertex(LitBuffer * buffer, float x, float y, float z, float nx, float ny, float nz, unsigned int color)
+{
+	if (buffer->count == buffer->capacity) _ReserveLitVertices(buffer, buffer->count + 1);
+	LitVertex & v = buffer->data[buffer->count++];
+	v.x = x; v.y = y; v.z = z;
+	v.nx = nx; v.ny = ny; v.nz = nz;
+	v.color = color;
+}
+/// <summary>
+/// Represents a box extending from (x1, y1, z1) to (x2, y2, z2) with the given cross
+/// section. The width is measured along the axis the canvas rotates the x axis to,
+/// the height along the horizontal axis perpendicular to the box.
+/// </summary>
+struct Box3D
+{
+	float x1, y1, z1;
+	float x2, y2, z2;
+	float width, height;
+	unsigned int color;
+};
+/// <summary>
+/// Represents a growable array of boxes.
+/// </summary>
+struct BoxList
+{
+	Box3D * data;
+	int count;
+	int capacity;
+};
+
+/// <summary>
+/// Creates an empty box list.
+/// </summary>
+BoxList * _CreateBoxList();
+/// <summary>
+/// Releases a box list.
+/// </summary>
+void _DestroyBoxList(BoxList * list);
+/// <summary>
+/// Makes room for at least capacity boxes. Existing boxes are preserved.
+/// </summary>
+void _ReserveBoxes(BoxList * list, int capacity);
+/// <summary>
+/// Appends a box to a list.
+/// </summary>
+inline void _AddBox3D(BoxList * list, float x1, float y1, float z1, float x2, float y2, float z2, float width, float height, unsigned int color)
+{
+	if (list->count == list->capacity) _ReserveBoxes(list, list->count + 1);
+	Box3D & box = list->data[list->count++];
+	box.x1 = x1; box.y1 = y1; box.z1 = z1;
+	box.x2 = x2; box.y2 = y2; box.z2 = z2;
+	box.width = width; box.height = height;
+	box.color = color;
+}
+/// <summary>
+/// Represents a growable array of faces, each given as the indices of three vertices
+/// of a lit vertex buffer. Face i holds the corners whose normal is given to the
+/// i-th triangle of a run of triangles at the end of the buffer.
+/// </summary>
+struct FaceList
+{
+	unsigned int * indices;
+	int count;
+	int capacity;
+};
+
+/// <summary>
+/// Creates an empty face list.
+/// </summary>
+FaceList * _CreateFaceList();
+/// <summary>
+/// Releases a face list.
+/// </summary>
+void _DestroyFaceList(FaceList * list);
+/// <summary>
+/// Makes room for at least capacity faces. Existing faces are preserved.
+/// </summary>
+void _ReserveFaces(FaceList * list, int capacity);
+/// <summary>
+/// Appends a face to a list.
+/// </summary>
+inline void _AddFace3D(FaceList * list, unsigned int a, unsigned int b, unsigned int c)
+{
+	if (list->count == list->capacity) _ReserveFaces(list, list->count + 1);
+	unsigned int * face = list->indices + list->count++ * 3;
+	face[0] = a; face[1] = b; face[2] = c;
+}
+/// <summary>
+/// Sets the normals of the last count triangles of a buffer, where count is the
+/// number of faces, to the normals of the faces. Normals are computed a chunk at a
+/// time by the face normal kernel, wound counter-clockwise seen from the front.
+/// </summary>
+void _SetFaceNormals3D(LitBuffer * triangles, const FaceList * faces);
+/// <summary>
+/// Appends the vertices of count boxes to output: 12 triangles with face normals
+/// for each filled box, or 12 edges with an upward normal for each wire box. The
+/// frames and corners of four boxes are computed at once with SSE.
+/// </summary>
+void _ExpandBoxes3D(LitBuffer * output, const Box3D * boxes, int count, bool wire);
+/// <summary>
+/// Creates an empty cache of unit sphere and cylinder meshes. Meshes are built the
+/// first time a slice and stack count is used, and collect the instances drawn
+/// with them until the cache is flushed.
+/// </summary>
+MeshCache * _CreateMeshCache();
+/// <summary>
+/// Releases a mesh cache and its meshes.
+/// </summary>
+void _DestroyMeshCache(MeshCache * cache);
+/// <summary>
+/// Sets the camera and the level of detail size in pixels used for the following
+/// spheres and cylinders. When size is greater than zero, the slice count of each
+/// object is reduced so that no segment of its outline is longer than size on the
+/// screen, and objects smaller than size are drawn as points. Set size to zero to
+/// always use the given slices and stacks.
+/// </summary>
+void _SetMeshDetail(MeshCache * cache, const float * projection, const float * modelview, float viewportHeight, float size);
+/// <summary>
+/// Adds an instance of the unit sphere with the given slices and stacks, moved to
+/// (x, y, z) and scaled to radius.
+/// </summary>
+void _AddSphere3D(MeshCache * cache, float x, float y, float z, float radius, int slices, int stacks, bool wire, unsigned int color);
+/// <summary>
+/// Adds an instance of the open unit cylinder with the given slices and stacks,
+/// extending from (x1, y1, z1) to (x2, y2, z2) with the given radius.
+/// </summary>
+void _AddCylinder3D(MeshCache * cache, float x1, float y1, float z1, float x2, float y2, float z2, float radius, int slices, int stacks, bool wire, unsigned int color);
+/// <summary>
+/// Returns the number of instances waiting to be drawn.
+/// </summary>
+int _GetPendingInstances(const MeshCache * cache);
+/// <summary>
+/// Draws the instances of all meshes, one call for each mesh, and clears them.
+/// The numbers of primitives and vertices drawn are added to primitives and vertices.
+/// </summary>
+void _FlushMeshCache(MeshCache * cache, Renderer * renderer, int * primitives, int * vertices);
+/// <summary>
+/// Appends the transformed vertices of all instances to triangles or lines instead
+/// of drawing them, and clears the instances. Used for geometry kept between frames.
+/// </summary>
+void _ExpandMeshCache(MeshCache * cache, LitBuffer * triangles, LitBuffer * lines);
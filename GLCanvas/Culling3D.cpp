@@ -0,0 +1,535 @@
+// Native code, compiled without /clr.
+
+#include "Culling3D.h"
+#include "GeometryKernels.h"
+#include "NativeMemory.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <xmmintrin.h>
+
+namespace
+{
+	// Maximum number of items in a leaf
+	const int LeafSize = 4;
+	// Depth of the traversal stack; median splits keep trees far shallower
+	const int StackSize = 64;
+	// Depth margin in normalized device coordinates, so that an occluder does not
+	// hide its own bounds through rounding
+	const float DepthBias = 1e-6f;
+	// Number of occluder vertices transformed at once, a multiple of three
+	const int OccluderChunk = 96;
+
+	inline float Min(float a, float b) { return a < b ? a : b; }
+	inline float Max(float a, float b) { return a > b ? a : b; }
+
+	// Total area of the faces of a box
+	float SurfaceArea(const BvhNode3D & node)
+	{
+		float dx = node.max[0] - node.min[0], dy = node.max[1] - node.min[1], dz = node.max[2] - node.min[2];
+		return 2.0f * (dx * dy + dy * dz + dz * dx);
+	}
+
+	// Sets the bounds of a leaf to the union of its items
+	void FitLeaf(BvhNode3D & node, const Bvh3D * bvh)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			node.min[k] = 3.4e38f;
+			node.max[k] = -3.4e38f;
+		}
+		for (int i = node.first; i < node.first + node.count; i++)
+		{
+			const float * b = bvh->bounds + bvh->order[i] * 6;
+			for (int k = 0; k < 3; k++)
+			{
+				if (b[k] < node.min[k]) node.min[k] = b[k];
+				if (b[3 + k] > node.max[k]) node.max[k] = b[3 + k];
+			}
+		}
+	}
+
+	// Sets the bounds of an inner node to the union of its children
+	void FitInner(BvhNode3D & node, const BvhNode3D & left, const BvhNode3D & right)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			node.min[k] = (left.min[k] < right.min[k] ? left.min[k] : right.min[k]);
+			node.max[k] = (left.max[k] > right.max[k] ? left.max[k] : right.max[k]);
+		}
+	}
+
+	// Builds the subtree of the items [first, first + count) and returns the index of its root
+	int Build(Bvh3D * bvh, int first, int count)
+	{
+		int index = bvh->nodeCount++;
+		BvhNode3D & node = bvh->nodes[index];
+		node.first = first;
+		node.count = count;
+		node.right = 0;
+		FitLeaf(node, bvh);
+		if (count <= LeafSize) return index;
+
+		// Split at the median center along the axis the centers spread the most
+		float cmin[3] = { 3.4e38f, 3.4e38f, 3.4e38f }, cmax[3] = { -3.4e38f, -3.4e38f, -3.4e38f };
+		for (int i = first; i < first + count; i++)
+		{
+			const float * b = bvh->bounds + bvh->order[i] * 6;
+			for (int k = 0; k < 3; k++)
+			{
+				float c = b[k] + b[3 + k];
+				if (c < cmin[k]) cmin[k] = c;
+				if (c > cmax[k]) cmax[k] = c;
+			}
+		}
+		int axis = 0;
+		if (cmax[1] - cmin[1] > cmax[axis] - cmin[axis]) axis = 1;
+		if (cmax[2] - cmin[2] > cmax[axis] - cmin[axis]) axis = 2;
+
+		const float * bounds = bvh->bounds;
+		int half = count / 2;
+		std::nth_element(bvh->order + first, bvh->order + first + half, bvh->order + first + count,
+			[bounds, axis](int a, int b) { return bounds[a * 6 + axis] + bounds[a * 6 + 3 + axis] < bounds[b * 6 + axis] + bounds[b * 6 + 3 + axis]; });
+
+		Build(bvh, first, half);
+		int right = Build(bvh, first + half, count - half);
+		bvh->nodes[index].right = right;
+		return index;
+	}
+
+	// Returns the plane mask of the planes the box is not entirely inside of, or -1 if
+	// the box is entirely outside of one of the planes
+	int Classify(const float * lo, const float * hi, const float * planes, int mask)
+	{
+		int result = 0;
+		for (int p = 0; p < 6; p++)
+		{
+			if ((mask & (1 << p)) == 0) continue;
+			const float * plane = planes + p * 4;
+			// Corners farthest along and against the plane normal
+			float farthest = plane[3], nearest = plane[3];
+			for (int k = 0; k < 3; k++)
+			{
+				if (plane[k] >= 0.0f)
+				{
+					farthest += plane[k] * hi[k];
+					nearest += plane[k] * lo[k];
+				}
+				else
+				{
+					farthest += plane[k] * lo[k];
+					nearest += plane[k] * hi[k];
+				}
+			}
+			if (farthest < 0.0f) return -1;
+			if (nearest < 0.0f) result |= (1 << p);
+		}
+		return result;
+	}
+
+	// Transforms a point by a column-major matrix into clip coordinates
+	void ToClip(const float * m, float x, float y, float z, float * clip)
+	{
+		for (int row = 0; row < 4; row++)
+			clip[row] = m[row] * x + m[4 + row] * y + m[8 + row] * z + m[12 + row];
+	}
+
+	// Rasterizes a triangle given in pixel coordinates with normalized device depth
+	void RasterizeTriangle(DepthBuffer3D * buffer, const float * a, const float * b, const float * c)
+	{
+		float area = (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+		if (area == 0.0f) return;
+		if (area < 0.0f)
+		{
+			const float * t = b; b = c; c = t;
+			area = -area;
+		}
+
+		// Pixel centers inside the bounding rectangle
+		int x1 = (int)floorf(Min(a[0], Min(b[0], c[0])) - 0.5f) + 1;
+		int x2 = (int)floorf(Max(a[0], Max(b[0], c[0])) - 0.5f);
+		int y1 = (int)floorf(Min(a[1], Min(b[1], c[1])) - 0.5f) + 1;
+		int y2 = (int)floorf(Max(a[1], Max(b[1], c[1])) - 0.5f);
+		if (x1 < 0) x1 = 0;
+		if (y1 < 0) y1 = 0;
+		if (x2 > buffer->width - 1) x2 = buffer->width - 1;
+		if (y2 > buffer->height - 1) y2 = buffer->height - 1;
+		if (x1 > x2 || y1 > y2) return;
+		x1 &= ~3;
+
+		// Edge functions e = A x + B y + C, positive inside, and the depth plane
+		const float * v[3] = { a, b, c };
+		float A[3], B[3], C[3];
+		for (int i = 0; i < 3; i++)
+		{
+			const float * p = v[i], * q = v[(i + 1) % 3];
+			A[i] = p[1] - q[1];
+			B[i] = q[0] - p[0];
+			C[i] = p[0] * q[1] - p[1] * q[0];
+		}
+		float dzdx = ((b[2] - a[2]) * (c[1] - a[1]) - (c[2] - a[2]) * (b[1] - a[1])) / area;
+		float dzdy = ((c[2] - a[2]) * (b[0] - a[0]) - (b[2] - a[2]) * (c[0] - a[0])) / area;
+		float dz = a[2] - dzdx * a[0] - dzdy * a[1];
+
+		const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 step = _mm_set1_ps(4.0f);
+		for (int y = y1; y <= y2; y++)
+		{
+			float py = (float)y + 0.5f;
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x1), offsets);
+			__m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[0]), px), _mm_set1_ps(B[0] * py + C[0]));
+			__m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[1]), px), _mm_set1_ps(B[1] * py + C[1]));
+			__m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[2]), px), _mm_set1_ps(B[2] * py + C[2]));
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), _mm_set1_ps(dzdy * py + dz));
+			__m128 de0 = _mm_mul_ps(_mm_set1_ps(A[0]), step), de1 = _mm_mul_ps(_mm_set1_ps(A[1]), step);
+			__m128 de2 = _mm_mul_ps(_mm_set1_ps(A[2]), step), ddz = _mm_mul_ps(_mm_set1_ps(dzdx), step);
+			float * row = buffer->depth + y * buffer->width;
+			for (int x = x1; x <= x2; x += 4)
+			{
+				__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+				if (_mm_movemask_ps(inside) != 0)
+				{
+					__m128 old = _mm_loadu_ps(row + x);
+					__m128 closer = _mm_min_ps(old, z);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, old)));
+				}
+				e0 = _mm_add_ps(e0, de0);
+				e1 = _mm_add_ps(e1, de1);
+				e2 = _mm_add_ps(e2, de2);
+				z = _mm_add_ps(z, ddz);
+			}
+		}
+	}
+
+	// Projects a clip space vertex to pixel coordinates and normalized device depth
+	void ToScreen(const DepthBuffer3D * buffer, const float * clip, float * screen)
+	{
+		float w = 1.0f / clip[3];
+		screen[0] = (clip[0] * w * 0.5f + 0.5f) * (float)buffer->width;
+		screen[1] = (clip[1] * w * 0.5f + 0.5f) * (float)buffer->height;
+		screen[2] = clip[2] * w;
+	}
+
+	// Clips a triangle in clip coordinates at the near plane and rasterizes the rest
+	void ClipTriangle(DepthBuffer3D * buffer, const float (* clip)[4])
+	{
+		float polygon[4][4];
+		int count = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			const float * p = clip[i], * q = clip[(i + 1) % 3];
+			float dp = p[2] + p[3], dq = q[2] + q[3];
+			if (dp >= 0.0f) memcpy(polygon[count++], p, sizeof(polygon[0]));
+			if ((dp >= 0.0f) != (dq >= 0.0f))
+			{
+				float t = dp / (dp - dq);
+				for (int k = 0; k < 4; k++)
+					polygon[count][k] = p[k] + t * (q[k] - p[k]);
+				count++;
+			}
+		}
+		if (count < 3) return;
+
+		float screen[4][3];
+		for (int i = 0; i < count; i++)
+		{
+			// Points on the near plane of an orthographic or degenerate view
+			if (polygon[i][3] <= 0.0f) return;
+			ToScreen(buffer, polygon[i], screen[i]);
+		}
+		RasterizeTriangle(buffer, screen[0], screen[1], screen[2]);
+		if (count == 4) RasterizeTriangle(buffer, screen[0], screen[2], screen[3]);
+	}
+
+	// Returns true if the pixels of the rectangle are all closer than the given depth
+	bool IsRectangleCovered(const DepthBuffer3D * buffer, int x1, int y1, int x2, int y2, float depth)
+	{
+		const __m128 limit = _mm_set1_ps(depth);
+		for (int y = y1; y <= y2; y++)
+		{
+			const float * row = buffer->depth + y * buffer->width;
+			int x = x1;
+			for (; x + 3 <= x2; x += 4)
+			{
+				if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), limit)) != 0) return false;
+			}
+			for (; x <= x2; x++)
+			{
+				if (row[x] >= depth) return false;
+			}
+		}
+		return true;
+	}
+}
+
+Bvh3D * _CreateBvh3D()
+{
+	Bvh3D * bvh = (Bvh3D *)_Allocate(sizeof(Bvh3D));
+	memset(bvh, 0, sizeof(Bvh3D));
+	return bvh;
+}
+
+void _DestroyBvh3D(Bvh3D * bvh)
+{
+	if (bvh == 0) return;
+	_Free(bvh->nodes);
+	_Free(bvh->order);
+	_Free(bvh->bounds);
+	_Free(bvh->transforms);
+	_Free(bvh->visible);
+	_Free(bvh);
+}
+
+void _ReserveBvhItems3D(Bvh3D * bvh, int capacity)
+{
+	if (capacity <= bvh->capacity) return;
+
+	int grown = bvh->capacity * 2;
+	if (grown < 64) grown = 64;
+	if (grown < capacity) grown = capacity;
+	bvh->nodes = (BvhNode3D *)_Reallocate(bvh->nodes, 2 * grown * sizeof(BvhNode3D));
+	bvh->order = (int *)_Reallocate(bvh->order, grown * sizeof(int));
+	bvh->bounds = (float *)_Reallocate(bvh->bounds, 6 * grown * sizeof(float));
+	bvh->transforms = (float *)_Reallocate(bvh->transforms, 16 * grown * sizeof(float));
+	bvh->visible = (unsigned char *)_Reallocate(bvh->visible, grown);
+	bvh->capacity = grown;
+}
+
+void _BuildBvh3D(Bvh3D * bvh)
+{
+	bvh->nodeCount = 0;
+	bvh->builtCount = bvh->count;
+	bvh->builtArea = 0.0f;
+	if (bvh->count == 0) return;
+
+	for (int i = 0; i < bvh->count; i++)
+		bvh->order[i] = i;
+	Build(bvh, 0, bvh->count);
+	for (int i = 0; i < bvh->nodeCount; i++)
+		bvh->builtArea += SurfaceArea(bvh->nodes[i]);
+}
+
+void _RefitBvh3D(Bvh3D * bvh)
+{
+	if (bvh->builtCount != bvh->count)
+	{
+		_BuildBvh3D(bvh);
+		return;
+	}
+
+	// Children follow their parents, so a reverse pass visits children first
+	float area = 0.0f;
+	for (int i = bvh->nodeCount - 1; i >= 0; i--)
+	{
+		BvhNode3D & node = bvh->nodes[i];
+		if (node.right == 0)
+			FitLeaf(node, bvh);
+		else
+			FitInner(node, bvh->nodes[i + 1], bvh->nodes[node.right]);
+		area += SurfaceArea(node);
+	}
+
+	// Objects moved far from the objects they were grouped with
+	if (area > 2.0f * bvh->builtArea) _BuildBvh3D(bvh);
+}
+
+int _CullBvh3D(Bvh3D * bvh, const float * planes)
+{
+	memset(bvh->visible, 0, bvh->count);
+	if (bvh->nodeCount == 0) return 0;
+
+	int visible = 0;
+	int stack[StackSize], masks[StackSize];
+	int top = 0;
+	stack[top] = 0;
+	masks[top++] = 0x3F;
+	while (top != 0)
+	{
+		top--;
+		int index = stack[top];
+		const BvhNode3D & node = bvh->nodes[index];
+		int mask = Classify(node.min, node.max, planes, masks[top]);
+		if (mask == -1) continue;
+
+		if (node.right == 0 && mask != 0)
+		{
+			// Items of a leaf crossing the frustum are tested one by one
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				int item = bvh->order[i];
+				const float * b = bvh->bounds + item * 6;
+				if (Classify(b, b + 3, planes, mask) == -1) continue;
+				bvh->visible[item] = 1;
+				visible++;
+			}
+		}
+		else if (mask == 0 || top + 2 > StackSize)
+		{
+			// The subtree is entirely inside, or too deep to descend
+			for (int i = node.first; i < node.first + node.count; i++)
+				bvh->visible[bvh->order[i]] = 1;
+			visible += node.count;
+		}
+		else
+		{
+			stack[top] = node.right;
+			masks[top++] = mask;
+			stack[top] = index + 1;
+			masks[top++] = mask;
+		}
+	}
+	return visible;
+}
+
+DepthBuffer3D * _CreateDepthBuffer3D(int width, int height)
+{
+	DepthBuffer3D * buffer = (DepthBuffer3D *)_Allocate(sizeof(DepthBuffer3D));
+	buffer->width = (width + 3) & ~3;
+	buffer->height = height;
+	buffer->depth = (float *)_Allocate(buffer->width * buffer->height * sizeof(float));
+	memset(buffer->viewProjection, 0, sizeof(buffer->viewProjection));
+	return buffer;
+}
+
+void _DestroyDepthBuffer3D(DepthBuffer3D * buffer)
+{
+	if (buffer == 0) return;
+	_Free(buffer->depth);
+	_Free(buffer);
+}
+
+void _ClearDepthBuffer3D(DepthBuffer3D * buffer, const float * projection, const float * modelview)
+{
+	_MultiplyMatrix3D(buffer->viewProjection, projection, modelview);
+	int count = buffer->width * buffer->height;
+	for (int i = 0; i < count; i++)
+		buffer->depth[i] = 1.0f;
+}
+
+void _RasterizeOccluder3D(DepthBuffer3D * buffer, const float * transform, const LitVertex * vertices, int count)
+{
+	float m[16];
+	_MultiplyMatrix3D(m, buffer->viewProjection, transform);
+
+	// Vertices are transformed a chunk of whole triangles at a time
+	float clip[OccluderChunk][4];
+	count -= count % 3;
+	for (int first = 0; first < count; first += OccluderChunk)
+	{
+		int chunk = (count - first < OccluderChunk ? count - first : OccluderChunk);
+		_TransformPoints3D(m, &vertices[first].x, sizeof(LitVertex), chunk, clip[0]);
+		for (int i = 0; i < chunk; i += 3)
+			ClipTriangle(buffer, clip + i);
+	}
+}
+
+bool _IsOccluded3D(const DepthBuffer3D * buffer, const float * bounds)
+{
+	// Screen rectangle and nearest depth of the corners
+	float sx1 = 3.4e38f, sy1 = 3.4e38f, sx2 = -3.4e38f, sy2 = -3.4e38f, nearest = 3.4e38f;
+	for (int i = 0; i < 8; i++)
+	{
+		float clip[4], screen[3];
+		ToClip(buffer->viewProjection, bounds[(i & 1) ? 3 : 0], bounds[(i & 2) ? 4 : 1], bounds[(i & 4) ? 5 : 2], clip);
+		if (clip[2] + clip[3] <= 0.0f || clip[3] <= 0.0f) return false;
+		ToScreen(buffer, clip, screen);
+		sx1 = Min(sx1, screen[0]); sx2 = Max(sx2, screen[0]);
+		sy1 = Min(sy1, screen[1]); sy2 = Max(sy2, screen[1]);
+		nearest = Min(nearest, screen[2]);
+	}
+
+	// Every pixel the box touches must hold a closer occluder
+	int x1 = (int)floorf(Max(sx1, 0.0f)), x2 = (int)floorf(Min(sx2, (float)(buffer->width - 1)));
+	int y1 = (int)floorf(Max(sy1, 0.0f)), y2 = (int)floorf(Min(sy2, (float)(buffer->height - 1)));
+	if (x1 > x2 || y1 > y2) return false;
+	return IsRectangleCovered(buffer, x1, y1, x2, y2, nearest - DepthBias);
+}
+
+int _CullOccluded3D(const DepthBuffer3D * buffer, Bvh3D * bvh)
+{
+	if (bvh->nodeCount == 0) return 0;
+
+	int hidden = 0;
+	int stack[StackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while (top != 0)
+	{
+		int index = stack[--top];
+		const BvhNode3D & node = bvh->nodes[index];
+
+		// Skip subtrees without visible items
+		bool any = false;
+		for (int i = node.first; i < node.first + node.count && !any; i++)
+			any = (bvh->visible[bvh->order[i]] != 0);
+		if (!any) continue;
+
+		float bounds[6] = { node.min[0], node.min[1], node.min[2], node.max[0], node.max[1], node.max[2] };
+		if (_IsOccluded3D(buffer, bounds))
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				unsigned char & visible = bvh->visible[bvh->order[i]];
+				if (visible != 0) hidden++;
+				visible = 0;
+			}
+		}
+		else if (node.right == 0 || top + 2 > StackSize)
+		{
+			for (int i = node.first; i < node.first + node.count; i++)
+			{
+				int item = bvh->order[i];
+				if (bvh->visible[item] == 0 || !_IsOccluded3D(buffer, bvh->bounds + item * 6)) continue;
+				bvh->visible[item] = 0;
+				hidden++;
+			}
+		}
+		else
+		{
+			stack[top++] = node.right;
+			stack[top++] = index + 1;
+		}
+	}
+	return hidden;
+}
+
+void _GetFrustumPlanes(const float * projection, const float * modelview, float * planes)
+{
+	// Planes are sums and differences of the rows of the combined matrix
+	float m[16];
+	_MultiplyMatrix3D(m, projection, modelview);
+	for (int p = 0; p < 6; p++)
+	{
+		int row = p / 2;
+		float sign = ((p & 1) ? -1.0f : 1.0f);
+		for (int k = 0; k < 4; k++)
+			planes[p * 4 + k] = m[k * 4 + 3] + sign * m[k * 4 + row];
+	}
+}
+
+void _MultiplyMatrix3D(float * result, const float * a, const float * b)
+{
+	for (int column = 0; column < 4; column++)
+		for (int row = 0; row < 4; row++)
+			result[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] +
+				a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+}
+
+void _TransformBounds3D(const float * matrix, const float * local, float * world)
+{
+	// Each axis of the result extends by the matrix column scaled by the box extent
+	for (int row = 0; row < 3; row++)
+	{
+		float lo = matrix[12 + row], hi = matrix[12 + row];
+		for (int k = 0; k < 3; k++)
+		{
+			float a = matrix[k * 4 + row] * local[k], b = matrix[k * 4 + row] * local[3 + k];
+			if (a < b) { lo += a; hi += b; }
+			else { lo += b; hi += a; }
+		}
+		world[row] = lo;
+		world[3 + row] = hi;
+	}
+}
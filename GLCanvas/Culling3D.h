@@ -0,0 +1,125 @@
+#pragma once
+
+// Native visibility culling of retained 3D objects. Objects are kept in a bounding
+// volume hierarchy of axis aligned boxes which is tested against the view frustum,
+// and optionally against a low resolution depth buffer of selected occluders. The
+// implementation is compiled without /clr.
+
+#include "VertexBuffer.h"
+
+/// <summary>
+/// Represents a node of a bounding volume hierarchy. The items of a node are the
+/// range [first, first + count) of the item order of the hierarchy. The left child
+/// of an inner node follows the node; right is the index of the right child, or 0
+/// for leaves.
+/// </summary>
+struct BvhNode3D
+{
+	float min[3], max[3];
+	int first, count;
+	int right;
+};
+/// <summary>
+/// Represents a bounding volume hierarchy over the objects of a scene. The caller
+/// fills the world bounds and transforms of the objects, then builds or refits
+/// the hierarchy.
+/// </summary>
+struct Bvh3D
+{
+	BvhNode3D * nodes;
+	int nodeCount;
+	int * order;				// item indices in leaf order
+	float * bounds;				// world bounds of each item as min x, y, z, max x, y, z
+	float * transforms;			// column-major model matrix of each item
+	unsigned char * visible;	// set by culling
+	int count;					// number of items
+	int capacity;				// number of items the arrays can hold
+	int builtCount;				// number of items when the hierarchy was built
+	float builtArea;			// total surface area of the nodes when the hierarchy was built
+};
+
+/// <summary>
+/// Creates an empty hierarchy.
+/// </summary>
+Bvh3D * _CreateBvh3D();
+/// <summary>
+/// Releases a hierarchy.
+/// </summary>
+void _DestroyBvh3D(Bvh3D * bvh);
+/// <summary>
+/// Makes room for the given number of items. Existing item data is preserved.
+/// </summary>
+void _ReserveBvhItems3D(Bvh3D * bvh, int capacity);
+/// <summary>
+/// Builds the hierarchy from the bounds of the items, splitting nodes at the median
+/// of the item centers along their longest axis.
+/// </summary>
+void _BuildBvh3D(Bvh3D * bvh);
+/// <summary>
+/// Updates the node bounds after items moved, without changing the tree. The tree is
+/// built again if it was built for a different number of items, or if the moves made
+/// the nodes more than twice as large in total as when the tree was built.
+/// </summary>
+void _RefitBvh3D(Bvh3D * bvh);
+/// <summary>
+/// Sets the visible flag of each item whose bounds intersect the frustum given by
+/// six planes (a, b, c, d with ax + by + cz + d >= 0 inside). Subtrees entirely inside
+/// the frustum are accepted without testing their items. Returns the number of
+/// visible items.
+/// </summary>
+int _CullBvh3D(Bvh3D * bvh, const float * planes);
+/// <summary>
+/// Represents a low resolution depth buffer rasterized on the CPU. Depths are
+/// normalized device z coordinates; the buffer is cleared to the far plane.
+/// </summary>
+struct DepthBuffer3D
+{
+	float * depth;
+	int width, height;			// width is a multiple of 4
+	float viewProjection[16];	// column-major projection * modelview
+};
+
+/// <summary>
+/// Creates a depth buffer of the given size. The width is rounded up to a multiple of 4.
+/// </summary>
+DepthBuffer3D * _CreateDepthBuffer3D(int width, int height);
+/// <summary>
+/// Releases a depth buffer.
+/// </summary>
+void _DestroyDepthBuffer3D(DepthBuffer3D * buffer);
+/// <summary>
+/// Clears the depth buffer to the far plane and sets the camera of the next frame.
+/// </summary>
+void _ClearDepthBuffer3D(DepthBuffer3D * buffer, const float * projection, const float * modelview);
+/// <summary>
+/// Rasterizes triangles transformed by a column-major model matrix into the depth
+/// buffer, four pixels at a time. Triangles are clipped at the near plane and both
+/// faces are drawn. Only pixels whose centers are covered are written, so occluders
+/// never hide more than they cover.
+/// </summary>
+void _RasterizeOccluder3D(DepthBuffer3D * buffer, const float * transform, const LitVertex * vertices, int count);
+/// <summary>
+/// Returns true if the world bounds given as min x, y, z, max x, y, z are entirely
+/// behind the depth buffer. Bounds crossing the near plane are never occluded.
+/// </summary>
+bool _IsOccluded3D(const DepthBuffer3D * buffer, const float * bounds);
+/// <summary>
+/// Clears the visible flag of visible items hidden behind the depth buffer. Nodes of
+/// the hierarchy are tested first, so hidden subtrees are skipped as a whole. Returns
+/// the number of items hidden.
+/// </summary>
+int _CullOccluded3D(const DepthBuffer3D * buffer, Bvh3D * bvh);
+/// <summary>
+/// Extracts the six planes of the view frustum in world coordinates from column-major
+/// projection and modelview matrices.
+/// </summary>
+void _GetFrustumPlanes(const float * projection, const float * modelview, float * planes);
+/// <summary>
+/// Multiplies two column-major 4x4 matrices.
+/// </summary>
+void _MultiplyMatrix3D(float * result, const float * a, const float * b);
+/// <summary>
+/// Computes the world bounds of a box in local coordinates transformed by a column-major
+/// matrix. Bounds are given as min x, y, z, max x, y, z.
+/// </summary>
+void _TransformBounds3D(const float * matrix, const float * local, float * world);
@@ -0,0 +1,70 @@
+// Native code, compiled without /clr.
+
+#include "Curves.h"
+
+#include <math.h>
+
+int _BezierSegments(const float * p, int degree, float tolerance, int maxSegments)
+{
+	// Wang's formula: n = sqrt(d (d - 1) / 8 * max |p[i] - 2 p[i + 1] + p[i + 2]| / tolerance)
+	float m = 0;
+	for (int i = 0; i + 2 <= degree; i++)
+	{
+		float dx = p[i * 2] - 2 * p[i * 2 + 2] + p[i * 2 + 4];
+		float dy = p[i * 2 + 1] - 2 * p[i * 2 + 3] + p[i * 2 + 5];
+		float d = dx * dx + dy * dy;
+		if (d > m) m = d;
+	}
+	if (!(tolerance > 0)) return maxSegments;
+	float n = sqrtf((float)(degree * (degree - 1)) / 8.0f * sqrtf(m) / tolerance);
+	if (!(n < (float)maxSegments)) return maxSegments;
+	int segments = (int)ceilf(n);
+	return segments < 1 ? 1 : segments;
+}
+
+void _FlattenBezier(const float * p, int degree, int segments, float * points)
+{
+	// Power basis coefficients: P(t) = a t^3 + b t^2 + c t + d
+	float ax, ay, bx, by, cx, cy, dx = p[0], dy = p[1];
+	if (degree == 2)
+	{
+		ax = ay = 0;
+		bx = p[0] - 2 * p[2] + p[4];
+		by = p[1] - 2 * p[3] + p[5];
+		cx = 2 * (p[2] - p[0]);
+		cy = 2 * (p[3] - p[1]);
+	}
+	else
+	{
+		ax = -p[0] + 3 * p[2] - 3 * p[4] + p[6];
+		ay = -p[1] + 3 * p[3] - 3 * p[5] + p[7];
+		bx = 3 * p[0] - 6 * p[2] + 3 * p[4];
+		by = 3 * p[1] - 6 * p[3] + 3 * p[5];
+		cx = 3 * (p[2] - p[0]);
+		cy = 3 * (p[3] - p[1]);
+	}
+
+	float step = 1.0f / (float)segments;
+	for (int i = 0; i <= segments; i++)
+	{
+		float t = (float)i * step;
+		points[i * 2] = ((ax * t + bx) * t + cx) * t + dx;
+		points[i * 2 + 1] = ((ay * t + by) * t + cy) * t + dy;
+	}
+
+	// End exactly on the last control point so that consecutive curves join without gaps
+	points[segments * 2] = p[degree * 2];
+	points[segments * 2 + 1] = p[degree * 2 + 1];
+}
+
+void _BSplineToBezier(const float * p, float * bezier)
+{
+	for (int k = 0; k < 2; k++)
+	{
+		float p0 = p[k], p1 = p[2 + k], p2 = p[4 + k], p3 = p[6 + k];
+		bezier[k] = (p0 + 4 * p1 + p2) / 6;
+		bezier[2 + k] = (2 * p1 + p2) / 3;
+		bezier[4 + k] = (p1 + 2 * p2) / 3;
+		bezier[6 + k] = (p1 + 4 * p2 + p3) / 6;
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Native flattening of Bezier curves and uniform cubic B-splines into polylines.
+// The implementation is compiled without /clr.
+
+/// <summary>
+/// Returns the number of line segments needed to flatten a Bezier curve of the given
+/// degree (2 or 3) so that the polyline deviates from the curve by at most tolerance.
+/// p holds degree + 1 control points as x, y pairs. The count is given by Wang's formula
+/// from the second differences of the control points and is limited to maxSegments.
+/// </summary>
+int _BezierSegments(const float * p, int degree, float tolerance, int maxSegments);
+/// <summary>
+/// Evaluates a Bezier curve of the given degree at segments + 1 evenly spaced
+/// parameters and writes the points to points as x, y pairs. The curve is evaluated
+/// in power basis at independent parameters, so the loop has no carried dependencies
+/// and is vectorized by the compiler.
+/// </summary>
+void _FlattenBezier(const float * p, int degree, int segments, float * points);
+/// <summary>
+/// Converts the span of a uniform cubic B-spline defined by four consecutive control
+/// points to the control points of the equivalent cubic Bezier curve.
+/// </summary>
+void _BSplineToBezier(const float * p, float * bezier);
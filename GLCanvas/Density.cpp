@@ -0,0 +1,181 @@
+// Native code, compiled without /clr.
+
+#include "Density.h"
+#include "JobSystem.h"
+#include "NativeMemory.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+struct DensityGrid
+{
+	int width, height;
+	std::vector<std::vector<unsigned int> > partial;	// counts of each thread
+	std::vector<unsigned int> counts;					// summed counts
+	std::vector<unsigned int> pixels;					// shaded counts
+	std::vector<unsigned int> rowMax;					// largest count of each row
+	std::vector<long long> rowSum;						// number of points in each row
+	unsigned int maxCount;
+};
+
+namespace
+{
+	// Number of points counted by one job
+	const int PointChunk = 65536;
+	// Number of rows summed or shaded by one job
+	const int RowChunk = 16;
+
+	struct AggregateJob
+	{
+		DensityGrid * grid;
+		const float * points;
+		float xmin, ymin, scale;
+	};
+
+	void ClearPartial(void * context, int begin, int end, int)
+	{
+		AggregateJob * job = (AggregateJob *)context;
+		DensityGrid * grid = job->grid;
+		for (int i = begin; i < end; i++)
+			memset(&grid->partial[i][0], 0, grid->partial[i].size() * sizeof(unsigned int));
+	}
+
+	void CountPoints(void * context, int begin, int end, int worker)
+	{
+		AggregateJob * job = (AggregateJob *)context;
+		DensityGrid * grid = job->grid;
+		unsigned int * cells = &grid->partial[worker][0];
+		const float width = (float)grid->width, height = (float)grid->height;
+		const int stride = grid->width;
+		const float * p = job->points + begin * 2;
+		for (int i = begin; i < end; i++, p += 2)
+		{
+			// NaN coordinates fail both tests and are skipped
+			float fx = (p[0] - job->xmin) * job->scale;
+			float fy = (p[1] - job->ymin) * job->scale;
+			if (!(fx >= 0 && fx < width && fy >= 0 && fy < height)) continue;
+			cells[(int)fy * stride + (int)fx]++;
+		}
+	}
+
+	void SumRows(void * context, int begin, int end, int)
+	{
+		AggregateJob * job = (AggregateJob *)context;
+		DensityGrid * grid = job->grid;
+		int threads = (int)grid->partial.size();
+		for (int y = begin; y < end; y++)
+		{
+			unsigned int * row = &grid->counts[y * grid->width];
+			memcpy(row, &grid->partial[0][y * grid->width], grid->width * sizeof(unsigned int));
+			for (int t = 1; t < threads; t++)
+			{
+				const unsigned int * other = &grid->partial[t][y * grid->width];
+				for (int x = 0; x < grid->width; x++) row[x] += other[x];
+			}
+			unsigned int largest = 0;
+			long long sum = 0;
+			for (int x = 0; x < grid->width; x++)
+			{
+				if (row[x] > largest) largest = row[x];
+				sum += row[x];
+			}
+			grid->rowMax[y] = largest;
+			grid->rowSum[y] = sum;
+		}
+	}
+
+	struct ShadeJob
+	{
+		DensityGrid * grid;
+		const unsigned int * colormap;
+		int colorCount;
+		float scale;
+	};
+
+	void ShadeRows(void * context, int begin, int end, int)
+	{
+		ShadeJob * job = (ShadeJob *)context;
+		DensityGrid * grid = job->grid;
+		int last = job->colorCount - 1;
+		for (int i = begin * grid->width; i < end * grid->width; i++)
+		{
+			unsigned int count = grid->counts[i];
+			if (count == 0)
+			{
+				grid->pixels[i] = 0;
+				continue;
+			}
+			int index = (int)(logf((float)count) * job->scale + 0.5f);
+			grid->pixels[i] = job->colormap[index < last ? index : last];
+		}
+	}
+}
+
+DensityGrid * _CreateDensityGrid()
+{
+	DensityGrid * grid = new DensityGrid();
+	_CountAllocation();
+	grid->width = 0;
+	grid->height = 0;
+	grid->maxCount = 0;
+	return grid;
+}
+
+void _DestroyDensityGrid(DensityGrid * grid)
+{
+	delete grid;
+}
+
+long long _AggregateDensity(DensityGrid * grid, JobSystem * jobs, const float * points, int count,
+	float xmin, float ymin, float cellSize, int width, int height)
+{
+	grid->width = (width > 0 ? width : 0);
+	grid->height = (height > 0 ? height : 0);
+	grid->maxCount = 0;
+	size_t cells = (size_t)grid->width * grid->height;
+	if (cells == 0 || !(cellSize > 0)) return 0;
+
+	// Grids only grow, so redrawing at the same size does not allocate
+	size_t threads = (size_t)_JobThreadCount(jobs);
+	if (grid->partial.size() < threads) grid->partial.resize(threads);
+	for (size_t t = 0; t < grid->partial.size(); t++)
+	{
+		if (grid->partial[t].size() != cells)
+		{
+			if (grid->partial[t].capacity() < cells) _CountAllocation();
+			grid->partial[t].resize(cells);
+		}
+	}
+	if (grid->counts.capacity() < cells || grid->rowMax.capacity() < (size_t)grid->height) _CountAllocation();
+	grid->counts.resize(cells);
+	grid->rowMax.resize(grid->height);
+	grid->rowSum.resize(grid->height);
+
+	AggregateJob job = { grid, points, xmin, ymin, 1.0f / cellSize };
+	_ParallelFor(jobs, (int)grid->partial.size(), 1, ClearPartial, &job);
+	_ParallelFor(jobs, count, PointChunk, CountPoints, &job);
+	_ParallelFor(jobs, grid->height, RowChunk, SumRows, &job);
+
+	long long inside = 0;
+	for (int y = 0; y < grid->height; y++)
+	{
+		if (grid->rowMax[y] > grid->maxCount) grid->maxCount = grid->rowMax[y];
+		inside += grid->rowSum[y];
+	}
+	return inside;
+}
+
+const unsigned int * _ShadeDensity(DensityGrid * grid, JobSystem * jobs, const unsigned int * colormap, int colorCount)
+{
+	size_t cells = (size_t)grid->width * grid->height;
+	if (cells == 0 || colorCount < 1) return 0;
+	if (grid->pixels.capacity() < cells) _CountAllocation();
+	grid->pixels.resize(cells);
+
+	// A single point maps to the first color and the largest count to the last
+	float range = logf((float)(grid->maxCount > 1 ? grid->maxCount : 2));
+	ShadeJob job = { grid, colormap, colorCount, (float)(colorCount - 1) / range };
+	_ParallelFor(jobs, grid->height, RowChunk, ShadeRows, &job);
+	return &grid->pixels[0];
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Native density aggregation for scatter plots with more points than pixels.
+// Points are counted into a screen sized grid in parallel and the counts are
+// shaded with a colormap. The implementation is compiled without /clr.
+
+struct DensityGrid;
+struct JobSystem;
+
+/// <summary>
+/// Creates an empty density grid. The grid keeps its memory between frames.
+/// </summary>
+DensityGrid * _CreateDensityGrid();
+/// <summary>
+/// Releases a density grid.
+/// </summary>
+void _DestroyDensityGrid(DensityGrid * grid);
+/// <summary>
+/// Counts the points falling into each cell of a width by height grid whose lower left
+/// corner is at xmin, ymin and whose cells are cellSize wide. points holds x, y pairs.
+/// Points are split between the threads of the job system; each thread counts into its
+/// own grid and the grids are summed by rows. Returns the number of points inside the grid.
+/// </summary>
+long long _AggregateDensity(DensityGrid * grid, JobSystem * jobs, const float * points, int count,
+	float xmin, float ymin, float cellSize, int width, int height);
+/// <summary>
+/// Shades the counts of the last aggregation into R, G, B, A pixels, rows from bottom to top.
+/// Counts are mapped to colormap logarithmically, from one point to the largest count.
+/// Empty cells are transparent. The pixels remain valid until the next call with the same grid.
+/// </summary>
+const unsigned int * _ShadeDensity(DensityGrid * grid, JobSystem * jobs, const unsigned int * colormap, int colorCount);
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "GLCommandBuffer.h"
+#include "GLGraphics2D.h"
+#include "Tessellator2D.h"
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Represents a reusable symbol, such as a door or a valve in a CAD drawing. The
+	/// block is defined by drawing commands recorded into a command buffer in block
+	/// coordinates, and is tessellated once. Each GLGraphics2D.DrawBlock call draws a
+	/// reference to the block with its own transform and color, by transforming the
+	/// tessellated vertices of the block instead of tessellating the symbol again.
+	/// The block is tessellated again only when references are zoomed in or out by
+	/// more than a factor of two, so that curves stay smooth.
+	/// </summary>
+	public ref class GLBlock
+	{
+	// Member variables
+	private:
+		Block2D * mBlock;
+		bool mTessellated;
+		int mBand;
+		int mRequiredBand;
+		int mFrame;
+		int mIndex;
+		Drawing::RectangleF mBounds;
+
+	// Constructor/destructor
+	public:
+		/// <summary>
+		/// Initializes a new instance of the GLBlock class.
+		/// </summary>
+		/// <param name="definition">Drawing commands defining the block in block coordinates.
+		/// Text cannot be drawn in a block.</param>
+		GLBlock(GLCommandBuffer ^ definition)
+		{
+			if (definition == nullptr) throw gcnew ArgumentNullException(L"definition");
+
+			mBlock = _CreateBlock2D();
+			mFrame = 0;
+			mIndex = 0;
+			try
+			{
+				GLGraphics2D::CaptureCommands(definition, mBlock->definition);
+			}
+			catch (Exception ^)
+			{
+				_DestroyBlock2D(mBlock);
+				mBlock = 0;
+				throw;
+			}
+
+			// Only compute the bounds; the block is tessellated when the
+			// pixel size of the first reference is known
+			_TessellateBlock2D(mBlock, 0.0f);
+			mTessellated = false;
+			mBand = 0;
+			mBounds = Drawing::RectangleF(mBlock->xmin, mBlock->ymin, mBlock->xmax - mBlock->xmin, mBlock->ymax - mBlock->ymin);
+		}
+
+		~GLBlock() // Dispose
+		{
+			this->!GLBlock();
+		}
+
+	protected:
+		!GLBlock() // Finalize
+		{
+			_DestroyBlock2D(mBlock);
+			mBlock = 0;
+		}
+
+	// Properties
+	public:
+		/// <summary>
+		/// Gets the bounding rectangle of the block in block coordinates.
+		/// </summary>
+		property Drawing::RectangleF Bounds
+		{
+			virtual Drawing::RectangleF get(void) { return mBounds; }
+		}
+		/// <summary>
+		/// Gets the number of drawing objects in the block.
+		/// </summary>
+		property int PrimitiveCount
+		{
+			virtual int get(void) { return mBlock->definition->primitiveCount; }
+		}
+		/// <summary>
+		/// Gets the number of vertices of the tessellated block.
+		/// </summary>
+		property int VertexCount
+		{
+			virtual int get(void) { return mBlock->lines->count + mBlock->strips->count + mBlock->triangles->count; }
+		}
+
+	internal:
+		/// <summary>
+		/// Gets the native block.
+		/// </summary>
+		property Block2D * Block
+		{
+			Block2D * get(void) { return mBlock; }
+		}
+		/// <summary>
+		/// Gets or sets the index of the block in the block list of the current frame.
+		/// </summary>
+		property int Index
+		{
+			int get(void) { return mIndex; }
+			void set(int value) { mIndex = value; }
+		}
+
+	// Implementation
+	internal:
+		/// <summary>
+		/// Records the pixel size a reference needs in block coordinates. The finest
+		/// pixel size of all references in a frame is used to tessellate the block.
+		/// </summary>
+		/// <param name="pixelSize">Size of a pixel in block coordinates</param>
+		/// <param name="frame">Number of the frame the reference is drawn in</param>
+		/// <returns>true for the first reference of the frame</returns>
+		bool Require(float pixelSize, int frame)
+		{
+			int band = (int)Math::Floor(Math::Log(Math::Max((double)pixelSize, 1.0e-30), 2.0));
+			if (mFrame != frame)
+			{
+				mFrame = frame;
+				mRequiredBand = band;
+				return true;
+			}
+			mRequiredBand = Math::Min(mRequiredBand, band);
+			return false;
+		}
+		/// <summary>
+		/// Tessellates the block again if the references of the current frame need a
+		/// pixel size finer than, or more than four times coarser than, the tessellation.
+		/// </summary>
+		System::Void Prepare()
+		{
+			if (mTessellated && mRequiredBand >= mBand && mRequiredBand <= mBand + 2) return;
+
+			_TessellateBlock2D(mBlock, (float)Math::Pow(2.0, mRequiredBand));
+			mTessellated = true;
+			mBand = mRequiredBand;
+		}
+	};
+
+}
@@ -2,8 +2,10 @@
 #include "GLCanvas2D.h"
 #include "GLGraphics2D.h"
 #include "EventArgs.h"
+#include "GLExtensions.h"
 #include "GLVertexArray.h"
 #include "GLPerformanceTimer.h"
+#include "GLRenderStatistics.h"
 
 #pragma warning(disable:4100)
 
@@ -52,6 +54,14 @@ namespace GLCanvas {
 		mSelecting = false;
 		mCameraPosition = PointF(0, 0);
 		mAntiAlias = false;
+		mParallelTessellation = true;
+		mLevelOfDetail = 0.0f;
+		mCurveFlatness = 0.25f;
+		mAnalyticShapes = false;
+		mRenderBackend = GLRenderBackend::FixedFunction;
+		mRendererBackend = GLRenderBackend::FixedFunction;
+		mRenderer = 0;
+		mStatistics = gcnew GLRenderStatistics();
 
 		if(!this->DesignMode)
 		{
@@ -81,8 +91,10 @@ namespace GLCanvas {
 			SetPixelFormat(mhDC, iPixelFormat, &pfd);
 			mIsAccelerated = !(pfd.dwFlags & PFD_GENERIC_FORMAT);
 
-			// Create the render context
-			mhGLRC = wglCreateContext(mhDC);
+			// Create the render context. The programmable backend needs OpenGL 3.3, while
+			// text, picking and the grid are still drawn with fixed function, so this is a
+			// compatibility profile context where the driver provides one.
+			mhGLRC = (HGLRC)_CreateGLContext(mhDC, false);
 			wglMakeCurrent(mhDC, mhGLRC);
 
 			// Set the viewport
@@ -114,8 +126,19 @@ namespace GLCanvas {
 
 	GLCanvas2D::~GLCanvas2D()
 	{
+		// Release the graphics object
+		delete mGraphics;
+
 		if(!this->DesignMode)
 		{
+			// Release the renderer while its context is current
+			if (mRenderer != 0)
+			{
+				wglMakeCurrent(mhDC, mhGLRC);
+				_DestroyRenderer(mRenderer);
+				mRenderer = 0;
+			}
+
 			wglMakeCurrent(NULL, NULL);
 			wglDeleteContext(mhGLRC);
 			ReleaseDC((HWND)this->Handle.ToPointer(), mhDC);
@@ -135,6 +158,8 @@ namespace GLCanvas {
 			return;
 		}
 
+		mStatistics->BeginFrame();
+
 		// Save previous context and make our context current
 		bool contextDifferent = (wglGetCurrentContext() != mhGLRC);
 		HDC mhOldDC = 0;
@@ -145,11 +170,14 @@ namespace GLCanvas {
 			mhOldGLRC = wglGetCurrentContext();
 			wglMakeCurrent(mhDC, mhGLRC);
 		}
+		UpdateRenderer();
 
-		// Set an orthogonal projection matrix
+		// Set an orthogonal projection matrix. It is computed on the CPU so that drawing
+		// objects do not read it back from the context.
+		float projection[16];
+		GetProjection(projection);
 		glMatrixMode(GL_PROJECTION);
-		glLoadIdentity();
-		glOrtho(mCameraPosition.X - ((float)ClientRectangle.Width) * mZoomFactor / 2, mCameraPosition.X + ((float)ClientRectangle.Width) * mZoomFactor / 2, mCameraPosition.Y - ((float)ClientRectangle.Height) * mZoomFactor / 2, mCameraPosition.Y + ((float)ClientRectangle.Height) * mZoomFactor / 2, -1.0f, 1.0f);
+		glLoadMatrixf(projection);
 
 		// Set the model matrix as the current matrix
 		glMatrixMode(GL_MODELVIEW);
@@ -158,8 +186,14 @@ namespace GLCanvas {
 		// Get view bounds
 		Drawing::RectangleF bounds = GetViewPort();
 
-		// Create the GLGraphics object
-		GLCanvas::GLGraphics2D ^ graphics = gcnew GLCanvas::GLGraphics2D(this, e->Graphics);
+		// Create the GLGraphics object on first use. The same object is used for all 
+		// frames so that memory allocated for drawing objects is retained.
+		if (mGraphics == nullptr)
+		{
+			mGraphics = gcnew GLCanvas::GLGraphics2D(this);
+			mRenderArgs = gcnew GLCanvas::Canvas2DRenderEventArgs(mGraphics);
+		}
+		mGraphics->BeginFrame(e->Graphics);
 
 		// Clear screen
 		glClearColor(((float)BackColor.R) / 255, ((float)BackColor.G) / 255, ((float)BackColor.B) / 255, ((float)BackColor.A) / 255);
@@ -243,11 +277,11 @@ namespace GLCanvas {
 
 		// Raise the custom draw event
 		glLoadIdentity();
-		OnRender(gcnew GLCanvas::Canvas2DRenderEventArgs(graphics));
+		OnRender(mRenderArgs);
 
 		// Render drawing objects
 		glLoadIdentity();
-		mLimits = graphics->Render();
+		mLimits = mGraphics->Render(mStatistics);
 
 		// Draw selection rectangle if in selection mode
 		float r;
@@ -379,8 +413,10 @@ namespace GLCanvas {
 			wglMakeCurrent(mhOldDC, mhOldGLRC);
 		}
 
+		mStatistics->EndFrame();
+
 		// Raise the render done event
-		OnRenderDone(gcnew System::EventArgs());
+		OnRenderDone(System::EventArgs::Empty);
 	}
 
 	void GLCanvas2D::OnPaintBackground(System::Windows::Forms::PaintEventArgs^ e) 
@@ -416,6 +452,24 @@ namespace GLCanvas {
 		}
 	}
 
+	System::Void GLCanvas2D::GetProjection(float * projection)
+	{
+		float halfWidth = ((float)ClientRectangle.Width) * mZoomFactor / 2;
+		float halfHeight = ((float)ClientRectangle.Height) * mZoomFactor / 2;
+		_OrthoMatrix(projection, mCameraPosition.X - halfWidth, mCameraPosition.X + halfWidth, mCameraPosition.Y - halfHeight, mCameraPosition.Y + halfHeight, -1.0f, 1.0f);
+	}
+
+	System::Void GLCanvas2D::UpdateRenderer()
+	{
+		if (mRenderer != 0 && mRendererBackend == mRenderBackend) return;
+
+		// Fall back to the fixed function pipeline if the backend is not supported
+		_DestroyRenderer(mRenderer);
+		mRenderer = _CreateRenderer((int)mRenderBackend);
+		if (mRenderer == 0) mRenderer = _CreateRenderer(RENDERBACKEND_FIXEDFUNCTION);
+		mRendererBackend = mRenderBackend;
+	}
+
 	System::Void GLCanvas2D::ControlMouseDown(System::Object^ sender, System::Windows::Forms::MouseEventArgs^ e)
 	{
 		if ((e->Button == Windows::Forms::MouseButtons::Middle) && AllowZoomAndPan && !(mSelecting))
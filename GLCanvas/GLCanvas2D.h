@@ -2,6 +2,7 @@
 
 #include <windows.h>
 #include <GL/gl.h>
+#include "GLRenderBackend.h"
 
 using namespace System;
 using namespace System::Drawing;
@@ -13,6 +14,7 @@ namespace GLCanvas {
 
 	// Forward class declarations
 	ref class GLGraphics2D;
+	ref class GLRenderStatistics;
 	ref class Canvas2DRenderEventArgs;
 	ref class Canvas2DMouseSelectEventArgs;
 
@@ -111,7 +113,17 @@ namespace GLCanvas {
 		Drawing::Color mAxisColor;
 		bool mDynamicGrid;
 		bool mAntiAlias;
+		bool mParallelTessellation;
+		float mLevelOfDetail;
+		float mCurveFlatness;
+		bool mAnalyticShapes;
+		GLRenderBackend mRenderBackend;
+		GLRenderBackend mRendererBackend;
+		Renderer * mRenderer;
 		GLuint base, rasterbase;
+		GLGraphics2D ^ mGraphics;
+		Canvas2DRenderEventArgs ^ mRenderArgs;
+		GLRenderStatistics ^ mStatistics;
 
 	public:
 		/// <summary>
@@ -132,6 +144,14 @@ namespace GLCanvas {
 			virtual bool get(void) { return mIsAccelerated; }
 		}
 		/// <summary>
+		/// Gets statistics about the last frame drawn by the canvas.
+		/// </summary>
+		[Category("Behavior"), Browsable(false), Description("Gets statistics about the last frame drawn by the canvas.")]
+		property GLRenderStatistics ^ Statistics
+		{
+			virtual GLRenderStatistics ^ get(void) { return mStatistics; }
+		}
+		/// <summary>
 		/// Determines if the user is currently selecting with the mouse.
 		/// </summary>
 		[Category("Behavior"), Browsable(false), DefaultValue(false), Description("Determines if the user is currently selecting with the mouse.")]
@@ -248,6 +268,65 @@ namespace GLCanvas {
 			}
 		}
 		/// <summary>
+		/// Determines whether drawing objects are tessellated on all processor cores.
+		/// </summary>
+		[Category("Behavior"), Browsable(true), DefaultValue(true), Description("Determines whether drawing objects are tessellated on all processor cores.")]
+		property bool ParallelTessellation
+		{
+			virtual bool get(void) { return mParallelTessellation; }
+			virtual void set(bool value) { mParallelTessellation = value; Invalidate(); }
+		}
+		/// <summary>
+		/// Gets or sets the level of detail size in pixels. Drawing objects smaller than this
+		/// size are drawn as dots, and polygon outlines are simplified so that they do not
+		/// deviate from the original by more than this size. The default of zero draws full detail.
+		/// </summary>
+		[Category("Behavior"), Browsable(true), DefaultValue(0.0f), Description("Gets or sets the level of detail size in pixels. Set to zero to draw full detail.")]
+		property float LevelOfDetail
+		{
+			virtual float get(void) { return mLevelOfDetail; }
+			virtual void set(float value) { mLevelOfDetail = Math::Max(value, 0.0f); Invalidate(); }
+		}
+		/// <summary>
+		/// Gets or sets the largest distance in pixels between a curve and the line
+		/// segments it is drawn with. Smaller values draw smoother curves with more segments.
+		/// </summary>
+		[Category("Appearance"), Browsable(true), DefaultValue(0.25f), Description("Gets or sets the largest distance in pixels between a curve and the line segments it is drawn with.")]
+		property float CurveFlatness
+		{
+			virtual float get(void) { return mCurveFlatness; }
+			virtual void set(float value) { mCurveFlatness = Math::Max(value, 0.01f); Invalidate(); }
+		}
+		/// <summary>
+		/// Gets or sets whether ellipses and rounded rectangles are drawn with a shader computing
+		/// their coverage per pixel instead of being tessellated. The setting is ignored if the
+		/// graphics hardware does not support OpenGL 2.0.
+		/// </summary>
+		[Category("Appearance"), Browsable(true), DefaultValue(false), Description("Gets or sets whether ellipses and rounded rectangles are drawn with a shader instead of being tessellated.")]
+		property bool AnalyticShapes
+		{
+			virtual bool get(void) { return mAnalyticShapes; }
+			virtual void set(bool value) { mAnalyticShapes = value; Invalidate(); }
+		}
+		/// <summary>
+		/// Gets or sets the OpenGL pipeline drawing objects are drawn with. The canvas falls
+		/// back to the fixed function pipeline if the driver does not support the programmable one.
+		/// </summary>
+		[Category("Behavior"), Browsable(true), DefaultValue(GLRenderBackend::typeid, "FixedFunction"), Description("Gets or sets the OpenGL pipeline drawing objects are drawn with.")]
+		property GLRenderBackend RenderBackend
+		{
+			virtual GLRenderBackend get(void) { return mRenderBackend; }
+			virtual void set(GLRenderBackend value) { mRenderBackend = value; Invalidate(); }
+		}
+		/// <summary>
+		/// Gets the OpenGL pipeline the last frame was drawn with.
+		/// </summary>
+		[Category("Behavior"), Browsable(false), Description("Gets the OpenGL pipeline the last frame was drawn with.")]
+		property GLRenderBackend ActiveRenderBackend
+		{
+			virtual GLRenderBackend get(void) { return (mRenderer == 0 ? GLRenderBackend::FixedFunction : (GLRenderBackend)_GetRenderBackend(mRenderer)); }
+		}
+		/// <summary>
 		/// Gets or sets the color of selection lines.
 		/// </summary>
 		[Category("Appearance"), Browsable(true), DefaultValue(System::Drawing::Color::typeid, "HighLight"), Description("Gets or sets the color of selection lines.")]
@@ -318,6 +397,26 @@ namespace GLCanvas {
 			}
 		}
 
+	internal:
+		/// <summary>
+		/// Gets the size of a pixel in world coordinates.
+		/// </summary>
+		property float PixelSize
+		{
+			float get(void) { return mZoomFactor; }
+		}
+		/// <summary>
+		/// Gets the renderer of the canvas. Only valid while the canvas is drawing.
+		/// </summary>
+		property Renderer * NativeRenderer
+		{
+			Renderer * get(void) { return mRenderer; }
+		}
+		/// <summary>
+		/// Computes the column-major orthographic projection of the camera and zoom factor.
+		/// </summary>
+		System::Void GetProjection(float * projection);
+
 	// Public methods
 	public:
 		/// <summary>
@@ -424,6 +523,10 @@ namespace GLCanvas {
 		System::Void ResetViewport();
 
 	private:
+		/// <summary>
+		/// Creates the renderer of the selected backend. The context of the canvas must be current.
+		/// </summary>
+		System::Void UpdateRenderer();
 		System::Void ControlResize(System::Object^ sender, System::EventArgs^ e);
 		System::Void ControlMouseDown(System::Object^ sender, System::Windows::Forms::MouseEventArgs^ e);
 		System::Void ControlMouseMove(System::Object^ sender, System::Windows::Forms::MouseEventArgs^ e);
@@ -2,7 +2,12 @@
 #include "GLCanvas3D.h"
 #include "GLGraphics3D.h"
 #include "GLPickBox.h"
+#include "GLRenderStatistics.h"
+#include "GLScene3D.h"
+#include "GLVertexArray.h"
+#include "Batch3D.h"
 #include "EventArgs.h"
+#include "GLExtensions.h"
 #include "Utility.h"
 #include "Camera.h"
 
@@ -54,6 +59,13 @@ namespace GLCanvas {
 
 		mOrigin = Point3D(0, 0, 0);
 		mSize = 1.0f;
+		mRenderBackend = GLRenderBackend::FixedFunction;
+		mRendererBackend = GLRenderBackend::FixedFunction;
+		mRenderer = 0;
+		mLevelOfDetail = 0.0f;
+		mFloor = _CreateLitBuffer();
+		mPickBoxes = _CreateBoxList();
+		mPickVertices = _CreateLitBuffer();
 
 		if(!this->DesignMode)
 		{
@@ -83,8 +95,10 @@ namespace GLCanvas {
 			SetPixelFormat(mhDC, iPixelFormat, &pfd);
 			mIsAccelerated = !(pfd.dwFlags & PFD_GENERIC_FORMAT);
 
-			// Create the render context
-			mhGLRC = wglCreateContext(mhDC);
+			// Create the render context. The programmable backend needs OpenGL 3.3, while
+			// text, picking and the grid are still drawn with fixed function, so this is a
+			// compatibility profile context where the driver provides one.
+			mhGLRC = (HGLRC)_CreateGLContext(mhDC, false);
 			wglMakeCurrent(mhDC, mhGLRC);
 
 			// Set the viewport
@@ -142,12 +156,24 @@ namespace GLCanvas {
 			// Object IDs for selection mode
 			selectBoxes = gcnew Dictionary<GLuint, GLPickBox>();
 		}
+
+		mStatistics = gcnew GLRenderStatistics();
 	}
 
 	GLCanvas3D::~GLCanvas3D()
 	{
 		if(!this->DesignMode)
 		{
+			// Release the renderer, the scene buffers and the mesh buffers while the context is current
+			if (mRenderer != 0)
+			{
+				wglMakeCurrent(mhDC, mhGLRC);
+				if (mScene != nullptr) mScene->Release();
+				if (mGraphics != nullptr) mGraphics->ReleaseMeshes(true);
+				_DestroyRenderer(mRenderer);
+				mRenderer = 0;
+			}
+
 			wglMakeCurrent(NULL, NULL);
 			wglDeleteContext(mhGLRC);
 			ReleaseDC((HWND)this->Handle.ToPointer(), mhDC);
@@ -159,6 +185,16 @@ namespace GLCanvas {
 			// Delete the selection buffer
 			delete[] selectBuffer;
 		}
+
+		// Release the graphics object
+		delete mGraphics;
+
+		_DestroyLitBuffer(mFloor);
+		_DestroyBoxList(mPickBoxes);
+		_DestroyLitBuffer(mPickVertices);
+		mFloor = 0;
+		mPickBoxes = 0;
+		mPickVertices = 0;
 	}
 
 	void GLCanvas3D::OnPaint(System::Windows::Forms::PaintEventArgs^ e) 
@@ -170,6 +206,8 @@ namespace GLCanvas {
 			return;
 		}
 
+		mStatistics->BeginFrame();
+
 		// Save previous context and make our context current
 		bool contextDifferent = (wglGetCurrentContext() != mhGLRC);
 		HDC mhOldDC = 0;
@@ -180,29 +218,31 @@ namespace GLCanvas {
 			mhOldGLRC = wglGetCurrentContext();
 			wglMakeCurrent(mhDC, mhGLRC);
 		}
+		UpdateRenderer();
 	
-		// Set the view frustrum
-		glMatrixMode(GL_PROJECTION);
-		glLoadIdentity();
+		// Set the view frustrum and the camera. The matrices are computed on the CPU and
+		// loaded for the parts still drawn with fixed function.
+		float projection[16], modelview[16];
+		GetViewMatrices(projection, modelview);
 		int cheight = Math::Max(1, this->ClientRectangle.Height);
-		float fwidth = 1.0f * (float)this->ClientRectangle.Width / (float)cheight;
-		if(Perspective)
-		{
-			glFrustum(-fwidth, fwidth, -1, 1, 1.0f, 100000.0f);
-		}
-		else
-		{
-			float zoom = 1.0f / Math::Max(0.00001f, mCamera->Distance);
-			glOrtho(-fwidth / zoom, fwidth / zoom, -1 / zoom, 1 / zoom, 1.0f, 100000.0f);
-		}
-
-		// Set the camera
+		glMatrixMode(GL_PROJECTION);
+		glLoadMatrixf(projection);
 		glMatrixMode(GL_MODELVIEW);
-		glLoadIdentity();
-		gluLookAt(mCamera->Position.X, mCamera->Position.Y, mCamera->Position.Z, mCamera->Target.X, mCamera->Target.Y, mCamera->Target.Z, mCamera->Up.X, mCamera->Up.Y, mCamera->Up.Z);
+		glLoadMatrixf(modelview);
+
+		// Pass the camera and the light to the renderer
+		_SetRenderTransform(mRenderer, projection, modelview);
+		const float light[3] = { 1.0f, 1.0f, 1.0f };
+		_SetRenderLighting(mRenderer, mLighting, light);
 
-		// Create the GLGraphics object
-		GLCanvas::GLGraphics3D ^ graphics = gcnew GLCanvas::GLGraphics3D(this, e->Graphics);
+		// Create the GLGraphics object on first use. The same object is used for all frames.
+		if (mGraphics == nullptr)
+		{
+			mGraphics = gcnew GLCanvas::GLGraphics3D(this);
+			mRenderArgs = gcnew GLCanvas::Canvas3DRenderEventArgs(mGraphics);
+		}
+		mGraphics->BeginFrame(e->Graphics);
+		mGraphics->SetLevelOfDetail(projection, modelview, (float)cheight, mLevelOfDetail);
 
 		// Clear screen
 		glClearColor(((float)BackColor.R) / 255, ((float)BackColor.G) / 255, ((float)BackColor.B) / 255, ((float)BackColor.A) / 255);
@@ -210,50 +250,36 @@ namespace GLCanvas {
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// Raise the custom draw event
-		OnRender(gcnew GLCanvas::Canvas3DRenderEventArgs(graphics));
+		OnRender(mRenderArgs);
+		mGraphics->Flush();
+
+		// Draw the retained scene
+		if (mScene != nullptr)
+			mScene->Render(mRenderer, mGraphics, mStatistics, projection, modelview);
+
+		// Release the buffers of meshes which were not drawn in this frame
+		mGraphics->ReleaseMeshes(false);
 		
 		// Get view properties
-		mOrigin = graphics->ModelOrigin();
-		mSize = graphics->ModelSize();
+		mOrigin = mGraphics->ModelOrigin();
+		mSize = mGraphics->ModelSize();
 
 		// Draw the floor
 		if(this->DrawFloor)
-		{
-			float floorSize = 5.0f * mSize;
-			glColor4f((float)mFloorColor.R / 256.0f, (float)mFloorColor.G / 256.0f, (float)mFloorColor.B / 256.0f, (float)mFloorColor.A / 256.0f);
-			glBegin(GL_QUADS);
-			glNormal3f(0.0f, 0.0f, 1.0f);
-			glVertex3f(-floorSize, -floorSize, -0.0002f);
-			glVertex3f(-floorSize, floorSize, -0.0002f);
-			glVertex3f(floorSize, floorSize, -0.0002f);
-			glVertex3f(floorSize, -floorSize, -0.0002f);
-			glEnd();
-
-			// Draw the grid
-			float spacing = mSize / 10.0f;
-			glColor4f((float)mGridColor.R / 256.0f, (float)mGridColor.G / 256.0f, (float)mGridColor.B / 256.0f, (float)mGridColor.A / 256.0f);
-			glBegin(GL_LINES);
-			glNormal3f(0.0f, 0.0f, 1.0f);
-			for(int i = -50; i <= 50; i++)
-			{
-				glVertex3f(-floorSize, (float)i * spacing, -0.0001f);
-				glVertex3f(floorSize, (float)i * spacing, -0.0001f);
-				glVertex3f((float)i * spacing, -floorSize, -0.0001f);
-				glVertex3f((float)i * spacing, floorSize, -0.0001f);
-			}
-			glEnd();
-		}
+			DrawFloorAndGrid();
 
 		// Draw the axis
 		if(ShowAxis)
 		{
 			float length = Math::Min(1.0f, mSize / 10.0f);
 			
-			graphics->FillBox(0, 0, 0, length, 0, 0, length / 10.0f, length / 10.0f, Color::Red);
-			graphics->FillBox(0, 0, 0, 0, length, 0, length / 10.0f, length / 10.0f, Color::Green);
-			graphics->FillBox(0, 0, 0, 0, 0, length, length / 10.0f, length / 10.0f, Color::Blue);
+			mGraphics->FillBox(0, 0, 0, length, 0, 0, length / 10.0f, length / 10.0f, Color::Red);
+			mGraphics->FillBox(0, 0, 0, 0, length, 0, length / 10.0f, length / 10.0f, Color::Green);
+			mGraphics->FillBox(0, 0, 0, 0, 0, length, length / 10.0f, length / 10.0f, Color::Blue);
 		}
 
+		mGraphics->Flush();
+
 		// Draw selection rectangle if in selection mode
 		glLoadIdentity();
 		if (mSelecting)
@@ -374,8 +400,11 @@ namespace GLCanvas {
 			wglMakeCurrent(mhOldDC, mhOldGLRC);
 		}
 
+		mGraphics->EndFrame();
+		mStatistics->EndFrame();
+
 		// Raise the render done event
-		OnRenderDone(gcnew System::EventArgs());
+		OnRenderDone(System::EventArgs::Empty);
 	}
 
 	System::Object ^ GLCanvas3D::HitTest(int x, int y, int pickSize)
@@ -483,23 +512,12 @@ namespace GLCanvas {
 		glLoadIdentity();
 		gluPickMatrix((GLdouble)x, (GLdouble)(viewport[3] - y), (GLdouble)width, (GLdouble)height, viewport);
 
-		// Set the view frustrum
-		int cheight = Math::Max(1, this->ClientRectangle.Height);
-		float fwidth = 1.0f * (float)this->ClientRectangle.Width / (float)cheight;
-		if(Perspective)
-		{
-			glFrustum(-fwidth, fwidth, -1, 1, 1.0f, 100000.0f);
-		}
-		else
-		{
-			float zoom = 1.0f / Math::Max(0.00001f, mCamera->Distance);
-			glOrtho(-fwidth / zoom, fwidth / zoom, -1 / zoom, 1 / zoom, 1.0f, 100000.0f);
-		}
-
-		// Set the camera
+		// Set the view frustrum and the camera
+		float projection[16], modelview[16];
+		GetViewMatrices(projection, modelview);
+		glMultMatrixf(projection);
 		glMatrixMode(GL_MODELVIEW);
-		glLoadIdentity();
-		gluLookAt(mCamera->Position.X, mCamera->Position.Y, mCamera->Position.Z, mCamera->Target.X, mCamera->Target.Y, mCamera->Target.Z, mCamera->Up.X, mCamera->Up.Y, mCamera->Up.Z);
+		glLoadMatrixf(modelview);
 
 		// Draw the pick boxes
 		DrawPickBoxes();
@@ -529,75 +547,26 @@ namespace GLCanvas {
 
 	void GLCanvas3D::DrawPickBoxes()
 	{
-		// Draw pick boxes in select mode
+		// Build all pick boxes in one pass
+		mPickBoxes->count = 0;
+		_ReserveBoxes(mPickBoxes, selectBoxes->Count);
 		for(int i = 0; i < selectBoxes->Count; i++)
 		{
-			glLoadName((GLuint)i);
-
 			GLPickBox box = selectBoxes[(GLuint)i];
-			float x1 = box.X1; float y1 = box.Y1; float z1 = box.Z1; 
-			float x2 = box.X2; float y2 = box.Y2; float z2 = box.Z2;
-			float width = box.Width; float height = box.Height;
-
-			float len = (float)Math::Sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2) + (z1 - z2) * (z1 - z2));
-			float zrot = (float)(Math::Atan2(y2 - y1, x2 - x1) * 180.0 / Math::PI);
-			float yrot = (float)(Math::Atan2(Math::Sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2)), z2 - z1) * 180.0 / Math::PI);
+			_AddBox3D(mPickBoxes, box.X1, box.Y1, box.Z1, box.X2, box.Y2, box.Z2, box.Width, box.Height, 0);
+		}
+		mPickVertices->count = 0;
+		_ExpandBoxes3D(mPickVertices, mPickBoxes->data, mPickBoxes->count, false);
 
-			glMatrixMode(GL_MODELVIEW);
-			glPushMatrix();
-			
-			glTranslatef(x1, y1, z1);
-			glRotatef(zrot, 0, 0, 1);
-			glRotatef(yrot, 0, 1, 0);
-			
-			glBegin(GL_QUADS);
-
-			// Front
-			glNormal3f(0, -1, 0);
-			glVertex3f(-width / 2, -height / 2, 0);
-			glVertex3f(-width / 2, -height / 2, len);
-			glVertex3f(width / 2, -height / 2, len);
-			glVertex3f(width / 2, -height / 2, 0);
-
-			// Right
-			glNormal3f(1, 0, 0);
-			glVertex3f(width / 2, -height / 2, 0);
-			glVertex3f(width / 2, -height / 2, len);
-			glVertex3f(width / 2, height / 2, len);
-			glVertex3f(width / 2, height / 2, 0);
-
-			// Back
-			glNormal3f(0, 1, 0);
-			glVertex3f(width / 2, height / 2, 0);
-			glVertex3f(width / 2, height / 2, len);
-			glVertex3f(-width / 2, height / 2, len);
-			glVertex3f(-width / 2, height / 2, 0);
-
-			// Left
-			glNormal3f(-1, 0, 0);
-			glVertex3f(-width / 2, height / 2, 0);
-			glVertex3f(-width / 2, height / 2, len);
-			glVertex3f(-width / 2, -height / 2, len);
-			glVertex3f(-width / 2, -height / 2, 0);
-
-			// Bottom
-			glNormal3f(0, 0, -1);
-			glVertex3f(-width / 2, -height / 2, 0);
-			glVertex3f(-width / 2, height / 2, 0);
-			glVertex3f(width / 2, height / 2, 0);
-			glVertex3f(width / 2, -height / 2, 0);
-
-			// Top
-			glNormal3f(0, 0, 1);
-			glVertex3f(-width / 2, -height / 2, len);
-			glVertex3f(-width / 2, height / 2, len);
-			glVertex3f(width / 2, height / 2, len);
-			glVertex3f(width / 2, -height / 2, len);
-
-			glEnd();
-			
-			glPopMatrix();
+		// Draw pick boxes in select mode
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(3, GL_FLOAT, sizeof(LitVertex), mPickVertices->data);
+		for(int i = 0; i < selectBoxes->Count; i++)
+		{
+			glLoadName((GLuint)i);
+			glDrawArrays(GL_TRIANGLES, i * 36, 36);
 		}
+		glDisableClientState(GL_VERTEX_ARRAY);
 
 		glFlush();
 	}
@@ -635,6 +604,101 @@ namespace GLCanvas {
 		}
 	}
 
+	void GLCanvas3D::Scene::set(GLScene3D ^ value)
+	{
+		if (value == mScene) return;
+
+		// Release the buffers of the previous scene while our context is current
+		if (mScene != nullptr && mRenderer != 0 && !this->DesignMode)
+		{
+			HDC mhOldDC = wglGetCurrentDC();
+			HGLRC mhOldGLRC = wglGetCurrentContext();
+			wglMakeCurrent(mhDC, mhGLRC);
+			mScene->Release();
+			wglMakeCurrent(mhOldDC, mhOldGLRC);
+		}
+		mScene = value;
+		Invalidate();
+	}
+
+	System::Void GLCanvas3D::GetViewMatrices(float * projection, float * modelview)
+	{
+		int cheight = Math::Max(1, this->ClientRectangle.Height);
+		float fwidth = 1.0f * (float)this->ClientRectangle.Width / (float)cheight;
+		if(Perspective)
+		{
+			_FrustumMatrix(projection, -fwidth, fwidth, -1, 1, 1.0f, 100000.0f);
+		}
+		else
+		{
+			float zoom = 1.0f / Math::Max(0.00001f, mCamera->Distance);
+			_OrthoMatrix(projection, -fwidth / zoom, fwidth / zoom, -1 / zoom, 1 / zoom, 1.0f, 100000.0f);
+		}
+
+		const float eye[3] = { mCamera->Position.X, mCamera->Position.Y, mCamera->Position.Z };
+		const float target[3] = { mCamera->Target.X, mCamera->Target.Y, mCamera->Target.Z };
+		const float up[3] = { mCamera->Up.X, mCamera->Up.Y, mCamera->Up.Z };
+		_LookAtMatrix(modelview, eye, target, up);
+	}
+
+	System::Void GLCanvas3D::UpdateRenderer()
+	{
+		if (mRenderer != 0 && mRendererBackend == mRenderBackend) return;
+
+		// Scene buffers are created for the vertex format of the previous renderer
+		if (mScene != nullptr && mRenderer != 0) mScene->Release();
+		if (mGraphics != nullptr && mRenderer != 0) mGraphics->ReleaseMeshes(true);
+
+		// Fall back to the fixed function pipeline if the backend is not supported
+		_DestroyRenderer(mRenderer);
+		mRenderer = _CreateRenderer((int)mRenderBackend);
+		if (mRenderer == 0) mRenderer = _CreateRenderer(RENDERBACKEND_FIXEDFUNCTION);
+		mRendererBackend = mRenderBackend;
+	}
+
+	System::Void GLCanvas3D::DrawFloorAndGrid()
+	{
+		// The floor is two triangles followed by 101 grid lines in each direction,
+		// all facing up
+		float floorSize = 5.0f * mSize;
+		float spacing = mSize / 10.0f;
+		_ReserveLitVertices(mFloor, 6 + 404);
+		LitVertex * v = mFloor->data;
+		const float corners[6][2] = { { -1, -1 }, { -1, 1 }, { 1, 1 }, { 1, 1 }, { 1, -1 }, { -1, -1 } };
+		unsigned int floorColor = GLVertexArray::PackColor(mFloorColor);
+		for (int i = 0; i < 6; i++)
+		{
+			v->x = corners[i][0] * floorSize; v->y = corners[i][1] * floorSize; v->z = -0.0002f;
+			v->color = floorColor;
+			v++;
+		}
+		unsigned int gridColor = GLVertexArray::PackColor(mGridColor);
+		for (int i = -50; i <= 50; i++)
+		{
+			float offset = (float)i * spacing;
+			v[0].x = -floorSize; v[0].y = offset;
+			v[1].x = floorSize; v[1].y = offset;
+			v[2].x = offset; v[2].y = -floorSize;
+			v[3].x = offset; v[3].y = floorSize;
+			for (int j = 0; j < 4; j++)
+			{
+				v[j].z = -0.0001f;
+				v[j].color = gridColor;
+			}
+			v += 4;
+		}
+		mFloor->count = 6 + 404;
+		for (int i = 0; i < mFloor->count; i++)
+		{
+			mFloor->data[i].nx = 0.0f;
+			mFloor->data[i].ny = 0.0f;
+			mFloor->data[i].nz = 1.0f;
+		}
+
+		_RenderLitVertices(mRenderer, GL_TRIANGLES, mFloor->data, 6);
+		_RenderLitVertices(mRenderer, GL_LINES, mFloor->data + 6, 404);
+	}
+
 	System::Void GLCanvas3D::ControlMouseDown(System::Object^ sender, System::Windows::Forms::MouseEventArgs^ e)
 	{
 		if ((e->Button == Windows::Forms::MouseButtons::Middle) && (AllowZoomAndPan || AllowRotate) && !mPanning)
@@ -3,6 +3,7 @@
 #include <windows.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
+#include "GLRenderBackend.h"
 
 #include "Point3D.h"
 #include "Camera.h"
@@ -13,10 +14,15 @@ using namespace System::ComponentModel;
 using namespace System::Windows::Forms;
 using namespace System::Collections::Generic;
 
+// Native box list
+struct BoxList;
+
 namespace GLCanvas
 {
 	// Forward class declarations
 	ref class GLGraphics3D;
+	ref class GLScene3D;
+	ref class GLRenderStatistics;
 	ref class Canvas3DRenderEventArgs;
 	ref class Canvas3DMouseSelectEventArgs;
 	value class GLPickBox;
@@ -106,9 +112,20 @@ namespace GLCanvas
 		System::Drawing::Color mFloorColor;
 		System::Drawing::Color mGridColor;
 		bool mLighting;
+		GLRenderBackend mRenderBackend;
+		GLRenderBackend mRendererBackend;
+		Renderer * mRenderer;
+		float mLevelOfDetail;
+		LitBuffer * mFloor;
+		BoxList * mPickBoxes;
+		LitBuffer * mPickVertices;
 		bool mSelecting;
 		Drawing::Point mSelPt1, mSelPt2;
 		GLuint* selectBuffer;
+		GLGraphics3D ^ mGraphics;
+		Canvas3DRenderEventArgs ^ mRenderArgs;
+		GLRenderStatistics ^ mStatistics;
+		GLScene3D ^ mScene;
 	internal:
 		Dictionary<GLuint, GLPickBox> ^ selectBoxes;
 		List<float> ^ charWidths;
@@ -161,6 +178,24 @@ namespace GLCanvas
 			virtual bool get(void) { return mIsAccelerated; }
 		}
 		/// <summary>
+		/// Gets statistics about the last frame drawn by the canvas.
+		/// </summary>
+		[Category("Behavior"), Browsable(false), Description("Gets statistics about the last frame drawn by the canvas.")]
+		property GLRenderStatistics ^ Statistics
+		{
+			virtual GLRenderStatistics ^ get(void) { return mStatistics; }
+		}
+		/// <summary>
+		/// Gets or sets the retained scene drawn after the Render event. The geometry of
+		/// the scene is kept on the graphics card between frames.
+		/// </summary>
+		[Category("Behavior"), Browsable(false), Description("Gets or sets the retained scene drawn after the Render event.")]
+		property GLScene3D ^ Scene
+		{
+			virtual GLScene3D ^ get(void) { return mScene; }
+			virtual void set(GLScene3D ^ value);
+		}
+		/// <summary>
 		/// Determines if the user is currently selecting with the mouse.
 		/// </summary>
 		[Category("Behavior"), Browsable(false), DefaultValue(false), Description("Determines if the user is currently selecting with the mouse.")]
@@ -255,6 +290,37 @@ namespace GLCanvas
 			virtual void set(Drawing::Color value) override { Control::BackColor = value; Invalidate(); }
 		}
 		/// <summary>
+		/// Gets or sets the OpenGL pipeline vertex arrays are drawn with. The canvas falls
+		/// back to the fixed function pipeline if the driver does not support the programmable one.
+		/// </summary>
+		[Category("Behavior"), Browsable(true), DefaultValue(GLRenderBackend::typeid, "FixedFunction"), Description("Gets or sets the OpenGL pipeline vertex arrays are drawn with.")]
+		property GLRenderBackend RenderBackend
+		{
+			virtual GLRenderBackend get(void) { return mRenderBackend; }
+			virtual void set(GLRenderBackend value) { mRenderBackend = value; Invalidate(); }
+		}
+		/// <summary>
+		/// Gets or sets the level of detail size in pixels. Spheres and cylinders are drawn
+		/// with fewer slices and stacks when they are small on the screen, so that no segment
+		/// of their outline is longer than this size, and objects smaller than this size are
+		/// drawn as dots. The slice and stack counts given to the drawing methods are the upper
+		/// limit. Set to zero to always draw the given slices and stacks.
+		/// </summary>
+		[Category("Behavior"), Browsable(true), DefaultValue(0.0f), Description("Gets or sets the level of detail size in pixels. Set to zero to draw full detail.")]
+		property float LevelOfDetail
+		{
+			virtual float get(void) { return mLevelOfDetail; }
+			virtual void set(float value) { mLevelOfDetail = Math::Max(value, 0.0f); Invalidate(); }
+		}
+		/// <summary>
+		/// Gets the OpenGL pipeline the last frame was drawn with.
+		/// </summary>
+		[Category("Behavior"), Browsable(false), Description("Gets the OpenGL pipeline the last frame was drawn with.")]
+		property GLRenderBackend ActiveRenderBackend
+		{
+			virtual GLRenderBackend get(void) { return (mRenderer == 0 ? GLRenderBackend::FixedFunction : (GLRenderBackend)_GetRenderBackend(mRenderer)); }
+		}
+		/// <summary>
 		/// Determines whether lines are anti-aliased.
 		/// </summary>
 		[Category("Appearance"), Browsable(true), DefaultValue(true), Description("Determines whether lines are anti-aliased.")]
@@ -322,6 +388,17 @@ namespace GLCanvas
 		{
 			virtual GLuint get(void) { return rasterbase; }
 		}
+
+	internal:
+		/// <summary>
+		/// Gets the renderer of the canvas. Only valid while the canvas is drawing.
+		/// </summary>
+		property Renderer * NativeRenderer
+		{
+			Renderer * get(void) { return mRenderer; }
+		}
+
+	public:
 		/// <summary>
 		/// Gets or sets the font used to display text in the control.
 		/// </summary>
@@ -542,6 +619,18 @@ namespace GLCanvas
 		System::Void DrawPickBoxes();
 		System::Void ResetViewport();
 		/// <summary>
+		/// Creates the renderer of the selected backend. The context of the canvas must be current.
+		/// </summary>
+		System::Void UpdateRenderer();
+		/// <summary>
+		/// Computes the column-major projection and modelview matrices of the camera.
+		/// </summary>
+		System::Void GetViewMatrices(float * projection, float * modelview);
+		/// <summary>
+		/// Draws the floor and its grid.
+		/// </summary>
+		System::Void DrawFloorAndGrid();
+		/// <summary>
 		/// Returns the coordinates of the viewport in world coordinates.
 		/// </summary>
 		Drawing::RectangleF GetViewPort()
@@ -0,0 +1,259 @@
+#pragma once
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Represents a recorded sequence of drawing commands. Command buffers are
+	/// filled by a GLGraphics2D or GLGraphics3D object created with a command
+	/// buffer, and can be replayed any number of times on any canvas with
+	/// GLGraphics2D.DrawCommands or GLGraphics3D.DrawCommands. A command buffer
+	/// does not depend on an OpenGL context, so it can be recorded on a worker thread
+	/// and saved to or loaded from a stream.
+	/// </summary>
+	public ref class GLCommandBuffer
+	{
+	// Command codes
+	internal:
+		enum class Command : System::Byte
+		{
+			// 2D commands
+			LineWidth2D = 1,
+			DrawRasterText2D,
+			DrawVectorText2D,
+			DrawLine2D,
+			DrawThickLine2D,
+			DrawTaperedLine2D,
+			DrawArc2D,
+			DrawTriangle2D,
+			DrawRectangle2D,
+			DrawRoundedRectangle2D,
+			DrawEllipse2D,
+			DrawPolygon2D,
+			FillPie2D,
+			FillTriangle2D,
+			FillRectangle2D,
+			FillRoundedRectangle2D,
+			FillEllipse2D,
+			FillPolygon2D,
+			FillTriangles2D,
+			DrawBeziers2D,
+			DrawQuadraticBeziers2D,
+			DrawBSpline2D,
+			MiterLimit2D,
+			DrawThickPolyline2D,
+			DrawTaperedPolyline2D,
+			DrawThickPolygon2D,
+
+			// 3D commands
+			LineWidth3D = 64,
+			DrawLine3D,
+			DrawTriangle3D,
+			DrawQuad3D,
+			FillTriangle3D,
+			FillQuad3D,
+			DrawBox3D,
+			FillBox3D,
+			DrawSphere3D,
+			FillSphere3D,
+			DrawCylinder3D,
+			FillCylinder3D,
+			DrawRasterText3D,
+			DrawRasterTextWindow3D,
+			DrawVectorText3D
+		};
+
+	// Constants
+	private:
+		literal int Signature = 0x42434C47; // "GLCB"
+		literal int FormatVersion = 1;
+
+	// Member variables
+	private:
+		System::IO::MemoryStream ^ mStream;
+		System::IO::BinaryWriter ^ mWriter;
+		int mCount;
+
+	// Constructor/destructor
+	public:
+		/// <summary>
+		/// Initializes a new instance of the GLCommandBuffer class.
+		/// </summary>
+		GLCommandBuffer()
+		{
+			mStream = gcnew System::IO::MemoryStream();
+			mWriter = gcnew System::IO::BinaryWriter(mStream);
+			mCount = 0;
+		}
+
+	// Properties
+	public:
+		/// <summary>
+		/// Gets the number of recorded commands.
+		/// </summary>
+		property int Count
+		{
+			virtual int get(void) { return mCount; }
+		}
+		/// <summary>
+		/// Gets the size of recorded commands in bytes.
+		/// </summary>
+		property int Size
+		{
+			virtual int get(void) { return (int)mStream->Length; }
+		}
+
+	// Implementation
+	public:
+		/// <summary>
+		/// Clears all recorded commands. The memory allocated for the buffer is retained.
+		/// </summary>
+		System::Void Clear()
+		{
+			mStream->SetLength(0);
+			mCount = 0;
+		}
+		/// <summary>
+		/// Writes the command buffer to the given stream.
+		/// </summary>
+		/// <param name="stream">The stream to write to</param>
+		System::Void Save(System::IO::Stream ^ stream)
+		{
+			System::IO::BinaryWriter ^ writer = gcnew System::IO::BinaryWriter(stream);
+			writer->Write(Signature);
+			writer->Write(FormatVersion);
+			writer->Write(mCount);
+			writer->Write((int)mStream->Length);
+			writer->Write(mStream->GetBuffer(), 0, (int)mStream->Length);
+			writer->Flush();
+		}
+		/// <summary>
+		/// Reads a command buffer from the given stream.
+		/// </summary>
+		/// <param name="stream">The stream to read from</param>
+		/// <returns>The command buffer read from the stream.</returns>
+		static GLCommandBuffer ^ Load(System::IO::Stream ^ stream)
+		{
+			System::IO::BinaryReader ^ reader = gcnew System::IO::BinaryReader(stream);
+			if (reader->ReadInt32() != Signature)
+				throw gcnew System::IO::InvalidDataException(L"The stream does not contain a command buffer.");
+			if (reader->ReadInt32() != FormatVersion)
+				throw gcnew System::IO::InvalidDataException(L"The command buffer was saved in an unsupported format.");
+
+			int count = reader->ReadInt32();
+			int length = reader->ReadInt32();
+			if (count < 0 || length < 0)
+				throw gcnew System::IO::InvalidDataException(L"The command buffer is corrupt.");
+
+			GLCommandBuffer ^ buffer = gcnew GLCommandBuffer();
+			buffer->mCount = count;
+			array<System::Byte> ^ data = reader->ReadBytes(length);
+			if (data->Length != length)
+				throw gcnew System::IO::EndOfStreamException(L"The command buffer is truncated.");
+			buffer->mStream->Write(data, 0, length);
+			return buffer;
+		}
+
+	// Recording
+	internal:
+		/// <summary>
+		/// Starts a new command.
+		/// </summary>
+		/// <param name="command">Command code</param>
+		System::Void Write(Command command)
+		{
+			mWriter->Write((System::Byte)command);
+			mCount++;
+		}
+		/// <summary>
+		/// Writes a command argument.
+		/// </summary>
+		System::Void Write(float value) { mWriter->Write(value); }
+		/// <summary>
+		/// Writes a pair of command arguments.
+		/// </summary>
+		System::Void Write(float x, float y) { mWriter->Write(x); mWriter->Write(y); }
+		/// <summary>
+		/// Writes a triplet of command arguments.
+		/// </summary>
+		System::Void Write(float x, float y, float z) { mWriter->Write(x); mWriter->Write(y); mWriter->Write(z); }
+		/// <summary>
+		/// Writes a command argument.
+		/// </summary>
+		System::Void Write(int value) { mWriter->Write(value); }
+		/// <summary>
+		/// Writes a command argument.
+		/// </summary>
+		System::Void Write(System::String ^ value) { mWriter->Write(value == nullptr ? System::String::Empty : value); }
+		/// <summary>
+		/// Writes a color argument.
+		/// </summary>
+		System::Void Write(Drawing::Color value) { mWriter->Write(value.ToArgb()); }
+		/// <summary>
+		/// Writes a float array argument.
+		/// </summary>
+		System::Void Write(array<float> ^ values)
+		{
+			mWriter->Write(values->Length);
+			for (int i = 0; i < values->Length; i++)
+				mWriter->Write(values[i]);
+		}
+		/// <summary>
+		/// Writes a point array argument.
+		/// </summary>
+		System::Void Write(array<Drawing::PointF> ^ points)
+		{
+			mWriter->Write(points->Length);
+			for (int i = 0; i < points->Length; i++)
+			{
+				mWriter->Write(points[i].X);
+				mWriter->Write(points[i].Y);
+			}
+		}
+
+	// Playback
+	internal:
+		/// <summary>
+		/// Returns a reader positioned at the first recorded command.
+		/// </summary>
+		System::IO::BinaryReader ^ GetReader()
+		{
+			return gcnew System::IO::BinaryReader(gcnew System::IO::MemoryStream(mStream->GetBuffer(), 0, (int)mStream->Length, false));
+		}
+		/// <summary>
+		/// Reads a color argument.
+		/// </summary>
+		static Drawing::Color ReadColor(System::IO::BinaryReader ^ reader)
+		{
+			return Drawing::Color::FromArgb(reader->ReadInt32());
+		}
+		/// <summary>
+		/// Reads a float array argument.
+		/// </summary>
+		static array<float> ^ ReadSingles(System::IO::BinaryReader ^ reader)
+		{
+			int count = reader->ReadInt32();
+			array<float> ^ values = gcnew array<float>(count);
+			for (int i = 0; i < count; i++)
+				values[i] = reader->ReadSingle();
+			return values;
+		}
+		/// <summary>
+		/// Reads a point array argument.
+		/// </summary>
+		static array<Drawing::PointF> ^ ReadPoints(System::IO::BinaryReader ^ reader)
+		{
+			int count = reader->ReadInt32();
+			array<Drawing::PointF> ^ points = gcnew array<Drawing::PointF>(count);
+			for (int i = 0; i < count; i++)
+			{
+				float x = reader->ReadSingle();
+				float y = reader->ReadSingle();
+				points[i] = Drawing::PointF(x, y);
+			}
+			return points;
+		}
+	};
+
+}
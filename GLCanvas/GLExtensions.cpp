@@ -0,0 +1,83 @@
+// Native code, compiled without /clr.
+
+#include "GLExtensions.h"
+
+#include <windows.h>
+#include <GL/gl.h>
+
+namespace
+{
+	typedef void (APIENTRY * MultiDrawArraysFunction)(GLenum mode, const GLint * first, const GLsizei * count, GLsizei primcount);
+	typedef HGLRC (WINAPI * CreateContextAttribsFunction)(HDC dc, HGLRC shareContext, const int * attributes);
+
+	// WGL_ARB_create_context definitions
+	const int ContextMajorVersion = 0x2091;
+	const int ContextMinorVersion = 0x2092;
+	const int ContextProfileMask = 0x9126;
+	const int ContextCoreProfileBit = 0x0001;
+	const int ContextCompatibilityProfileBit = 0x0002;
+
+	// Entry points are the same for all contexts of the pixel formats the canvases use
+	bool gLoaded = false;
+	MultiDrawArraysFunction gMultiDrawArrays = 0;
+
+	void Load()
+	{
+		gMultiDrawArrays = (MultiDrawArraysFunction)_GetGLFunction("glMultiDrawArrays");
+		if (gMultiDrawArrays == 0) gMultiDrawArrays = (MultiDrawArraysFunction)_GetGLFunction("glMultiDrawArraysEXT");
+		gLoaded = true;
+	}
+}
+
+void * _GetGLFunction(const char * name)
+{
+	// Some drivers return small integers instead of null for functions they do not provide
+	PROC function = wglGetProcAddress(name);
+	INT_PTR value = (INT_PTR)function;
+	if (value >= -1 && value <= 3) return 0;
+	return (void *)function;
+}
+
+void * _CreateGLContext(void * dc, bool core)
+{
+	// wglCreateContextAttribsARB is only returned while a context is current, so a
+	// legacy context is created first
+	HDC hdc = (HDC)dc;
+	HGLRC legacy = wglCreateContext(hdc);
+	if (legacy == 0) return 0;
+	HDC oldDC = wglGetCurrentDC();
+	HGLRC oldGLRC = wglGetCurrentContext();
+	CreateContextAttribsFunction createContextAttribs = 0;
+	if (wglMakeCurrent(hdc, legacy))
+		createContextAttribs = (CreateContextAttribsFunction)_GetGLFunction("wglCreateContextAttribsARB");
+	wglMakeCurrent(oldDC, oldGLRC);
+
+	HGLRC context = 0;
+	if (createContextAttribs != 0)
+	{
+		const int attributes[] = {
+			ContextMajorVersion, 3,
+			ContextMinorVersion, 3,
+			ContextProfileMask, (core ? ContextCoreProfileBit : ContextCompatibilityProfileBit),
+			0
+		};
+		context = createContextAttribs(hdc, 0, attributes);
+	}
+	if (context == 0 && !core) return legacy;
+	wglDeleteContext(legacy);
+	return context;
+}
+
+void _MultiDrawArrays(unsigned int mode, const int * firsts, const int * counts, int count)
+{
+	if (count <= 0) return;
+	if (!gLoaded) Load();
+
+	if (gMultiDrawArrays != 0)
+	{
+		gMultiDrawArrays(mode, firsts, counts, count);
+		return;
+	}
+	for (int i = 0; i < count; i++)
+		glDrawArrays(mode, firsts[i], counts[i]);
+}
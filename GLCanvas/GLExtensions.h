@@ -0,0 +1,26 @@
+#pragma once
+
+// Native access to OpenGL functions newer than OpenGL 1.1, which opengl32.dll does
+// not export. Entry points are loaded with wglGetProcAddress the first time they are
+// used, so a rendering context must be current. The implementation is compiled without /clr.
+
+/// <summary>
+/// Returns the address of an OpenGL function of the current context, or null if the
+/// driver does not provide it.
+/// </summary>
+void * _GetGLFunction(const char * name);
+/// <summary>
+/// Creates an OpenGL 3.3 rendering context for a device context whose pixel format is
+/// set, with wglCreateContextAttribsARB. A core profile context has no fixed function
+/// pipeline; a compatibility profile context keeps it next to the OpenGL 3.3 features.
+/// If the driver cannot create a 3.3 context, a compatibility request falls back to
+/// wglCreateContext and a core request returns null. The current context is not changed.
+/// </summary>
+void * _CreateGLContext(void * dc, bool core);
+/// <summary>
+/// Draws count ranges of the enabled vertex arrays with the given primitive mode.
+/// Range i starts at vertex firsts[i] and has counts[i] vertices. The ranges are drawn
+/// with a single glMultiDrawArrays call where OpenGL 1.4 or EXT_multi_draw_arrays is
+/// available, and with one glDrawArrays call for each range otherwise.
+/// </summary>
+void _MultiDrawArrays(unsigned int mode, const int * firsts, const int * counts, int count);
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <windows.h>
+#include <GL/gl.h>
+#include "GeometryKernels.h"
+#include "VertexBuffer.h"
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Represents the way vertices of a buffer are connected.
+	/// </summary>
+	public enum class GLPrimitiveType
+	{
+		/// <summary>
+		/// Each vertex is drawn as a point.
+		/// </summary>
+		Points = GL_POINTS,
+		/// <summary>
+		/// Each pair of vertices is drawn as a line.
+		/// </summary>
+		Lines = GL_LINES,
+		/// <summary>
+		/// Vertices are connected by a polyline.
+		/// </summary>
+		LineStrip = GL_LINE_STRIP,
+		/// <summary>
+		/// Vertices are connected by a closed polyline.
+		/// </summary>
+		LineLoop = GL_LINE_LOOP,
+		/// <summary>
+		/// Each group of three vertices is drawn as a filled triangle.
+		/// </summary>
+		Triangles = GL_TRIANGLES,
+		/// <summary>
+		/// Vertices are drawn as a strip of filled triangles.
+		/// </summary>
+		TriangleStrip = GL_TRIANGLE_STRIP,
+		/// <summary>
+		/// Vertices are drawn as a fan of filled triangles around the first vertex.
+		/// </summary>
+		TriangleFan = GL_TRIANGLE_FAN
+	};
+
+	/// <summary>
+	/// Describes vertex data in native memory owned by the application, for example
+	/// a simulation buffer or a view of shared memory. The canvas reads vertices
+	/// directly from the given address each time the buffer is drawn, without copying.
+	/// Each vertex starts at PositionOffset with two or three floats. Vertex colors are
+	/// either read from ColorOffset as R, G, B, A bytes or taken from the Color property.
+	/// The application must keep the memory valid while the buffer is in use and call
+	/// NotifyChanged after modifying the vertices.
+	/// </summary>
+	public ref class GLExternalBuffer
+	{
+	// Member variables
+	private:
+		IntPtr mData;
+		int mCount;
+		int mStride;
+		int mPositionOffset;
+		int mPositionComponents;
+		int mColorOffset;
+		Drawing::Color mColor;
+		GLPrimitiveType mPrimitiveType;
+		int mVersion;
+		int mBoundsVersion;
+		bool mHasBounds;
+		float mLower0, mLower1, mLower2;
+		float mUpper0, mUpper1, mUpper2;
+
+	// Constructor/destructor
+	public:
+		/// <summary>
+		/// Initializes a new instance of the GLExternalBuffer class with tightly packed
+		/// two dimensional positions.
+		/// </summary>
+		/// <param name="data">Address of the first vertex</param>
+		/// <param name="count">Number of vertices</param>
+		/// <param name="primitiveType">The way vertices are connected</param>
+		/// <param name="color">Drawing color</param>
+		GLExternalBuffer(IntPtr data, int count, GLPrimitiveType primitiveType, Drawing::Color color)
+		{
+			SetData(data, count);
+			mStride = 0;
+			mPositionOffset = 0;
+			mPositionComponents = 2;
+			mColorOffset = -1;
+			mColor = color;
+			mPrimitiveType = primitiveType;
+		}
+		/// <summary>
+		/// Initializes a new instance of the GLExternalBuffer class with interleaved vertices.
+		/// </summary>
+		/// <param name="data">Address of the first vertex</param>
+		/// <param name="count">Number of vertices</param>
+		/// <param name="stride">Distance between consecutive vertices in bytes</param>
+		/// <param name="positionOffset">Offset of the position within a vertex in bytes</param>
+		/// <param name="positionComponents">Number of position coordinates (2 or 3)</param>
+		/// <param name="colorOffset">Offset of the R, G, B, A color bytes within a vertex, or -1 to use the Color property</param>
+		/// <param name="primitiveType">The way vertices are connected</param>
+		GLExternalBuffer(IntPtr data, int count, int stride, int positionOffset, int positionComponents, int colorOffset, GLPrimitiveType primitiveType)
+		{
+			if (positionComponents != 2 && positionComponents != 3) throw gcnew ArgumentOutOfRangeException(L"positionComponents");
+			if (positionOffset < 0) throw gcnew ArgumentOutOfRangeException(L"positionOffset");
+			if (stride < 0) throw gcnew ArgumentOutOfRangeException(L"stride");
+			int size = Math::Max(positionOffset + positionComponents * (int)sizeof(float), colorOffset + 4);
+			if (stride != 0 && stride < size) throw gcnew ArgumentException(L"The stride is smaller than a vertex.", L"stride");
+
+			SetData(data, count);
+			mStride = stride;
+			mPositionOffset = positionOffset;
+			mPositionComponents = positionComponents;
+			mColorOffset = (colorOffset < 0 ? -1 : colorOffset);
+			mColor = Drawing::Color::White;
+			mPrimitiveType = primitiveType;
+		}
+
+	// Properties
+	public:
+		/// <summary>
+		/// Gets the address of the first vertex.
+		/// </summary>
+		property IntPtr Data
+		{
+			virtual IntPtr get(void) { return mData; }
+		}
+		/// <summary>
+		/// Gets the number of vertices.
+		/// </summary>
+		property int Count
+		{
+			virtual int get(void) { return mCount; }
+		}
+		/// <summary>
+		/// Gets the distance between consecutive vertices in bytes. Zero means that
+		/// positions are tightly packed.
+		/// </summary>
+		property int Stride
+		{
+			virtual int get(void) { return mStride; }
+		}
+		/// <summary>
+		/// Gets the offset of the position within a vertex in bytes.
+		/// </summary>
+		property int PositionOffset
+		{
+			virtual int get(void) { return mPositionOffset; }
+		}
+		/// <summary>
+		/// Gets the number of position coordinates.
+		/// </summary>
+		property int PositionComponents
+		{
+			virtual int get(void) { return mPositionComponents; }
+		}
+		/// <summary>
+		/// Gets the offset of the vertex color within a vertex in bytes, or -1 if
+		/// all vertices are drawn with the Color property.
+		/// </summary>
+		property int ColorOffset
+		{
+			virtual int get(void) { return mColorOffset; }
+		}
+		/// <summary>
+		/// Gets or sets the drawing color used when the buffer has no vertex colors.
+		/// </summary>
+		property Drawing::Color Color
+		{
+			virtual Drawing::Color get(void) { return mColor; }
+			virtual void set(Drawing::Color value) { mColor = value; }
+		}
+		/// <summary>
+		/// Gets or sets the way vertices are connected.
+		/// </summary>
+		property GLPrimitiveType PrimitiveType
+		{
+			virtual GLPrimitiveType get(void) { return mPrimitiveType; }
+			virtual void set(GLPrimitiveType value) { mPrimitiveType = value; }
+		}
+		/// <summary>
+		/// Gets the version of the vertex data. The version is incremented each time
+		/// NotifyChanged or SetData is called.
+		/// </summary>
+		property int Version
+		{
+			virtual int get(void) { return mVersion; }
+		}
+
+	// Implementation
+	public:
+		/// <summary>
+		/// Signals that the vertex data has been modified.
+		/// </summary>
+		System::Void NotifyChanged()
+		{
+			mVersion++;
+		}
+		/// <summary>
+		/// Sets the address and number of vertices.
+		/// </summary>
+		/// <param name="data">Address of the first vertex</param>
+		/// <param name="count">Number of vertices</param>
+		System::Void SetData(IntPtr data, int count)
+		{
+			if (count < 0) throw gcnew ArgumentOutOfRangeException(L"count");
+			if (count > 0 && data == IntPtr::Zero) throw gcnew ArgumentNullException(L"data");
+
+			mData = data;
+			mCount = count;
+			mVersion++;
+		}
+
+	internal:
+		/// <summary>
+		/// Gets the distance between consecutive vertices in bytes.
+		/// </summary>
+		property int VertexSize
+		{
+			int get(void) { return (mStride != 0 ? mStride : mPositionComponents * (int)sizeof(float)); }
+		}
+		/// <summary>
+		/// Gets the bounding box of the vertices. Bounds are only computed again when
+		/// the version of the data changes.
+		/// </summary>
+		/// <returns>false if the buffer is empty</returns>
+		bool GetBounds(float % xmin, float % ymin, float % zmin, float % xmax, float % ymax, float % zmax)
+		{
+			if (mBoundsVersion != mVersion)
+			{
+				float lower[3] = { 0.0f, 0.0f, 0.0f };
+				float upper[3] = { 0.0f, 0.0f, 0.0f };
+				const char * first = (const char *)mData.ToPointer() + mPositionOffset;
+				mHasBounds = _StridedBounds(first, mCount, VertexSize, mPositionComponents, lower, upper);
+				mLower0 = lower[0]; mLower1 = lower[1]; mLower2 = lower[2];
+				mUpper0 = upper[0]; mUpper1 = upper[1]; mUpper2 = upper[2];
+				mBoundsVersion = mVersion;
+			}
+			xmin = mLower0; ymin = mLower1; zmin = mLower2;
+			xmax = mUpper0; ymax = mUpper1; zmax = mUpper2;
+			return mHasBounds;
+		}
+		/// <summary>
+		/// Draws the buffer with vertex arrays. The vertex array client state must be enabled.
+		/// </summary>
+		System::Void Render()
+		{
+			if (mCount == 0) return;
+
+			const char * bytes = (const char *)mData.ToPointer();
+			glVertexPointer(mPositionComponents, GL_FLOAT, VertexSize, bytes + mPositionOffset);
+			if (mColorOffset >= 0)
+			{
+				glEnableClientState(GL_COLOR_ARRAY);
+				glColorPointer(4, GL_UNSIGNED_BYTE, VertexSize, bytes + mColorOffset);
+				glDrawArrays((GLenum)mPrimitiveType, 0, mCount);
+			}
+			else
+			{
+				glDisableClientState(GL_COLOR_ARRAY);
+				glColor4ub(mColor.R, mColor.G, mColor.B, mColor.A);
+				glDrawArrays((GLenum)mPrimitiveType, 0, mCount);
+			}
+		}
+	};
+
+}
@@ -1,32 +1,206 @@
 #include "stdafx.h"
 #include "GLGraphics2D.h"
+#include "GLBlock.h"
 #include "GLCanvas2D.h"
+#include "GLCommandBuffer.h"
+#include "GLExternalBuffer.h"
+#include "GLPolygon.h"
+#include "GLRenderStatistics.h"
+#include "GLScatter.h"
+#include "GLTimeSeries.h"
+#include "GeometryKernels.h"
+#include "JobSystem.h"
+#include "ShapeShader.h"
+#include "Tessellator2D.h"
+#include "TimeSeries.h"
+#include "Utility.h"
 #include <Vcclr.h>
+#include <string.h>
 
 namespace GLCanvas
 {
-	GLGraphics2D::GLGraphics2D(GLCanvas2D ^ Canvas, Drawing::Graphics ^ GDIGraphics)
+	GLGraphics2D::GLGraphics2D(GLCanvas2D ^ Canvas)
 	{
 		mCanvas = Canvas; 
-		mGDIGraphics = GDIGraphics;
-		LineWidth = 1.0f;
+		mLineWidth = 1.0f;
+		mMiterLimit = 4.0f;
 		mZ = -0.9f;
 		mInit = false;
+		mBatch = _CreateBatch2D();
 		mTriangles = gcnew GLVertexArray(GL_TRIANGLES);
 		mLines = gcnew GLVertexArray(GL_LINES);
+		mLineStrips = gcnew GLVertexArray(GL_LINE_STRIP);
+		mWideLines = gcnew GLVertexArray(GL_TRIANGLES);
+		mShapes = _CreateShapeBuffer();
+		mShapeProgram = 0;
+		mShapeProgramChecked = false;
 		mTexts = gcnew System::Collections::Generic::List<GLTextParam>;
-		mView = Canvas->GetViewPort();
+		mBuffers = gcnew System::Collections::Generic::List<GLExternalBuffer ^>;
+		mScatters = gcnew System::Collections::Generic::List<GLScatter ^>;
+		mBlocks = gcnew System::Collections::Generic::List<GLBlock ^>;
+	}
+
+	GLGraphics2D::GLGraphics2D(GLCommandBuffer ^ Buffer)
+	{
+		if (Buffer == nullptr) throw gcnew ArgumentNullException(L"Buffer");
+
+		mRecorder = Buffer;
+		mLineWidth = 1.0f;
+		mMiterLimit = 4.0f;
+		mZ = -0.9f;
+		mInit = false;
+		mBatch = 0;
+		mShapes = 0;
+	}
+
+	GLGraphics2D::GLGraphics2D(Batch2D * Definition)
+	{
+		mLineWidth = 1.0f;
+		mMiterLimit = 4.0f;
+		mZ = -0.9f;
+		mInit = false;
+		mBatch = Definition;
+		mShapes = 0;
+	}
+
+	GLGraphics2D::~GLGraphics2D()
+	{
+		// Release vertex arrays
+		delete mTriangles;
+		delete mLines;
+		delete mLineStrips;
+		delete mWideLines;
+		this->!GLGraphics2D();
 	}
 
-	Drawing::RectangleF GLGraphics2D::Render()
+	GLGraphics2D::!GLGraphics2D()
+	{
+		// Release the primitive batch; block definitions own their batch
+		if (mCanvas != nullptr) _DestroyBatch2D(mBatch);
+		mBatch = 0;
+		if (mShapes != 0) _DestroyShapeBuffer(mShapes);
+		mShapes = 0;
+	}
+
+	void GLGraphics2D::LineWidth::set(float value)
+	{
+		mLineWidth = value;
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::LineWidth2D);
+			mRecorder->Write(value);
+		}
+		else if (mCanvas != nullptr)
+			glLineWidth(value);
+	}
+
+	void GLGraphics2D::MiterLimit::set(float value)
+	{
+		mMiterLimit = Math::Max(value, 1.0f);
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::MiterLimit2D);
+			mRecorder->Write(mMiterLimit);
+		}
+	}
+
+	System::Void GLGraphics2D::BeginFrame(Drawing::Graphics ^ GDIGraphics)
+	{
+		mGDIGraphics = GDIGraphics;
+		LineWidth = 1.0f;
+		mMiterLimit = 4.0f;
+		mZ = -0.9f;
+		mInit = false;
+		mView = mCanvas->GetViewPort();
+		mFrame = System::Threading::Interlocked::Increment(sFrameCounter);
+	}
+
+	Drawing::RectangleF GLGraphics2D::Render(GLRenderStatistics ^ statistics)
 	{		
-		// Render drawing objects
-		mTriangles->Render();
-		mLines->Render();
+		// Cull and tessellate drawing objects on all cores
+		View2D view;
+		view.xmin = mView.Left;
+		view.ymin = mView.Top;
+		view.xmax = mView.Right;
+		view.ymax = mView.Bottom;
+		view.pixelSize = mCanvas->PixelSize;
+		view.depth = mZ;
+		view.depthStep = 0.000001f;
+		view.lodSize = mCanvas->PixelSize * mCanvas->LevelOfDetail;
+		view.flatness = mCanvas->PixelSize * mCanvas->CurveFlatness;
+
+		// Ellipses and rounded rectangles are drawn as quads with a margin wide enough
+		// for antialiased outlines; the program is compiled once, on first use
+		if (mCanvas->AnalyticShapes && !mShapeProgramChecked)
+		{
+			mShapeProgram = _CreateShapeProgram();
+			mShapeProgramChecked = true;
+		}
+		bool shaped = (mCanvas->AnalyticShapes && mShapeProgram != 0);
+		view.shapeMargin = (shaped ? mCanvas->PixelSize * (1.0f + mLineWidth / 2.0f) : 0.0f);
+		JobSystem * jobs = (mCanvas->ParallelTessellation ? _SharedJobSystem() : 0);
+		for (int i = 0; i < mBlocks->Count; i++)
+			mBlocks[i]->Prepare();
+		int visible = _Tessellate2D(mBatch, view, jobs, mLines->Buffer, mLineStrips->Buffer, mLineStrips->Strips, mTriangles->Buffer, mShapes);
+		mZ += (float)visible * view.depthStep;
+		statistics->AddCounts(mBatch->primitiveCount, mTriangles->Count + mLines->Count + mLineStrips->Count + mShapes->count);
+
+		// Render drawing objects with the projection set by the canvas; outlines and
+		// curves are drawn as line strips
+		Renderer * renderer = mCanvas->NativeRenderer;
+		float projection[16];
+		float modelview[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+		mCanvas->GetProjection(projection);
+		_SetRenderTransform(renderer, projection, modelview);
+		mTriangles->Render(renderer);
+		if (mLineWidth > 1.0f && _GetRenderBackend(renderer) == RENDERBACKEND_PROGRAMMABLE)
+		{
+			// Core profile contexts do not draw lines wider than a pixel, so wide lines
+			// and each line strip are expanded into triangles
+			float halfWidth = mLineWidth * mCanvas->PixelSize / 2.0f;
+			VertexBuffer * strips = mLineStrips->Buffer;
+			StripList * list = mLineStrips->Strips;
+			_ExpandLines2D(mLines->Buffer->data, mLines->Count / 2, 2, halfWidth, mWideLines->Buffer);
+			for (int i = 0; i < list->count; i++)
+			{
+				if (list->counts[i] > 1)
+					_ExpandLines2D(strips->data + list->firsts[i], list->counts[i] - 1, 1, halfWidth, mWideLines->Buffer);
+			}
+			mWideLines->Render(renderer);
+		}
+		else
+		{
+			mLines->Render(renderer);
+			mLineStrips->Render(renderer);
+		}
+		if (shaped) _DrawShapes(mShapeProgram, mShapes, mCanvas->PixelSize, mLineWidth);
+
+		// Draw external buffers flattened to the current depth
+		for (int i = 0; i < mBuffers->Count; i++)
+		{
+			GLExternalBuffer ^ buffer = mBuffers[i];
+			glLoadIdentity();
+			glTranslatef(0.0f, 0.0f, mZ);
+			glScalef(1.0f, 1.0f, 0.0f);
+			buffer->Render();
+			statistics->AddCounts(1, buffer->Count);
+			UpdateDepth();
+		}
+
+		// Draw scatter plots; density images are computed on all cores
+		for (int i = 0; i < mScatters->Count; i++)
+		{
+			GLScatter ^ scatter = mScatters[i];
+			scatter->Render(mView, mCanvas->PixelSize, mCanvas->ClientSize.Width, mCanvas->ClientSize.Height, jobs, mZ);
+			statistics->AddCounts(1, scatter->Count);
+			UpdateDepth();
+		}
+		if (mBuffers->Count != 0 || mScatters->Count != 0) glEnableClientState(GL_COLOR_ARRAY);
 
 		// Draw text objects
-		for each (GLTextParam tp in mTexts)
+		for (int i = 0; i < mTexts->Count; i++)
 		{
+			GLTextParam tp = mTexts[i];
 			// Position the text
 			glLoadIdentity();
 			glColor4ub(tp.color.R, tp.color.G, tp.color.B, tp.color.A);
@@ -42,169 +216,267 @@ namespace GLCanvas
 				glRasterPos2f(tp.x, tp.y);
 			}
 			// Draw the text
-			System::IntPtr str = System::Runtime::InteropServices::Marshal::StringToHGlobalAnsi(tp.text);
-			glCallLists(tp.text->Length, GL_UNSIGNED_BYTE, 
-				(GLvoid*)str.ToPointer());
-			System::Runtime::InteropServices::Marshal::FreeHGlobal(str);
+			Utility::CallLists(tp.text, mTextBuffer);
 			UpdateDepth();
 		}
 		glLoadIdentity();
 
 		// Clear arrays
+		mBatch->primitiveCount = 0;
+		mBatch->pointCount = 0;
+		mBatch->blockCount = 0;
 		mTriangles->Clear();
 		mLines->Clear();
+		mLineStrips->Clear();
+		mWideLines->Clear();
+		mShapes->count = 0;
 		mTexts->Clear();
+		mBuffers->Clear();
+		mScatters->Clear();
+		mBlocks->Clear();
 
 		// Set depth
 		mZ = -0.9f;
+		mGDIGraphics = nullptr;
 
 		return Drawing::RectangleF(mBL.X, mBL.Y, mTR.X - mBL.X, mTR.Y - mBL.Y);
 	}
 
-	int GLGraphics2D::GetCirclePrecision(float featureSize)
+	Primitive2D * GLGraphics2D::AddPrimitive(int type, Drawing::Color color)
+	{
+		if (mBatch->primitiveCount == mBatch->primitiveCapacity) _ReservePrimitives(mBatch, mBatch->primitiveCount + 1);
+		Primitive2D * prim = &mBatch->primitives[mBatch->primitiveCount++];
+		prim->type = type;
+		prim->color = GLVertexArray::PackColor(color);
+		prim->first = 0;
+		prim->count = 0;
+		return prim;
+	}
+
+	System::Void GLGraphics2D::AddPrimitive(int type, Drawing::Color color, float p0, float p1, float p2, float p3)
+	{
+		Primitive2D * prim = AddPrimitive(type, color);
+		prim->p[0] = p0;
+		prim->p[1] = p1;
+		prim->p[2] = p2;
+		prim->p[3] = p3;
+	}
+
+	System::Void GLGraphics2D::AddPrimitive(int type, Drawing::Color color, float p0, float p1, float p2, float p3, float p4, float p5)
 	{
-		// Measure the pixel size of the feature
-		int pts = mCanvas->WorldToScreen(Drawing::SizeF(featureSize, 0.0f)).Width;				
-		// Try to represent curved features by at most 4 pixels.
-		return (int)((float)Math::Sqrt(pts) * 3.0f) + 4;
+		Primitive2D * prim = AddPrimitive(type, color);
+		prim->p[0] = p0;
+		prim->p[1] = p1;
+		prim->p[2] = p2;
+		prim->p[3] = p3;
+		prim->p[4] = p4;
+		prim->p[5] = p5;
+	}
+
+	System::Void GLGraphics2D::AddPrimitive(int type, Drawing::Color color, array<Drawing::PointF, 1> ^ points)
+	{
+		// Copy corner points to the point pool
+		int first = mBatch->pointCount;
+		if (first + points->Length > mBatch->pointCapacity) _ReservePoints(mBatch, first + points->Length);
+		float * pt = mBatch->points + first * 2;
+		for (int i = 0; i < points->Length; i++)
+		{
+			pt[i * 2] = points[i].X;
+			pt[i * 2 + 1] = points[i].Y;
+		}
+		mBatch->pointCount += points->Length;
+
+		float lower[2], upper[2];
+		if (_StridedBounds(pt, points->Length, 2 * sizeof(float), 2, lower, upper))
+		{
+			UpdateLimits(lower[0], lower[1]);
+			UpdateLimits(upper[0], upper[1]);
+		}
+
+		Primitive2D * prim = AddPrimitive(type, color);
+		prim->first = first;
+		prim->count = points->Length;
+	}
+
+	System::Void GLGraphics2D::AddStroke(array<Drawing::PointF, 1> ^ points, float thickness, array<float> ^ thicknesses,
+		GLLineJoin join, GLLineCap cap, bool closed, Drawing::Color color)
+	{
+		// Thicknesses follow the points in the point pool, two to a point
+		int widthPoints = (thicknesses != nullptr ? (thicknesses->Length + 1) / 2 : 0);
+		AddPrimitive(PRIMITIVE_STROKE, color, points);
+		Primitive2D * prim = &mBatch->primitives[mBatch->primitiveCount - 1];
+		if (thicknesses != nullptr)
+		{
+			int first = mBatch->pointCount;
+			if (first + widthPoints > mBatch->pointCapacity) _ReservePoints(mBatch, first + widthPoints);
+			float * widths = mBatch->points + first * 2;
+			for (int i = 0; i < thicknesses->Length; i++)
+			{
+				widths[i] = thicknesses[i];
+				thickness = Math::Max(thickness, Math::Abs(thicknesses[i]));
+			}
+			widths[widthPoints * 2 - 1] = widths[thicknesses->Length - 1];
+			mBatch->pointCount += widthPoints;
+		}
+		prim->p[0] = (thicknesses != nullptr ? 0.0f : thickness);
+		prim->p[1] = (float)(int)join;
+		prim->p[2] = (float)(int)cap;
+		prim->p[3] = mMiterLimit;
+		prim->p[4] = (closed ? 1.0f : 0.0f);
+		prim->p[5] = (thicknesses != nullptr ? 1.0f : 0.0f);
+
+		// Extend drawing limits by the reach of the corners
+		float extent = Math::Abs(thickness) / 2 * Math::Max(join == GLLineJoin::Miter ? mMiterLimit : 0.0f, 1.5f);
+		float lower[2], upper[2];
+		if (_StridedBounds(mBatch->points + prim->first * 2, points->Length, 2 * sizeof(float), 2, lower, upper))
+		{
+			UpdateLimits(lower[0] - extent, lower[1] - extent);
+			UpdateLimits(upper[0] + extent, upper[1] + extent);
+		}
+	}
+
+	System::Void GLGraphics2D::UpdateArcLimits(float x, float y, float width, float height, float startAngle, float sweepAngle)
+	{
+		// End points of the arc
+		float a1 = Math::Min(startAngle, startAngle + sweepAngle);
+		float a2 = Math::Max(startAngle, startAngle + sweepAngle);
+		UpdateLimits(x + width / 2 * (float)Math::Cos(a1), y + height / 2 * (float)Math::Sin(a1));
+		UpdateLimits(x + width / 2 * (float)Math::Cos(a2), y + height / 2 * (float)Math::Sin(a2));
+
+		// Extreme points of the ellipse swept by the arc
+		double quarter = Math::PI / 2;
+		double end = Math::Min((double)a2, (double)a1 + 2 * Math::PI);
+		for (double a = Math::Ceiling(a1 / quarter) * quarter; a < end; a += quarter)
+			UpdateLimits(x + width / 2 * (float)Math::Cos(a), y + height / 2 * (float)Math::Sin(a));
 	}
 
 	System::Void GLGraphics2D::DrawRasterText(float x, float y, System::String ^ text, Drawing::Color color)
 	{
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawRasterText2D);
+			mRecorder->Write(x, y);
+			mRecorder->Write(text);
+			mRecorder->Write(color);
+			return;
+		}
+
+		if (mTexts == nullptr) throw gcnew InvalidOperationException(L"Text cannot be drawn in a block.");
+
 		mTexts->Add(GLTextParam(x, y, 0.0f, text, color, false));
 	}
 
 	System::Void GLGraphics2D::DrawVectorText(float x, float y, float height, System::String ^ text, Drawing::Color color)
 	{
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawVectorText2D);
+			mRecorder->Write(x, y, height);
+			mRecorder->Write(text);
+			mRecorder->Write(color);
+			return;
+		}
+
+		if (mTexts == nullptr) throw gcnew InvalidOperationException(L"Text cannot be drawn in a block.");
+
 		mTexts->Add(GLTextParam(x, y, height, text, color, true));
 	}
 
 	System::Void GLGraphics2D::DrawLine(float x1, float y1, float x2, float y2, Drawing::Color color)
 	{
-		// Check intersections
-		Drawing::RectangleF lRect(Math::Min(x1, x2), Math::Min(y1, y2), Math::Abs(x1 - x2), Math::Abs(y1 - y2));
-		if (mView.IntersectsWith(lRect))
+		if (mRecorder != nullptr)
 		{
-			mLines->AddVertex(x1, y1, mZ, color);
-			mLines->AddVertex(x2, y2, mZ, color);
-			UpdateDepth();
+			mRecorder->Write(GLCommandBuffer::Command::DrawLine2D);
+			mRecorder->Write(x1, y1);
+			mRecorder->Write(x2, y2);
+			mRecorder->Write(color);
+			return;
 		}
+
+		AddPrimitive(PRIMITIVE_LINE, color, x1, y1, x2, y2);
 		UpdateLimits(x1, y1);
 		UpdateLimits(x2, y2);
 	}
 
 	System::Void GLGraphics2D::DrawLine(float x1, float y1, float x2, float y2, float thickness, Drawing::Color color)
 	{
-		// Check intersections
-		Drawing::RectangleF lRect(Math::Min(x1, x2), Math::Min(y1, y2), Math::Abs(x1 - x2), Math::Abs(y1 - y2));
-		if (mView.IntersectsWith(lRect))
-		{
-			float angle = (float)Math::Atan2(y2 - y1, x2 - x1);
-			float t2sina = thickness / 2 * (float)Math::Sin(angle);
-			float t2cosa = thickness / 2 * (float)Math::Cos(angle);
-			mTriangles->AddVertex(x1 + t2sina, y1 - t2cosa, mZ, color);
-			mTriangles->AddVertex(x2 + t2sina, y2 - t2cosa, mZ, color);
-			mTriangles->AddVertex(x2 - t2sina, y2 + t2cosa, mZ, color);
-			mTriangles->AddVertex(x2 - t2sina, y2 + t2cosa, mZ, color);
-			mTriangles->AddVertex(x1 - t2sina, y1 + t2cosa, mZ, color);
-			mTriangles->AddVertex(x1 + t2sina, y1 - t2cosa, mZ, color);
-			UpdateDepth();
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawThickLine2D);
+			mRecorder->Write(x1, y1);
+			mRecorder->Write(x2, y2);
+			mRecorder->Write(thickness);
+			mRecorder->Write(color);
+			return;
 		}
+
+		AddPrimitive(PRIMITIVE_THICKLINE, color, x1, y1, x2, y2, thickness, thickness);
 		UpdateLimits(x1, y1);
 		UpdateLimits(x2, y2);
 	}
 
 	System::Void GLGraphics2D::DrawLine(float x1, float y1, float x2, float y2, float startthickness, float endthickness, Drawing::Color color)
 	{
-		// Check intersections
-		Drawing::RectangleF lRect(Math::Min(x1, x2), Math::Min(y1, y2), Math::Abs(x1 - x2), Math::Abs(y1 - y2));
-		if (mView.IntersectsWith(lRect))
-		{
-			float angle = (float)Math::Atan2(y2 - y1, x2 - x1);
-			float t2sina1 = startthickness / 2 * (float)Math::Sin(angle);
-			float t2cosa1 = startthickness / 2 * (float)Math::Cos(angle);
-			float t2sina2 = endthickness / 2 * (float)Math::Sin(angle);
-			float t2cosa2 = endthickness / 2 * (float)Math::Cos(angle);
-			mTriangles->AddVertex(x1 + t2sina1, y1 - t2cosa1, mZ, color);
-			mTriangles->AddVertex(x2 + t2sina2, y2 - t2cosa2, mZ, color);
-			mTriangles->AddVertex(x2 - t2sina2, y2 + t2cosa2, mZ, color);
-			mTriangles->AddVertex(x2 - t2sina2, y2 + t2cosa2, mZ, color);
-			mTriangles->AddVertex(x1 - t2sina1, y1 + t2cosa1, mZ, color);
-			mTriangles->AddVertex(x1 + t2sina1, y1 - t2cosa1, mZ, color);
-			UpdateDepth();
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawTaperedLine2D);
+			mRecorder->Write(x1, y1);
+			mRecorder->Write(x2, y2);
+			mRecorder->Write(startthickness, endthickness);
+			mRecorder->Write(color);
+			return;
 		}
+
+		AddPrimitive(PRIMITIVE_THICKLINE, color, x1, y1, x2, y2, startthickness, endthickness);
 		UpdateLimits(x1, y1);
 		UpdateLimits(x2, y2);
 	}
 
 	System::Void GLGraphics2D::DrawArc(float x, float y, float width, float height, float startAngle, float sweepAngle, Drawing::Color color) 
 	{
-		bool check = mView.IntersectsWith(Drawing::RectangleF(x - width / 2, y - height / 2, width, height));
-		float da = sweepAngle / (float)GetCirclePrecision(Math::Max(width, height));
-		for (float a = startAngle; a < startAngle + sweepAngle; a += da)
+		if (mRecorder != nullptr)
 		{
-			float xv = x + width / 2 * (float)Math::Cos(a);
-			float yv = y + height / 2 * (float)Math::Sin(a);
-			float xend = x + width / 2 * (float)Math::Cos(a + da);
-			float yend = y + height / 2 * (float)Math::Sin(a + da);
-			UpdateLimits(xv, yv);
-			UpdateLimits(xend, yend);
-
-			if (check)
-			{
-				mLines->AddVertex(xv, yv, mZ, color);
-				mLines->AddVertex(xend, yend, mZ, color);
-			}
+			mRecorder->Write(GLCommandBuffer::Command::DrawArc2D);
+			mRecorder->Write(x, y);
+			mRecorder->Write(width, height);
+			mRecorder->Write(startAngle, sweepAngle);
+			mRecorder->Write(color);
+			return;
 		}
 
-		UpdateDepth();
+		AddPrimitive(PRIMITIVE_ARC, color, x, y, width, height, startAngle, sweepAngle);
+		UpdateArcLimits(x, y, width, height, startAngle, sweepAngle);
 	}
 
 	System::Void GLGraphics2D::FillPie(float x, float y, float width, float height, float startAngle, float sweepAngle, Drawing::Color color) 
 	{ 
-		bool check = mView.IntersectsWith(Drawing::RectangleF(x - width / 2, y - height / 2, width, height));
-		float da = sweepAngle / (float)GetCirclePrecision(Math::Max(width, height));
-		for (float a = startAngle; a < startAngle + sweepAngle; a += da)
-		{
-			float xv = x + width / 2 * (float)Math::Cos(a);
-			float yv = y + height / 2 * (float)Math::Sin(a);
-			float xend = x + width / 2 * (float)Math::Cos(a + da);
-			float yend = y + height / 2 * (float)Math::Sin(a + da);
-			UpdateLimits(xv, yv);
-			UpdateLimits(xend, yend);
-
-			if (check)
-			{
-				mTriangles->AddVertex(x, y, mZ, color);
-				mTriangles->AddVertex(xv, yv, mZ, color);
-				mTriangles->AddVertex(xend, yend, mZ, color);
-			}
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::FillPie2D);
+			mRecorder->Write(x, y);
+			mRecorder->Write(width, height);
+			mRecorder->Write(startAngle, sweepAngle);
+			mRecorder->Write(color);
+			return;
 		}
 
-		UpdateDepth();
+		AddPrimitive(PRIMITIVE_PIE, color, x, y, width, height, startAngle, sweepAngle);
+		UpdateArcLimits(x, y, width, height, startAngle, sweepAngle);
 	}
 
 	System::Void GLGraphics2D::DrawTriangle(float x1, float y1, float x2, float y2,float x3,float y3, Drawing::Color color)
 	{
-		float xmin = Math::Min(Math::Min(x1, x2), x3);
-		float ymin = Math::Min(Math::Min(y1, y2), y3);
-		float xmax = Math::Max(Math::Max(x1, x2), x3);
-		float ymax = Math::Max(Math::Max(y1, y2), y3);
-		Drawing::RectangleF lRect(xmin, ymin, xmax - xmin, ymax - ymin);
-		if (mView.IntersectsWith(lRect))
+		if (mRecorder != nullptr)
 		{
-			mLines->AddVertex(x1, y1, mZ, color);
-			mLines->AddVertex(x2, y2, mZ, color);
-
-			mLines->AddVertex(x2, y2, mZ, color);
-			mLines->AddVertex(x3, y3, mZ, color);
-
-			mLines->AddVertex(x3, y3, mZ, color);
-			mLines->AddVertex(x1, y1, mZ, color);
-
-			UpdateDepth();
+			mRecorder->Write(GLCommandBuffer::Command::DrawTriangle2D);
+			mRecorder->Write(x1, y1);
+			mRecorder->Write(x2, y2);
+			mRecorder->Write(x3, y3);
+			mRecorder->Write(color);
+			return;
 		}
 
+		AddPrimitive(PRIMITIVE_TRIANGLE, color, x1, y1, x2, y2, x3, y3);
 		UpdateLimits(x1, y1);
 		UpdateLimits(x2, y2);
 		UpdateLimits(x3, y3);
@@ -212,117 +484,67 @@ namespace GLCanvas
 
 	System::Void GLGraphics2D::DrawRectangle(float x1, float y1, float x2, float y2, Drawing::Color color) 
 	{ 
-		bool check = mView.IntersectsWith(Drawing::RectangleF(Math::Min(x1, x2), Math::Min(y1, y2), Math::Abs(x1 - x2), Math::Abs(y1 - y2)));
-
-		if (check)
+		if (mRecorder != nullptr)
 		{
-			mLines->AddVertex(x1, y1, mZ, color);
-			mLines->AddVertex(x2, y1, mZ, color);
-
-			mLines->AddVertex(x2, y1, mZ, color);
-			mLines->AddVertex(x2, y2, mZ, color);
-
-			mLines->AddVertex(x2, y2, mZ, color);
-			mLines->AddVertex(x1, y2, mZ, color);
-
-			mLines->AddVertex(x1, y2, mZ, color);
-			mLines->AddVertex(x1, y1, mZ, color);
-
-			UpdateDepth();
+			mRecorder->Write(GLCommandBuffer::Command::DrawRectangle2D);
+			mRecorder->Write(x1, y1);
+			mRecorder->Write(x2, y2);
+			mRecorder->Write(color);
+			return;
 		}
 
+		AddPrimitive(PRIMITIVE_RECTANGLE, color, x1, y1, x2, y2);
 		UpdateLimits(x1, y1);
 		UpdateLimits(x2, y2);
 	}
 
 	System::Void GLGraphics2D::DrawRoundedRectangle(float x1, float y1, float x2, float y2, float rx, float ry, Drawing::Color color)
 	{
-		DrawLine(x1 + rx, y1, x2 - rx, y1, color);
-		DrawLine(x1 + rx, y2, x2 - rx, y2, color);
-		DrawLine(x1, y1 + ry, x1, y2 - ry, color);
-		DrawLine(x2, y1 + ry, x2, y2 - ry, color);
-
-	    int prec = GetCirclePrecision(Math::Max(rx, ry) * 2.0f);
-		// make precision divisable by 4, this is neccessary for the
-		// loop variable to detect the offset change
-		prec = (prec | 3) + 1;
-		float da = 2.0f * (float)Math::PI / (float)prec;	
-
-		float x = x2 - rx;	// offset ellipse to first corner (upper right)
-		float y = y2 - ry;
-		for(int loop = 0; loop < prec; loop++)
+		if (mRecorder != nullptr)
 		{
-			float a = da * (float)loop;
-			float xv = x + rx * (float)Math::Cos(a);
-			float yv = y + ry * (float)Math::Sin(a);
-			float xend = x + rx * (float)Math::Cos(a + da);
-			float yend = y + ry * (float)Math::Sin(a + da);
-
-			mLines->AddVertex(xv, yv, mZ, color);
-			mLines->AddVertex(xend, yend, mZ, color);
-
-			if (loop == (prec / 4) * 1 - 1) x = x1 + rx;		// offset ellipse to second corner (upper left)
-			if (loop == (prec / 4) * 2 - 1) y = y1 + ry;		// offset ellipse to third corner (lower left)
-			if (loop == (prec / 4) * 3 - 1) x = x2 - rx;		// offset ellipse to fourth corner (lower right)
+			mRecorder->Write(GLCommandBuffer::Command::DrawRoundedRectangle2D);
+			mRecorder->Write(x1, y1);
+			mRecorder->Write(x2, y2);
+			mRecorder->Write(rx, ry);
+			mRecorder->Write(color);
+			return;
 		}
-		UpdateDepth();
 
+		AddPrimitive(PRIMITIVE_ROUNDEDRECTANGLE, color, x1, y1, x2, y2, rx, ry);
 		UpdateLimits(x1, y1);
 		UpdateLimits(x2, y2);
 	}
 
 	System::Void GLGraphics2D::FillRoundedRectangle(float x1, float y1, float x2, float y2, float rx, float ry, Drawing::Color color)
 	{
-		FillRectangle(x1, y1 + ry, x2, y2 - ry, color);			// center
-		FillRectangle(x1 + rx, y2 - ry, x2 - rx, y2, color);	// top
-		FillRectangle(x1 + rx, y1, x2 - rx, y1 + ry, color);	// bottom
-
-	    int prec = GetCirclePrecision(Math::Max(rx, ry) * 2.0f);
-		// make precision divisable by 4, this is neccessary for the
-		// loop variable to detect the offset change
-		prec = (prec | 3) + 1;
-		float da = 2.0f * (float)Math::PI / (float)prec;	
-
-		float x = x2 - rx;	// offset ellipse to first corner (upper right)
-		float y = y2 - ry;
-		for(int loop = 0; loop < prec; loop++)
+		if (mRecorder != nullptr)
 		{
-			float a = da * (float)loop;
-			float xv = x + rx * (float)Math::Cos(a);
-			float yv = y + ry * (float)Math::Sin(a);
-			float xend = x + rx * (float)Math::Cos(a + da);
-			float yend = y + ry * (float)Math::Sin(a + da);
-
-			mTriangles->AddVertex(x, y, mZ, color);
-			mTriangles->AddVertex(xv, yv, mZ, color);
-			mTriangles->AddVertex(xend, yend, mZ, color);
-
-			if (loop == (prec / 4) * 1 - 1) x = x1 + rx;		// offset ellipse to second corner (upper left)
-			if (loop == (prec / 4) * 2 - 1) y = y1 + ry;		// offset ellipse to third corner (lower left)
-			if (loop == (prec / 4) * 3 - 1) x = x2 - rx;		// offset ellipse to fourth corner (lower right)
+			mRecorder->Write(GLCommandBuffer::Command::FillRoundedRectangle2D);
+			mRecorder->Write(x1, y1);
+			mRecorder->Write(x2, y2);
+			mRecorder->Write(rx, ry);
+			mRecorder->Write(color);
+			return;
 		}
-		UpdateDepth();
 
+		AddPrimitive(PRIMITIVE_FILLROUNDEDRECTANGLE, color, x1, y1, x2, y2, rx, ry);
 		UpdateLimits(x1, y1);
 		UpdateLimits(x2, y2);
 	}
 
 	System::Void GLGraphics2D::FillTriangle(float x1, float y1, float x2, float y2,float x3,float y3, Drawing::Color color)
 	{
-		float xmin = Math::Min(Math::Min(x1, x2), x3);
-		float ymin = Math::Min(Math::Min(y1, y2), y3);
-		float xmax = Math::Max(Math::Max(x1, x2), x3);
-		float ymax = Math::Max(Math::Max(y1, y2), y3);
-		Drawing::RectangleF lRect(xmin, ymin, xmax - xmin, ymax - ymin);
-		if (mView.IntersectsWith(lRect))
+		if (mRecorder != nullptr)
 		{
-			mTriangles->AddVertex(x1, y1, mZ, color);
-			mTriangles->AddVertex(x2, y2, mZ, color);
-			mTriangles->AddVertex(x3, y3, mZ, color);
-
-			UpdateDepth();
+			mRecorder->Write(GLCommandBuffer::Command::FillTriangle2D);
+			mRecorder->Write(x1, y1);
+			mRecorder->Write(x2, y2);
+			mRecorder->Write(x3, y3);
+			mRecorder->Write(color);
+			return;
 		}
 
+		AddPrimitive(PRIMITIVE_FILLTRIANGLE, color, x1, y1, x2, y2, x3, y3);
 		UpdateLimits(x1, y1);
 		UpdateLimits(x2, y2);
 		UpdateLimits(x3, y3);
@@ -330,68 +552,48 @@ namespace GLCanvas
 
 	System::Void GLGraphics2D::FillRectangle(float x1, float y1, float x2, float y2, Drawing::Color color) 
 	{ 
-		bool check = mView.IntersectsWith(Drawing::RectangleF(Math::Min(x1, x2), Math::Min(y1, y2), Math::Abs(x1 - x2), Math::Abs(y1 - y2)));
-
-		if (check)
+		if (mRecorder != nullptr)
 		{
-			mTriangles->AddVertex(x1, y1, mZ, color);
-			mTriangles->AddVertex(x2, y1, mZ, color);
-			mTriangles->AddVertex(x2, y2, mZ, color);
-
-			mTriangles->AddVertex(x2, y2, mZ, color);
-			mTriangles->AddVertex(x1, y2, mZ, color);
-			mTriangles->AddVertex(x1, y1, mZ, color);
-
-			UpdateDepth();
+			mRecorder->Write(GLCommandBuffer::Command::FillRectangle2D);
+			mRecorder->Write(x1, y1);
+			mRecorder->Write(x2, y2);
+			mRecorder->Write(color);
+			return;
 		}
 
+		AddPrimitive(PRIMITIVE_FILLRECTANGLE, color, x1, y1, x2, y2);
 		UpdateLimits(x1, y1);
 		UpdateLimits(x2, y2);
 	}
 
 	System::Void GLGraphics2D::DrawEllipse(float x, float y, float width, float height, Drawing::Color color) 
 	{ 
-		bool check = mView.IntersectsWith(Drawing::RectangleF(x - width / 2, y - height / 2, width, height));
-		if (check)
+		if (mRecorder != nullptr)
 		{
-			float da = 2.0f * (float)Math::PI / (float)GetCirclePrecision(Math::Max(width, height));
-			for (float a = 0; a <= 2.0f * (float)Math::PI; a += da)
-			{
-				float xv = x + width / 2 * (float)Math::Cos(a);
-				float yv = y + height / 2 * (float)Math::Sin(a);
-				float xend = x + width / 2 * (float)Math::Cos(a + da);
-				float yend = y + height / 2 * (float)Math::Sin(a + da);
-
-				mLines->AddVertex(xv, yv, mZ, color);
-				mLines->AddVertex(xend, yend, mZ, color);
-			}
-			UpdateDepth();
+			mRecorder->Write(GLCommandBuffer::Command::DrawEllipse2D);
+			mRecorder->Write(x, y);
+			mRecorder->Write(width, height);
+			mRecorder->Write(color);
+			return;
 		}
 
+		AddPrimitive(PRIMITIVE_ELLIPSE, color, x, y, width, height);
 		UpdateLimits(x - width / 2.0f, y - height / 2.0f);
 		UpdateLimits(x + width / 2.0f, y + height / 2.0f);
 	}
 
 	System::Void GLGraphics2D::FillEllipse(float x, float y, float width, float height, Drawing::Color color) 
 	{ 
-		bool check = mView.IntersectsWith(Drawing::RectangleF(x - width / 2, y - height / 2, width, height));
-		if (check)
+		if (mRecorder != nullptr)
 		{
-			float da = 2.0f * (float)Math::PI / (float)GetCirclePrecision(Math::Max(width, height));
-			for (float a = 0; a <= 2.0f * (float)Math::PI; a += 2.0f * (float)Math::PI / (float)GetCirclePrecision(Math::Max(width, height)))
-			{
-				float xv = x + width / 2 * (float)Math::Cos(a);
-				float yv = y + height / 2 * (float)Math::Sin(a);
-				float xend = x + width / 2 * (float)Math::Cos(a + da);
-				float yend = y + height / 2 * (float)Math::Sin(a + da);
-
-				mTriangles->AddVertex(x, y, mZ, color);
-				mTriangles->AddVertex(xv, yv, mZ, color);
-				mTriangles->AddVertex(xend, yend, mZ, color);
-			}
-			UpdateDepth();
+			mRecorder->Write(GLCommandBuffer::Command::FillEllipse2D);
+			mRecorder->Write(x, y);
+			mRecorder->Write(width, height);
+			mRecorder->Write(color);
+			return;
 		}
 
+		AddPrimitive(PRIMITIVE_FILLELLIPSE, color, x, y, width, height);
 		UpdateLimits(x - width / 2.0f, y - height / 2.0f);
 		UpdateLimits(x + width / 2.0f, y + height / 2.0f);
 	}
@@ -400,46 +602,298 @@ namespace GLCanvas
 	{
 		if (points->Length < 2) return;
 
-		for (int i = 0; i <= points->Length - 1; i++)
+		if (mRecorder != nullptr)
 		{
-			int j = (i == points->Length - 1 ? 0 : i + 1);
-			mLines->AddVertex(points[i].X, points[i].Y, mZ, color);
-			mLines->AddVertex(points[j].X, points[j].Y, mZ, color);
-			UpdateLimits(points[i].X, points[i].Y);
-			UpdateLimits(points[j].X, points[j].Y);
+			mRecorder->Write(GLCommandBuffer::Command::DrawPolygon2D);
+			mRecorder->Write(points);
+			mRecorder->Write(color);
+			return;
 		}
-		UpdateDepth();
+
+		AddPrimitive(PRIMITIVE_POLYGON, color, points);
+	}
+
+	System::Void GLGraphics2D::DrawPolyline(array<Drawing::PointF, 1> ^ points, float thickness, GLLineJoin join, GLLineCap cap, Drawing::Color color)
+	{
+		if (points == nullptr) throw gcnew ArgumentNullException(L"points");
+		if (points->Length < 2) return;
+
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawThickPolyline2D);
+			mRecorder->Write(points);
+			mRecorder->Write(thickness);
+			mRecorder->Write((int)join);
+			mRecorder->Write((int)cap);
+			mRecorder->Write(color);
+			return;
+		}
+
+		AddStroke(points, thickness, nullptr, join, cap, false, color);
+	}
+
+	System::Void GLGraphics2D::DrawPolyline(array<Drawing::PointF, 1> ^ points, array<float> ^ thicknesses, GLLineJoin join, GLLineCap cap, Drawing::Color color)
+	{
+		if (points == nullptr) throw gcnew ArgumentNullException(L"points");
+		if (thicknesses == nullptr) throw gcnew ArgumentNullException(L"thicknesses");
+		if (thicknesses->Length != points->Length) throw gcnew ArgumentException(L"A thickness must be given for each point.", L"thicknesses");
+		if (points->Length < 2) return;
+
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawTaperedPolyline2D);
+			mRecorder->Write(points);
+			mRecorder->Write(thicknesses);
+			mRecorder->Write((int)join);
+			mRecorder->Write((int)cap);
+			mRecorder->Write(color);
+			return;
+		}
+
+		AddStroke(points, 0.0f, thicknesses, join, cap, false, color);
+	}
+
+	System::Void GLGraphics2D::DrawPolygon(array<Drawing::PointF, 1> ^ points, float thickness, GLLineJoin join, Drawing::Color color)
+	{
+		if (points == nullptr) throw gcnew ArgumentNullException(L"points");
+		if (points->Length < 2) return;
+
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawThickPolygon2D);
+			mRecorder->Write(points);
+			mRecorder->Write(thickness);
+			mRecorder->Write((int)join);
+			mRecorder->Write(color);
+			return;
+		}
+
+		AddStroke(points, thickness, nullptr, join, GLLineCap::Flat, true, color);
+	}
+
+	System::Void GLGraphics2D::DrawBeziers(array<Drawing::PointF, 1> ^ points, Drawing::Color color)
+	{
+		if (points == nullptr) throw gcnew ArgumentNullException(L"points");
+		if (points->Length < 4 || (points->Length - 1) % 3 != 0) throw gcnew ArgumentException(L"The number of points must be 3n + 1.", L"points");
+
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawBeziers2D);
+			mRecorder->Write(points);
+			mRecorder->Write(color);
+			return;
+		}
+
+		// Curves are flattened by the tessellator
+		AddPrimitive(PRIMITIVE_BEZIER, color, points);
+	}
+
+	System::Void GLGraphics2D::DrawQuadraticBeziers(array<Drawing::PointF, 1> ^ points, Drawing::Color color)
+	{
+		if (points == nullptr) throw gcnew ArgumentNullException(L"points");
+		if (points->Length < 3 || (points->Length - 1) % 2 != 0) throw gcnew ArgumentException(L"The number of points must be 2n + 1.", L"points");
+
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawQuadraticBeziers2D);
+			mRecorder->Write(points);
+			mRecorder->Write(color);
+			return;
+		}
+
+		AddPrimitive(PRIMITIVE_QUADRATICBEZIER, color, points);
+	}
+
+	System::Void GLGraphics2D::DrawBSpline(array<Drawing::PointF, 1> ^ points, Drawing::Color color)
+	{
+		if (points == nullptr) throw gcnew ArgumentNullException(L"points");
+		if (points->Length < 4) throw gcnew ArgumentException(L"At least four control points are required.", L"points");
+
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawBSpline2D);
+			mRecorder->Write(points);
+			mRecorder->Write(color);
+			return;
+		}
+
+		AddPrimitive(PRIMITIVE_BSPLINE, color, points);
 	}
 
 	System::Void GLGraphics2D::FillPolygon(array<Drawing::PointF, 1> ^ points, Drawing::Color color) 
 	{ 
 		if (points->Length < 3) return;
 
-		// Calculate center coordinates. Polygons are drawn as triangle fans sharing this point.
-		// This is why only concave polygons are supported.
-		float x = 0;
-		float y = 0;
-		for (int i = 0; i < points->Length; i++)
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::FillPolygon2D);
+			mRecorder->Write(points);
+			mRecorder->Write(color);
+			return;
+		}
+
+		// Polygons are triangulated by the tessellator
+		AddPrimitive(PRIMITIVE_FILLPOLYGON, color, points);
+	}
+
+	System::Void GLGraphics2D::FillPolygon(GLPolygon ^ polygon, Drawing::Color color)
+	{
+		if (polygon == nullptr) throw gcnew ArgumentNullException(L"polygon");
+
+		// Recorded polygons are kept at full detail, since they may be played back at any zoom
+		float tolerance = (mRecorder != nullptr ? 0 : mCanvas->PixelSize * mCanvas->LevelOfDetail);
+		int count;
+		const float * triangles = polygon->GetTriangles(tolerance, count);
+		if (count == 0) return;
+
+		if (mRecorder != nullptr)
+		{
+			// Record the triangulation, so that it is not computed again on playback
+			array<Drawing::PointF> ^ points = gcnew array<Drawing::PointF>(count);
+			for (int i = 0; i < count; i++)
+				points[i] = Drawing::PointF(triangles[i * 2], triangles[i * 2 + 1]);
+			FillTriangles(points, color);
+			return;
+		}
+
+		// Copy the cached triangles to the point pool
+		int first = mBatch->pointCount;
+		if (first + count > mBatch->pointCapacity) _ReservePoints(mBatch, first + count);
+		memcpy(mBatch->points + first * 2, triangles, count * 2 * sizeof(float));
+		mBatch->pointCount += count;
+
+		Primitive2D * prim = AddPrimitive(PRIMITIVE_TRIANGLELIST, color);
+		prim->first = first;
+		prim->count = count;
+
+		Drawing::RectangleF bounds = polygon->Bounds;
+		UpdateLimits(bounds.Left, bounds.Top);
+		UpdateLimits(bounds.Right, bounds.Bottom);
+	}
+
+	System::Void GLGraphics2D::DrawPolygon(GLPolygon ^ polygon, Drawing::Color color)
+	{
+		if (polygon == nullptr) throw gcnew ArgumentNullException(L"polygon");
+
+		for (int i = 0; i < polygon->RingCount; i++)
 		{
-			x += points[i].X;
-			y += points[i].Y;
-			UpdateLimits(points[i].X, points[i].Y);
+			bool isHole;
+			array<Drawing::PointF> ^ ring = polygon->GetRing(i, isHole);
+			if (ring->Length >= 2) DrawPolygon(ring, color);
 		}
-		x /= (float)points->Length;
-		y /= (float)points->Length;
+	}
+
+	System::Void GLGraphics2D::AddBlockReference(GLBlock ^ block, float m11, float m12, float m21, float m22, float dx, float dy, Drawing::Color color)
+	{
+		if (block == nullptr) throw gcnew ArgumentNullException(L"block");
+		if (mRecorder != nullptr) throw gcnew InvalidOperationException(L"Block references cannot be recorded into a command buffer.");
+		if (mCanvas == nullptr) throw gcnew InvalidOperationException(L"Blocks cannot be nested.");
+		if (block->PrimitiveCount == 0) return;
+
+		// The block is tessellated for the finest pixel size of its references
+		float scale = (float)Math::Sqrt(Math::Max(m11 * m11 + m12 * m12, m21 * m21 + m22 * m22));
+		if (!(scale > 0)) return;
+		if (block->Require(mCanvas->PixelSize / scale, mFrame))
+		{
+			block->Index = _AddBlock(mBatch, block->Block);
+			mBlocks->Add(block);
+		}
+
+		// Without a color, dots drawn for tiny references take the color of the first primitive
+		Primitive2D * prim = AddPrimitive(PRIMITIVE_BLOCK, color);
+		if (color.IsEmpty) prim->color = block->Block->definition->primitives[0].color;
+		prim->first = block->Index;
+		prim->count = (color.IsEmpty ? 0 : 1);
+		prim->p[0] = m11; prim->p[1] = m12;
+		prim->p[2] = m21; prim->p[3] = m22;
+		prim->p[4] = dx; prim->p[5] = dy;
+
+		Drawing::RectangleF bounds = block->Bounds;
+		float x1 = bounds.Left, y1 = bounds.Top, x2 = bounds.Right, y2 = bounds.Bottom;
+		UpdateLimits(m11 * x1 + m21 * y1 + dx, m12 * x1 + m22 * y1 + dy);
+		UpdateLimits(m11 * x2 + m21 * y1 + dx, m12 * x2 + m22 * y1 + dy);
+		UpdateLimits(m11 * x1 + m21 * y2 + dx, m12 * x1 + m22 * y2 + dy);
+		UpdateLimits(m11 * x2 + m21 * y2 + dx, m12 * x2 + m22 * y2 + dy);
+	}
+
+	System::Void GLGraphics2D::CaptureCommands(GLCommandBuffer ^ commands, Batch2D * definition)
+	{
+		GLGraphics2D ^ graphics = gcnew GLGraphics2D(definition);
+		graphics->DrawCommands(commands);
+	}
+
+	System::Void GLGraphics2D::FillTriangles(array<Drawing::PointF, 1> ^ points, Drawing::Color color)
+	{
+		if (points->Length < 3) return;
 
-		for (int i = 0; i <= points->Length - 1; i++)
+		if (mRecorder != nullptr)
 		{
-			int j = (i == points->Length - 1 ? 0 : i + 1);
-			mTriangles->AddVertex(x, y, mZ, color);
-			mTriangles->AddVertex(points[i].X, points[i].Y, mZ, color);
-			mTriangles->AddVertex(points[j].X, points[j].Y, mZ, color);
+			mRecorder->Write(GLCommandBuffer::Command::FillTriangles2D);
+			mRecorder->Write(points);
+			mRecorder->Write(color);
+			return;
 		}
-		UpdateDepth();
+
+		AddPrimitive(PRIMITIVE_TRIANGLELIST, color, points);
+	}
+
+	System::Void GLGraphics2D::DrawBuffer(GLExternalBuffer ^ buffer)
+	{
+		if (buffer == nullptr) throw gcnew ArgumentNullException(L"buffer");
+		if (mRecorder != nullptr) throw gcnew InvalidOperationException(L"External buffers cannot be recorded into a command buffer.");
+
+		float xmin, ymin, zmin, xmax, ymax, zmax;
+		if (!buffer->GetBounds(xmin, ymin, zmin, xmax, ymax, zmax)) return;
+
+		mBuffers->Add(buffer);
+		UpdateLimits(xmin, ymin);
+		UpdateLimits(xmax, ymax);
+	}
+
+	System::Void GLGraphics2D::DrawTimeSeries(GLTimeSeries ^ series, Drawing::Color color)
+	{
+		if (series == nullptr) throw gcnew ArgumentNullException(L"series");
+		if (mRecorder != nullptr) throw gcnew InvalidOperationException(L"Time series cannot be recorded into a command buffer.");
+
+		if (series->Count == 0) return;
+		Drawing::RectangleF bounds = series->Bounds;
+		UpdateLimits(bounds.Left, bounds.Top);
+		UpdateLimits(bounds.Right, bounds.Bottom);
+
+		// Reduce the visible samples directly into the point pool
+		float xmin = Math::Max(mView.Left, bounds.Left);
+		float xmax = Math::Min(mView.Right, bounds.Right);
+		if (xmin > xmax) return;
+		int columns = Math::Max((int)Math::Ceiling((xmax - xmin) / mCanvas->PixelSize), 1);
+		int first = mBatch->pointCount;
+		int capacity = first + _DecimatedPointCount(columns);
+		if (capacity > mBatch->pointCapacity) _ReservePoints(mBatch, capacity);
+		int count = _DecimateTimeSeries(series->Series, series->Origin, series->Interval,
+			xmin, xmax, columns, mBatch->points + first * 2);
+		if (count == 0) return;
+		mBatch->pointCount += count;
+
+		Primitive2D * prim = AddPrimitive(PRIMITIVE_POLYLINE, color);
+		prim->first = first;
+		prim->count = count;
+	}
+
+	System::Void GLGraphics2D::DrawScatter(GLScatter ^ scatter)
+	{
+		if (scatter == nullptr) throw gcnew ArgumentNullException(L"scatter");
+		if (mRecorder != nullptr) throw gcnew InvalidOperationException(L"Scatter plots cannot be recorded into a command buffer.");
+		if (scatter->Count == 0) return;
+
+		mScatters->Add(scatter);
+		Drawing::RectangleF bounds = scatter->Bounds;
+		UpdateLimits(bounds.Left, bounds.Top);
+		UpdateLimits(bounds.Right, bounds.Bottom);
 	}
 
 	Drawing::SizeF GLGraphics2D::MeasureString(System::String ^ text)
 	{
+		if (mRecorder != nullptr) throw gcnew InvalidOperationException(L"Text cannot be measured while recording a command buffer.");
+
 		Drawing::SizeF szf = mGDIGraphics->MeasureString(text, mCanvas->Font);
 		Drawing::SizeF sz = mCanvas->ScreenToWorld(Drawing::Size((int)szf.Width, (int)szf.Height));
 		if (sz.Width < 0) sz.Width = -sz.Width;
@@ -447,4 +901,161 @@ namespace GLCanvas
 		return sz;
 	}
 
+	System::Void GLGraphics2D::DrawCommands(GLCommandBuffer ^ commands)
+	{
+		if (commands == nullptr) throw gcnew ArgumentNullException(L"commands");
+		if (commands == mRecorder) throw gcnew InvalidOperationException(L"A command buffer cannot be drawn into itself.");
+
+		System::IO::BinaryReader ^ reader = commands->GetReader();
+		for (int i = 0; i < commands->Count; i++)
+		{
+			float x1, y1, x2, y2, x3, y3, a, b;
+			System::String ^ text;
+			array<Drawing::PointF> ^ points;
+			GLLineJoin join;
+			GLLineCap cap;
+
+			switch ((GLCommandBuffer::Command)reader->ReadByte())
+			{
+			case GLCommandBuffer::Command::LineWidth2D:
+				LineWidth = reader->ReadSingle();
+				break;
+			case GLCommandBuffer::Command::DrawRasterText2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				text = reader->ReadString();
+				DrawRasterText(x1, y1, text, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawVectorText2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); a = reader->ReadSingle();
+				text = reader->ReadString();
+				DrawVectorText(x1, y1, a, text, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawLine2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				DrawLine(x1, y1, x2, y2, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawThickLine2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				a = reader->ReadSingle();
+				DrawLine(x1, y1, x2, y2, a, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawTaperedLine2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				a = reader->ReadSingle(); b = reader->ReadSingle();
+				DrawLine(x1, y1, x2, y2, a, b, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawArc2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				a = reader->ReadSingle(); b = reader->ReadSingle();
+				DrawArc(x1, y1, x2, y2, a, b, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillPie2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				a = reader->ReadSingle(); b = reader->ReadSingle();
+				FillPie(x1, y1, x2, y2, a, b, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawTriangle2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				x3 = reader->ReadSingle(); y3 = reader->ReadSingle();
+				DrawTriangle(x1, y1, x2, y2, x3, y3, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillTriangle2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				x3 = reader->ReadSingle(); y3 = reader->ReadSingle();
+				FillTriangle(x1, y1, x2, y2, x3, y3, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawRectangle2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				DrawRectangle(x1, y1, x2, y2, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillRectangle2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				FillRectangle(x1, y1, x2, y2, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawRoundedRectangle2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				a = reader->ReadSingle(); b = reader->ReadSingle();
+				DrawRoundedRectangle(x1, y1, x2, y2, a, b, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillRoundedRectangle2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				a = reader->ReadSingle(); b = reader->ReadSingle();
+				FillRoundedRectangle(x1, y1, x2, y2, a, b, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawEllipse2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				DrawEllipse(x1, y1, x2, y2, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillEllipse2D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle();
+				FillEllipse(x1, y1, x2, y2, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawPolygon2D:
+				points = GLCommandBuffer::ReadPoints(reader);
+				DrawPolygon(points, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillPolygon2D:
+				points = GLCommandBuffer::ReadPoints(reader);
+				FillPolygon(points, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillTriangles2D:
+				points = GLCommandBuffer::ReadPoints(reader);
+				FillTriangles(points, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawBeziers2D:
+				points = GLCommandBuffer::ReadPoints(reader);
+				DrawBeziers(points, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawQuadraticBeziers2D:
+				points = GLCommandBuffer::ReadPoints(reader);
+				DrawQuadraticBeziers(points, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawBSpline2D:
+				points = GLCommandBuffer::ReadPoints(reader);
+				DrawBSpline(points, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::MiterLimit2D:
+				MiterLimit = reader->ReadSingle();
+				break;
+			case GLCommandBuffer::Command::DrawThickPolyline2D:
+				points = GLCommandBuffer::ReadPoints(reader);
+				a = reader->ReadSingle();
+				join = (GLLineJoin)reader->ReadInt32();
+				cap = (GLLineCap)reader->ReadInt32();
+				DrawPolyline(points, a, join, cap, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawTaperedPolyline2D:
+				{
+					points = GLCommandBuffer::ReadPoints(reader);
+					array<float> ^ thicknesses = GLCommandBuffer::ReadSingles(reader);
+					join = (GLLineJoin)reader->ReadInt32();
+					cap = (GLLineCap)reader->ReadInt32();
+					DrawPolyline(points, thicknesses, join, cap, GLCommandBuffer::ReadColor(reader));
+				}
+				break;
+			case GLCommandBuffer::Command::DrawThickPolygon2D:
+				points = GLCommandBuffer::ReadPoints(reader);
+				a = reader->ReadSingle();
+				join = (GLLineJoin)reader->ReadInt32();
+				DrawPolygon(points, a, join, GLCommandBuffer::ReadColor(reader));
+				break;
+			default:
+				throw gcnew InvalidOperationException(L"The command buffer contains commands that cannot be drawn on a 2D canvas.");
+			}
+		}
+	}
+
 }
\ No newline at end of file
@@ -2,14 +2,27 @@
 
 #include <windows.h>
 #include <GL/gl.h>
+#include "GLStrokeStyle.h"
 #include "GLVertexArray.h"
 
 using namespace System;
 
+// Native tessellator types
+struct Batch2D;
+struct Primitive2D;
+struct ShapeBuffer;
+
 namespace GLCanvas {
 
 	// Forward class declarations
+	ref class GLBlock;
 	ref class GLCanvas2D;
+	ref class GLCommandBuffer;
+	ref class GLExternalBuffer;
+	ref class GLPolygon;
+	ref class GLRenderStatistics;
+	ref class GLScatter;
+	ref class GLTimeSeries;
 
 	/// <summary>
 	/// Contains methods for drawing on the canvas.
@@ -18,16 +31,30 @@ namespace GLCanvas {
 	{
 	// Constructor/destructor
 	internal:
-		GLGraphics2D(GLCanvas2D ^ Canvas, Drawing::Graphics ^ GDIGraphics);
+		GLGraphics2D(GLCanvas2D ^ Canvas);
+
+	public:
+		/// <summary>
+		/// Initializes a new instance of the GLGraphics2D class that records drawing
+		/// commands into the given command buffer instead of drawing them. The recorded
+		/// commands can later be drawn with DrawCommands. A recording graphics object 
+		/// does not require an OpenGL context and can be used from any thread.
+		/// </summary>
+		/// <param name="Buffer">The command buffer to record into</param>
+		GLGraphics2D(GLCommandBuffer ^ Buffer);
+
+		~GLGraphics2D(); // Dispose
+
+	private:
+		/// <summary>
+		/// Initializes a new instance of the GLGraphics2D class that collects drawing
+		/// objects into the primitives of a block definition. The batch is not owned.
+		/// </summary>
+		/// <param name="Definition">The batch receiving the primitives of the block</param>
+		GLGraphics2D(Batch2D * Definition);
 
 	protected:
-		~GLGraphics2D() // Dispose
-		{ 
-			// Clear arrays
-			mTriangles->Clear();
-			mLines->Clear();
-			mTexts->Clear();
-		}
+		!GLGraphics2D(); // Finalize
 
 	// Privat classes
 	private:
@@ -53,24 +80,69 @@ namespace GLCanvas {
 	private:
 		bool mInit;
 		float mLineWidth;
+		float mMiterLimit;
 		float mZ;
 		Drawing::RectangleF mView;
 		System::Drawing::Graphics^ mGDIGraphics;
 		GLCanvas2D^ mCanvas;
+		GLCommandBuffer^ mRecorder;
+		Batch2D * mBatch;
 		GLVertexArray^ mTriangles;
 		GLVertexArray^ mLines;
+		GLVertexArray^ mLineStrips;
+		GLVertexArray^ mWideLines;
+		ShapeBuffer * mShapes;
+		unsigned int mShapeProgram;
+		bool mShapeProgramChecked;
 		System::Collections::Generic::List<GLTextParam> ^ mTexts;
+		System::Collections::Generic::List<GLExternalBuffer ^> ^ mBuffers;
+		System::Collections::Generic::List<GLScatter ^> ^ mScatters;
+		System::Collections::Generic::List<GLBlock ^> ^ mBlocks;
+		int mFrame;
+		static int sFrameCounter;
+		array<System::Byte> ^ mTextBuffer;
 		Drawing::PointF mBL, mTR;
 
 	// Helper methods
 	private:
 		/// <summary>
-		/// Returns the number of lines required to properly approximate a curve with the given feature size.
+		/// Adds a primitive to the batch. Primitives are culled and tessellated in parallel
+		/// when the batch is rendered.
+		/// </summary>
+		/// <param name="type">Primitive type</param>
+		/// <param name="color">Drawing color</param>
+		/// <returns>The new primitive</returns>
+		Primitive2D * AddPrimitive(int type, Drawing::Color color);
+		/// <summary>
+		/// Adds a primitive with four parameters to the batch.
+		/// </summary>
+		System::Void AddPrimitive(int type, Drawing::Color color, float p0, float p1, float p2, float p3);
+		/// <summary>
+		/// Adds a primitive with six parameters to the batch.
+		/// </summary>
+		System::Void AddPrimitive(int type, Drawing::Color color, float p0, float p1, float p2, float p3, float p4, float p5);
+		/// <summary>
+		/// Adds a primitive defined by the given corner points to the batch.
+		/// </summary>
+		System::Void AddPrimitive(int type, Drawing::Color color, array<Drawing::PointF, 1> ^ points);
+		/// <summary>
+		/// Adds a thick polyline to the batch. The thickness at each point is stored
+		/// in the point pool after the points.
+		/// </summary>
+		System::Void AddStroke(array<Drawing::PointF, 1> ^ points, float thickness, array<float> ^ thicknesses,
+			GLLineJoin join, GLLineCap cap, bool closed, Drawing::Color color);
+		/// <summary>
+		/// Adds a reference to a block with the given transform to the batch.
 		/// </summary>
-		/// <param name="featureSize">The size of the feature (circle perimeter, 
-		/// arc length etc.) in model coordinates.</param>
-		/// <returns>Number of lines required to approximate the given model size.</returns>
-		int GetCirclePrecision(float featureSize);
+		System::Void AddBlockReference(GLBlock ^ block, float m11, float m12, float m21, float m22, float dx, float dy, Drawing::Color color);
+		/// <summary>
+		/// Adds a list of filled triangles given by their corner points to the batch.
+		/// </summary>
+		System::Void FillTriangles(array<Drawing::PointF, 1> ^ points, Drawing::Color color);
+		/// <summary>
+		/// Updates drawing limits to enclose the given elliptic arc.
+		/// </summary>
+		System::Void UpdateArcLimits(float x, float y, float width, float height, float startAngle, float sweepAngle);
 		/// <summary>
 		/// Updates the Z coordinate of the next drawing object, so that new objects
 		/// are drawn on top of old ones.
@@ -112,20 +184,48 @@ namespace GLCanvas {
 			{ 
 				return mLineWidth; 
 			}
-			virtual void set(float value) 
+			virtual void set(float value);
+		}
+		/// <summary>
+		/// Gets or sets the largest ratio of the length of a miter join to the thickness
+		/// of the line. Sharper miter joins are beveled. The default is 4.
+		/// </summary>
+		property float MiterLimit
+		{
+			virtual float get(void) 
 			{ 
-				mLineWidth = value;
-				glLineWidth(value);
+				return mMiterLimit; 
 			}
+			virtual void set(float value);
+		}
+		/// <summary>
+		/// Determines whether drawing commands are recorded into a command buffer.
+		/// </summary>
+		property bool IsRecording
+		{
+			virtual bool get(void) { return mRecorder != nullptr; }
 		}
 		
 	internal:
+		/// <summary>
+		/// Prepares the graphics object for a new frame. The canvas reuses the same graphics
+		/// object for every frame, so that the memory allocated for drawing objects is retained.
+		/// </summary>
+		/// <param name="GDIGraphics">The GDI+ graphics of the paint event</param>
+		System::Void BeginFrame(Drawing::Graphics ^ GDIGraphics);
 		/// <summary>
 		/// The GLGraphics class collects drawing objects in arrays. No drawing is actually 
 		/// performed until Render() is called. Render() is automatically called by the containing 
 		/// canvas class. Do not call Render() manually from your code.
 		/// </summary>
-		Drawing::RectangleF Render();
+		/// <param name="statistics">Receives the number of drawn primitives and vertices</param>
+		Drawing::RectangleF Render(GLRenderStatistics ^ statistics);
+		/// <summary>
+		/// Collects the drawing objects of a command buffer into the primitives of a block definition.
+		/// </summary>
+		/// <param name="commands">The commands defining the block</param>
+		/// <param name="definition">The batch receiving the primitives</param>
+		static System::Void CaptureCommands(GLCommandBuffer ^ commands, Batch2D * definition);
 
 	public:
 		/// <summary>
@@ -363,6 +463,70 @@ namespace GLCanvas {
 		/// <param name="color">Drawing color</param>
 		System::Void DrawPolygon(array<Drawing::PointF, 1>^ points, Drawing::Color color);
 		/// <summary>
+		/// Draws a polyline of the given thickness through the given points. Segments
+		/// are connected by the given joins, so that the line is drawn without gaps or
+		/// overlaps at its corners.
+		/// </summary>
+		/// <param name="points">Points of the polyline</param>
+		/// <param name="thickness">Line thickness in world coordinates</param>
+		/// <param name="join">Shape of the corners</param>
+		/// <param name="cap">Shape of the ends</param>
+		/// <param name="color">Drawing color</param>
+		System::Void DrawPolyline(array<Drawing::PointF, 1> ^ points, float thickness, GLLineJoin join, GLLineCap cap, Drawing::Color color);
+		/// <summary>
+		/// Draws a polyline through the given points with a thickness varying along the line.
+		/// </summary>
+		/// <param name="points">Points of the polyline</param>
+		/// <param name="thicknesses">Line thickness at each point in world coordinates</param>
+		/// <param name="join">Shape of the corners</param>
+		/// <param name="cap">Shape of the ends</param>
+		/// <param name="color">Drawing color</param>
+		System::Void DrawPolyline(array<Drawing::PointF, 1> ^ points, array<float> ^ thicknesses, GLLineJoin join, GLLineCap cap, Drawing::Color color);
+		/// <summary>
+		/// Draws the outline of a polygon with the given thickness.
+		/// </summary>
+		/// <param name="points">An array of corner points</param>
+		/// <param name="thickness">Line thickness in world coordinates</param>
+		/// <param name="join">Shape of the corners</param>
+		/// <param name="color">Drawing color</param>
+		System::Void DrawPolygon(array<Drawing::PointF, 1> ^ points, float thickness, GLLineJoin join, Drawing::Color color);
+		/// <summary>
+		/// Draws a cubic Bezier curve. The curve is flattened into line segments when
+		/// the canvas is rendered, with as many segments as the current zoom requires.
+		/// </summary>
+		/// <param name="pt1">Start point</param>
+		/// <param name="pt2">First control point</param>
+		/// <param name="pt3">Second control point</param>
+		/// <param name="pt4">End point</param>
+		/// <param name="color">Drawing color</param>
+		System::Void DrawBezier(Drawing::PointF pt1, Drawing::PointF pt2, Drawing::PointF pt3, Drawing::PointF pt4, Drawing::Color color)
+		{
+			DrawBeziers(gcnew array<Drawing::PointF> { pt1, pt2, pt3, pt4 }, color);
+		}
+		/// <summary>
+		/// Draws a series of connected cubic Bezier curves. The first curve is defined by
+		/// the first four points; each following curve uses the end point of the previous
+		/// curve as its start point and the next three points as its control and end points.
+		/// </summary>
+		/// <param name="points">Curve points; the number of points must be 3n + 1</param>
+		/// <param name="color">Drawing color</param>
+		System::Void DrawBeziers(array<Drawing::PointF, 1> ^ points, Drawing::Color color);
+		/// <summary>
+		/// Draws a series of connected quadratic Bezier curves. The first curve is defined
+		/// by the first three points; each following curve uses the end point of the previous
+		/// curve as its start point and the next two points as its control and end points.
+		/// </summary>
+		/// <param name="points">Curve points; the number of points must be 2n + 1</param>
+		/// <param name="color">Drawing color</param>
+		System::Void DrawQuadraticBeziers(array<Drawing::PointF, 1> ^ points, Drawing::Color color);
+		/// <summary>
+		/// Draws a uniform cubic B-spline. The curve follows the control points without
+		/// passing through them.
+		/// </summary>
+		/// <param name="points">Control points; at least four are required</param>
+		/// <param name="color">Drawing color</param>
+		System::Void DrawBSpline(array<Drawing::PointF, 1> ^ points, Drawing::Color color);
+		/// <summary>
 		/// Fills an elliptic pie specified by center coordinates, a width, and a height.
 		/// </summary>
 		/// <param name="x">X coordinate of the center of the pie</param>
@@ -490,17 +654,97 @@ namespace GLCanvas {
 			FillEllipse(pt.X, pt.Y, sz.Width, sz.Height, color);
 		}
 		/// <summary>
-		/// Fills a polygon specified by the given point coordinates.
+		/// Fills a polygon specified by the given point coordinates. The polygon may be concave.
+		/// The polygon is triangulated each time it is drawn; use a GLPolygon to keep the
+		/// triangulation of large polygons between frames.
 		/// </summary>
 		/// <param name="points">An array of corner points</param>
 		/// <param name="color">Drawing color</param>
 		System::Void FillPolygon(array<Drawing::PointF, 1> ^ points, Drawing::Color color);
 		/// <summary>
+		/// Fills the given polygons. The triangulation of the polygons is cached by the
+		/// GLPolygon object, once at full detail and once for each zoom band the
+		/// polygons are simplified for.
+		/// </summary>
+		/// <param name="polygon">The polygons to fill</param>
+		/// <param name="color">Drawing color</param>
+		System::Void FillPolygon(GLPolygon ^ polygon, Drawing::Color color);
+		/// <summary>
+		/// Draws the boundaries and holes of the given polygons.
+		/// </summary>
+		/// <param name="polygon">The polygons to draw</param>
+		/// <param name="color">Drawing color</param>
+		System::Void DrawPolygon(GLPolygon ^ polygon, Drawing::Color color);
+		/// <summary>
+		/// Draws vertices stored in an external native buffer. Vertices are read directly
+		/// from the buffer when the canvas is rendered. Z coordinates of the buffer are ignored.
+		/// </summary>
+		/// <param name="buffer">The buffer to draw</param>
+		System::Void DrawBuffer(GLExternalBuffer ^ buffer);
+		/// <summary>
+		/// Draws the visible part of a time series as a line. Samples are reduced to
+		/// at most two vertices per pixel column showing the smallest and largest
+		/// sample of the column, so that peaks remain visible at any zoom.
+		/// </summary>
+		/// <param name="series">The time series to draw</param>
+		/// <param name="color">Drawing color</param>
+		System::Void DrawTimeSeries(GLTimeSeries ^ series, Drawing::Color color);
+		/// <summary>
+		/// Draws a scatter plot. The points are drawn as sprites or, when they outnumber
+		/// the pixels of the canvas, as a density image when the canvas is rendered.
+		/// </summary>
+		/// <param name="scatter">The points to draw</param>
+		System::Void DrawScatter(GLScatter ^ scatter);
+		/// <summary>
+		/// Draws a reference to a block at the given location.
+		/// </summary>
+		/// <param name="block">The block to draw</param>
+		/// <param name="x">X coordinate of the block origin</param>
+		/// <param name="y">Y coordinate of the block origin</param>
+		/// <param name="color">Color replacing the colors of the block, or Color.Empty to keep them</param>
+		System::Void DrawBlock(GLBlock ^ block, float x, float y, Drawing::Color color)
+		{
+			AddBlockReference(block, 1.0f, 0.0f, 0.0f, 1.0f, x, y, color);
+		}
+		/// <summary>
+		/// Draws a reference to a block scaled and rotated about its origin.
+		/// </summary>
+		/// <param name="block">The block to draw</param>
+		/// <param name="x">X coordinate of the block origin</param>
+		/// <param name="y">Y coordinate of the block origin</param>
+		/// <param name="scale">Scale factor</param>
+		/// <param name="angle">Rotation angle in radians measured counter-clockwise from the x-axis</param>
+		/// <param name="color">Color replacing the colors of the block, or Color.Empty to keep them</param>
+		System::Void DrawBlock(GLBlock ^ block, float x, float y, float scale, float angle, Drawing::Color color)
+		{
+			float c = (float)Math::Cos(angle) * scale;
+			float s = (float)Math::Sin(angle) * scale;
+			AddBlockReference(block, c, s, -s, c, x, y, color);
+		}
+		/// <summary>
+		/// Draws a reference to a block with the given transform.
+		/// </summary>
+		/// <param name="block">The block to draw</param>
+		/// <param name="transform">Transform from block coordinates to world coordinates</param>
+		/// <param name="color">Color replacing the colors of the block, or Color.Empty to keep them</param>
+		System::Void DrawBlock(GLBlock ^ block, Drawing::Drawing2D::Matrix ^ transform, Drawing::Color color)
+		{
+			if (transform == nullptr) throw gcnew ArgumentNullException(L"transform");
+
+			array<float> ^ m = transform->Elements;
+			AddBlockReference(block, m[0], m[1], m[2], m[3], m[4], m[5], color);
+		}
+		/// <summary>
 		/// Measures the given string.
 		/// </summary>
 		/// <param name="text">The text to measure</param>
 		/// <returns>Size of text bounds</returns>
 		Drawing::SizeF MeasureString(System::String ^ text);
+		/// <summary>
+		/// Draws the commands recorded in the given command buffer.
+		/// </summary>
+		/// <param name="commands">The command buffer to draw</param>
+		System::Void DrawCommands(GLCommandBuffer ^ commands);
 	};
 
 }
\ No newline at end of file
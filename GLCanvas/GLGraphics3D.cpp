@@ -5,177 +5,363 @@
 #include <GL/gl.h>
 #include <GL/glu.h>
 
+#include "GLVertexArray.h"
 #include "GLGraphics3D.h"
 #include "GLCanvas3D.h"
-#include "UnManaged.h"
+#include "GLRenderStatistics.h"
+#include "Batch3D.h"
+#include "GeometryKernels.h"
 #include "Point3D.h"
 #include "Utility.h"
 #include "GLPickBox.h"
+#include "GLCommandBuffer.h"
+#include "GLExternalBuffer.h"
+#include "GLMesh3D.h"
+#include "GLMeshImporter.h"
+#include "Renderer.h"
+
+namespace
+{
+	// Model matrix of meshes, which are drawn in world coordinates
+	const float IdentityMatrix[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+}
 
 namespace GLCanvas
 {
-	GLGraphics3D::GLGraphics3D(GLCanvas3D ^ Canvas, Drawing::Graphics ^ GDIGraphics)
+	GLGraphics3D::GLGraphics3D(GLCanvas3D ^ Canvas)
 	{
 		mCanvas = Canvas; 
-		mGDIGraphics = GDIGraphics;
-		LineWidth = 1.0f;
+		mLineWidth = 1.0f;
+		mTriangles = _CreateLitBuffer();
+		mLines = _CreateLitBuffer();
+		mBoxes = _CreateBoxList();
+		mWireBoxes = _CreateBoxList();
+		mFaces = _CreateFaceList();
+		mMeshes = _CreateMeshCache();
+		mMeshBuffers = gcnew System::Collections::Generic::Dictionary<GLMesh3D ^, GLMeshGeometry3D ^>();
+		mStaleMeshes = gcnew System::Collections::Generic::List<GLMesh3D ^>();
 	}
 
-	Point3D GLGraphics3D::ModelOrigin()
+	GLGraphics3D::GLGraphics3D(GLCommandBuffer ^ Buffer)
 	{
-		return Point3D((xmin + xmax) / 2.0f, (ymin + ymax) / 2.0f, (zmin + zmax) / 2.0f);
+		if (Buffer == nullptr) throw gcnew ArgumentNullException(L"Buffer");
+
+		mRecorder = Buffer;
+		mLineWidth = 1.0f;
+		mTriangles = 0;
+		mLines = 0;
+		mBoxes = 0;
+		mWireBoxes = 0;
+		mFaces = 0;
+		mMeshes = 0;
 	}
 
-	float GLGraphics3D::ModelSize()
+	GLGraphics3D::GLGraphics3D(LitBuffer * Triangles, LitBuffer * Lines)
 	{
-		return (float)Math::Max(Math::Sqrt((xmin - xmax) * (xmin - xmax) + (ymin - ymax) * (ymin - ymax) + (zmin - zmax) * (zmin - zmax)), 1.0);
+		mLineWidth = 1.0f;
+		mTriangles = Triangles;
+		mLines = Lines;
+		mBoundedTriangles = Triangles->count;
+		mBoundedLines = Lines->count;
+		mBoxes = _CreateBoxList();
+		mWireBoxes = _CreateBoxList();
+		mFaces = _CreateFaceList();
+		mMeshes = _CreateMeshCache();
+		xmin = ymin = zmin = Single::MaxValue;
+		xmax = ymax = zmax = -Single::MaxValue;
 	}
 
-	System::Void GLGraphics3D::DrawLine(float x1, float y1, float z1, float x2, float y2, float z2, Drawing::Color color)
+	GLGraphics3D::!GLGraphics3D()
 	{
-		glColor4ub(color.R, color.G, color.B, color.A);
-		glBegin(GL_LINES);
+		// Release the batches. The vertex buffers of a scene node belong to the node.
+		if (mCanvas != nullptr)
+		{
+			_DestroyLitBuffer(mTriangles);
+			_DestroyLitBuffer(mLines);
+		}
+		_DestroyBoxList(mBoxes);
+		_DestroyBoxList(mWireBoxes);
+		_DestroyFaceList(mFaces);
+		_DestroyMeshCache(mMeshes);
+		mTriangles = 0;
+		mLines = 0;
+		mBoxes = 0;
+		mWireBoxes = 0;
+		mFaces = 0;
+		mMeshes = 0;
+	}
 
-		glVertex3f(x1, y1, z1);
-		glVertex3f(x2, y2, z2);
+	void GLGraphics3D::LineWidth::set(float value)
+	{
+		if (mRecorder != nullptr)
+		{
+			mLineWidth = value;
+			mRecorder->Write(GLCommandBuffer::Command::LineWidth3D);
+			mRecorder->Write(value);
+			return;
+		}
+		if (mCanvas == nullptr)
+		{
+			// Scene node geometry is drawn with the default line width
+			mLineWidth = value;
+			return;
+		}
 
-		glEnd();
+		// Lines and wire meshes batched so far are drawn with the previous width
+		if (value != mLineWidth && (mLines->count != 0 || mWireBoxes->count != 0 || _GetPendingInstances(mMeshes) != 0)) Flush();
+		mLineWidth = value;
+		glLineWidth(value);
+	}
 
-		UpdateLimits(x1, y1, z1);
-		UpdateLimits(x2, y2, z2);
+	System::Void GLGraphics3D::BeginFrame(Drawing::Graphics ^ GDIGraphics)
+	{
+		mGDIGraphics = GDIGraphics;
+		mFrame++;
+		mMeshesDrawn = 0;
+		LineWidth = 1.0f;
+		xmin = xmax = ymin = ymax = zmin = zmax = 0.0f;
 	}
 
-	System::Void GLGraphics3D::DrawTriangle(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, Drawing::Color color)
+	System::Void GLGraphics3D::EndFrame()
 	{
-		glColor4ub(color.R, color.G, color.B, color.A);
-		glBegin(GL_LINES);
+		mGDIGraphics = nullptr;
+	}
 
-		glVertex3f(x1, y1, z1);
-		glVertex3f(x2, y2, z2);
+	System::Void GLGraphics3D::SetLevelOfDetail(const float * projection, const float * modelview, float viewportHeight, float size)
+	{
+		_SetMeshDetail(mMeshes, projection, modelview, viewportHeight, size);
+	}
 
-		glVertex3f(x2, y2, z2);
-		glVertex3f(x3, y3, z3);
+	System::Void GLGraphics3D::Flush()
+	{
+		if (mTriangles->count == 0 && mLines->count == 0 && mBoxes->count == 0 && mWireBoxes->count == 0 && _GetPendingInstances(mMeshes) == 0) return;
+		IncludeBatchBounds();
+
+		// Filled triangles and quads, the only triangles batched before this point, get
+		// their normals from the face normal kernel in one pass
+		_SetFaceNormals3D(mTriangles, mFaces);
+		mFaces->count = 0;
+
+		// Boxes are expanded to triangles and lines in one pass
+		_ExpandBoxes3D(mTriangles, mBoxes->data, mBoxes->count, false);
+		_ExpandBoxes3D(mLines, mWireBoxes->data, mWireBoxes->count, true);
+		mBoxes->count = 0;
+		mWireBoxes->count = 0;
+
+		// Scene nodes keep the vertices of their meshes instead of drawing them
+		if (mCanvas == nullptr)
+		{
+			_ExpandMeshCache(mMeshes, mTriangles, mLines);
+			mBoundedTriangles = mTriangles->count;
+			mBoundedLines = mLines->count;
+			return;
+		}
 
-		glVertex3f(x3, y3, z3);
-		glVertex3f(x1, y1, z1);
+		Renderer * renderer = mCanvas->NativeRenderer;
+		GLRenderStatistics ^ statistics = mCanvas->Statistics;
+		if (mTriangles->count != 0)
+		{
+			_RenderLitVertices(renderer, GL_TRIANGLES, mTriangles->data, mTriangles->count);
+			statistics->AddCounts(mTriangles->count / 3, mTriangles->count);
+		}
+		if (mLines->count != 0)
+		{
+			_RenderLitVertices(renderer, GL_LINES, mLines->data, mLines->count);
+			statistics->AddCounts(mLines->count / 2, mLines->count);
+		}
+		mTriangles->count = 0;
+		mLines->count = 0;
+		mBoundedTriangles = 0;
+		mBoundedLines = 0;
+
+		// Spheres and cylinders are drawn as instances of their unit meshes
+		int primitives = 0, vertices = 0;
+		_FlushMeshCache(mMeshes, renderer, &primitives, &vertices);
+		statistics->AddCounts(primitives, vertices);
+	}
 
-		glEnd();
+	bool GLGraphics3D::CaptureCommands(GLCommandBuffer ^ commands, LitBuffer * triangles, LitBuffer * lines, 
+		float % x1, float % y1, float % z1, float % x2, float % y2, float % z2)
+	{
+		GLGraphics3D ^ graphics = gcnew GLGraphics3D(triangles, lines);
+		try
+		{
+			graphics->DrawCommands(commands);
+			graphics->Flush();
+			x1 = graphics->xmin; y1 = graphics->ymin; z1 = graphics->zmin;
+			x2 = graphics->xmax; y2 = graphics->ymax; z2 = graphics->zmax;
+		}
+		finally
+		{
+			delete graphics;
+		}
 
-		UpdateLimits(x1, y1, z1);
-		UpdateLimits(x2, y2, z2);
-		UpdateLimits(x3, y3, z3);
+		return (x1 <= x2);
 	}
 
-	System::Void GLGraphics3D::DrawQuad(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, float x4, float y4, float z4, Drawing::Color color)
-	{ 
-		glColor4ub(color.R, color.G, color.B, color.A);
-		glBegin(GL_LINES);
+	System::Void GLGraphics3D::ReleaseMeshes(bool all)
+	{
+		if (mMeshBuffers == nullptr || (!all && mMeshesDrawn == mMeshBuffers->Count)) return;
 
-		glVertex3f(x1, y1, z1);
-		glVertex3f(x2, y2, z2);
+		for each (System::Collections::Generic::KeyValuePair<GLMesh3D ^, GLMeshGeometry3D ^> pair in mMeshBuffers)
+		{
+			if (all || pair.Value->Frame != mFrame) mStaleMeshes->Add(pair.Key);
+		}
+		for (int i = 0; i < mStaleMeshes->Count; i++)
+		{
+			_DestroyRenderGeometry(mMeshBuffers[mStaleMeshes[i]]->Geometry);
+			mMeshBuffers->Remove(mStaleMeshes[i]);
+		}
+		mStaleMeshes->Clear();
+	}
 
-		glVertex3f(x2, y2, z2);
-		glVertex3f(x3, y3, z3);
+	System::Void GLGraphics3D::AddLine(float x1, float y1, float z1, float x2, float y2, float z2, unsigned int color)
+	{
+		// Lines are lit with an upward normal
+		_AddLitVertex(mLines, x1, y1, z1, 0.0f, 0.0f, 1.0f, color);
+		_AddLitVertex(mLines, x2, y2, z2, 0.0f, 0.0f, 1.0f, color);
+	}
 
-		glVertex3f(x3, y3, z3);
-		glVertex3f(x4, y4, z4);
+	System::Void GLGraphics3D::AddTriangle(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, unsigned int face, unsigned int color)
+	{
+		// Listing the corners of the face as 1, 3, 2 gives the normal (p1 - p2) x (p3 - p2)
+		_AddFace3D(mFaces, face, face + 2, face + 1);
+		_AddLitVertex(mTriangles, x1, y1, z1, 0.0f, 0.0f, 0.0f, color);
+		_AddLitVertex(mTriangles, x2, y2, z2, 0.0f, 0.0f, 0.0f, color);
+		_AddLitVertex(mTriangles, x3, y3, z3, 0.0f, 0.0f, 0.0f, color);
+	}
 
-		glVertex3f(x4, y4, z4);
-		glVertex3f(x1, y1, z1);
+	System::Void GLGraphics3D::IncludeBatchBounds()
+	{
+		// Lines and triangles extend the limits in bulk rather than one corner at a time
+		if (mTriangles == 0) return;
+		float lower[3], upper[3];
+		if (_StridedBounds(mTriangles->data + mBoundedTriangles, mTriangles->count - mBoundedTriangles, sizeof(LitVertex), 3, lower, upper))
+		{
+			UpdateLimits(lower[0], lower[1], lower[2]);
+			UpdateLimits(upper[0], upper[1], upper[2]);
+		}
+		if (_StridedBounds(mLines->data + mBoundedLines, mLines->count - mBoundedLines, sizeof(LitVertex), 3, lower, upper))
+		{
+			UpdateLimits(lower[0], lower[1], lower[2]);
+			UpdateLimits(upper[0], upper[1], upper[2]);
+		}
+		mBoundedTriangles = mTriangles->count;
+		mBoundedLines = mLines->count;
+	}
 
-		glEnd();
+	Point3D GLGraphics3D::ModelOrigin()
+	{
+		IncludeBatchBounds();
+		return Point3D((xmin + xmax) / 2.0f, (ymin + ymax) / 2.0f, (zmin + zmax) / 2.0f);
+	}
 
-		UpdateLimits(x1, y1, z1);
-		UpdateLimits(x2, y2, z2);
-		UpdateLimits(x3, y3, z3);
-		UpdateLimits(x4, y4, z4);
+	float GLGraphics3D::ModelSize()
+	{
+		IncludeBatchBounds();
+		return (float)Math::Max(Math::Sqrt((xmin - xmax) * (xmin - xmax) + (ymin - ymax) * (ymin - ymax) + (zmin - zmax) * (zmin - zmax)), 1.0);
 	}
 
-	System::Void GLGraphics3D::FillTriangle(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, Drawing::Color color)
+	System::Void GLGraphics3D::DrawLine(float x1, float y1, float z1, float x2, float y2, float z2, Drawing::Color color)
 	{
-		glColor4ub(color.R, color.G, color.B, color.A);
-		glBegin(GL_TRIANGLES);
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawLine3D);
+			mRecorder->Write(x1, y1, z1);
+			mRecorder->Write(x2, y2, z2);
+			mRecorder->Write(color);
+			return;
+		}
 
-		float n[3];
-		Utility::CrossProduct(x1 - x2, y1 - y2, z1 - z2, x3 - x2, y3 - y2, z3 - z2, n);
-		glNormal3f(n[0], n[1], n[2]);
+		AddLine(x1, y1, z1, x2, y2, z2, GLVertexArray::PackColor(color));
+	}
 
-		glVertex3f(x1, y1, z1);
-		glVertex3f(x2, y2, z2);
-		glVertex3f(x3, y3, z3);
+	System::Void GLGraphics3D::DrawTriangle(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, Drawing::Color color)
+	{
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawTriangle3D);
+			mRecorder->Write(x1, y1, z1);
+			mRecorder->Write(x2, y2, z2);
+			mRecorder->Write(x3, y3, z3);
+			mRecorder->Write(color);
+			return;
+		}
 
-		glEnd();
+		unsigned int c = GLVertexArray::PackColor(color);
+		AddLine(x1, y1, z1, x2, y2, z2, c);
+		AddLine(x2, y2, z2, x3, y3, z3, c);
+		AddLine(x3, y3, z3, x1, y1, z1, c);
+	}
 
-		UpdateLimits(x1, y1, z1);
-		UpdateLimits(x2, y2, z2);
-		UpdateLimits(x3, y3, z3);
+	System::Void GLGraphics3D::DrawQuad(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, float x4, float y4, float z4, Drawing::Color color)
+	{ 
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawQuad3D);
+			mRecorder->Write(x1, y1, z1);
+			mRecorder->Write(x2, y2, z2);
+			mRecorder->Write(x3, y3, z3);
+			mRecorder->Write(x4, y4, z4);
+			mRecorder->Write(color);
+			return;
+		}
+
+		unsigned int c = GLVertexArray::PackColor(color);
+		AddLine(x1, y1, z1, x2, y2, z2, c);
+		AddLine(x2, y2, z2, x3, y3, z3, c);
+		AddLine(x3, y3, z3, x4, y4, z4, c);
+		AddLine(x4, y4, z4, x1, y1, z1, c);
 	}
 
-	System::Void GLGraphics3D::FillQuad(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, float x4, float y4, float z4, Drawing::Color color)
+	System::Void GLGraphics3D::FillTriangle(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, Drawing::Color color)
 	{
-		glColor4ub(color.R, color.G, color.B, color.A);
-		glBegin(GL_QUADS);
-
-		float n[3];
-		Utility::CrossProduct(x1 - x2, y1 - y2, z1 - z2, x3 - x2, y3 - y2, z3 - z2, n);
-		glNormal3f(n[0], n[1], n[2]);
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::FillTriangle3D);
+			mRecorder->Write(x1, y1, z1);
+			mRecorder->Write(x2, y2, z2);
+			mRecorder->Write(x3, y3, z3);
+			mRecorder->Write(color);
+			return;
+		}
 
-		glVertex3f(x1, y1, z1);
-		glVertex3f(x2, y2, z2);
-		glVertex3f(x3, y3, z3);
-		glVertex3f(x4, y4, z4);
+		AddTriangle(x1, y1, z1, x2, y2, z2, x3, y3, z3, (unsigned int)mTriangles->count, GLVertexArray::PackColor(color));
+	}
 
-		glEnd();
+	System::Void GLGraphics3D::FillQuad(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, float x4, float y4, float z4, Drawing::Color color)
+	{
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::FillQuad3D);
+			mRecorder->Write(x1, y1, z1);
+			mRecorder->Write(x2, y2, z2);
+			mRecorder->Write(x3, y3, z3);
+			mRecorder->Write(x4, y4, z4);
+			mRecorder->Write(color);
+			return;
+		}
 
-		UpdateLimits(x1, y1, z1);
-		UpdateLimits(x2, y2, z2);
-		UpdateLimits(x3, y3, z3);
-		UpdateLimits(x4, y4, z4);
+		// The quad is drawn as two triangles sharing the normal of the first corner
+		unsigned int face = (unsigned int)mTriangles->count;
+		unsigned int c = GLVertexArray::PackColor(color);
+		AddTriangle(x1, y1, z1, x2, y2, z2, x3, y3, z3, face, c);
+		AddTriangle(x1, y1, z1, x3, y3, z3, x4, y4, z4, face, c);
 	}
 
 	System::Void GLGraphics3D::DrawBox(float x1, float y1, float z1, float x2, float y2, float z2, float width, float height, Drawing::Color color)
 	{
-		float len = (float)Math::Sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2) + (z1 - z2) * (z1 - z2));
-		float zrot = (float)(Math::Atan2(y2 - y1, x2 - x1) * 180.0 / Math::PI);
-		float yrot = (float)(Math::Atan2(Math::Sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2)), z2 - z1) * 180.0 / Math::PI);
-
-		glMatrixMode(GL_MODELVIEW);
-		glPushMatrix();
-		glTranslatef(x1, y1, z1);
-		glRotatef(zrot, 0, 0, 1);
-		glRotatef(yrot, 0, 1, 0);
-
-		glColor4ub(color.R, color.G, color.B, color.A);
-		glBegin(GL_LINES);
-
-		glVertex3f(-width / 2, -height / 2, 0);
-		glVertex3f(-width / 2, -height / 2, len);
-		glVertex3f(width / 2, -height / 2, 0);
-		glVertex3f(width / 2, -height / 2, len);
-		glVertex3f(-width / 2, height / 2, 0);
-		glVertex3f(-width / 2, height / 2, len);
-		glVertex3f(width / 2, height / 2, 0);
-		glVertex3f(width / 2, height / 2, len);
-
-		glEnd();
-		
-		// Bottom
-		glBegin(GL_LINE_LOOP);
-		glVertex3f(-width / 2, -height / 2, 0);
-		glVertex3f(-width / 2, height / 2, 0);
-		glVertex3f(width / 2, height / 2, 0);
-		glVertex3f(width / 2, -height / 2, 0);
-		glEnd();
-
-		// Top
-		glBegin(GL_LINE_LOOP);
-		glVertex3f(-width / 2, -height / 2, len);
-		glVertex3f(-width / 2, height / 2, len);
-		glVertex3f(width / 2, height / 2, len);
-		glVertex3f(width / 2, -height / 2, len);
-		glEnd();
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawBox3D);
+			mRecorder->Write(x1, y1, z1);
+			mRecorder->Write(x2, y2, z2);
+			mRecorder->Write(width, height);
+			mRecorder->Write(color);
+			return;
+		}
 
-		glPopMatrix();
+		_AddBox3D(mWireBoxes, x1, y1, z1, x2, y2, z2, width, height, GLVertexArray::PackColor(color));
 
 		UpdateLimits(x1, y1, z1);
 		UpdateLimits(x2, y2, z2);
@@ -183,64 +369,17 @@ namespace GLCanvas
 
 	System::Void GLGraphics3D::FillBox(float x1, float y1, float z1, float x2, float y2, float z2, float width, float height, Drawing::Color color)
 	{
-		float len = (float)Math::Sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2) + (z1 - z2) * (z1 - z2));
-		float zrot = (float)(Math::Atan2(y2 - y1, x2 - x1) * 180.0 / Math::PI);
-		float yrot = (float)(Math::Atan2(Math::Sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2)), z2 - z1) * 180.0 / Math::PI);
-
-		glMatrixMode(GL_MODELVIEW);
-		glPushMatrix();
-		glTranslatef(x1, y1, z1);
-		glRotatef(zrot, 0, 0, 1);
-		glRotatef(yrot, 0, 1, 0);
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::FillBox3D);
+			mRecorder->Write(x1, y1, z1);
+			mRecorder->Write(x2, y2, z2);
+			mRecorder->Write(width, height);
+			mRecorder->Write(color);
+			return;
+		}
 
-		glColor4ub(color.R, color.G, color.B, color.A);
-		glBegin(GL_QUADS);
-
-		// Front
-		glNormal3f(0, -1, 0);
-		glVertex3f(-width / 2, -height / 2, 0);
-		glVertex3f(-width / 2, -height / 2, len);
-		glVertex3f(width / 2, -height / 2, len);
-		glVertex3f(width / 2, -height / 2, 0);
-
-		// Right
-		glNormal3f(1, 0, 0);
-		glVertex3f(width / 2, -height / 2, 0);
-		glVertex3f(width / 2, -height / 2, len);
-		glVertex3f(width / 2, height / 2, len);
-		glVertex3f(width / 2, height / 2, 0);
-
-		// Back
-		glNormal3f(0, 1, 0);
-		glVertex3f(width / 2, height / 2, 0);
-		glVertex3f(width / 2, height / 2, len);
-		glVertex3f(-width / 2, height / 2, len);
-		glVertex3f(-width / 2, height / 2, 0);
-
-		// Left
-		glNormal3f(-1, 0, 0);
-		glVertex3f(-width / 2, height / 2, 0);
-		glVertex3f(-width / 2, height / 2, len);
-		glVertex3f(-width / 2, -height / 2, len);
-		glVertex3f(-width / 2, -height / 2, 0);
-
-		// Bottom
-		glNormal3f(0, 0, -1);
-		glVertex3f(-width / 2, -height / 2, 0);
-		glVertex3f(-width / 2, height / 2, 0);
-		glVertex3f(width / 2, height / 2, 0);
-		glVertex3f(width / 2, -height / 2, 0);
-
-		// Top
-		glNormal3f(0, 0, 1);
-		glVertex3f(-width / 2, -height / 2, len);
-		glVertex3f(-width / 2, height / 2, len);
-		glVertex3f(width / 2, height / 2, len);
-		glVertex3f(width / 2, -height / 2, len);
-
-		glEnd();
-		
-		glPopMatrix();
+		_AddBox3D(mBoxes, x1, y1, z1, x2, y2, z2, width, height, GLVertexArray::PackColor(color));
 
 		UpdateLimits(x1, y1, z1);
 		UpdateLimits(x2, y2, z2);
@@ -248,21 +387,19 @@ namespace GLCanvas
 
 	System::Void GLGraphics3D::DrawCylinder(float x1, float y1, float z1, float x2, float y2, float z2, float radius, int slices, int stacks, Drawing::Color color)
 	{
-		float len = (float)Math::Sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2) + (z1 - z2) * (z1 - z2));
-		float zrot = (float)(Math::Atan2(y2 - y1, x2 - x1) * 180.0 / Math::PI);
-		float yrot = (float)(Math::Atan2(Math::Sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2)), z2 - z1) * 180.0 / Math::PI);
-
-		glMatrixMode(GL_MODELVIEW);
-		glPushMatrix();
-		glTranslatef(x1, y1, z1);
-		glRotatef(zrot, 0, 0, 1);
-		glRotatef(yrot, 0, 1, 0);
-
-		glColor4ub(color.R, color.G, color.B, color.A);
-
-		_DrawCylinder(radius, len, true, slices, stacks);
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawCylinder3D);
+			mRecorder->Write(x1, y1, z1);
+			mRecorder->Write(x2, y2, z2);
+			mRecorder->Write(radius);
+			mRecorder->Write(slices);
+			mRecorder->Write(stacks);
+			mRecorder->Write(color);
+			return;
+		}
 
-		glPopMatrix();
+		_AddCylinder3D(mMeshes, x1, y1, z1, x2, y2, z2, radius, slices, stacks, true, GLVertexArray::PackColor(color));
 
 		UpdateLimits(x1, y1, z1);
 		UpdateLimits(x2, y2, z2);
@@ -270,20 +407,19 @@ namespace GLCanvas
 
 	System::Void GLGraphics3D::FillCylinder(float x1, float y1, float z1, float x2, float y2, float z2, float radius, int slices, int stacks, Drawing::Color color)
 	{
-		float len = (float)Math::Sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2) + (z1 - z2) * (z1 - z2));
-		float zrot = (float)(Math::Atan2(y2 - y1, x2 - x1) * 180.0 / Math::PI);
-		float yrot = (float)(Math::Atan2(Math::Sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2)), z2 - z1) * 180.0 / Math::PI);
-
-		glMatrixMode(GL_MODELVIEW);
-		glPushMatrix();
-		glTranslatef(x1, y1, z1);
-		glRotatef(zrot, 0, 0, 1);
-		glRotatef(yrot, 0, 1, 0);
-
-		glColor4ub(color.R, color.G, color.B, color.A);
-		_DrawCylinder(radius, len, false, slices, stacks);
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::FillCylinder3D);
+			mRecorder->Write(x1, y1, z1);
+			mRecorder->Write(x2, y2, z2);
+			mRecorder->Write(radius);
+			mRecorder->Write(slices);
+			mRecorder->Write(stacks);
+			mRecorder->Write(color);
+			return;
+		}
 
-		glPopMatrix();
+		_AddCylinder3D(mMeshes, x1, y1, z1, x2, y2, z2, radius, slices, stacks, false, GLVertexArray::PackColor(color));
 
 		UpdateLimits(x1, y1, z1);
 		UpdateLimits(x2, y2, z2);
@@ -291,14 +427,18 @@ namespace GLCanvas
 
 	System::Void GLGraphics3D::DrawSphere(float x, float y, float z,float radius, int slices, int stacks, Drawing::Color color)
 	{
-		glMatrixMode(GL_MODELVIEW);
-		glPushMatrix();
-		glTranslatef(x, y, z);
-
-		glColor4ub(color.R, color.G, color.B, color.A);
-		_DrawSphere(radius, true, slices, stacks);
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawSphere3D);
+			mRecorder->Write(x, y, z);
+			mRecorder->Write(radius);
+			mRecorder->Write(slices);
+			mRecorder->Write(stacks);
+			mRecorder->Write(color);
+			return;
+		}
 
-		glPopMatrix();
+		_AddSphere3D(mMeshes, x, y, z, radius, slices, stacks, true, GLVertexArray::PackColor(color));
 
 		UpdateLimits(x - radius, y - radius, z - radius);
 		UpdateLimits(x + radius, y + radius, z + radius);
@@ -306,14 +446,18 @@ namespace GLCanvas
 
 	System::Void GLGraphics3D::FillSphere(float x, float y, float z,float radius, int slices, int stacks, Drawing::Color color)
 	{
-		glMatrixMode(GL_MODELVIEW);
-		glPushMatrix();
-		glTranslatef(x, y, z);
-
-		glColor4ub(color.R, color.G, color.B, color.A);
-		_DrawSphere(radius, false, slices, stacks);
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::FillSphere3D);
+			mRecorder->Write(x, y, z);
+			mRecorder->Write(radius);
+			mRecorder->Write(slices);
+			mRecorder->Write(stacks);
+			mRecorder->Write(color);
+			return;
+		}
 
-		glPopMatrix();
+		_AddSphere3D(mMeshes, x, y, z, radius, slices, stacks, false, GLVertexArray::PackColor(color));
 
 		UpdateLimits(x - radius, y - radius, z - radius);
 		UpdateLimits(x + radius, y + radius, z + radius);
@@ -321,6 +465,19 @@ namespace GLCanvas
 
 	System::Void GLGraphics3D::DrawRasterText(float x, float y, float z, System::String ^ text, Drawing::Color color, Windows::Forms::HorizontalAlignment alignment)
 	{
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawRasterText3D);
+			mRecorder->Write(x, y, z);
+			mRecorder->Write(text);
+			mRecorder->Write(color);
+			mRecorder->Write((int)alignment);
+			return;
+		}
+
+		if (mCanvas == nullptr) throw gcnew InvalidOperationException(L"Text cannot be drawn in a scene node.");
+		Flush();
+
 		glColor4ub(color.R, color.G, color.B, color.A);
 		glListBase(mCanvas->RasterListBase);
 		// Measure the text
@@ -335,24 +492,45 @@ namespace GLCanvas
 		}
 		glRasterPos3f(x, y, z);
 		// Draw the text
-		System::IntPtr str = System::Runtime::InteropServices::Marshal::StringToHGlobalAnsi(text);
-		glCallLists(text->Length, GL_UNSIGNED_BYTE, (GLvoid*)str.ToPointer());
-		System::Runtime::InteropServices::Marshal::FreeHGlobal(str);
+		Utility::CallLists(text, mTextBuffer);
 	}
 
 	System::Void GLGraphics3D::DrawRasterTextWindow(float x, float y, System::String ^ text, Drawing::Color color)
 	{
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawRasterTextWindow3D);
+			mRecorder->Write(x, y);
+			mRecorder->Write(text);
+			mRecorder->Write(color);
+			return;
+		}
+
+		if (mCanvas == nullptr) throw gcnew InvalidOperationException(L"Text cannot be drawn in a scene node.");
+		Flush();
+
 		glColor4ub(color.R, color.G, color.B, color.A);
 		glListBase(mCanvas->RasterListBase);
 		this->glWindowPos2f(x, y);
 		// Draw the text
-		System::IntPtr str = System::Runtime::InteropServices::Marshal::StringToHGlobalAnsi(text);
-		glCallLists(text->Length, GL_UNSIGNED_BYTE, (GLvoid*)str.ToPointer());
-		System::Runtime::InteropServices::Marshal::FreeHGlobal(str);
+		Utility::CallLists(text, mTextBuffer);
 	}
 
 	System::Void GLGraphics3D::DrawVectorText(float x, float y, float z, float height, System::String ^ text, Drawing::Color color)
 	{
+		if (mRecorder != nullptr)
+		{
+			mRecorder->Write(GLCommandBuffer::Command::DrawVectorText3D);
+			mRecorder->Write(x, y, z);
+			mRecorder->Write(height);
+			mRecorder->Write(text);
+			mRecorder->Write(color);
+			return;
+		}
+
+		if (mCanvas == nullptr) throw gcnew InvalidOperationException(L"Text cannot be drawn in a scene node.");
+		Flush();
+
 		glMatrixMode(GL_MODELVIEW);
 		glPushMatrix();
 		glColor4ub(color.R, color.G, color.B, color.A);
@@ -360,12 +538,120 @@ namespace GLCanvas
 		glTranslatef(x, y, z);
 		glScalef(height, height, height);
 		// Draw the text
-		System::IntPtr str = System::Runtime::InteropServices::Marshal::StringToHGlobalAnsi(text);
-		glCallLists(text->Length, GL_UNSIGNED_BYTE, (GLvoid*)str.ToPointer());
-		System::Runtime::InteropServices::Marshal::FreeHGlobal(str);
+		Utility::CallLists(text, mTextBuffer);
 		glPopMatrix();
 	}
 
+	System::Void GLGraphics3D::DrawCommands(GLCommandBuffer ^ commands)
+	{
+		if (commands == nullptr) throw gcnew ArgumentNullException(L"commands");
+		if (commands == mRecorder) throw gcnew InvalidOperationException(L"A command buffer cannot be drawn into itself.");
+
+		System::IO::BinaryReader ^ reader = commands->GetReader();
+		for (int i = 0; i < commands->Count; i++)
+		{
+			float x1, y1, z1, x2, y2, z2, x3, y3, z3, x4, y4, z4, a, b;
+			int slices, stacks;
+			System::String ^ text;
+			Drawing::Color color;
+
+			switch ((GLCommandBuffer::Command)reader->ReadByte())
+			{
+			case GLCommandBuffer::Command::LineWidth3D:
+				LineWidth = reader->ReadSingle();
+				break;
+			case GLCommandBuffer::Command::DrawLine3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle(); z2 = reader->ReadSingle();
+				DrawLine(x1, y1, z1, x2, y2, z2, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawTriangle3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle(); z2 = reader->ReadSingle();
+				x3 = reader->ReadSingle(); y3 = reader->ReadSingle(); z3 = reader->ReadSingle();
+				DrawTriangle(x1, y1, z1, x2, y2, z2, x3, y3, z3, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillTriangle3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle(); z2 = reader->ReadSingle();
+				x3 = reader->ReadSingle(); y3 = reader->ReadSingle(); z3 = reader->ReadSingle();
+				FillTriangle(x1, y1, z1, x2, y2, z2, x3, y3, z3, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawQuad3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle(); z2 = reader->ReadSingle();
+				x3 = reader->ReadSingle(); y3 = reader->ReadSingle(); z3 = reader->ReadSingle();
+				x4 = reader->ReadSingle(); y4 = reader->ReadSingle(); z4 = reader->ReadSingle();
+				DrawQuad(x1, y1, z1, x2, y2, z2, x3, y3, z3, x4, y4, z4, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillQuad3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle(); z2 = reader->ReadSingle();
+				x3 = reader->ReadSingle(); y3 = reader->ReadSingle(); z3 = reader->ReadSingle();
+				x4 = reader->ReadSingle(); y4 = reader->ReadSingle(); z4 = reader->ReadSingle();
+				FillQuad(x1, y1, z1, x2, y2, z2, x3, y3, z3, x4, y4, z4, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawBox3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle(); z2 = reader->ReadSingle();
+				a = reader->ReadSingle(); b = reader->ReadSingle();
+				DrawBox(x1, y1, z1, x2, y2, z2, a, b, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillBox3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle(); z2 = reader->ReadSingle();
+				a = reader->ReadSingle(); b = reader->ReadSingle();
+				FillBox(x1, y1, z1, x2, y2, z2, a, b, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawCylinder3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle(); z2 = reader->ReadSingle();
+				a = reader->ReadSingle();
+				slices = reader->ReadInt32(); stacks = reader->ReadInt32();
+				DrawCylinder(x1, y1, z1, x2, y2, z2, a, slices, stacks, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillCylinder3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				x2 = reader->ReadSingle(); y2 = reader->ReadSingle(); z2 = reader->ReadSingle();
+				a = reader->ReadSingle();
+				slices = reader->ReadInt32(); stacks = reader->ReadInt32();
+				FillCylinder(x1, y1, z1, x2, y2, z2, a, slices, stacks, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawSphere3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				a = reader->ReadSingle();
+				slices = reader->ReadInt32(); stacks = reader->ReadInt32();
+				DrawSphere(x1, y1, z1, a, slices, stacks, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::FillSphere3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				a = reader->ReadSingle();
+				slices = reader->ReadInt32(); stacks = reader->ReadInt32();
+				FillSphere(x1, y1, z1, a, slices, stacks, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawRasterText3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				text = reader->ReadString();
+				color = GLCommandBuffer::ReadColor(reader);
+				DrawRasterText(x1, y1, z1, text, color, (Windows::Forms::HorizontalAlignment)reader->ReadInt32());
+				break;
+			case GLCommandBuffer::Command::DrawRasterTextWindow3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle();
+				text = reader->ReadString();
+				DrawRasterTextWindow(x1, y1, text, GLCommandBuffer::ReadColor(reader));
+				break;
+			case GLCommandBuffer::Command::DrawVectorText3D:
+				x1 = reader->ReadSingle(); y1 = reader->ReadSingle(); z1 = reader->ReadSingle();
+				a = reader->ReadSingle();
+				text = reader->ReadString();
+				DrawVectorText(x1, y1, z1, a, text, GLCommandBuffer::ReadColor(reader));
+				break;
+			default:
+				throw gcnew InvalidOperationException(L"The command buffer contains commands that cannot be drawn on a 3D canvas.");
+			}
+		}
+	}
+
 	System::Void GLGraphics3D::glWindowPos2f(GLfloat x, GLfloat y)
 	{
 		GLfloat z = 0;
@@ -396,4 +682,91 @@ namespace GLCanvas
 		glPopMatrix();
 	    glPopAttrib();
 	}
+
+	System::Void GLGraphics3D::DrawBuffer(GLExternalBuffer ^ buffer)
+	{
+		if (buffer == nullptr) throw gcnew ArgumentNullException(L"buffer");
+		if (mRecorder != nullptr) throw gcnew InvalidOperationException(L"External buffers cannot be recorded into a command buffer.");
+		if (mCanvas == nullptr) throw gcnew InvalidOperationException(L"External buffers cannot be drawn in a scene node.");
+
+		float x1, y1, z1, x2, y2, z2;
+		if (!buffer->GetBounds(x1, y1, z1, x2, y2, z2)) return;
+
+		Flush();
+		glEnableClientState(GL_VERTEX_ARRAY);
+		buffer->Render();
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glDisableClientState(GL_COLOR_ARRAY);
+
+		UpdateLimits(x1, y1, z1);
+		UpdateLimits(x2, y2, z2);
+	}
+
+	System::Void GLGraphics3D::RenderMesh(GLMesh3D ^ mesh, int parts, bool recolor, unsigned int color)
+	{
+		if (mesh == nullptr) throw gcnew ArgumentNullException(L"mesh");
+		if (mRecorder != nullptr) throw gcnew InvalidOperationException(L"Meshes cannot be recorded into a command buffer.");
+		if (mCanvas == nullptr) throw gcnew InvalidOperationException(L"Meshes cannot be drawn in a scene node.");
+
+		Mesh3D * data = mesh->Data;
+		if (data->indexCount == 0) return;
+
+		Flush();
+		GLMeshGeometry3D ^ entry;
+		if (!mMeshBuffers->TryGetValue(mesh, entry))
+		{
+			entry = gcnew GLMeshGeometry3D();
+			mMeshBuffers->Add(mesh, entry);
+		}
+		if (entry->Frame != mFrame)
+		{
+			entry->Frame = mFrame;
+			mMeshesDrawn++;
+		}
+
+		// Upload the mesh the first time it is drawn, after it changes and the first time
+		// its edges are drawn. Edges are only collected for meshes drawn as wireframes.
+		bool edges = ((parts & RENDERGEOMETRY_LINES) != 0);
+		if (entry->Geometry == 0 || entry->Version != mesh->Version || (edges && !entry->HasEdges))
+		{
+			if (edges) _FindMeshEdges3D(data);
+			_DestroyRenderGeometry(entry->Geometry);
+			entry->Geometry = _CreateIndexedGeometry(mCanvas->NativeRenderer, data->vertices, data->vertexCount,
+				data->indices, data->indexCount, data->edges, (data->hasEdges ? data->edgeCount : 0));
+			entry->Version = mesh->Version;
+			entry->HasEdges = data->hasEdges;
+		}
+
+		_RenderGeometry(mCanvas->NativeRenderer, entry->Geometry, parts, IdentityMatrix, recolor, color);
+		if (edges)
+			mCanvas->Statistics->AddCounts(data->edgeCount / 2, data->vertexCount);
+		else
+			mCanvas->Statistics->AddCounts(data->indexCount / 3, data->vertexCount);
+
+		if (data->hasBounds)
+		{
+			UpdateLimits(data->bounds[0], data->bounds[1], data->bounds[2]);
+			UpdateLimits(data->bounds[3], data->bounds[4], data->bounds[5]);
+		}
+	}
+
+	System::Void GLGraphics3D::DrawMesh(GLMesh3D ^ mesh)
+	{
+		RenderMesh(mesh, RENDERGEOMETRY_LINES, false, 0);
+	}
+
+	System::Void GLGraphics3D::DrawMesh(GLMesh3D ^ mesh, Drawing::Color color)
+	{
+		RenderMesh(mesh, RENDERGEOMETRY_LINES, true, GLVertexArray::PackColor(color));
+	}
+
+	System::Void GLGraphics3D::FillMesh(GLMesh3D ^ mesh)
+	{
+		RenderMesh(mesh, RENDERGEOMETRY_TRIANGLES, false, 0);
+	}
+
+	System::Void GLGraphics3D::FillMesh(GLMesh3D ^ mesh, Drawing::Color color)
+	{
+		RenderMesh(mesh, RENDERGEOMETRY_TRIANGLES, true, GLVertexArray::PackColor(color));
+	}
 }
@@ -2,10 +2,19 @@
 
 using namespace System;
 
+// Native vertex types
+struct LitBuffer;
+struct BoxList;
+struct MeshCache;
+
 namespace GLCanvas
 {
 	// Forward class declarations
 	ref class GLCanvas3D;
+	ref class GLCommandBuffer;
+	ref class GLExternalBuffer;
+	ref class GLMesh3D;
+	ref class GLMeshGeometry3D;
 	value class Point3D;
 
 	/// <summary>
@@ -15,12 +24,31 @@ namespace GLCanvas
 	{
 	// Constructor/destructor
 	internal:
-		GLGraphics3D(GLCanvas3D ^ Canvas, Drawing::Graphics ^ GDIGraphics);
+		GLGraphics3D(GLCanvas3D ^ Canvas);
+
+	private:
+		/// <summary>
+		/// Initializes a new instance of the GLGraphics3D class that collects drawing
+		/// commands into the given vertex buffers of a scene node.
+		/// </summary>
+		GLGraphics3D(LitBuffer * Triangles, LitBuffer * Lines);
+
+	public:
+		/// <summary>
+		/// Initializes a new instance of the GLGraphics3D class that records drawing
+		/// commands into the given command buffer instead of drawing them. The recorded
+		/// commands can later be drawn with DrawCommands. A recording graphics object 
+		/// does not require an OpenGL context and can be used from any thread.
+		/// </summary>
+		/// <param name="Buffer">The command buffer to record into</param>
+		GLGraphics3D(GLCommandBuffer ^ Buffer);
 
 	protected:
 		~GLGraphics3D() // Dispose
 		{ 
+			this->!GLGraphics3D();
 		}
+		!GLGraphics3D(); // Finalize
 
 	// Member variables
 	private:
@@ -29,6 +57,20 @@ namespace GLCanvas
 		System::Drawing::Graphics ^ mGDIGraphics;
 		float xmin, xmax, ymin, ymax, zmin, zmax;
 		GLCanvas3D ^ mCanvas;
+		GLCommandBuffer ^ mRecorder;
+		array<System::Byte> ^ mTextBuffer;
+		LitBuffer * mTriangles;
+		LitBuffer * mLines;
+		int mBoundedTriangles;
+		int mBoundedLines;
+		BoxList * mBoxes;
+		BoxList * mWireBoxes;
+		FaceList * mFaces;
+		MeshCache * mMeshes;
+		System::Collections::Generic::Dictionary<GLMesh3D ^, GLMeshGeometry3D ^> ^ mMeshBuffers;
+		System::Collections::Generic::List<GLMesh3D ^> ^ mStaleMeshes;
+		int mFrame;
+		int mMeshesDrawn;
 
 	// Helper methods
 	private:
@@ -48,11 +90,30 @@ namespace GLCanvas
 			zmax = Math::Max(zmax, z);
 		}
 		/// <summary>
+		/// Updates model limits with the batched triangles and lines added since the
+		/// last update.
+		/// </summary>
+		System::Void IncludeBatchBounds();
+		/// <summary>
 		/// Sets the raster position to given window coordinates.
 		/// </summary>
 		/// <param name="x">X coordinate</param>
 		/// <param name="y">Y coordinate</param>
 		System::Void glWindowPos2f(GLfloat x, GLfloat y);
+		/// <summary>
+		/// Adds a line segment to the line batch.
+		/// </summary>
+		System::Void AddLine(float x1, float y1, float z1, float x2, float y2, float z2, unsigned int color);
+		/// <summary>
+		/// Adds a triangle to the triangle batch. It takes the normal of the batched
+		/// triangle starting at vertex face, which is computed when the batch is flushed.
+		/// </summary>
+		System::Void AddTriangle(float x1, float y1, float z1, float x2, float y2, float z2, float x3, float y3, float z3, unsigned int face, unsigned int color);
+		/// <summary>
+		/// Draws the triangles or the edges of a mesh from its buffer objects, uploading
+		/// the mesh first if it is new or has changed.
+		/// </summary>
+		System::Void RenderMesh(GLMesh3D ^ mesh, int parts, bool recolor, unsigned int color);
 
 	// Properties
 	public:
@@ -65,13 +126,65 @@ namespace GLCanvas
 			{ 
 				return mLineWidth; 
 			}
-			virtual void set(float value) 
-			{ 
-				mLineWidth = value;
-				glLineWidth(value);
-			}
+			virtual void set(float value);
+		}
+		/// <summary>
+		/// Determines whether drawing commands are recorded into a command buffer.
+		/// </summary>
+		property bool IsRecording
+		{
+			virtual bool get(void) { return mRecorder != nullptr; }
 		}
 
+	internal:
+		/// <summary>
+		/// Prepares the graphics object for a new frame. The canvas reuses the same
+		/// graphics object for every frame.
+		/// </summary>
+		/// <param name="GDIGraphics">The GDI+ graphics of the paint event</param>
+		System::Void BeginFrame(Drawing::Graphics ^ GDIGraphics);
+		/// <summary>
+		/// Releases references held for the current frame.
+		/// </summary>
+		System::Void EndFrame();
+		/// <summary>
+		/// Sets the camera and the level of detail size in pixels used to choose the slice
+		/// and stack counts of spheres and cylinders.
+		/// </summary>
+		/// <param name="projection">The column-major projection matrix</param>
+		/// <param name="modelview">The column-major modelview matrix</param>
+		/// <param name="viewportHeight">Height of the view in pixels</param>
+		/// <param name="size">Level of detail size in pixels, or zero for full detail</param>
+		System::Void SetLevelOfDetail(const float * projection, const float * modelview, float viewportHeight, float size);
+		/// <summary>
+		/// Draws the batched lines, triangles, spheres and cylinders. Primitives which
+		/// are not batched call this before drawing, so that the drawing order is kept.
+		/// </summary>
+		System::Void Flush();
+		/// <summary>
+		/// Extends the model limits with the given bounding box.
+		/// </summary>
+		System::Void IncludeBounds(float x1, float y1, float z1, float x2, float y2, float z2)
+		{
+			UpdateLimits(x1, y1, z1);
+			UpdateLimits(x2, y2, z2);
+		}
+		/// <summary>
+		/// Collects the drawing objects of a command buffer into the vertices of a scene node.
+		/// </summary>
+		/// <param name="commands">The commands defining the node geometry</param>
+		/// <param name="triangles">The buffer receiving the triangles</param>
+		/// <param name="lines">The buffer receiving the lines</param>
+		/// <returns>true if anything was drawn; otherwise false.</returns>
+		static bool CaptureCommands(GLCommandBuffer ^ commands, LitBuffer * triangles, LitBuffer * lines, 
+			float % x1, float % y1, float % z1, float % x2, float % y2, float % z2);
+		/// <summary>
+		/// Releases the buffer objects of meshes which were not drawn in the current frame,
+		/// or of all meshes. The OpenGL context of the canvas must be current.
+		/// </summary>
+		/// <param name="all">true to release the buffers of all meshes</param>
+		System::Void ReleaseMeshes(bool all);
+
 	public:
 		/// <summary>
 		/// Gets the origion of the model.
@@ -325,6 +438,40 @@ namespace GLCanvas
 		/// <param name="text">Text to draw</param>
 		/// <param name="color">Drawing color</param>
 		System::Void DrawVectorText(float x, float y, float z, float height, System::String ^ text, Drawing::Color color);
+		/// <summary>
+		/// Draws the commands recorded in the given command buffer.
+		/// </summary>
+		/// <param name="commands">The command buffer to draw</param>
+		System::Void DrawCommands(GLCommandBuffer ^ commands);
+		/// <summary>
+		/// Draws vertices stored in an external native buffer. Vertices are read directly
+		/// from the buffer without copying.
+		/// </summary>
+		/// <param name="buffer">The buffer to draw</param>
+		System::Void DrawBuffer(GLExternalBuffer ^ buffer);
+		/// <summary>
+		/// Draws the edges of a mesh with the colors of its vertices. Each edge shared by
+		/// several triangles is drawn once.
+		/// </summary>
+		/// <param name="mesh">The mesh to draw</param>
+		System::Void DrawMesh(GLMesh3D ^ mesh);
+		/// <summary>
+		/// Draws the edges of a mesh. Each edge shared by several triangles is drawn once.
+		/// </summary>
+		/// <param name="mesh">The mesh to draw</param>
+		/// <param name="color">Drawing color</param>
+		System::Void DrawMesh(GLMesh3D ^ mesh, Drawing::Color color);
+		/// <summary>
+		/// Draws a filled mesh with the colors of its vertices.
+		/// </summary>
+		/// <param name="mesh">The mesh to draw</param>
+		System::Void FillMesh(GLMesh3D ^ mesh);
+		/// <summary>
+		/// Draws a filled mesh.
+		/// </summary>
+		/// <param name="mesh">The mesh to draw</param>
+		/// <param name="color">Drawing color</param>
+		System::Void FillMesh(GLMesh3D ^ mesh, Drawing::Color color);
 	};
 
 }
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "GLVertexArray.h"
+#include "Mesh3D.h"
+#include "NativeMemory.h"
+
+struct RenderGeometry;
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Represents an indexed triangle mesh with per vertex normals and colors, such as
+	/// a scanned or imported part. The mesh data is copied into native memory when it
+	/// is set. A canvas uploads the mesh to vertex buffer objects the first time the
+	/// mesh is drawn and draws it with a single call in following frames, until the
+	/// mesh data is replaced. The buffers are released after a frame in which the mesh
+	/// is not drawn.
+	/// </summary>
+	public ref class GLMesh3D
+	{
+	// Member variables
+	private:
+		Mesh3D * mMesh;
+		int mVersion;
+
+	// Constructor/destructor
+	public:
+		/// <summary>
+		/// Initializes a new instance of the GLMesh3D class with white vertices and
+		/// computed normals.
+		/// </summary>
+		/// <param name="positions">Vertex coordinates as x, y, z triples</param>
+		/// <param name="indices">Vertex indices, three for each counter-clockwise triangle</param>
+		GLMesh3D(array<float> ^ positions, array<int> ^ indices)
+		{
+			mMesh = _CreateMesh3D();
+			SetData(positions, nullptr, nullptr, indices);
+		}
+		/// <summary>
+		/// Initializes a new instance of the GLMesh3D class.
+		/// </summary>
+		/// <param name="positions">Vertex coordinates as x, y, z triples</param>
+		/// <param name="normals">Vertex normals as x, y, z triples, or null to compute them</param>
+		/// <param name="colors">Vertex colors, or null for white vertices</param>
+		/// <param name="indices">Vertex indices, three for each counter-clockwise triangle</param>
+		GLMesh3D(array<float> ^ positions, array<float> ^ normals, array<Drawing::Color> ^ colors, array<int> ^ indices)
+		{
+			mMesh = _CreateMesh3D();
+			SetData(positions, normals, colors, indices);
+		}
+		/// <summary>
+		/// Initializes a new instance of the GLMesh3D class from data in native memory.
+		/// The data is copied.
+		/// </summary>
+		/// <param name="positions">Address of the vertex coordinates as x, y, z floats</param>
+		/// <param name="normals">Address of the vertex normals as x, y, z floats, or zero to compute them</param>
+		/// <param name="colors">Address of the vertex colors as R, G, B, A bytes, or zero for white vertices</param>
+		/// <param name="vertexCount">Number of vertices</param>
+		/// <param name="indices">Address of the vertex indices as 32 bit unsigned integers</param>
+		/// <param name="indexCount">Number of indices, three for each counter-clockwise triangle</param>
+		GLMesh3D(IntPtr positions, IntPtr normals, IntPtr colors, int vertexCount, IntPtr indices, int indexCount)
+		{
+			mMesh = _CreateMesh3D();
+			SetData(positions, normals, colors, vertexCount, indices, indexCount);
+		}
+
+	internal:
+		/// <summary>
+		/// Initializes a new instance of the GLMesh3D class that takes ownership of
+		/// native mesh data, such as an imported mesh.
+		/// </summary>
+		/// <param name="mesh">Native mesh data, destroyed with the mesh</param>
+		GLMesh3D(Mesh3D * mesh)
+		{
+			mMesh = mesh;
+			mVersion = 1;
+		}
+
+	public:
+		~GLMesh3D() // Dispose
+		{
+			this->!GLMesh3D();
+		}
+
+	protected:
+		!GLMesh3D() // Finalize
+		{
+			_DestroyMesh3D(mMesh);
+			mMesh = 0;
+		}
+
+	// Properties
+	public:
+		/// <summary>
+		/// Gets the number of vertices.
+		/// </summary>
+		property int VertexCount
+		{
+			virtual int get(void) { return (mMesh == 0 ? 0 : mMesh->vertexCount); }
+		}
+		/// <summary>
+		/// Gets the number of triangles.
+		/// </summary>
+		property int TriangleCount
+		{
+			virtual int get(void) { return (mMesh == 0 ? 0 : mMesh->indexCount / 3); }
+		}
+		/// <summary>
+		/// Gets the version of the mesh data. The version is incremented each time
+		/// the data is set.
+		/// </summary>
+		property int Version
+		{
+			virtual int get(void) { return mVersion; }
+		}
+
+	// Implementation
+	public:
+		/// <summary>
+		/// Replaces the mesh data.
+		/// </summary>
+		/// <param name="positions">Vertex coordinates as x, y, z triples</param>
+		/// <param name="normals">Vertex normals as x, y, z triples, or null to compute them</param>
+		/// <param name="colors">Vertex colors, or null for white vertices</param>
+		/// <param name="indices">Vertex indices, three for each counter-clockwise triangle</param>
+		System::Void SetData(array<float> ^ positions, array<float> ^ normals, array<Drawing::Color> ^ colors, array<int> ^ indices)
+		{
+			if (positions == nullptr) throw gcnew ArgumentNullException(L"positions");
+			if (indices == nullptr) throw gcnew ArgumentNullException(L"indices");
+			if (positions->Length % 3 != 0) throw gcnew ArgumentException(L"The number of coordinates is not a multiple of three.", L"positions");
+			int count = positions->Length / 3;
+			if (normals != nullptr && normals->Length != positions->Length) throw gcnew ArgumentException(L"The number of normals does not match the number of vertices.", L"normals");
+			if (colors != nullptr && colors->Length != count) throw gcnew ArgumentException(L"The number of colors does not match the number of vertices.", L"colors");
+
+			// Colors are packed into a temporary native array in the vertex color format
+			unsigned int * packed = 0;
+			if (colors != nullptr && count != 0)
+			{
+				packed = (unsigned int *)_Allocate((size_t)count * sizeof(unsigned int));
+				for (int i = 0; i < count; i++)
+					packed[i] = GLVertexArray::PackColor(colors[i]);
+			}
+
+			try
+			{
+				pin_ptr<float> pinnedPositions = nullptr;
+				pin_ptr<float> pinnedNormals = nullptr;
+				pin_ptr<int> pinnedIndices = nullptr;
+				if (count != 0) pinnedPositions = &positions[0];
+				if (normals != nullptr && count != 0) pinnedNormals = &normals[0];
+				if (indices->Length != 0) pinnedIndices = &indices[0];
+				SetData(IntPtr(pinnedPositions), IntPtr(pinnedNormals), IntPtr(packed), count, IntPtr(pinnedIndices), indices->Length);
+			}
+			finally
+			{
+				_Free(packed);
+			}
+		}
+		/// <summary>
+		/// Replaces the mesh data with data in native memory. The data is copied.
+		/// </summary>
+		/// <param name="positions">Address of the vertex coordinates as x, y, z floats</param>
+		/// <param name="normals">Address of the vertex normals as x, y, z floats, or zero to compute them</param>
+		/// <param name="colors">Address of the vertex colors as R, G, B, A bytes, or zero for white vertices</param>
+		/// <param name="vertexCount">Number of vertices</param>
+		/// <param name="indices">Address of the vertex indices as 32 bit unsigned integers</param>
+		/// <param name="indexCount">Number of indices, three for each counter-clockwise triangle</param>
+		System::Void SetData(IntPtr positions, IntPtr normals, IntPtr colors, int vertexCount, IntPtr indices, int indexCount)
+		{
+			if (mMesh == 0) throw gcnew ObjectDisposedException(L"GLMesh3D");
+			if (vertexCount < 0) throw gcnew ArgumentOutOfRangeException(L"vertexCount");
+			if (indexCount < 0 || indexCount % 3 != 0) throw gcnew ArgumentOutOfRangeException(L"indexCount");
+			if (vertexCount > 0 && positions == IntPtr::Zero) throw gcnew ArgumentNullException(L"positions");
+			if (indexCount > 0 && indices == IntPtr::Zero) throw gcnew ArgumentNullException(L"indices");
+
+			if (!_SetMesh3D(mMesh, (const float *)positions.ToPointer(), (const float *)normals.ToPointer(), (const unsigned int *)colors.ToPointer(),
+				GLVertexArray::PackColor(Drawing::Color::White), vertexCount, (const unsigned int *)indices.ToPointer(), indexCount))
+				throw gcnew ArgumentOutOfRangeException(L"indices", L"An index is outside the vertices.");
+			mVersion++;
+		}
+
+	internal:
+		/// <summary>
+		/// Gets the native mesh data.
+		/// </summary>
+		property Mesh3D * Data
+		{
+			Mesh3D * get(void)
+			{
+				if (mMesh == 0) throw gcnew ObjectDisposedException(L"GLMesh3D");
+				return mMesh;
+			}
+		}
+	};
+
+	/// <summary>
+	/// Holds the vertex and element buffer objects of a mesh.
+	/// </summary>
+	private ref class GLMeshGeometry3D
+	{
+	internal:
+		RenderGeometry * Geometry;
+		int Version;
+		int Frame;
+		bool HasEdges;
+	};
+
+}
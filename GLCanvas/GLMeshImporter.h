@@ -0,0 +1,225 @@
+#pragma once
+
+#include <vcclr.h>
+#include "GLMesh3D.h"
+#include "JobSystem.h"
+#include "MeshImport.h"
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Represents the formats of mesh files.
+	/// </summary>
+	public enum class GLMeshFormat
+	{
+		/// <summary>
+		/// The format is chosen from the file extension, or from the file contents if
+		/// the extension is not known.
+		/// </summary>
+		Auto = MESHFILE_AUTO,
+		/// <summary>
+		/// Binary or ASCII STL.
+		/// </summary>
+		Stl = MESHFILE_STL,
+		/// <summary>
+		/// Wavefront OBJ. Polygons are split into triangle fans; texture coordinates,
+		/// normals and materials are ignored.
+		/// </summary>
+		Obj = MESHFILE_OBJ,
+		/// <summary>
+		/// ASCII or binary PLY. Vertex normals and colors are read when present.
+		/// </summary>
+		Ply = MESHFILE_PLY,
+	};
+
+	/// <summary>
+	/// Loads triangle meshes from STL, OBJ and PLY files. Files are mapped into memory
+	/// and parsed in parallel; vertices at the same position are merged so that the
+	/// mesh can be drawn with indexed triangles. The statistics of the last load are
+	/// kept until the next load.
+	/// </summary>
+	public ref class GLMeshImporter
+	{
+	// Member variables
+	private:
+		float mWeldTolerance;
+		bool mParallel;
+		MeshImportInfo * mInfo;
+
+	// Constructor/destructor
+	public:
+		/// <summary>
+		/// Initializes a new instance of the GLMeshImporter class.
+		/// </summary>
+		GLMeshImporter()
+		{
+			mWeldTolerance = 0.0f;
+			mParallel = true;
+			mInfo = new MeshImportInfo();
+		}
+
+		~GLMeshImporter() // Dispose
+		{
+			this->!GLMeshImporter();
+		}
+
+	protected:
+		!GLMeshImporter() // Finalize
+		{
+			delete mInfo;
+			mInfo = 0;
+		}
+
+	// Properties
+	public:
+		/// <summary>
+		/// Gets or sets the distance within which vertices are merged. Vertices whose
+		/// coordinates round to the same multiples of the tolerance are merged; zero
+		/// merges vertices at exactly the same position.
+		/// </summary>
+		property float WeldTolerance
+		{
+			virtual float get(void) { return mWeldTolerance; }
+			virtual void set(float value)
+			{
+				if (!(value >= 0.0f)) throw gcnew ArgumentOutOfRangeException(L"value", L"The tolerance must be zero or positive.");
+				mWeldTolerance = value;
+			}
+		}
+		/// <summary>
+		/// Gets or sets whether files are parsed and merged on the shared worker threads.
+		/// </summary>
+		property bool Parallel
+		{
+			virtual bool get(void) { return mParallel; }
+			virtual void set(bool value) { mParallel = value; }
+		}
+		/// <summary>
+		/// Gets the format of the last loaded file.
+		/// </summary>
+		property GLMeshFormat Format
+		{
+			virtual GLMeshFormat get(void) { return (GLMeshFormat)Info->format; }
+		}
+		/// <summary>
+		/// Gets the size of the last loaded file in bytes.
+		/// </summary>
+		property long long FileSize
+		{
+			virtual long long get(void) { return Info->fileSize; }
+		}
+		/// <summary>
+		/// Gets the number of vertices in the last loaded file before merging. STL files
+		/// store three vertices for each triangle.
+		/// </summary>
+		property int FileVertexCount
+		{
+			virtual int get(void) { return Info->fileVertexCount; }
+		}
+		/// <summary>
+		/// Gets the number of triangles of the last loaded mesh.
+		/// </summary>
+		property int TriangleCount
+		{
+			virtual int get(void) { return Info->triangleCount; }
+		}
+		/// <summary>
+		/// Gets the number of vertices of the last loaded mesh after merging.
+		/// </summary>
+		property int VertexCount
+		{
+			virtual int get(void) { return Info->vertexCount; }
+		}
+		/// <summary>
+		/// Gets the time spent parsing the last loaded file in milliseconds.
+		/// </summary>
+		property double ParseTime
+		{
+			virtual double get(void) { return Info->parseTime; }
+		}
+		/// <summary>
+		/// Gets the time spent merging vertices of the last loaded file in milliseconds.
+		/// </summary>
+		property double WeldTime
+		{
+			virtual double get(void) { return Info->weldTime; }
+		}
+		/// <summary>
+		/// Gets the time spent building the vertices, indices and normals of the last
+		/// loaded mesh in milliseconds.
+		/// </summary>
+		property double BuildTime
+		{
+			virtual double get(void) { return Info->buildTime; }
+		}
+		/// <summary>
+		/// Gets the total time spent loading the last file in milliseconds.
+		/// </summary>
+		property double LoadTime
+		{
+			virtual double get(void) { return Info->totalTime; }
+		}
+		/// <summary>
+		/// Gets the largest number of bytes held at once while loading the last file,
+		/// not counting the mapped file.
+		/// </summary>
+		property long long PeakMemory
+		{
+			virtual long long get(void) { return Info->peakMemory; }
+		}
+
+	// Implementation
+	public:
+		/// <summary>
+		/// Loads a mesh file, choosing the format from the file extension.
+		/// </summary>
+		/// <param name="path">Path of the file</param>
+		/// <returns>The loaded mesh.</returns>
+		GLMesh3D ^ Load(String ^ path)
+		{
+			return Load(path, GLMeshFormat::Auto);
+		}
+		/// <summary>
+		/// Loads a mesh file in the given format.
+		/// </summary>
+		/// <param name="path">Path of the file</param>
+		/// <param name="format">Format of the file</param>
+		/// <returns>The loaded mesh.</returns>
+		GLMesh3D ^ Load(String ^ path, GLMeshFormat format)
+		{
+			if (path == nullptr) throw gcnew ArgumentNullException(L"path");
+			MeshImportInfo * info = Info;
+
+			Mesh3D * mesh = _CreateMesh3D();
+			int result;
+			{
+				pin_ptr<const wchar_t> chars = PtrToStringChars(path);
+				result = _ImportMesh3D(chars, (int)format, mWeldTolerance, (mParallel ? _SharedJobSystem() : 0), mesh, info);
+			}
+			if (result != MESHIMPORT_OK)
+			{
+				_DestroyMesh3D(mesh);
+				if (result == MESHIMPORT_OPENFAILED)
+					throw gcnew IO::IOException(String::Format(L"The file '{0}' could not be opened.", path));
+				else if (result == MESHIMPORT_TOOLARGE)
+					throw gcnew OutOfMemoryException(String::Format(L"The file '{0}' is too large to be loaded.", path));
+				else
+					throw gcnew IO::InvalidDataException(String::Format(L"The file '{0}' does not contain a valid mesh.", path));
+			}
+			return gcnew GLMesh3D(mesh);
+		}
+
+	private:
+		property MeshImportInfo * Info
+		{
+			MeshImportInfo * get(void)
+			{
+				if (mInfo == 0) throw gcnew ObjectDisposedException(L"GLMeshImporter");
+				return mInfo;
+			}
+		}
+	};
+
+}
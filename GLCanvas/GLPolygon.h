@@ -0,0 +1,328 @@
+#pragma once
+
+#include "NativeMemory.h"
+#include "Simplifier.h"
+#include "Triangulator.h"
+
+#include <string.h>
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Holds the triangulation of a polygon set at one level of detail.
+	/// </summary>
+	struct PolygonLevel
+	{
+		int band;				// zoom band the triangles were simplified for
+		bool valid;				// false if the polygons were modified since
+		float * triangles;		// triangle corner points as x, y pairs
+		int capacity;			// number of points triangles can hold
+		int vertexCount;		// number of triangle corner points
+	};
+
+	/// <summary>
+	/// Represents a set of polygons which may be concave and may contain holes, such
+	/// as the parcels of a map. The polygons are triangulated the first time they are
+	/// filled, and the triangulation is kept until the polygon set is modified, so
+	/// drawing the same polygons in every frame does not triangulate them again.
+	/// When the polygons are drawn zoomed out, they are simplified to the level of
+	/// detail of the canvas before they are triangulated. Simplified triangulations
+	/// are cached for a few zoom bands, each spanning a factor of two in zoom.
+	/// </summary>
+	public ref class GLPolygon
+	{
+	// Member variables
+	private:
+		System::Collections::Generic::List<array<Drawing::PointF> ^> ^ mRings;
+		System::Collections::Generic::List<bool> ^ mIsHole;
+		PolygonLevel * mLevels;
+		int mNextLevel;
+		Drawing::RectangleF mBounds;
+
+		/// <summary>
+		/// The number of simplified triangulations cached in addition to the full detail one.
+		/// </summary>
+		static const int CachedLevels = 4;
+
+	// Constructor/destructor
+	public:
+		/// <summary>
+		/// Initializes a new empty instance of the GLPolygon class.
+		/// </summary>
+		GLPolygon()
+		{
+			mRings = gcnew System::Collections::Generic::List<array<Drawing::PointF> ^>();
+			mIsHole = gcnew System::Collections::Generic::List<bool>();
+			mLevels = (PolygonLevel *)_Allocate((CachedLevels + 1) * sizeof(PolygonLevel));
+			memset(mLevels, 0, (CachedLevels + 1) * sizeof(PolygonLevel));
+			mNextLevel = 1;
+		}
+		/// <summary>
+		/// Initializes a new instance of the GLPolygon class with the given boundary.
+		/// </summary>
+		/// <param name="boundary">Corner points of the outer boundary</param>
+		GLPolygon(array<Drawing::PointF> ^ boundary)
+		{
+			mRings = gcnew System::Collections::Generic::List<array<Drawing::PointF> ^>();
+			mIsHole = gcnew System::Collections::Generic::List<bool>();
+			mLevels = (PolygonLevel *)_Allocate((CachedLevels + 1) * sizeof(PolygonLevel));
+			memset(mLevels, 0, (CachedLevels + 1) * sizeof(PolygonLevel));
+			mNextLevel = 1;
+			AddBoundary(boundary);
+		}
+
+		~GLPolygon() // Dispose
+		{
+			this->!GLPolygon();
+		}
+
+	protected:
+		!GLPolygon() // Finalize
+		{
+			if (mLevels == 0) return;
+			for (int i = 0; i <= CachedLevels; i++)
+				_Free(mLevels[i].triangles);
+			_Free(mLevels);
+			mLevels = 0;
+		}
+
+	// Properties
+	public:
+		/// <summary>
+		/// Gets the number of boundaries and holes.
+		/// </summary>
+		property int RingCount
+		{
+			virtual int get(void) { return mRings->Count; }
+		}
+		/// <summary>
+		/// Gets the number of triangles the polygons are filled with. Reading this
+		/// property triangulates the polygons if they are not triangulated yet.
+		/// </summary>
+		property int TriangleCount
+		{
+			virtual int get(void) { Triangulate(); return mLevels[0].vertexCount / 3; }
+		}
+		/// <summary>
+		/// Gets the bounding rectangle of the boundaries.
+		/// </summary>
+		property Drawing::RectangleF Bounds
+		{
+			virtual Drawing::RectangleF get(void) { Triangulate(); return mBounds; }
+		}
+
+	// Implementation
+	public:
+		/// <summary>
+		/// Adds the outer boundary of a new polygon. The polygon may be concave.
+		/// </summary>
+		/// <param name="boundary">Corner points of the boundary</param>
+		System::Void AddBoundary(array<Drawing::PointF> ^ boundary)
+		{
+			if (boundary == nullptr) throw gcnew ArgumentNullException(L"boundary");
+
+			mRings->Add(boundary);
+			mIsHole->Add(false);
+			Invalidate();
+		}
+		/// <summary>
+		/// Adds a hole to the polygon added last with AddBoundary.
+		/// </summary>
+		/// <param name="hole">Corner points of the hole</param>
+		System::Void AddHole(array<Drawing::PointF> ^ hole)
+		{
+			if (hole == nullptr) throw gcnew ArgumentNullException(L"hole");
+			if (mRings->Count == 0) throw gcnew InvalidOperationException(L"A boundary must be added before holes.");
+
+			mRings->Add(hole);
+			mIsHole->Add(true);
+			Invalidate();
+		}
+		/// <summary>
+		/// Removes all boundaries and holes. The memory allocated for triangles is retained.
+		/// </summary>
+		System::Void Clear()
+		{
+			mRings->Clear();
+			mIsHole->Clear();
+			Invalidate();
+		}
+		/// <summary>
+		/// Signals that the corner points of the boundaries or holes have been modified,
+		/// so that the polygons are triangulated again.
+		/// </summary>
+		System::Void NotifyChanged()
+		{
+			Invalidate();
+		}
+		/// <summary>
+		/// Gets the corner points of the given boundary or hole.
+		/// </summary>
+		/// <param name="index">Index of the ring in the order it was added</param>
+		/// <param name="isHole">Receives whether the ring is a hole</param>
+		array<Drawing::PointF> ^ GetRing(int index, bool % isHole)
+		{
+			isHole = mIsHole[index];
+			return mRings[index];
+		}
+		/// <summary>
+		/// Triangulates the polygons if they were modified since they were last triangulated.
+		/// This is done automatically when the polygons are filled; calling it in advance
+		/// moves the work to the calling thread.
+		/// </summary>
+		System::Void Triangulate()
+		{
+			if (mLevels[0].valid) return;
+
+			TriangulateLevel(&mLevels[0], 0);
+		}
+
+	internal:
+		/// <summary>
+		/// Gets the triangulation of the polygons simplified with the given tolerance.
+		/// Tolerances are rounded down to a power of two, so that the triangulation
+		/// is reused while zooming within a factor of two.
+		/// </summary>
+		/// <param name="tolerance">Largest allowed deviation in world coordinates; zero for full detail</param>
+		/// <param name="vertexCount">Receives the number of triangle corner points</param>
+		/// <returns>The triangle corner points as x, y pairs</returns>
+		const float * GetTriangles(float tolerance, int % vertexCount)
+		{
+			Triangulate();
+			PolygonLevel * level = &mLevels[0];
+			if (tolerance > 0)
+			{
+				int band = (int)Math::Floor(Math::Log(tolerance, 2.0));
+				level = 0;
+				for (int i = 1; i <= CachedLevels; i++)
+				{
+					if (mLevels[i].valid && mLevels[i].band == band) level = &mLevels[i];
+				}
+				if (level == 0)
+				{
+					// Replace the cached levels in turn
+					level = &mLevels[mNextLevel];
+					mNextLevel = (mNextLevel == CachedLevels ? 1 : mNextLevel + 1);
+					level->band = band;
+					TriangulateLevel(level, (float)Math::Pow(2.0, band));
+				}
+			}
+			vertexCount = level->vertexCount;
+			return level->triangles;
+		}
+
+	// Helper methods
+	private:
+		/// <summary>
+		/// Marks all cached triangulations as out of date.
+		/// </summary>
+		System::Void Invalidate()
+		{
+			for (int i = 0; i <= CachedLevels; i++)
+				mLevels[i].valid = false;
+		}
+		/// <summary>
+		/// Triangulates the polygons into the given level. The bounds are computed
+		/// with the full detail level.
+		/// </summary>
+		/// <param name="level">The level receiving the triangles</param>
+		/// <param name="tolerance">Tolerance the rings are simplified with; zero for full detail</param>
+		System::Void TriangulateLevel(PolygonLevel * level, float tolerance)
+		{
+			level->vertexCount = 0;
+			bool first = true;
+			float xmin = 0, ymin = 0, xmax = 0, ymax = 0;
+			Triangulator * triangulator = _CreateTriangulator();
+			Simplifier * simplifier = _CreateSimplifier();
+			float * ring = 0;
+			float * points = 0;
+			int * ringEnds = 0;
+			try
+			{
+				// Copy the points of each polygon and its holes to native memory
+				int pointCount = 0;
+				int longest = 0;
+				for (int i = 0; i < mRings->Count; i++)
+				{
+					pointCount += mRings[i]->Length;
+					longest = Math::Max(longest, mRings[i]->Length);
+				}
+				ring = (float *)_Allocate(Math::Max(longest, 1) * 2 * sizeof(float));
+				points = (float *)_Allocate(Math::Max(pointCount, 1) * 2 * sizeof(float));
+				ringEnds = (int *)_Allocate(Math::Max(mRings->Count, 1) * sizeof(int));
+
+				int start = 0;
+				while (start < mRings->Count)
+				{
+					int end = start + 1;
+					while (end < mRings->Count && mIsHole[end]) end++;
+
+					int count = 0;
+					int ringCount = 0;
+					for (int r = start; r < end; r++)
+					{
+						array<Drawing::PointF> ^ source = mRings[r];
+						for (int i = 0; i < source->Length; i++)
+						{
+							ring[i * 2] = source[i].X;
+							ring[i * 2 + 1] = source[i].Y;
+						}
+						const float * simplified;
+						int length = _Simplify(simplifier, ring, source->Length, tolerance, true, &simplified);
+						if (length < 3)
+						{
+							// A degenerate boundary removes the whole polygon
+							if (r == start) break;
+							continue;
+						}
+						for (int i = 0; i < length; i++)
+						{
+							float x = simplified[i * 2];
+							float y = simplified[i * 2 + 1];
+							points[count * 2] = x;
+							points[count * 2 + 1] = y;
+							count++;
+							if (r != start) continue;
+							if (first) { xmin = xmax = x; ymin = ymax = y; first = false; }
+							xmin = Math::Min(xmin, x); xmax = Math::Max(xmax, x);
+							ymin = Math::Min(ymin, y); ymax = Math::Max(ymax, y);
+						}
+						ringEnds[ringCount++] = count;
+					}
+
+					const int * indices;
+					int indexCount = (ringCount == 0 ? 0 : _Triangulate(triangulator, points, ringEnds, ringCount, &indices));
+					if (level->vertexCount + indexCount > level->capacity)
+					{
+						level->capacity = Math::Max(level->capacity * 2, level->vertexCount + indexCount);
+						level->triangles = (float *)_Reallocate(level->triangles, level->capacity * 2 * sizeof(float));
+					}
+					float * out = level->triangles + level->vertexCount * 2;
+					for (int i = 0; i < indexCount; i++)
+					{
+						out[i * 2] = points[indices[i] * 2];
+						out[i * 2 + 1] = points[indices[i] * 2 + 1];
+					}
+					level->vertexCount += indexCount;
+
+					start = end;
+				}
+			}
+			finally
+			{
+				_Free(ring);
+				_Free(points);
+				_Free(ringEnds);
+				_DestroySimplifier(simplifier);
+				_DestroyTriangulator(triangulator);
+			}
+
+			if (tolerance == 0)
+				mBounds = (first ? Drawing::RectangleF::Empty : Drawing::RectangleF(xmin, ymin, xmax - xmin, ymax - ymin));
+			level->valid = true;
+		}
+	};
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "Renderer.h"
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Represents the OpenGL pipeline a canvas draws its vertex arrays with.
+	/// </summary>
+	public enum class GLRenderBackend
+	{
+		/// <summary>
+		/// Vertex arrays are drawn with the OpenGL 1.1 fixed function pipeline.
+		/// This backend is supported by all drivers.
+		/// </summary>
+		FixedFunction = RENDERBACKEND_FIXEDFUNCTION,
+		/// <summary>
+		/// Vertex arrays are drawn from vertex buffer objects with GLSL shaders, using
+		/// only OpenGL 3.3 core profile features. Canvases fall back to the fixed function
+		/// pipeline if the driver does not support OpenGL 3.3. The context of a canvas is a
+		/// compatibility profile context, since text, picking, the grid and selection
+		/// outlines are still drawn with the fixed function pipeline.
+		/// </summary>
+		Programmable = RENDERBACKEND_PROGRAMMABLE
+	};
+
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "NativeMemory.h"
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Contains statistics about the last frame drawn by a canvas.
+	/// </summary>
+	public ref class GLRenderStatistics
+	{
+	// Member variables
+	private:
+		long long mStartTime;
+		long long mStartManagedBytes;
+		long long mStartNativeAllocations;
+		int mStartCollections;
+		double mFrameTime;
+		int mFrameCount;
+		int mPrimitiveCount;
+		int mVertexCount;
+		int mCulledCount;
+		long long mManagedBytes;
+		long long mNativeAllocations;
+		int mCollections;
+		bool mTrackManaged;
+		bool mFrameTracked;
+
+	// Constructor/destructor
+	internal:
+		GLRenderStatistics()
+		{
+			mTrackManaged = false;
+			mFrameTracked = false;
+			mManagedBytes = -1;
+		}
+
+	// Properties
+	public:
+		/// <summary>
+		/// Gets the time spent drawing the last frame in milliseconds.
+		/// </summary>
+		property double FrameTime
+		{
+			virtual double get(void) { return mFrameTime; }
+		}
+		/// <summary>
+		/// Gets the number of frames drawn.
+		/// </summary>
+		property int FrameCount
+		{
+			virtual int get(void) { return mFrameCount; }
+		}
+		/// <summary>
+		/// Gets the number of drawing objects recorded in the last frame.
+		/// </summary>
+		property int PrimitiveCount
+		{
+			virtual int get(void) { return mPrimitiveCount; }
+		}
+		/// <summary>
+		/// Gets the number of vertices sent to OpenGL in the last frame.
+		/// </summary>
+		property int VertexCount
+		{
+			virtual int get(void) { return mVertexCount; }
+		}
+		/// <summary>
+		/// Gets the number of scene objects skipped in the last frame because they were outside
+		/// the view or hidden behind occluders.
+		/// </summary>
+		property int CulledObjectCount
+		{
+			virtual int get(void) { return mCulledCount; }
+		}
+		/// <summary>
+		/// Gets or sets whether the managed bytes allocated while drawing are measured.
+		/// Measuring turns on AppDomain resource monitoring, which stays on for the
+		/// whole process and adds bookkeeping to every allocation, so it is off by default.
+		/// </summary>
+		property bool TrackManagedAllocations
+		{
+			virtual bool get(void) { return mTrackManaged; }
+			virtual void set(bool value)
+			{
+				if (value && !AppDomain::MonitoringIsEnabled)
+				{
+					try
+					{
+						AppDomain::MonitoringIsEnabled = true;
+					}
+					catch (InvalidOperationException ^)
+					{
+						throw gcnew NotSupportedException(L"Managed allocations cannot be monitored in this application domain.");
+					}
+				}
+				mTrackManaged = value;
+			}
+		}
+		/// <summary>
+		/// Gets the number of managed bytes allocated by the process while drawing the last
+		/// frame, or -1 if TrackManagedAllocations was off. The runtime updates this value in
+		/// allocation quanta of a few kilobytes, so small allocations may be reported in a
+		/// later frame.
+		/// </summary>
+		property long long ManagedBytesAllocated
+		{
+			virtual long long get(void) { return mManagedBytes; }
+		}
+		/// <summary>
+		/// Gets the number of native memory allocations made by the library while drawing the last frame.
+		/// </summary>
+		property long long NativeAllocations
+		{
+			virtual long long get(void) { return mNativeAllocations; }
+		}
+		/// <summary>
+		/// Gets the number of garbage collections that occurred while drawing the last frame.
+		/// </summary>
+		property int GarbageCollections
+		{
+			virtual int get(void) { return mCollections; }
+		}
+
+	// Implementation
+	internal:
+		/// <summary>
+		/// Starts measuring a frame.
+		/// </summary>
+		System::Void BeginFrame()
+		{
+			mStartTime = Diagnostics::Stopwatch::GetTimestamp();
+			mFrameTracked = mTrackManaged;
+			mStartManagedBytes = (mFrameTracked ? AppDomain::CurrentDomain->MonitoringTotalAllocatedMemorySize : 0);
+			mStartNativeAllocations = _NativeAllocationCount();
+			mStartCollections = GC::CollectionCount(0);
+			mPrimitiveCount = 0;
+			mVertexCount = 0;
+			mCulledCount = 0;
+		}
+		/// <summary>
+		/// Adds to the number of primitives and vertices drawn in the current frame.
+		/// </summary>
+		/// <param name="primitives">Number of primitives</param>
+		/// <param name="vertices">Number of vertices</param>
+		System::Void AddCounts(int primitives, int vertices)
+		{
+			mPrimitiveCount += primitives;
+			mVertexCount += vertices;
+		}
+		/// <summary>
+		/// Adds to the number of scene objects skipped in the current frame.
+		/// </summary>
+		/// <param name="objects">Number of objects</param>
+		System::Void AddCulled(int objects)
+		{
+			mCulledCount += objects;
+		}
+		/// <summary>
+		/// Stops measuring a frame.
+		/// </summary>
+		System::Void EndFrame()
+		{
+			mFrameTime = (double)(Diagnostics::Stopwatch::GetTimestamp() - mStartTime) * 1000.0 / (double)Diagnostics::Stopwatch::Frequency;
+			mManagedBytes = (mFrameTracked ? AppDomain::CurrentDomain->MonitoringTotalAllocatedMemorySize - mStartManagedBytes : -1);
+			mNativeAllocations = _NativeAllocationCount() - mStartNativeAllocations;
+			mCollections = GC::CollectionCount(0) - mStartCollections;
+			mFrameCount++;
+		}
+	};
+
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <windows.h>
+#include <GL/gl.h>
+#include "Density.h"
+#include "GeometryKernels.h"
+#include "GLVertexArray.h"
+#include "NativeMemory.h"
+#include "VertexBuffer.h"
+
+#include <string.h>
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Represents a large set of points drawn as a scatter plot. While the points are
+	/// fewer than the pixels of the canvas, they are drawn as round point sprites.
+	/// With more points than pixels, the points are counted into a screen sized grid
+	/// on all processor cores and the counts are drawn with a colormap, so that tens
+	/// of millions of points can be panned and zoomed interactively. The density image
+	/// is kept until the view, the points or the colormap change.
+	/// </summary>
+	public ref class GLScatter
+	{
+	// Member variables
+	private:
+		float * mPoints;
+		int mCount;
+		int mCapacity;
+		int mVersion;
+		Drawing::Color mColor;
+		float mPointSize;
+		float mDensityThreshold;
+		array<Drawing::Color> ^ mColormap;
+		unsigned int * mColormapTable;
+		DensityGrid * mGrid;
+		const unsigned int * mPixels;
+		int mPixelsVersion;
+		Drawing::RectangleF mPixelsView;
+		int mPixelsWidth, mPixelsHeight;
+		Drawing::RectangleF mBounds;
+
+		/// <summary>
+		/// The number of entries in the colormap lookup table.
+		/// </summary>
+		static const int ColormapSize = 256;
+
+	// Constructor/destructor
+	public:
+		/// <summary>
+		/// Initializes a new instance of the GLScatter class.
+		/// </summary>
+		/// <param name="points">Point coordinates</param>
+		/// <param name="color">Color of points drawn as sprites</param>
+		GLScatter(array<Drawing::PointF> ^ points, Drawing::Color color)
+		{
+			mPoints = 0;
+			mCount = 0;
+			mCapacity = 0;
+			mVersion = 0;
+			mColor = color;
+			mPointSize = 3.0f;
+			mDensityThreshold = 1.0f;
+			mColormapTable = (unsigned int *)_Allocate(ColormapSize * sizeof(unsigned int));
+			mGrid = _CreateDensityGrid();
+			mPixels = 0;
+			mPixelsVersion = -1;
+			Colormap = gcnew array<Drawing::Color> {
+				Drawing::Color::FromArgb(68, 1, 84),
+				Drawing::Color::FromArgb(59, 82, 139),
+				Drawing::Color::FromArgb(33, 145, 140),
+				Drawing::Color::FromArgb(94, 201, 98),
+				Drawing::Color::FromArgb(253, 231, 37) };
+			SetPoints(points);
+		}
+
+		~GLScatter() // Dispose
+		{
+			this->!GLScatter();
+		}
+
+	protected:
+		!GLScatter() // Finalize
+		{
+			_Free(mPoints);
+			_Free(mColormapTable);
+			_DestroyDensityGrid(mGrid);
+			mPoints = 0;
+			mColormapTable = 0;
+			mGrid = 0;
+			mPixels = 0;
+		}
+
+	// Properties
+	public:
+		/// <summary>
+		/// Gets the number of points.
+		/// </summary>
+		property int Count
+		{
+			virtual int get(void) { return mCount; }
+		}
+		/// <summary>
+		/// Gets the bounding rectangle of the points.
+		/// </summary>
+		property Drawing::RectangleF Bounds
+		{
+			virtual Drawing::RectangleF get(void) { return mBounds; }
+		}
+		/// <summary>
+		/// Gets or sets the color of points drawn as sprites.
+		/// </summary>
+		property Drawing::Color Color
+		{
+			virtual Drawing::Color get(void) { return mColor; }
+			virtual void set(Drawing::Color value) { mColor = value; }
+		}
+		/// <summary>
+		/// Gets or sets the diameter of point sprites in pixels.
+		/// </summary>
+		property float PointSize
+		{
+			virtual float get(void) { return mPointSize; }
+			virtual void set(float value) { mPointSize = Math::Max(value, 1.0f); }
+		}
+		/// <summary>
+		/// Gets or sets the number of points per pixel above which the points are drawn
+		/// as a density image instead of sprites.
+		/// </summary>
+		property float DensityThreshold
+		{
+			virtual float get(void) { return mDensityThreshold; }
+			virtual void set(float value) { mDensityThreshold = Math::Max(value, 0.0f); }
+		}
+		/// <summary>
+		/// Gets or sets the colors of the density image, from the lowest to the highest
+		/// density. Colors are interpolated between the given stops; densities are mapped
+		/// logarithmically. Pixels without points are transparent.
+		/// </summary>
+		property array<Drawing::Color> ^ Colormap
+		{
+			virtual array<Drawing::Color> ^ get(void) { return mColormap; }
+			virtual void set(array<Drawing::Color> ^ value)
+			{
+				if (value == nullptr) throw gcnew ArgumentNullException(L"value");
+				if (value->Length == 0) throw gcnew ArgumentException(L"The colormap must contain at least one color.", L"value");
+
+				mColormap = value;
+				for (int i = 0; i < ColormapSize; i++)
+				{
+					float t = (float)i / (float)(ColormapSize - 1) * (float)(value->Length - 1);
+					int j = Math::Min((int)t, value->Length - 1);
+					int k = Math::Min(j + 1, value->Length - 1);
+					float f = t - (float)j;
+					Drawing::Color c1 = value[j], c2 = value[k];
+					mColormapTable[i] = GLVertexArray::PackColor(Drawing::Color::FromArgb(
+						(int)(c1.A + (c2.A - c1.A) * f), (int)(c1.R + (c2.R - c1.R) * f),
+						(int)(c1.G + (c2.G - c1.G) * f), (int)(c1.B + (c2.B - c1.B) * f)));
+				}
+				mPixelsVersion = -1;
+			}
+		}
+		/// <summary>
+		/// Gets the version of the points. The version is incremented each time
+		/// the points are set.
+		/// </summary>
+		property int Version
+		{
+			virtual int get(void) { return mVersion; }
+		}
+
+	// Implementation
+	public:
+		/// <summary>
+		/// Replaces the points.
+		/// </summary>
+		/// <param name="points">Point coordinates</param>
+		System::Void SetPoints(array<Drawing::PointF> ^ points)
+		{
+			if (points == nullptr) throw gcnew ArgumentNullException(L"points");
+
+			if (points->Length == 0)
+			{
+				SetPoints(IntPtr::Zero, 0);
+				return;
+			}
+			pin_ptr<Drawing::PointF> pinned = &points[0];
+			SetPoints(IntPtr(pinned), points->Length);
+		}
+		/// <summary>
+		/// Replaces the points with points stored in native memory as x, y float pairs.
+		/// The points are copied.
+		/// </summary>
+		/// <param name="points">Address of the first point</param>
+		/// <param name="count">Number of points</param>
+		System::Void SetPoints(IntPtr points, int count)
+		{
+			if (count < 0) throw gcnew ArgumentOutOfRangeException(L"count");
+			if (count > 0 && points == IntPtr::Zero) throw gcnew ArgumentNullException(L"points");
+
+			if (count > mCapacity)
+			{
+				mCapacity = count;
+				mPoints = (float *)_Reallocate(mPoints, (size_t)mCapacity * 2 * sizeof(float));
+			}
+			if (count > 0) memcpy(mPoints, points.ToPointer(), (size_t)count * 2 * sizeof(float));
+			mCount = count;
+			mVersion++;
+
+			float lower[2], upper[2];
+			if (_StridedBounds(mPoints, mCount, 2 * sizeof(float), 2, lower, upper))
+				mBounds = Drawing::RectangleF(lower[0], lower[1], upper[0] - lower[0], upper[1] - lower[1]);
+			else
+				mBounds = Drawing::RectangleF::Empty;
+		}
+
+	internal:
+		/// <summary>
+		/// Draws the points as sprites or as a density image covering the view.
+		/// The vertex array client state must be enabled; the color array state is disabled.
+		/// </summary>
+		/// <param name="view">The visible area in world coordinates</param>
+		/// <param name="pixelSize">Size of a pixel in world coordinates</param>
+		/// <param name="width">Width of the view in pixels</param>
+		/// <param name="height">Height of the view in pixels</param>
+		/// <param name="jobs">Job system used to compute the density, or null</param>
+		/// <param name="z">Depth of the points</param>
+		System::Void Render(Drawing::RectangleF view, float pixelSize, int width, int height, JobSystem * jobs, float z)
+		{
+			if (mCount == 0 || width <= 0 || height <= 0) return;
+
+			glDisableClientState(GL_COLOR_ARRAY);
+			if ((double)mCount <= (double)width * (double)height * mDensityThreshold)
+			{
+				glLoadIdentity();
+				glTranslatef(0.0f, 0.0f, z);
+				glPointSize(mPointSize);
+				glEnable(GL_POINT_SMOOTH);
+				glColor4ub(mColor.R, mColor.G, mColor.B, mColor.A);
+				glVertexPointer(2, GL_FLOAT, 0, mPoints);
+				glDrawArrays(GL_POINTS, 0, mCount);
+				glDisable(GL_POINT_SMOOTH);
+				glPointSize(1.0f);
+				return;
+			}
+
+			// Count the points again only if the view or the data changed
+			if (mPixelsVersion != mVersion || mPixelsView != view || mPixelsWidth != width || mPixelsHeight != height)
+			{
+				_AggregateDensity(mGrid, jobs, mPoints, mCount, view.Left, view.Top, pixelSize, width, height);
+				mPixels = _ShadeDensity(mGrid, jobs, mColormapTable, ColormapSize);
+				mPixelsVersion = mVersion;
+				mPixelsView = view;
+				mPixelsWidth = width;
+				mPixelsHeight = height;
+			}
+			if (mPixels == 0) return;
+
+			// Place the raster position at the center pixel, which is never clipped,
+			// then move it to the lower left corner of the view
+			glLoadIdentity();
+			glRasterPos3f(view.Left + ((float)(width / 2) + 0.5f) * pixelSize, view.Top + ((float)(height / 2) + 0.5f) * pixelSize, z);
+			glBitmap(0, 0, 0.0f, 0.0f, -((float)(width / 2) + 0.5f), -((float)(height / 2) + 0.5f), 0);
+			glDrawPixels(width, height, GL_RGBA, GL_UNSIGNED_BYTE, mPixels);
+		}
+	};
+
+}
@@ -0,0 +1,539 @@
+#pragma once
+
+#include "Culling3D.h"
+#include "GLCommandBuffer.h"
+#include "GLGraphics3D.h"
+#include "GLRenderStatistics.h"
+#include "GLVertexArray.h"
+#include "Renderer.h"
+#include "VertexBuffer.h"
+
+#include <string.h>
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Represents an object of a retained 3D scene. The geometry of a node is defined
+	/// by drawing commands recorded into a command buffer in node coordinates, and
+	/// is converted to vertices once. The vertices are uploaded to a vertex buffer
+	/// object the first time the node is drawn and are kept on the graphics card, so
+	/// moving, hiding or recoloring a node does not send its geometry again.
+	/// Nodes can be built on any thread, since no OpenGL context is needed until the
+	/// scene is drawn. Text and external buffers cannot be drawn in a scene node.
+	/// </summary>
+	public ref class GLSceneNode3D
+	{
+	// Member variables
+	private:
+		GLCommandBuffer ^ mGeometry;
+		array<float> ^ mTransform;
+		bool mVisible;
+		bool mOccluder;
+		Drawing::Color mColor;
+		System::Collections::Generic::List<GLSceneNode3D ^> ^ mChildren;
+		LitBuffer * mTriangles;
+		LitBuffer * mLines;
+		bool mHasBounds;
+		float xmin, ymin, zmin, xmax, ymax, zmax;
+		int mVersion;
+
+	// Constructor/destructor
+	public:
+		/// <summary>
+		/// Initializes a new instance of the GLSceneNode3D class without geometry,
+		/// which can be used to group and transform its child nodes.
+		/// </summary>
+		GLSceneNode3D()
+		{
+			mTransform = gcnew array<float>(16) { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+			mVisible = true;
+			mOccluder = false;
+			mColor = Drawing::Color::Empty;
+			mChildren = gcnew System::Collections::Generic::List<GLSceneNode3D ^>();
+			mTriangles = _CreateLitBuffer();
+			mLines = _CreateLitBuffer();
+			mHasBounds = false;
+			mVersion = 0;
+		}
+		/// <summary>
+		/// Initializes a new instance of the GLSceneNode3D class with the given geometry.
+		/// </summary>
+		/// <param name="geometry">Drawing commands defining the node in node coordinates</param>
+		GLSceneNode3D(GLCommandBuffer ^ geometry)
+		{
+			mTransform = gcnew array<float>(16) { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+			mVisible = true;
+			mOccluder = false;
+			mColor = Drawing::Color::Empty;
+			mChildren = gcnew System::Collections::Generic::List<GLSceneNode3D ^>();
+			mTriangles = _CreateLitBuffer();
+			mLines = _CreateLitBuffer();
+			mHasBounds = false;
+			mVersion = 0;
+			Geometry = geometry;
+		}
+
+		~GLSceneNode3D() // Dispose
+		{
+			this->!GLSceneNode3D();
+		}
+
+	protected:
+		!GLSceneNode3D() // Finalize
+		{
+			_DestroyLitBuffer(mTriangles);
+			_DestroyLitBuffer(mLines);
+			mTriangles = 0;
+			mLines = 0;
+		}
+
+	// Properties
+	public:
+		/// <summary>
+		/// Gets or sets the drawing commands defining the node in node coordinates. Setting
+		/// the geometry converts the commands to vertices, which are sent to the graphics
+		/// card again the next time the node is drawn.
+		/// </summary>
+		property GLCommandBuffer ^ Geometry
+		{
+			virtual GLCommandBuffer ^ get(void) { return mGeometry; }
+			virtual void set(GLCommandBuffer ^ value)
+			{
+				if (value == nullptr)
+				{
+					mTriangles->count = 0;
+					mLines->count = 0;
+					mHasBounds = false;
+				}
+				else
+				{
+					// Capture into new buffers so that the node is unchanged if the commands are invalid
+					LitBuffer * triangles = _CreateLitBuffer();
+					LitBuffer * lines = _CreateLitBuffer();
+					float x1 = 0, y1 = 0, z1 = 0, x2 = 0, y2 = 0, z2 = 0;
+					try
+					{
+						mHasBounds = GLGraphics3D::CaptureCommands(value, triangles, lines, x1, y1, z1, x2, y2, z2);
+					}
+					catch (Exception ^)
+					{
+						_DestroyLitBuffer(triangles);
+						_DestroyLitBuffer(lines);
+						throw;
+					}
+					_DestroyLitBuffer(mTriangles);
+					_DestroyLitBuffer(mLines);
+					mTriangles = triangles;
+					mLines = lines;
+					xmin = x1; ymin = y1; zmin = z1;
+					xmax = x2; ymax = y2; zmax = z2;
+				}
+				mGeometry = value;
+				mVersion++;
+			}
+		}
+		/// <summary>
+		/// Gets or sets the transformation of the node relative to its parent, as a
+		/// column-major 4x4 matrix in the layout used by glMultMatrixf. Elements of the
+		/// array can be modified in place.
+		/// </summary>
+		property array<float> ^ Transform
+		{
+			virtual array<float> ^ get(void) { return mTransform; }
+			virtual void set(array<float> ^ value)
+			{
+				if (value == nullptr) throw gcnew ArgumentNullException(L"value");
+				if (value->Length != 16) throw gcnew ArgumentException(L"The transformation matrix must have 16 elements.", L"value");
+				mTransform = value;
+			}
+		}
+		/// <summary>
+		/// Determines whether the node and its children are drawn.
+		/// </summary>
+		property bool Visible
+		{
+			virtual bool get(void) { return mVisible; }
+			virtual void set(bool value) { mVisible = value; }
+		}
+		/// <summary>
+		/// Determines whether the filled triangles of the node hide the nodes behind it when
+		/// occlusion culling is enabled. Large objects such as walls, floors and equipment
+		/// housings make good occluders.
+		/// </summary>
+		property bool Occluder
+		{
+			virtual bool get(void) { return mOccluder; }
+			virtual void set(bool value) { mOccluder = value; }
+		}
+		/// <summary>
+		/// Gets or sets the color the geometry of the node is drawn with. If set to
+		/// Color.Empty the colors of the drawing commands are used.
+		/// </summary>
+		property Drawing::Color Color
+		{
+			virtual Drawing::Color get(void) { return mColor; }
+			virtual void set(Drawing::Color value) { mColor = value; }
+		}
+		/// <summary>
+		/// Gets the child nodes, which are transformed with this node.
+		/// </summary>
+		property System::Collections::Generic::List<GLSceneNode3D ^> ^ Children
+		{
+			virtual System::Collections::Generic::List<GLSceneNode3D ^> ^ get(void) { return mChildren; }
+		}
+		/// <summary>
+		/// Gets the number of vertices of the node geometry.
+		/// </summary>
+		property int VertexCount
+		{
+			virtual int get(void) { return mTriangles->count + mLines->count; }
+		}
+
+	internal:
+		/// <summary>
+		/// Gets the triangle vertices of the node geometry.
+		/// </summary>
+		property LitBuffer * Triangles
+		{
+			LitBuffer * get(void) { return mTriangles; }
+		}
+		/// <summary>
+		/// Gets the line vertices of the node geometry.
+		/// </summary>
+		property LitBuffer * Lines
+		{
+			LitBuffer * get(void) { return mLines; }
+		}
+		/// <summary>
+		/// Gets a counter which is incremented each time the geometry changes.
+		/// </summary>
+		property int Version
+		{
+			int get(void) { return mVersion; }
+		}
+
+	// Implementation
+	public:
+		/// <summary>
+		/// Sets the translation part of the transformation matrix.
+		/// </summary>
+		/// <param name="x">X coordinate of the node origin in parent coordinates</param>
+		/// <param name="y">Y coordinate of the node origin in parent coordinates</param>
+		/// <param name="z">Z coordinate of the node origin in parent coordinates</param>
+		System::Void SetTranslation(float x, float y, float z)
+		{
+			mTransform[12] = x;
+			mTransform[13] = y;
+			mTransform[14] = z;
+		}
+
+	internal:
+		/// <summary>
+		/// Gets the bounding box of the node geometry in node coordinates.
+		/// </summary>
+		/// <returns>false if the node has no geometry</returns>
+		bool GetBounds(float % x1, float % y1, float % z1, float % x2, float % y2, float % z2)
+		{
+			x1 = xmin; y1 = ymin; z1 = zmin;
+			x2 = xmax; y2 = ymax; z2 = zmax;
+			return mHasBounds;
+		}
+	};
+
+	/// <summary>
+	/// Holds the vertex buffer object of a scene node.
+	/// </summary>
+	private ref class GLSceneGeometry3D
+	{
+	internal:
+		RenderGeometry * Geometry;
+		int Version;
+		int Frame;
+	};
+
+	/// <summary>
+	/// Represents a retained 3D scene, which is drawn by a GLCanvas3D after the Render
+	/// event when it is assigned to the Scene property of the canvas. The geometry of
+	/// the scene nodes is kept in vertex buffer objects between frames, and each node
+	/// is drawn with a single call per primitive type. Nodes are kept in a bounding
+	/// volume hierarchy which is tested against the view frustum, so nodes outside
+	/// the view are not drawn. When nodes move, the hierarchy is refitted instead of
+	/// built again. When occlusion culling is enabled, the nodes marked as occluders
+	/// are rasterized into a low resolution depth buffer on the CPU, and nodes whose
+	/// bounds are entirely behind it are not drawn. Buffers of nodes removed from the
+	/// scene are released after the next frame. A scene can be shown by one canvas
+	/// at a time.
+	/// </summary>
+	public ref class GLScene3D
+	{
+	// Member variables
+	private:
+		System::Collections::Generic::List<GLSceneNode3D ^> ^ mNodes;
+		System::Collections::Generic::Dictionary<GLSceneNode3D ^, GLSceneGeometry3D ^> ^ mCache;
+		System::Collections::Generic::List<GLSceneNode3D ^> ^ mStale;
+		System::Collections::Generic::List<GLSceneNode3D ^> ^ mItems;
+		Bvh3D * mBvh;
+		DepthBuffer3D * mDepth;
+		bool mFrustumCulling;
+		bool mOcclusionCulling;
+		bool mStructureChanged;
+		bool mMoved;
+		int mFrame;
+		int mVisited;
+
+		/// <summary>
+		/// The size of the occlusion depth buffer in pixels.
+		/// </summary>
+		static const int OcclusionWidth = 256;
+		static const int OcclusionHeight = 128;
+
+	// Constructor/destructor
+	public:
+		/// <summary>
+		/// Initializes a new empty instance of the GLScene3D class.
+		/// </summary>
+		GLScene3D()
+		{
+			mNodes = gcnew System::Collections::Generic::List<GLSceneNode3D ^>();
+			mCache = gcnew System::Collections::Generic::Dictionary<GLSceneNode3D ^, GLSceneGeometry3D ^>();
+			mStale = gcnew System::Collections::Generic::List<GLSceneNode3D ^>();
+			mItems = gcnew System::Collections::Generic::List<GLSceneNode3D ^>();
+			mBvh = _CreateBvh3D();
+			mDepth = 0;
+			mFrustumCulling = true;
+			mOcclusionCulling = false;
+			mFrame = 0;
+		}
+
+		~GLScene3D() // Dispose
+		{
+			this->!GLScene3D();
+		}
+
+	protected:
+		!GLScene3D() // Finalize
+		{
+			_DestroyBvh3D(mBvh);
+			_DestroyDepthBuffer3D(mDepth);
+			mBvh = 0;
+			mDepth = 0;
+		}
+
+	// Properties
+	public:
+		/// <summary>
+		/// Gets the top level nodes of the scene.
+		/// </summary>
+		property System::Collections::Generic::List<GLSceneNode3D ^> ^ Nodes
+		{
+			virtual System::Collections::Generic::List<GLSceneNode3D ^> ^ get(void) { return mNodes; }
+		}
+		/// <summary>
+		/// Determines whether nodes outside the view are skipped.
+		/// </summary>
+		property bool FrustumCulling
+		{
+			virtual bool get(void) { return mFrustumCulling; }
+			virtual void set(bool value) { mFrustumCulling = value; }
+		}
+		/// <summary>
+		/// Determines whether nodes hidden behind the nodes marked as occluders are skipped.
+		/// </summary>
+		property bool OcclusionCulling
+		{
+			virtual bool get(void) { return mOcclusionCulling; }
+			virtual void set(bool value) { mOcclusionCulling = value; }
+		}
+
+	// Helper methods
+	private:
+		/// <summary>
+		/// Keeps the buffers of a hidden node and its children.
+		/// </summary>
+		System::Void Touch(GLSceneNode3D ^ node)
+		{
+			GLSceneGeometry3D ^ entry;
+			if (mCache->TryGetValue(node, entry) && entry->Frame != mFrame)
+			{
+				entry->Frame = mFrame;
+				mVisited++;
+			}
+			for (int i = 0; i < node->Children->Count; i++)
+				Touch(node->Children[i]);
+		}
+		/// <summary>
+		/// Adds a node and its children to the items of the hierarchy with their world
+		/// transformations and bounds.
+		/// </summary>
+		System::Void Collect(GLSceneNode3D ^ node, const float * parent, GLGraphics3D ^ graphics)
+		{
+			if (!node->Visible)
+			{
+				Touch(node);
+				return;
+			}
+
+			float world[16];
+			pin_ptr<float> local = &node->Transform[0];
+			_MultiplyMatrix3D(world, parent, local);
+
+			float bounds[6];
+			if (node->GetBounds(bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5]))
+			{
+				// The tree is built again when the sequence of drawn nodes changes,
+				// and refitted when only their bounds change
+				int slot = mBvh->count;
+				_ReserveBvhItems3D(mBvh, slot + 1);
+				if (slot == mItems->Count)
+				{
+					mItems->Add(node);
+					mStructureChanged = true;
+				}
+				else if (mItems[slot] != node)
+				{
+					mItems[slot] = node;
+					mStructureChanged = true;
+				}
+
+				float worldBounds[6];
+				_TransformBounds3D(world, bounds, worldBounds);
+				float * itemBounds = mBvh->bounds + slot * 6;
+				if (memcmp(itemBounds, worldBounds, sizeof(worldBounds)) != 0)
+				{
+					memcpy(itemBounds, worldBounds, sizeof(worldBounds));
+					mMoved = true;
+				}
+				memcpy(mBvh->transforms + slot * 16, world, sizeof(world));
+				mBvh->count++;
+
+				graphics->IncludeBounds(worldBounds[0], worldBounds[1], worldBounds[2], worldBounds[3], worldBounds[4], worldBounds[5]);
+			}
+
+			for (int i = 0; i < node->Children->Count; i++)
+				Collect(node->Children[i], world, graphics);
+		}
+
+	// Implementation
+	internal:
+		/// <summary>
+		/// Draws the visible nodes of the scene. Buffers of nodes which are no longer
+		/// in the scene are released.
+		/// </summary>
+		/// <param name="renderer">The renderer of the canvas</param>
+		/// <param name="graphics">The graphics object receiving the model limits</param>
+		/// <param name="statistics">Receives the number of drawn primitives and vertices</param>
+		/// <param name="projection">The column-major projection matrix of the camera</param>
+		/// <param name="modelview">The column-major modelview matrix of the camera</param>
+		System::Void Render(Renderer * renderer, GLGraphics3D ^ graphics, GLRenderStatistics ^ statistics, const float * projection, const float * modelview)
+		{
+			const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+			mFrame++;
+			mVisited = 0;
+			mStructureChanged = false;
+			mMoved = false;
+			mBvh->count = 0;
+			for (int i = 0; i < mNodes->Count; i++)
+				Collect(mNodes[i], identity, graphics);
+
+			int count = mBvh->count;
+			if (mItems->Count > count)
+			{
+				mItems->RemoveRange(count, mItems->Count - count);
+				mStructureChanged = true;
+			}
+			if (mStructureChanged)
+				_BuildBvh3D(mBvh);
+			else if (mMoved)
+				_RefitBvh3D(mBvh);
+
+			if (mFrustumCulling && count != 0)
+			{
+				float planes[24];
+				_GetFrustumPlanes(projection, modelview, planes);
+				_CullBvh3D(mBvh, planes);
+			}
+			else if (count != 0)
+				memset(mBvh->visible, 1, count);
+
+			// Rasterize the visible occluders, then test the hierarchy against them
+			if (mOcclusionCulling && count != 0)
+			{
+				if (mDepth == 0) mDepth = _CreateDepthBuffer3D(OcclusionWidth, OcclusionHeight);
+				_ClearDepthBuffer3D(mDepth, projection, modelview);
+				bool occluders = false;
+				for (int i = 0; i < count; i++)
+				{
+					if (mBvh->visible[i] == 0 || !mItems[i]->Occluder) continue;
+					LitBuffer * triangles = mItems[i]->Triangles;
+					_RasterizeOccluder3D(mDepth, mBvh->transforms + i * 16, triangles->data, triangles->count);
+					occluders = true;
+				}
+				if (occluders) _CullOccluded3D(mDepth, mBvh);
+			}
+
+			graphics->LineWidth = 1.0f;
+			int culled = 0;
+			for (int i = 0; i < count; i++)
+			{
+				GLSceneNode3D ^ node = mItems[i];
+				GLSceneGeometry3D ^ entry;
+				if (!mCache->TryGetValue(node, entry))
+				{
+					entry = gcnew GLSceneGeometry3D();
+					mCache->Add(node, entry);
+				}
+				if (entry->Frame != mFrame)
+				{
+					entry->Frame = mFrame;
+					mVisited++;
+				}
+				if (mBvh->visible[i] == 0)
+				{
+					culled++;
+					continue;
+				}
+
+				// Upload the geometry the first time the node is drawn and after it changes
+				if (entry->Geometry == 0 || entry->Version != node->Version)
+				{
+					LitBuffer * triangles = node->Triangles;
+					LitBuffer * lines = node->Lines;
+					_DestroyRenderGeometry(entry->Geometry);
+					entry->Geometry = _CreateRenderGeometry(renderer, triangles->data, triangles->count, lines->data, lines->count);
+					entry->Version = node->Version;
+				}
+
+				Drawing::Color color = node->Color;
+				_RenderGeometry(renderer, entry->Geometry, RENDERGEOMETRY_ALL, mBvh->transforms + i * 16, !color.IsEmpty, GLVertexArray::PackColor(color));
+				statistics->AddCounts(node->Triangles->count / 3 + node->Lines->count / 2, node->VertexCount);
+			}
+			statistics->AddCulled(culled);
+
+			// Release the buffers of removed nodes
+			if (mVisited == mCache->Count) return;
+			for each (System::Collections::Generic::KeyValuePair<GLSceneNode3D ^, GLSceneGeometry3D ^> pair in mCache)
+			{
+				if (pair.Value->Frame != mFrame) mStale->Add(pair.Key);
+			}
+			for (int i = 0; i < mStale->Count; i++)
+			{
+				_DestroyRenderGeometry(mCache[mStale[i]]->Geometry);
+				mCache->Remove(mStale[i]);
+			}
+			mStale->Clear();
+		}
+		/// <summary>
+		/// Releases all vertex buffer objects. The OpenGL context the scene was drawn
+		/// with must be current.
+		/// </summary>
+		System::Void Release()
+		{
+			for each (GLSceneGeometry3D ^ entry in mCache->Values)
+				_DestroyRenderGeometry(entry->Geometry);
+			mCache->Clear();
+		}
+	};
+
+}
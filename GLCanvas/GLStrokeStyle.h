@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Stroker.h"
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Represents the shape drawn where two segments of a thick polyline meet.
+	/// </summary>
+	public enum class GLLineJoin
+	{
+		/// <summary>
+		/// The outer edges of the segments are extended until they meet. Joins sharper
+		/// than the miter limit of the graphics object are beveled.
+		/// </summary>
+		Miter = LINEJOIN_MITER,
+		/// <summary>
+		/// The outer corners of the segments are connected by a straight edge.
+		/// </summary>
+		Bevel = LINEJOIN_BEVEL,
+		/// <summary>
+		/// The outer corners of the segments are connected by a circular arc.
+		/// </summary>
+		Round = LINEJOIN_ROUND
+	};
+
+	/// <summary>
+	/// Represents the shape drawn at the ends of a thick polyline.
+	/// </summary>
+	public enum class GLLineCap
+	{
+		/// <summary>
+		/// The line ends at its end points.
+		/// </summary>
+		Flat = LINECAP_FLAT,
+		/// <summary>
+		/// The line is extended past its end points by half its thickness.
+		/// </summary>
+		Square = LINECAP_SQUARE,
+		/// <summary>
+		/// The line ends with a half circle around its end points.
+		/// </summary>
+		Round = LINECAP_ROUND
+	};
+
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "TimeSeries.h"
+
+using namespace System;
+
+namespace GLCanvas {
+
+	/// <summary>
+	/// Represents a stream of regularly sampled values, such as a telemetry channel,
+	/// drawn as a line against time. The last Capacity samples are kept in a ring
+	/// buffer with a min/max pyramid. Appending writes only the new samples, and
+	/// drawing reduces the visible samples to about two vertices per pixel column,
+	/// so the cost of a frame does not depend on the number of samples.
+	/// A time series must not be appended to while it is being drawn.
+	/// </summary>
+	public ref class GLTimeSeries
+	{
+	// Member variables
+	private:
+		TimeSeries * mSeries;
+		double mOrigin;
+		double mInterval;
+
+	// Constructor/destructor
+	public:
+		/// <summary>
+		/// Initializes a new instance of the GLTimeSeries class.
+		/// </summary>
+		/// <param name="capacity">Number of samples to retain; rounded up to a power of two</param>
+		/// <param name="origin">X coordinate of the first sample</param>
+		/// <param name="interval">Distance between the X coordinates of consecutive samples</param>
+		GLTimeSeries(int capacity, double origin, double interval)
+		{
+			if (capacity < 1) throw gcnew ArgumentOutOfRangeException(L"capacity");
+			if (!(interval > 0)) throw gcnew ArgumentOutOfRangeException(L"interval");
+
+			mSeries = _CreateTimeSeries(capacity);
+			mOrigin = origin;
+			mInterval = interval;
+		}
+
+		~GLTimeSeries() // Dispose
+		{
+			this->!GLTimeSeries();
+		}
+
+	protected:
+		!GLTimeSeries() // Finalize
+		{
+			_DestroyTimeSeries(mSeries);
+			mSeries = 0;
+		}
+
+	// Properties
+	public:
+		/// <summary>
+		/// Gets the number of samples retained.
+		/// </summary>
+		property int Capacity
+		{
+			virtual int get(void) { return _TimeSeriesCapacity(mSeries); }
+		}
+		/// <summary>
+		/// Gets the number of samples appended since the series was created or cleared.
+		/// </summary>
+		property Int64 Count
+		{
+			virtual Int64 get(void) { return _TimeSeriesCount(mSeries); }
+		}
+		/// <summary>
+		/// Gets or sets the X coordinate of the first sample.
+		/// </summary>
+		property double Origin
+		{
+			virtual double get(void) { return mOrigin; }
+			virtual void set(double value) { mOrigin = value; }
+		}
+		/// <summary>
+		/// Gets the distance between the X coordinates of consecutive samples.
+		/// </summary>
+		property double Interval
+		{
+			virtual double get(void) { return mInterval; }
+		}
+		/// <summary>
+		/// Gets the bounding rectangle of the retained samples.
+		/// </summary>
+		property Drawing::RectangleF Bounds
+		{
+			virtual Drawing::RectangleF get(void)
+			{
+				float lower, upper;
+				if (!_TimeSeriesRange(mSeries, &lower, &upper)) return Drawing::RectangleF::Empty;
+				Int64 count = Count;
+				Int64 first = Math::Max(count - Capacity, (Int64)0);
+				float x1 = (float)(mOrigin + (double)first * mInterval);
+				float x2 = (float)(mOrigin + (double)(count - 1) * mInterval);
+				return Drawing::RectangleF(x1, lower, x2 - x1, upper - lower);
+			}
+		}
+
+	internal:
+		/// <summary>
+		/// Gets the native time series.
+		/// </summary>
+		property TimeSeries * Series
+		{
+			TimeSeries * get(void) { return mSeries; }
+		}
+
+	// Implementation
+	public:
+		/// <summary>
+		/// Appends a sample.
+		/// </summary>
+		/// <param name="value">The sample value</param>
+		System::Void Append(float value)
+		{
+			_AppendSamples(mSeries, &value, 1);
+		}
+		/// <summary>
+		/// Appends samples.
+		/// </summary>
+		/// <param name="values">The sample values</param>
+		System::Void Append(array<float> ^ values)
+		{
+			if (values == nullptr) throw gcnew ArgumentNullException(L"values");
+
+			Append(values, 0, values->Length);
+		}
+		/// <summary>
+		/// Appends a range of samples.
+		/// </summary>
+		/// <param name="values">The sample values</param>
+		/// <param name="offset">Index of the first value to append</param>
+		/// <param name="count">Number of values to append</param>
+		System::Void Append(array<float> ^ values, int offset, int count)
+		{
+			if (values == nullptr) throw gcnew ArgumentNullException(L"values");
+			if (offset < 0 || count < 0 || offset + count > values->Length) throw gcnew ArgumentOutOfRangeException(L"count");
+			if (count == 0) return;
+
+			pin_ptr<float> pinned = &values[offset];
+			_AppendSamples(mSeries, pinned, count);
+		}
+		/// <summary>
+		/// Appends samples stored in native memory.
+		/// </summary>
+		/// <param name="values">Address of the first float value</param>
+		/// <param name="count">Number of values to append</param>
+		System::Void Append(IntPtr values, int count)
+		{
+			if (values == IntPtr::Zero && count != 0) throw gcnew ArgumentNullException(L"values");
+			if (count < 0) throw gcnew ArgumentOutOfRangeException(L"count");
+
+			_AppendSamples(mSeries, (const float *)values.ToPointer(), count);
+		}
+		/// <summary>
+		/// Removes all samples. The next sample appended is placed at Origin.
+		/// </summary>
+		System::Void Clear()
+		{
+			_ClearTimeSeries(mSeries);
+		}
+	};
+
+}
@@ -2,45 +2,58 @@
 
 #include <windows.h>
 #include <GL/gl.h>
+#include "Renderer.h"
 
 using namespace System;
 
 namespace GLCanvas {
 
 	/// <summary>
-	/// Represents a vertex array.
+	/// Represents a vertex array. Vertices are kept in native memory
+	/// which is reused between frames. Arrays of line strips, line loops and
+	/// triangle strips hold many strips, which are drawn with a single call.
 	/// </summary>
 	private ref class GLVertexArray
 	{
-	private:
-		// Custom vertex class
-		value class GLColorVertex {
-		public:
-			float x, y, z;
-			float r, g, b, a;
-		};
-
 	// Constructor/destructor
 	public:
-		GLVertexArray(GLenum Type) 
-		{ 
-			mVertices = gcnew System::Collections::Generic::List<GLColorVertex>;
+		GLVertexArray(GLenum Type)
+		{
+			mBuffer = _CreateVertexBuffer();
 			mType = Type;
+			mStrips = 0;
+			if (Type == GL_LINE_STRIP || Type == GL_LINE_LOOP || Type == GL_TRIANGLE_STRIP || Type == GL_TRIANGLE_FAN)
+				mStrips = _CreateStripList();
+		}
+
+		~GLVertexArray() // Dispose
+		{
+			this->!GLVertexArray();
+		}
+
+		!GLVertexArray() // Finalize
+		{
+			_DestroyVertexBuffer(mBuffer);
+			_DestroyStripList(mStrips);
+			mBuffer = 0;
+			mStrips = 0;
 		}
 
 	// Member variables
 	private:
-		System::Collections::Generic::List<GLColorVertex>^ mVertices;
+		VertexBuffer * mBuffer;
+		StripList * mStrips;
 		GLenum mType;
 
 	// Implementation
 	public:
 		/// <summary>
-		/// Clears all vertices.
+		/// Clears all vertices. The memory allocated for the array is retained.
 		/// </summary>
 		System::Void Clear()
 		{
-			mVertices->Clear();
+			mBuffer->count = 0;
+			if (mStrips != 0) mStrips->count = 0;
 		}
 		/// <summary>
 		/// Adds a new vertex to the array.
@@ -48,63 +61,42 @@ namespace GLCanvas {
 		/// <param name="x">X coordinate</param>
 		/// <param name="y">Y coordinate</param>
 		/// <param name="z">Z coordinate</param>
-		/// <param name="r">Red color component</param>
-		/// <param name="g">Green color component</param>
-		/// <param name="b">Blue color component</param>
-		/// <param name="a">Alpha color component</param>
-		System::Void AddVertex(float x, float y, float z, float r, float g, float b, float a)
+		/// <param name="color">Vertex color</param>
+		System::Void AddVertex(float x, float y, float z, Drawing::Color color)
 		{
-			GLColorVertex v;
+			if (mBuffer->count == mBuffer->capacity) _ReserveVertices(mBuffer, mBuffer->count + 1);
+			ColorVertex & v = mBuffer->data[mBuffer->count++];
 			v.x = x;
 			v.y = y;
 			v.z = z;
-			v.r = r;
-			v.g = g;
-			v.b = b;
-			v.a = a;
-
-			mVertices->Add(v);
+			v.color = PackColor(color);
 		}
 		/// <summary>
-		/// Adds a new vertex to the array.
+		/// Ends the current strip. The vertices added since the previous strip ended
+		/// form a new strip. Only valid for arrays of strips, loops or fans.
 		/// </summary>
-		/// <param name="x">X coordinate</param>
-		/// <param name="y">Y coordinate</param>
-		/// <param name="z">Z coordinate</param>
-		/// <param name="color">Vertex color</param>
-		System::Void AddVertex(float x, float y, float z, Drawing::Color color)
+		System::Void EndStrip()
 		{
-			AddVertex(x, y, z, (float)color.R / 256.0f, (float)color.G / 256.0f, (float)color.B / 256.0f, (float)color.A / 256.0f);
+			int first = 0;
+			if (mStrips->count != 0) first = mStrips->firsts[mStrips->count - 1] + mStrips->counts[mStrips->count - 1];
+			_EndStrip(mBuffer, mStrips, first);
 		}
-
 		/// <summary>
-		/// Renders the vertex array.
+		/// Packs the given color into R, G, B, A bytes.
 		/// </summary>
-		System::Void Render()
+		/// <param name="color">Color to pack</param>
+		static unsigned int PackColor(Drawing::Color color)
 		{
-			float * vp = new float[mVertices->Count * 3];
-			float * cp = new float[mVertices->Count * 4];
-
-			for (int j = 0; j < mVertices->Count; j++)
-			{
-				vp[j * 3] = mVertices[j].x;
-				vp[j * 3 + 1] = mVertices[j].y;
-				vp[j * 3 + 2] = mVertices[j].z;
-				cp[j * 4] = mVertices[j].r;
-				cp[j * 4 + 1] = mVertices[j].g;
-				cp[j * 4 + 2] = mVertices[j].b;
-				cp[j * 4 + 3] = mVertices[j].a;
-			}
-
-			glLoadIdentity();
-			glVertexPointer(3, GL_FLOAT, 3 * sizeof(float), vp);
-			glColorPointer(4, GL_FLOAT, 4 * sizeof(float), cp);
-			glDrawArrays(mType, 0, mVertices->Count);
+			return (unsigned int)color.R | ((unsigned int)color.G << 8) | ((unsigned int)color.B << 16) | ((unsigned int)color.A << 24);
+		}
 
-			delete[] vp;
-			vp = 0;
-			delete[] cp;
-			cp = 0;
+		/// <summary>
+		/// Renders the vertex array with the transform of the given renderer.
+		/// </summary>
+		/// <param name="renderer">The renderer of the canvas</param>
+		System::Void Render(Renderer * renderer)
+		{
+			_RenderColorVertices(renderer, mType, mBuffer->data, mBuffer->count, mStrips);
 		}
 
 	// Properties
@@ -114,15 +106,23 @@ namespace GLCanvas {
 		/// </summary>
 		property int Count
 		{
-			virtual int get(void) { return mVertices->Count; }
+			virtual int get(void) { return mBuffer->count; }
+		}
+
+	internal:
+		/// <summary>
+		/// Gets the native vertex storage.
+		/// </summary>
+		property VertexBuffer * Buffer
+		{
+			VertexBuffer * get(void) { return mBuffer; }
 		}
 		/// <summary>
-		/// Gets the vertex at the given index.
+		/// Gets the vertex ranges of the strips, or null if the array is not made of strips.
 		/// </summary>
-		/// <param name="index">Item index</param>
-		property GLColorVertex Vertex[int]
+		property StripList * Strips
 		{
-			virtual GLColorVertex get(int index) { return mVertices[index]; }
+			StripList * get(void) { return mStrips; }
 		}
 
 	};
@@ -0,0 +1,421 @@
+// Native code, compiled without /clr.
+
+#include "GeometryKernels.h"
+
+#include <immintrin.h>
+#include <intrin.h>
+#include <math.h>
+
+namespace
+{
+	// Number of triangles or segments processed at once by the kernels working in chunks
+	const int ChunkSize = 256;
+
+	// Instruction set used by the kernels, or -1 before it is detected
+	int gSimdLevel = -1;
+
+	inline int Min(int a, int b) { return a < b ? a : b; }
+	inline int Max(int a, int b) { return a > b ? a : b; }
+	inline float Min(float a, float b) { return a < b ? a : b; }
+	inline float Max(float a, float b) { return a > b ? a : b; }
+
+	// Returns the widest instruction set supported by the processor and the operating system
+	int DetectSimdLevel()
+	{
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 1) return SIMDLEVEL_SCALAR;
+		__cpuid(info, 1);
+		bool sse = ((info[3] & (1 << 25)) != 0);
+
+		// The operating system must also save the AVX registers on context switches
+		bool avx = ((info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6);
+		return (avx ? SIMDLEVEL_AVX : (sse ? SIMDLEVEL_SSE : SIMDLEVEL_SCALAR));
+	}
+
+	inline int Level()
+	{
+		if (gSimdLevel < 0) gSimdLevel = DetectSimdLevel();
+		return gSimdLevel;
+	}
+
+	inline const float * At(const char * bytes, int stride, size_t index)
+	{
+		return (const float *)(bytes + index * stride);
+	}
+
+	// Bounds
+
+	void BoundsScalar(const char * bytes, int stride, int first, int count, int components, float * lower, float * upper)
+	{
+		for (int i = first; i < count; i++)
+		{
+			const float * v = At(bytes, stride, i);
+			for (int j = 0; j < components; j++)
+			{
+				if (v[j] < lower[j]) lower[j] = v[j];
+				if (v[j] > upper[j]) upper[j] = v[j];
+			}
+		}
+	}
+
+	// Merges the first components lanes of SIMD bounds into the bounds
+	void MergeBounds(__m128 lo, __m128 hi, int components, float * lower, float * upper)
+	{
+		float l[4], h[4];
+		_mm_storeu_ps(l, lo);
+		_mm_storeu_ps(h, hi);
+		for (int j = 0; j < components; j++)
+		{
+			lower[j] = Min(lower[j], l[j]);
+			upper[j] = Max(upper[j], h[j]);
+		}
+	}
+
+	// Vertices are loaded four floats at a time, reading into the next vertex, so the
+	// last vertex is left to the scalar loop. Strides are at least two floats, so no
+	// load runs past the end of the buffer. Returns the number of vertices processed.
+	int BoundsSse(const char * bytes, int stride, int count, int components, float * lower, float * upper)
+	{
+		int last = count - 1;
+		if (last < 1) return 0;
+
+		__m128 lo = _mm_loadu_ps(At(bytes, stride, 0)), hi = lo;
+		for (int i = 1; i < last; i++)
+		{
+			__m128 v = _mm_loadu_ps(At(bytes, stride, i));
+			lo = _mm_min_ps(lo, v);
+			hi = _mm_max_ps(hi, v);
+		}
+		MergeBounds(lo, hi, components, lower, upper);
+		return last;
+	}
+
+	// Two vertices are loaded into the halves of each register
+	int BoundsAvx(const char * bytes, int stride, int count, int components, float * lower, float * upper)
+	{
+		int last = count - 1;
+		if (last < 1) return 0;
+
+		__m128 first = _mm_loadu_ps(At(bytes, stride, 0));
+		__m256 lo = _mm256_insertf128_ps(_mm256_castps128_ps256(first), first, 1), hi = lo;
+		int i = 1;
+		for (; i + 1 < last; i += 2)
+		{
+			__m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(At(bytes, stride, i))), _mm_loadu_ps(At(bytes, stride, i + 1)), 1);
+			lo = _mm256_min_ps(lo, v);
+			hi = _mm256_max_ps(hi, v);
+		}
+		__m128 lo4 = _mm_min_ps(_mm256_castps256_ps128(lo), _mm256_extractf128_ps(lo, 1));
+		__m128 hi4 = _mm_max_ps(_mm256_castps256_ps128(hi), _mm256_extractf128_ps(hi, 1));
+		for (; i < last; i++)
+		{
+			__m128 v = _mm_loadu_ps(At(bytes, stride, i));
+			lo4 = _mm_min_ps(lo4, v);
+			hi4 = _mm_max_ps(hi4, v);
+		}
+		_mm256_zeroupper();
+		MergeBounds(lo4, hi4, components, lower, upper);
+		return last;
+	}
+
+	// Face normals
+
+	void FaceNormalsScalar(const char * bytes, int stride, const unsigned int * indices, int first, int count, float * normals)
+	{
+		for (int t = first; t < count; t++)
+		{
+			const float * a = At(bytes, stride, indices[t * 3]);
+			const float * b = At(bytes, stride, indices[t * 3 + 1]);
+			const float * c = At(bytes, stride, indices[t * 3 + 2]);
+			float ux = b[0] - a[0], uy = b[1] - a[1], uz = b[2] - a[2];
+			float wx = c[0] - a[0], wy = c[1] - a[1], wz = c[2] - a[2];
+			normals[t * 3] = uy * wz - uz * wy;
+			normals[t * 3 + 1] = uz * wx - ux * wz;
+			normals[t * 3 + 2] = ux * wy - uy * wx;
+		}
+	}
+
+	// Loads one coordinate of one corner of four consecutive triangles
+	inline __m128 Gather4(const char * bytes, int stride, const unsigned int * indices, int corner, int component)
+	{
+		return _mm_set_ps(At(bytes, stride, indices[9 + corner])[component], At(bytes, stride, indices[6 + corner])[component],
+			At(bytes, stride, indices[3 + corner])[component], At(bytes, stride, indices[corner])[component]);
+	}
+
+	// Corners are gathered into one register per coordinate, four triangles at a time
+	int FaceNormalsSse(const char * bytes, int stride, const unsigned int * indices, int count, float * normals)
+	{
+		int t = 0;
+		for (; t + 4 <= count; t += 4)
+		{
+			const unsigned int * i = indices + t * 3;
+			__m128 ax = Gather4(bytes, stride, i, 0, 0), ay = Gather4(bytes, stride, i, 0, 1), az = Gather4(bytes, stride, i, 0, 2);
+			__m128 ux = _mm_sub_ps(Gather4(bytes, stride, i, 1, 0), ax);
+			__m128 uy = _mm_sub_ps(Gather4(bytes, stride, i, 1, 1), ay);
+			__m128 uz = _mm_sub_ps(Gather4(bytes, stride, i, 1, 2), az);
+			__m128 wx = _mm_sub_ps(Gather4(bytes, stride, i, 2, 0), ax);
+			__m128 wy = _mm_sub_ps(Gather4(bytes, stride, i, 2, 1), ay);
+			__m128 wz = _mm_sub_ps(Gather4(bytes, stride, i, 2, 2), az);
+
+			float x[4], y[4], z[4];
+			_mm_storeu_ps(x, _mm_sub_ps(_mm_mul_ps(uy, wz), _mm_mul_ps(uz, wy)));
+			_mm_storeu_ps(y, _mm_sub_ps(_mm_mul_ps(uz, wx), _mm_mul_ps(ux, wz)));
+			_mm_storeu_ps(z, _mm_sub_ps(_mm_mul_ps(ux, wy), _mm_mul_ps(uy, wx)));
+			float * n = normals + t * 3;
+			for (int k = 0; k < 4; k++)
+			{
+				n[k * 3] = x[k];
+				n[k * 3 + 1] = y[k];
+				n[k * 3 + 2] = z[k];
+			}
+		}
+		return t;
+	}
+
+	// Normalization
+
+	void NormalizeScalar(LitVertex * vertices, int first, int count)
+	{
+		for (int i = first; i < count; i++)
+		{
+			LitVertex & v = vertices[i];
+			float length = sqrtf(v.nx * v.nx + v.ny * v.ny + v.nz * v.nz);
+			if (length == 0.0f) continue;
+			v.nx /= length;
+			v.ny /= length;
+			v.nz /= length;
+		}
+	}
+
+	// Four normals are loaded with the colors that follow them and transposed, so that
+	// each register holds one coordinate. The colors are moved without arithmetic and
+	// written back unchanged.
+	int NormalizeSse(LitVertex * vertices, int count)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			float * p0 = &vertices[i].nx, * p1 = &vertices[i + 1].nx, * p2 = &vertices[i + 2].nx, * p3 = &vertices[i + 3].nx;
+			__m128 x = _mm_loadu_ps(p0), y = _mm_loadu_ps(p1), z = _mm_loadu_ps(p2), c = _mm_loadu_ps(p3);
+			_MM_TRANSPOSE4_PS(x, y, z, c);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+			__m128 valid = _mm_cmpneq_ps(length, zero);
+			x = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(x, length)), _mm_andnot_ps(valid, x));
+			y = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(y, length)), _mm_andnot_ps(valid, y));
+			z = _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(z, length)), _mm_andnot_ps(valid, z));
+			_MM_TRANSPOSE4_PS(x, y, z, c);
+			_mm_storeu_ps(p0, x);
+			_mm_storeu_ps(p1, y);
+			_mm_storeu_ps(p2, z);
+			_mm_storeu_ps(p3, c);
+		}
+		return i;
+	}
+
+	// Transforms
+
+	void TransformScalar(const float * m, const char * bytes, int stride, int first, int count, float * result)
+	{
+		for (int i = first; i < count; i++)
+		{
+			const float * p = At(bytes, stride, i);
+			float * r = result + (size_t)i * 4;
+			for (int k = 0; k < 4; k++)
+				r[k] = m[k] * p[0] + m[4 + k] * p[1] + m[8 + k] * p[2] + m[12 + k];
+		}
+	}
+
+	// Each point is multiplied with the matrix columns held in four registers
+	int TransformSse(const float * m, const char * bytes, int stride, int count, float * result)
+	{
+		__m128 c0 = _mm_loadu_ps(m), c1 = _mm_loadu_ps(m + 4), c2 = _mm_loadu_ps(m + 8), c3 = _mm_loadu_ps(m + 12);
+		for (int i = 0; i < count; i++)
+		{
+			const float * p = At(bytes, stride, i);
+			__m128 r = _mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p[0])), _mm_mul_ps(c1, _mm_set1_ps(p[1])));
+			r = _mm_add_ps(_mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(p[2]))), c3);
+			_mm_storeu_ps(result + (size_t)i * 4, r);
+		}
+		return count;
+	}
+
+	inline __m256 Repeat2(const float * v)
+	{
+		__m128 r = _mm_loadu_ps(v);
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(r), r, 1);
+	}
+
+	inline __m256 Broadcast2(float a, float b)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(a)), _mm_set1_ps(b), 1);
+	}
+
+	// Two points are transformed at a time with the columns repeated in both halves
+	int TransformAvx(const float * m, const char * bytes, int stride, int count, float * result)
+	{
+		__m256 c0 = Repeat2(m), c1 = Repeat2(m + 4), c2 = Repeat2(m + 8), c3 = Repeat2(m + 12);
+		int i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			const float * p = At(bytes, stride, i), * q = At(bytes, stride, i + 1);
+			__m256 r = _mm256_add_ps(_mm256_mul_ps(c0, Broadcast2(p[0], q[0])), _mm256_mul_ps(c1, Broadcast2(p[1], q[1])));
+			r = _mm256_add_ps(_mm256_add_ps(r, _mm256_mul_ps(c2, Broadcast2(p[2], q[2]))), c3);
+			_mm256_storeu_ps(result + (size_t)i * 4, r);
+		}
+		_mm256_zeroupper();
+		return i;
+	}
+
+	// Wide lines
+
+	// Computes the offset of the long edges of each segment from its center line
+	void OffsetsScalar(const ColorVertex * v, int step, int first, int count, float halfWidth, float * ox, float * oy)
+	{
+		for (int i = first; i < count; i++)
+		{
+			const ColorVertex & p = v[i * step], & q = v[i * step + 1];
+			float dx = q.x - p.x, dy = q.y - p.y;
+			float length = sqrtf(dx * dx + dy * dy);
+			float k = (length > 0.0f ? halfWidth / length : 0.0f);
+			ox[i] = -dy * k;
+			oy[i] = dx * k;
+		}
+	}
+
+	int OffsetsSse(const ColorVertex * v, int step, int count, float halfWidth, float * ox, float * oy)
+	{
+		const __m128 zero = _mm_setzero_ps(), sign = _mm_set1_ps(-0.0f), width = _mm_set1_ps(halfWidth);
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const ColorVertex * s = v + i * step;
+			__m128 px = _mm_set_ps(s[3 * step].x, s[2 * step].x, s[step].x, s[0].x);
+			__m128 py = _mm_set_ps(s[3 * step].y, s[2 * step].y, s[step].y, s[0].y);
+			__m128 dx = _mm_sub_ps(_mm_set_ps(s[3 * step + 1].x, s[2 * step + 1].x, s[step + 1].x, s[1].x), px);
+			__m128 dy = _mm_sub_ps(_mm_set_ps(s[3 * step + 1].y, s[2 * step + 1].y, s[step + 1].y, s[1].y), py);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+			__m128 k = _mm_and_ps(_mm_cmpgt_ps(length, zero), _mm_div_ps(width, length));
+			_mm_storeu_ps(ox + i, _mm_mul_ps(_mm_xor_ps(dy, sign), k));
+			_mm_storeu_ps(oy + i, _mm_mul_ps(dx, k));
+		}
+		return i;
+	}
+
+	inline void SetVertex(ColorVertex & v, float x, float y, float z, unsigned int color)
+	{
+		v.x = x;
+		v.y = y;
+		v.z = z;
+		v.color = color;
+	}
+}
+
+int _GetSimdLevel()
+{
+	return Level();
+}
+
+void _SetSimdLevel(int level)
+{
+	int supported = DetectSimdLevel();
+	gSimdLevel = (level < SIMDLEVEL_SCALAR ? SIMDLEVEL_SCALAR : (level > supported ? supported : level));
+}
+
+bool _StridedBounds(const void * data, int count, int stride, int components, float * lower, float * upper)
+{
+	if (data == 0 || count <= 0) return false;
+
+	const char * bytes = (const char *)data;
+	const float * first = (const float *)bytes;
+	for (int j = 0; j < components; j++)
+		lower[j] = upper[j] = first[j];
+
+	int done = 1;
+	int level = (stride >= 2 * (int)sizeof(float) ? Level() : SIMDLEVEL_SCALAR);
+	if (level == SIMDLEVEL_AVX)
+		done = Max(done, BoundsAvx(bytes, stride, count, components, lower, upper));
+	else if (level == SIMDLEVEL_SSE)
+		done = Max(done, BoundsSse(bytes, stride, count, components, lower, upper));
+	BoundsScalar(bytes, stride, done, count, components, lower, upper);
+	return true;
+}
+
+void _FaceNormals3D(const float * positions, int stride, const unsigned int * indices, int triangleCount, float * normals)
+{
+	const char * bytes = (const char *)positions;
+	// Gathering corners costs more than eight wide arithmetic saves, so AVX is not used
+	int done = (Level() >= SIMDLEVEL_SSE ? FaceNormalsSse(bytes, stride, indices, triangleCount, normals) : 0);
+	FaceNormalsScalar(bytes, stride, indices, done, triangleCount, normals);
+}
+
+void _SmoothNormals3D(LitVertex * vertices, int vertexCount, const unsigned int * indices, int indexCount)
+{
+	for (int i = 0; i < vertexCount; i++)
+		vertices[i].nx = vertices[i].ny = vertices[i].nz = 0.0f;
+
+	// Face normals are computed a chunk at a time and added to the corners
+	float normals[ChunkSize * 3];
+	int triangleCount = indexCount / 3;
+	for (int first = 0; first < triangleCount; first += ChunkSize)
+	{
+		int count = Min(ChunkSize, triangleCount - first);
+		const unsigned int * chunk = indices + first * 3;
+		_FaceNormals3D(&vertices->x, sizeof(LitVertex), chunk, count, normals);
+		for (int t = 0; t < count; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				LitVertex & v = vertices[chunk[t * 3 + k]];
+				v.nx += normals[t * 3];
+				v.ny += normals[t * 3 + 1];
+				v.nz += normals[t * 3 + 2];
+			}
+		}
+	}
+
+	int done = (Level() >= SIMDLEVEL_SSE ? NormalizeSse(vertices, vertexCount) : 0);
+	NormalizeScalar(vertices, done, vertexCount);
+}
+
+void _TransformPoints3D(const float * matrix, const float * points, int stride, int count, float * result)
+{
+	const char * bytes = (const char *)points;
+	int done = 0;
+	int level = Level();
+	if (level == SIMDLEVEL_AVX)
+		done = TransformAvx(matrix, bytes, stride, count, result);
+	else if (level == SIMDLEVEL_SSE)
+		done = TransformSse(matrix, bytes, stride, count, result);
+	TransformScalar(matrix, bytes, stride, done, count, result);
+}
+
+void _ExpandLines2D(const ColorVertex * vertices, int segmentCount, int step, float halfWidth, VertexBuffer * triangles)
+{
+	if (segmentCount <= 0) return;
+	if (triangles->count + segmentCount * 6 > triangles->capacity) _ReserveVertices(triangles, triangles->count + segmentCount * 6);
+
+	float ox[ChunkSize], oy[ChunkSize];
+	ColorVertex * out = triangles->data + triangles->count;
+	for (int first = 0; first < segmentCount; first += ChunkSize)
+	{
+		int count = Min(ChunkSize, segmentCount - first);
+		const ColorVertex * v = vertices + (size_t)first * step;
+		int done = (Level() >= SIMDLEVEL_SSE ? OffsetsSse(v, step, count, halfWidth, ox, oy) : 0);
+		OffsetsScalar(v, step, done, count, halfWidth, ox, oy);
+
+		for (int i = 0; i < count; i++)
+		{
+			const ColorVertex & p = v[i * step], & q = v[i * step + 1];
+			ColorVertex * quad = out + (size_t)(first + i) * 6;
+			SetVertex(quad[0], p.x + ox[i], p.y + oy[i], p.z, p.color);
+			SetVertex(quad[1], p.x - ox[i], p.y - oy[i], p.z, p.color);
+			SetVertex(quad[2], q.x - ox[i], q.y - oy[i], q.z, q.color);
+			quad[3] = quad[0];
+			quad[4] = quad[2];
+			SetVertex(quad[5], q.x + ox[i], q.y + oy[i], q.z, q.color);
+		}
+	}
+	triangles->count += segmentCount * 6;
+}
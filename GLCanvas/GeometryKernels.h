@@ -0,0 +1,60 @@
+#pragma once
+
+// Native bulk geometry kernels shared by the 2D and 3D canvases: bounding boxes,
+// triangle normals, point transforms and the expansion of wide lines into quads.
+// Each kernel has a scalar, an SSE and, where wider registers pay off, an AVX
+// implementation. The widest instruction set supported by the processor and the
+// operating system is chosen on first use. The implementation is compiled without /clr.
+
+#include "VertexBuffer.h"
+
+/// <summary>
+/// Instruction sets used by the kernels.
+/// </summary>
+enum SimdLevel
+{
+	SIMDLEVEL_SCALAR,	// plain C++
+	SIMDLEVEL_SSE,		// 128 bit registers, four floats
+	SIMDLEVEL_AVX		// 256 bit registers, eight floats
+};
+
+/// <summary>
+/// Returns the instruction set used by the kernels.
+/// </summary>
+int _GetSimdLevel();
+/// <summary>
+/// Limits the kernels to the given instruction set, for example to compare the
+/// implementations. Levels the processor does not support are lowered to the
+/// widest supported level.
+/// </summary>
+void _SetSimdLevel(int level);
+/// <summary>
+/// Computes the bounding box of count vertices stored with the given stride in bytes.
+/// Each vertex starts with components (2 or 3) floats. Returns false if there are no vertices.
+/// </summary>
+bool _StridedBounds(const void * data, int count, int stride, int components, float * lower, float * upper);
+/// <summary>
+/// Computes the normals of indexed triangles, wound counter-clockwise seen from the
+/// front. Positions are x, y, z floats stored with the given stride in bytes. Each
+/// normal is written as three floats; its length is twice the area of the triangle.
+/// </summary>
+void _FaceNormals3D(const float * positions, int stride, const unsigned int * indices, int triangleCount, float * normals);
+/// <summary>
+/// Sets the normal of each vertex to the normalized sum of the normals of the
+/// triangles around it, so that larger triangles weigh more. Vertices outside all
+/// triangles get a zero normal.
+/// </summary>
+void _SmoothNormals3D(LitVertex * vertices, int vertexCount, const unsigned int * indices, int indexCount);
+/// <summary>
+/// Transforms count points by a column-major 4x4 matrix. Points are x, y, z floats
+/// stored with the given stride in bytes; the results are written as x, y, z, w floats.
+/// </summary>
+void _TransformPoints3D(const float * matrix, const float * points, int stride, int count, float * result);
+/// <summary>
+/// Appends each line segment as two triangles of the given half width in vertex
+/// coordinates. Segment i connects vertices[i * step] and vertices[i * step + 1], so a
+/// step of 2 expands independent lines and a step of 1 expands a line strip. Corners
+/// take the depth and the color of the nearest end; segments of zero length are
+/// appended as empty triangles.
+/// </summary>
+void _ExpandLines2D(const ColorVertex * vertices, int segmentCount, int step, float halfWidth, VertexBuffer * triangles);
@@ -0,0 +1,237 @@
+// Native code, compiled without /clr.
+
+#include "JobSystem.h"
+#include "NativeMemory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// The state of one _ParallelFor call. Chunks are claimed in order with the next
+	// counter, so neither the submitter nor the workers search the queues for them.
+	struct TaskGroup
+	{
+		JobFunction function;
+		void * context;
+		int count, grain, chunks;
+		std::atomic<int> next;		// index of the next unclaimed chunk
+		std::atomic<int> helpers;	// queued or running helper entries of the group
+	};
+
+	// A double ended queue of helper entries. The owner thread pushes and pops at the
+	// back, other threads steal from the front. Storage is kept between calls so that
+	// submitting jobs does not allocate once the queue has grown.
+	struct WorkQueue
+	{
+		std::mutex lock;
+		std::vector<TaskGroup *> ring;
+		int head, count;
+
+		WorkQueue() : ring(64), head(0), count(0) { }
+
+		void Push(TaskGroup * group)
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (count == (int)ring.size())
+			{
+				std::vector<TaskGroup *> grown(ring.size() * 2);
+				_CountAllocation();
+				for (int i = 0; i < count; i++)
+					grown[i] = ring[(head + i) % ring.size()];
+				ring.swap(grown);
+				head = 0;
+			}
+			ring[(head + count) % ring.size()] = group;
+			count++;
+		}
+
+		TaskGroup * Pop()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (count == 0) return 0;
+			count--;
+			return ring[(head + count) % ring.size()];
+		}
+
+		TaskGroup * Steal()
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (count == 0) return 0;
+			TaskGroup * group = ring[head];
+			head = (head + 1) % (int)ring.size();
+			count--;
+			return group;
+		}
+	};
+
+	// Index of the job slot used by the current thread, -1 outside the job system
+	thread_local int tWorkerIndex = -1;
+}
+
+struct JobSystem
+{
+	std::vector<std::thread> threads;
+	std::vector<WorkQueue *> queues;	// queues[i - 1] belongs to worker i
+	std::atomic<int> queued;			// helper entries pushed but not yet taken
+	std::mutex sleepLock;
+	std::condition_variable wake;
+	std::mutex finishLock;
+	std::condition_variable finished;	// signaled when the last helper of a group leaves
+	bool stop;
+};
+
+namespace
+{
+	TaskGroup * FindTask(JobSystem * jobs, int self)
+	{
+		int queues = (int)jobs->queues.size();
+		TaskGroup * group = jobs->queues[self - 1]->Pop();
+		for (int i = 1; group == 0 && i < queues; i++)
+			group = jobs->queues[(self - 1 + i) % queues]->Steal();
+		if (group != 0)
+			jobs->queued.fetch_sub(1);
+		return group;
+	}
+
+	// Claims and runs chunks of the group until none are left
+	void RunChunks(TaskGroup * group, int worker)
+	{
+		for (;;)
+		{
+			int chunk = group->next.fetch_add(1);
+			if (chunk >= group->chunks) return;
+			int begin = chunk * group->grain;
+			group->function(group->context, begin, std::min(group->count, begin + group->grain), worker);
+		}
+	}
+
+	void WorkerMain(JobSystem * jobs, int index)
+	{
+		tWorkerIndex = index;
+		for (;;)
+		{
+			TaskGroup * group = FindTask(jobs, index);
+			if (group != 0)
+			{
+				RunChunks(group, index);
+				// The submitter may return as soon as the count reaches zero, so the
+				// group is not touched after that
+				if (group->helpers.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					std::lock_guard<std::mutex> lock(jobs->finishLock);
+					jobs->finished.notify_all();
+				}
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(jobs->sleepLock);
+			jobs->wake.wait(lock, [jobs] { return jobs->stop || jobs->queued.load() > 0; });
+			if (jobs->stop) return;
+		}
+	}
+
+	void RunSerial(int count, int grain, JobFunction function, void * context)
+	{
+		// Nested calls keep the slot of the job they are called from. Other threads
+		// take slot 0 for the call, so that calls nested in these chunks run serially too.
+		int outer = tWorkerIndex;
+		int worker = (outer >= 0 ? outer : 0);
+		tWorkerIndex = worker;
+		for (int begin = 0; begin < count; begin += grain)
+			function(context, begin, std::min(count, begin + grain), worker);
+		tWorkerIndex = outer;
+	}
+}
+
+JobSystem * _CreateJobSystem(int threadCount)
+{
+	if (threadCount <= 0)
+		threadCount = std::max(0, (int)std::thread::hardware_concurrency() - 1);
+
+	JobSystem * jobs = new JobSystem();
+	jobs->queued = 0;
+	jobs->stop = false;
+	for (int i = 0; i < threadCount; i++)
+		jobs->queues.push_back(new WorkQueue());
+	for (int i = 1; i <= threadCount; i++)
+		jobs->threads.push_back(std::thread(WorkerMain, jobs, i));
+	return jobs;
+}
+
+void _DestroyJobSystem(JobSystem * jobs)
+{
+	if (jobs == 0) return;
+
+	{
+		std::lock_guard<std::mutex> lock(jobs->sleepLock);
+		jobs->stop = true;
+	}
+	jobs->wake.notify_all();
+	for (size_t i = 0; i < jobs->threads.size(); i++)
+		jobs->threads[i].join();
+	for (size_t i = 0; i < jobs->queues.size(); i++)
+		delete jobs->queues[i];
+	delete jobs;
+}
+
+JobSystem * _SharedJobSystem()
+{
+	// The shared job system lives until the process exits. Worker threads are not
+	// joined during static destruction, which could otherwise deadlock under the loader lock.
+	static JobSystem * shared = _CreateJobSystem(0);
+	return shared;
+}
+
+int _JobThreadCount(JobSystem * jobs)
+{
+	return jobs == 0 ? 1 : (int)jobs->threads.size() + 1;
+}
+
+void _ParallelFor(JobSystem * jobs, int count, int grain, JobFunction function, void * context)
+{
+	if (count <= 0) return;
+	if (grain < 1) grain = 1;
+
+	int chunks = (count + grain - 1) / grain;
+	if (jobs == 0 || jobs->threads.empty() || chunks == 1 || tWorkerIndex >= 0)
+	{
+		RunSerial(count, grain, function, context);
+		return;
+	}
+
+	// One helper entry per worker that can be used, spread over the worker queues;
+	// idle workers steal entries left in the queues of busy ones
+	TaskGroup group;
+	group.function = function;
+	group.context = context;
+	group.count = count;
+	group.grain = grain;
+	group.chunks = chunks;
+	group.next = 0;
+	int helpers = std::min(chunks - 1, (int)jobs->threads.size());
+	group.helpers = helpers;
+	jobs->queued.fetch_add(helpers);
+	for (int i = 0; i < helpers; i++)
+		jobs->queues[i]->Push(&group);
+	{
+		std::lock_guard<std::mutex> lock(jobs->sleepLock);
+	}
+	jobs->wake.notify_all();
+
+	// Run chunks until all of them are claimed, then sleep until the helpers have
+	// finished theirs. Submitting threads only run chunks of their own call, so that
+	// two calls in flight never both run chunks as slot 0.
+	tWorkerIndex = 0;
+	RunChunks(&group, 0);
+	tWorkerIndex = -1;
+	if (group.helpers.load(std::memory_order_acquire) > 0)
+	{
+		std::unique_lock<std::mutex> lock(jobs->finishLock);
+		jobs->finished.wait(lock, [&group] { return group.helpers.load(std::memory_order_acquire) == 0; });
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+// Native work-stealing job system. The implementation is compiled without /clr;
+// this header only exposes plain functions so it can be included from managed code.
+
+struct JobSystem;
+
+/// <summary>
+/// Represents a job. begin and end give the range of items to process and worker
+/// is the index of the thread running the job (0 is the thread that submitted the jobs).
+/// </summary>
+typedef void (*JobFunction)(void * context, int begin, int end, int worker);
+
+/// <summary>
+/// Creates a job system with the given number of worker threads. If threadCount is
+/// zero, one worker is created for each processor core other than the calling thread's.
+/// </summary>
+JobSystem * _CreateJobSystem(int threadCount);
+/// <summary>
+/// Stops the worker threads and releases the job system.
+/// </summary>
+void _DestroyJobSystem(JobSystem * jobs);
+/// <summary>
+/// Returns the job system shared by all canvases. The shared job system is created on first use.
+/// </summary>
+JobSystem * _SharedJobSystem();
+/// <summary>
+/// Returns the number of threads that can run jobs, including the submitting thread.
+/// </summary>
+int _JobThreadCount(JobSystem * jobs);
+/// <summary>
+/// Splits the range [0, count) into chunks of grain items and runs function on each chunk
+/// in parallel. Chunk boundaries are always multiples of grain, so function can locate
+/// per-chunk output with begin / grain. Returns after all chunks are processed. Called
+/// from inside a job, or with a null job system, the chunks are run on the calling thread
+/// with its slot. Several threads may call _ParallelFor at the same time; worker indices
+/// are unique among the chunks of one call, not across calls.
+/// </summary>
+void _ParallelFor(JobSystem * jobs, int count, int grain, JobFunction function, void * context);
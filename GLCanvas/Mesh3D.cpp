@@ -0,0 +1,105 @@
+// Native code, compiled without /clr.
+
+#include "Mesh3D.h"
+#include "GeometryKernels.h"
+#include "NativeMemory.h"
+
+#include <algorithm>
+#include <string.h>
+
+namespace
+{
+	// Grows an array to hold at least count items, keeping its contents
+	template <typename T>
+	void Reserve(T *& data, int & capacity, int count)
+	{
+		if (count <= capacity) return;
+		int size = (capacity < 64 ? 64 : capacity);
+		while (size < count) size = (size > 0x3FFFFFFF ? count : size * 2);
+		data = (T *)_Reallocate(data, (size_t)size * sizeof(T));
+		capacity = size;
+	}
+}
+
+Mesh3D * _CreateMesh3D()
+{
+	Mesh3D * mesh = (Mesh3D *)_Allocate(sizeof(Mesh3D));
+	memset(mesh, 0, sizeof(Mesh3D));
+	return mesh;
+}
+
+void _DestroyMesh3D(Mesh3D * mesh)
+{
+	if (mesh == 0) return;
+	_Free(mesh->vertices);
+	_Free(mesh->indices);
+	_Free(mesh->edges);
+	_Free(mesh);
+}
+
+bool _SetMesh3D(Mesh3D * mesh, const float * positions, const float * normals, const unsigned int * colors, unsigned int color,
+	int vertexCount, const unsigned int * indices, int indexCount)
+{
+	for (int i = 0; i < indexCount; i++)
+		if (indices[i] >= (unsigned int)vertexCount) return false;
+
+	Reserve(mesh->vertices, mesh->vertexCapacity, vertexCount);
+	Reserve(mesh->indices, mesh->indexCapacity, indexCount);
+	for (int i = 0; i < vertexCount; i++)
+	{
+		LitVertex & v = mesh->vertices[i];
+		v.x = positions[i * 3];
+		v.y = positions[i * 3 + 1];
+		v.z = positions[i * 3 + 2];
+		if (normals != 0)
+		{
+			v.nx = normals[i * 3];
+			v.ny = normals[i * 3 + 1];
+			v.nz = normals[i * 3 + 2];
+		}
+		v.color = (colors != 0 ? colors[i] : color);
+	}
+	if (indexCount != 0) memcpy(mesh->indices, indices, (size_t)indexCount * sizeof(unsigned int));
+	mesh->vertexCount = vertexCount;
+	mesh->indexCount = indexCount;
+	mesh->edgeCount = 0;
+	mesh->hasEdges = false;
+
+	if (normals == 0) _SmoothNormals3D(mesh->vertices, vertexCount, mesh->indices, indexCount);
+	mesh->hasBounds = _StridedBounds(mesh->vertices, vertexCount, sizeof(LitVertex), 3, mesh->bounds, mesh->bounds + 3);
+	return true;
+}
+
+void _FindMeshEdges3D(Mesh3D * mesh)
+{
+	if (mesh->hasEdges) return;
+	mesh->hasEdges = true;
+	mesh->edgeCount = 0;
+	if (mesh->indexCount < 3) return;
+
+	// Edges are keyed by their lower and higher vertex index, so that sorting brings
+	// the copies of an edge together
+	int triangleCount = mesh->indexCount / 3;
+	unsigned long long * keys = (unsigned long long *)_Allocate((size_t)triangleCount * 3 * sizeof(unsigned long long));
+	int count = 0;
+	for (int i = 0; i < triangleCount * 3; i += 3)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned long long a = mesh->indices[i + k], b = mesh->indices[i + (k + 1) % 3];
+			if (a == b) continue;
+			keys[count++] = (a < b ? (a << 32) | b : (b << 32) | a);
+		}
+	}
+	std::sort(keys, keys + count);
+	count = (int)(std::unique(keys, keys + count) - keys);
+
+	Reserve(mesh->edges, mesh->edgeCapacity, count * 2);
+	for (int i = 0; i < count; i++)
+	{
+		mesh->edges[i * 2] = (unsigned int)(keys[i] >> 32);
+		mesh->edges[i * 2 + 1] = (unsigned int)keys[i];
+	}
+	mesh->edgeCount = count * 2;
+	_Free(keys);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+// Native storage of indexed triangle meshes. Vertices are kept in the lit vertex
+// format so that they can be copied into vertex buffer objects without conversion.
+// The implementation is compiled without /clr.
+
+#include "VertexBuffer.h"
+
+/// <summary>
+/// Represents an indexed triangle mesh. Each group of three indices is a triangle;
+/// edges holds each edge shared by the triangles once, as pairs of indices.
+/// </summary>
+struct Mesh3D
+{
+	LitVertex * vertices;
+	int vertexCount;
+	int vertexCapacity;
+	unsigned int * indices;
+	int indexCount;
+	int indexCapacity;
+	unsigned int * edges;
+	int edgeCount;				// number of edge indices, twice the number of edges
+	int edgeCapacity;
+	bool hasEdges;				// false until _FindMeshEdges3D is called after the mesh changes
+	bool hasBounds;
+	float bounds[6];			// min x, y, z, max x, y, z
+};
+
+/// <summary>
+/// Creates an empty mesh.
+/// </summary>
+Mesh3D * _CreateMesh3D();
+/// <summary>
+/// Releases a mesh.
+/// </summary>
+void _DestroyMesh3D(Mesh3D * mesh);
+/// <summary>
+/// Replaces the mesh data. positions and normals hold x, y, z floats for each vertex;
+/// colors holds R, G, B, A bytes for each vertex. If normals is null, vertex normals
+/// are computed by adding the area weighted normals of the triangles around each
+/// vertex, with triangles wound counter-clockwise seen from the outside. If colors
+/// is null, all vertices take the given color. Returns false without changing the
+/// mesh if an index is outside the vertices.
+/// </summary>
+bool _SetMesh3D(Mesh3D * mesh, const float * positions, const float * normals, const unsigned int * colors, unsigned int color,
+	int vertexCount, const unsigned int * indices, int indexCount);
+/// <summary>
+/// Collects the edges of the triangles, each edge shared by several triangles once.
+/// </summary>
+void _FindMeshEdges3D(Mesh3D * mesh);
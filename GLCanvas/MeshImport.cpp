@@ -0,0 +1,1360 @@
+// Native code, compiled without /clr.
+
+#include "MeshImport.h"
+#include "GeometryKernels.h"
+#include "NativeMemory.h"
+
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	// Number of bytes of text parsed by one job
+	const size_t TextChunk = 1 << 20;
+	// Number of vertices, triangles or corners processed by one job
+	const int ItemChunk = 65536;
+	// Vertices are split into partitions by the top bits of their hash, and each
+	// partition is merged on its own
+	const int PartitionBits = 10;
+	const int PartitionCount = 1 << PartitionBits;
+	// Number of partitions merged by one job
+	const int PartitionChunk = 16;
+	// Largest number of triangles, so that all indices fit in an int
+	const long long MaxTriangles = 0x7FFFFFFF / 3;
+
+	const double Powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	typedef std::chrono::steady_clock Clock;
+
+	double Milliseconds(Clock::time_point start, Clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	// Counts the bytes held by the importer. Buffers only grow within a phase, so the
+	// tally is updated between phases.
+	struct MemoryTally
+	{
+		long long current;
+		long long peak;
+
+		void Add(long long bytes)
+		{
+			current += bytes;
+			if (current > peak) peak = current;
+		}
+		void Remove(long long bytes)
+		{
+			current -= bytes;
+		}
+	};
+
+	template <typename T>
+	long long Bytes(const std::vector<T> & items)
+	{
+		return (long long)items.capacity() * (long long)sizeof(T);
+	}
+
+	template <typename T>
+	void Release(std::vector<T> & items)
+	{
+		std::vector<T>().swap(items);
+	}
+
+	// Vertices and triangles read from a file
+	struct MeshData
+	{
+		std::vector<float> positions;		// x, y, z of each vertex
+		std::vector<float> normals;			// empty, or x, y, z of each vertex
+		std::vector<unsigned int> colors;	// empty, or R, G, B, A bytes of each vertex
+		std::vector<int> corners;			// three vertex indices for each triangle; empty
+											// when each vertex is a corner, as in STL files
+
+		long long Size() const
+		{
+			return Bytes(positions) + Bytes(normals) + Bytes(colors) + Bytes(corners);
+		}
+	};
+
+	// Text
+
+	inline bool IsSpace(char c)
+	{
+		return (c == ' ' || c == '\t' || c == '\r');
+	}
+
+	inline const char * SkipSpaces(const char * p, const char * end)
+	{
+		while (p < end && IsSpace(*p)) p++;
+		return p;
+	}
+
+	inline const char * SkipToken(const char * p, const char * end)
+	{
+		p = SkipSpaces(p, end);
+		while (p < end && !IsSpace(*p)) p++;
+		return p;
+	}
+
+	inline const char * LineEnd(const char * p, const char * end)
+	{
+		const char * e = (const char *)memchr(p, '\n', (size_t)(end - p));
+		return (e == 0 ? end : e);
+	}
+
+	// Tests whether a line continues with the given word followed by a space
+	inline bool IsKeyword(const char * p, const char * end, const char * word, size_t length)
+	{
+		return ((size_t)(end - p) > length && memcmp(p, word, length) == 0 && IsSpace(p[length]));
+	}
+
+	// Tests whether a line is empty or starts with one of the ASCII STL keywords, so
+	// that binary data with a header starting with "solid" is not read as text
+	bool IsStlLine(const char * p, const char * end)
+	{
+		const char * Keywords[] = { "solid", "facet", "outer", "endloop", "endfacet", "endsolid" };
+		if (p == end) return true;
+		for (int i = 0; i < 6; i++)
+		{
+			size_t length = strlen(Keywords[i]);
+			if ((size_t)(end - p) >= length && memcmp(p, Keywords[i], length) == 0 && ((size_t)(end - p) == length || IsSpace(p[length])))
+				return true;
+		}
+		return false;
+	}
+
+	// Tests whether the last line that is not empty starts with "endsolid"
+	bool EndsStl(const char * data, size_t size)
+	{
+		const char * end = data + size;
+		while (end > data && (IsSpace(end[-1]) || end[-1] == '\n')) end--;
+		const char * line = end;
+		while (line > data && line[-1] != '\n') line--;
+		line = SkipSpaces(line, end);
+		return ((size_t)(end - line) >= 8 && memcmp(line, "endsolid", 8) == 0);
+	}
+
+	// Returns the start of the first line at or after offset
+	size_t LineStart(const char * data, size_t size, size_t offset)
+	{
+		if (offset == 0) return 0;
+		if (offset >= size) return size;
+		const char * p = (const char *)memchr(data + offset - 1, '\n', size - offset + 1);
+		return (p == 0 ? size : (size_t)(p - data) + 1);
+	}
+
+	// Reads a decimal number. Mapped files are not terminated, so the standard
+	// conversion functions cannot be used.
+	bool ParseFloat(const char *& p, const char * end, float & value)
+	{
+		p = SkipSpaces(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+		unsigned long long mantissa = 0;
+		int exponent = 0, digits = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+		{
+			if (mantissa < 100000000000000000ULL) mantissa = mantissa * 10 + (unsigned int)(*p - '0');
+			else exponent++;
+		}
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+			{
+				if (mantissa >= 100000000000000000ULL) continue;
+				mantissa = mantissa * 10 + (unsigned int)(*p - '0');
+				exponent--;
+			}
+		}
+		if (digits == 0) return false;
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char * q = p + 1;
+			bool negativeExponent = false;
+			if (q < end && (*q == '-' || *q == '+')) negativeExponent = (*q++ == '-');
+			if (q < end && *q >= '0' && *q <= '9')
+			{
+				int e = 0;
+				for (; q < end && *q >= '0' && *q <= '9'; q++)
+					if (e < 10000) e = e * 10 + (*q - '0');
+				exponent += (negativeExponent ? -e : e);
+				p = q;
+			}
+		}
+
+		double v = (double)mantissa;
+		if (exponent < 0) v = (exponent >= -22 ? v / Powers[-exponent] : v * pow(10.0, exponent));
+		else if (exponent > 0) v = (exponent <= 22 ? v * Powers[exponent] : v * pow(10.0, exponent));
+		value = (float)(negative ? -v : v);
+		return true;
+	}
+
+	bool ParseInt(const char *& p, const char * end, long long & value)
+	{
+		p = SkipSpaces(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+		if (p == end || *p < '0' || *p > '9') return false;
+		long long v = 0;
+		for (; p < end && *p >= '0' && *p <= '9'; p++)
+			if (v < 0x7FFFFFFFFFFFLL) v = v * 10 + (*p - '0');
+		value = (negative ? -v : v);
+		return true;
+	}
+
+	// Output of one chunk of text
+	struct TextPart
+	{
+		std::vector<float> positions;
+		std::vector<int> corners;
+		std::vector<int> relative;		// corners counted from the first vertex of the chunk
+		long long firstLine;
+		bool failed;
+	};
+
+	struct PlyHeader;
+
+	struct TextJob
+	{
+		const char * data;
+		size_t size;
+		std::vector<TextPart> * parts;
+		const PlyHeader * header;
+		MeshData * mesh;
+		std::vector<size_t> positionOffsets;
+		std::vector<size_t> cornerOffsets;
+	};
+
+	// Chunks start at the first line starting in their range of bytes
+	inline const char * ChunkStart(const TextJob * job, int chunk)
+	{
+		return job->data + LineStart(job->data, job->size, (size_t)chunk * TextChunk);
+	}
+
+	void CountLines(void * context, int begin, int end, int)
+	{
+		TextJob * job = (TextJob *)context;
+		for (int chunk = begin; chunk < end; chunk++)
+		{
+			const char * p = ChunkStart(job, chunk), * last = ChunkStart(job, chunk + 1);
+			long long lines = 0;
+			for (; p < last; lines++)
+				p = LineEnd(p, last) + 1;
+			(*job->parts)[chunk].firstLine = lines;
+		}
+	}
+
+	// Reads the vertices of ASCII STL facets
+	void ParseStlChunks(void * context, int begin, int end, int)
+	{
+		TextJob * job = (TextJob *)context;
+		for (int chunk = begin; chunk < end; chunk++)
+		{
+			TextPart & part = (*job->parts)[chunk];
+			const char * p = ChunkStart(job, chunk), * last = ChunkStart(job, chunk + 1);
+			while (p < last)
+			{
+				const char * lineEnd = LineEnd(p, last);
+				p = SkipSpaces(p, lineEnd);
+				if (IsKeyword(p, lineEnd, "vertex", 6))
+				{
+					p += 6;
+					float x, y, z;
+					if (ParseFloat(p, lineEnd, x) && ParseFloat(p, lineEnd, y) && ParseFloat(p, lineEnd, z))
+					{
+						part.positions.push_back(x);
+						part.positions.push_back(y);
+						part.positions.push_back(z);
+					}
+					else
+						part.failed = true;
+				}
+				else if (!IsStlLine(p, lineEnd))
+					part.failed = true;
+				p = lineEnd + 1;
+			}
+		}
+	}
+
+	// Reads the vertices and faces of OBJ files. Faces are split into fans of
+	// triangles; texture coordinates, normals, groups and materials are skipped.
+	void ParseObjChunks(void * context, int begin, int end, int)
+	{
+		TextJob * job = (TextJob *)context;
+		std::vector<int> polygon;
+		std::vector<bool> relative;
+		for (int chunk = begin; chunk < end; chunk++)
+		{
+			TextPart & part = (*job->parts)[chunk];
+			const char * p = ChunkStart(job, chunk), * last = ChunkStart(job, chunk + 1);
+			int vertices = 0;
+			while (p < last)
+			{
+				const char * lineEnd = LineEnd(p, last);
+				p = SkipSpaces(p, lineEnd);
+				if (IsKeyword(p, lineEnd, "v", 1))
+				{
+					p++;
+					float x, y, z;
+					if (ParseFloat(p, lineEnd, x) && ParseFloat(p, lineEnd, y) && ParseFloat(p, lineEnd, z))
+					{
+						part.positions.push_back(x);
+						part.positions.push_back(y);
+						part.positions.push_back(z);
+						vertices++;
+					}
+					else
+						part.failed = true;
+				}
+				else if (IsKeyword(p, lineEnd, "f", 1))
+				{
+					// Negative indices count back from the last vertex read; they are
+					// counted from the start of the chunk until the chunks are merged
+					p++;
+					polygon.clear();
+					relative.clear();
+					while (true)
+					{
+						p = SkipSpaces(p, lineEnd);
+						if (p == lineEnd || *p == '#') break;
+						long long index;
+						if (!ParseInt(p, lineEnd, index) || index == 0 || index > 0x7FFFFFFF || index < -0x7FFFFFFF)
+						{
+							part.failed = true;
+							break;
+						}
+						while (p < lineEnd && !IsSpace(*p)) p++;
+						polygon.push_back(index > 0 ? (int)(index - 1) : vertices + (int)index);
+						relative.push_back(index < 0);
+					}
+					if (polygon.size() < 3) part.failed = true;
+					for (size_t k = 1; k + 1 < polygon.size(); k++)
+					{
+						size_t corners[3] = { 0, k, k + 1 };
+						for (int c = 0; c < 3; c++)
+						{
+							if (relative[corners[c]]) part.relative.push_back((int)part.corners.size());
+							part.corners.push_back(polygon[corners[c]]);
+						}
+					}
+				}
+				p = lineEnd + 1;
+			}
+		}
+	}
+
+	void MergeTextChunks(void * context, int begin, int end, int)
+	{
+		TextJob * job = (TextJob *)context;
+		for (int chunk = begin; chunk < end; chunk++)
+		{
+			TextPart & part = (*job->parts)[chunk];
+			if (!part.positions.empty())
+				memcpy(&job->mesh->positions[job->positionOffsets[chunk]], &part.positions[0], part.positions.size() * sizeof(float));
+			if (!part.corners.empty())
+			{
+				int * corners = &job->mesh->corners[job->cornerOffsets[chunk]];
+				memcpy(corners, &part.corners[0], part.corners.size() * sizeof(int));
+				int firstVertex = (int)(job->positionOffsets[chunk] / 3);
+				for (size_t i = 0; i < part.relative.size(); i++)
+					corners[part.relative[i]] += firstVertex;
+			}
+			Release(part.positions);
+			Release(part.corners);
+			Release(part.relative);
+		}
+	}
+
+	// Splits text into chunks of lines, parses them in parallel and appends their
+	// vertices and corners to the mesh in order. PLY files also get the number of lines.
+	int ParseText(const char * data, size_t size, const PlyHeader * header, JobFunction function, JobSystem * jobs,
+		MeshData & mesh, MemoryTally & memory, long long * lineCount = 0)
+	{
+		int chunks = (int)((size + TextChunk - 1) / TextChunk);
+		std::vector<TextPart> parts(chunks);
+		TextJob job = { data, size, &parts, header, &mesh };
+		for (int i = 0; i < chunks; i++)
+		{
+			parts[i].firstLine = 0;
+			parts[i].failed = false;
+		}
+		if (header != 0)
+		{
+			// PLY lines are assigned to elements by their number, so the lines of
+			// each chunk are counted first
+			_ParallelFor(jobs, chunks, 1, CountLines, &job);
+			long long lines = 0;
+			for (int i = 0; i < chunks; i++)
+			{
+				long long n = parts[i].firstLine;
+				parts[i].firstLine = lines;
+				lines += n;
+			}
+			if (lineCount != 0) *lineCount = lines;
+		}
+		_ParallelFor(jobs, chunks, 1, function, &job);
+
+		long long partBytes = 0;
+		size_t positions = mesh.positions.size(), corners = mesh.corners.size();
+		job.positionOffsets.resize(chunks);
+		job.cornerOffsets.resize(chunks);
+		for (int i = 0; i < chunks; i++)
+		{
+			if (parts[i].failed) return MESHIMPORT_BADFORMAT;
+			job.positionOffsets[i] = positions;
+			job.cornerOffsets[i] = corners;
+			positions += parts[i].positions.size();
+			corners += parts[i].corners.size();
+			partBytes += Bytes(parts[i].positions) + Bytes(parts[i].corners) + Bytes(parts[i].relative);
+		}
+		if (positions / 3 > 0x7FFFFFFF || corners > 0x7FFFFFFF) return MESHIMPORT_TOOLARGE;
+
+		memory.Add(partBytes);
+		long long before = mesh.Size();
+		mesh.positions.resize(positions);
+		mesh.corners.resize(corners);
+		memory.Add(mesh.Size() - before);
+		_ParallelFor(jobs, chunks, 1, MergeTextChunks, &job);
+		memory.Remove(partBytes);
+		return MESHIMPORT_OK;
+	}
+
+	// STL
+
+	bool IsBinaryStl(const char * data, size_t size)
+	{
+		if (size < 84) return false;
+		unsigned int count;
+		memcpy(&count, data + 80, sizeof(count));
+		return (84 + 50 * (unsigned long long)count == (unsigned long long)size);
+	}
+
+	bool IsAsciiStl(const char * data, size_t size)
+	{
+		const char * end = data + size;
+		const char * p = SkipSpaces(data, end);
+		while (p < end && *p == '\n') p = SkipSpaces(p + 1, end);
+		return ((size_t)(end - p) >= 5 && memcmp(p, "solid", 5) == 0);
+	}
+
+	struct BinaryStlJob
+	{
+		const char * records;
+		float * positions;
+	};
+
+	// Each 50 byte record holds the facet normal, three corners and an attribute word
+	void CopyStlTriangles(void * context, int begin, int end, int)
+	{
+		BinaryStlJob * job = (BinaryStlJob *)context;
+		for (int i = begin; i < end; i++)
+			memcpy(job->positions + (size_t)i * 9, job->records + (size_t)i * 50 + 12, 9 * sizeof(float));
+	}
+
+	int ParseStl(const char * data, size_t size, JobSystem * jobs, MeshData & mesh, MemoryTally & memory)
+	{
+		if (IsBinaryStl(data, size))
+		{
+			unsigned int count;
+			memcpy(&count, data + 80, sizeof(count));
+			if (count > MaxTriangles) return MESHIMPORT_TOOLARGE;
+			if (count == 0) return MESHIMPORT_OK;
+			mesh.positions.resize((size_t)count * 9);
+			memory.Add(mesh.Size());
+			BinaryStlJob job = { data + 84, &mesh.positions[0] };
+			_ParallelFor(jobs, (int)count, ItemChunk, CopyStlTriangles, &job);
+			return MESHIMPORT_OK;
+		}
+		if (!IsAsciiStl(data, size)) return MESHIMPORT_BADFORMAT;
+
+		int result = ParseText(data, size, 0, ParseStlChunks, jobs, mesh, memory);
+		// Truncated files end inside a facet or before "endsolid"
+		if (result == MESHIMPORT_OK && (mesh.positions.size() % 9 != 0 || !EndsStl(data, size))) result = MESHIMPORT_BADFORMAT;
+		return result;
+	}
+
+	// PLY
+
+	enum PlyType { PLY_NONE, PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64 };
+	enum PlyEncoding { PLY_ASCII, PLY_LITTLEENDIAN, PLY_BIGENDIAN };
+	enum VertexAttribute { ATTR_X, ATTR_Y, ATTR_Z, ATTR_NX, ATTR_NY, ATTR_NZ, ATTR_RED, ATTR_GREEN, ATTR_BLUE, ATTR_ALPHA, ATTR_COUNT };
+
+	const int PlySizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+	const char * const AttributeNames[ATTR_COUNT] = { "x", "y", "z", "nx", "ny", "nz", "red", "green", "blue", "alpha" };
+
+	struct PlyProperty
+	{
+		std::string name;
+		int type;
+		int countType;			// type of the item count of list properties, or PLY_NONE
+	};
+
+	struct PlyElement
+	{
+		std::string name;
+		long long count;
+		std::vector<PlyProperty> properties;
+	};
+
+	struct PlyHeader
+	{
+		int encoding;
+		std::vector<PlyElement> elements;
+		size_t dataStart;
+		int vertexElement, faceElement;
+		int indexProperty;					// the vertex index list of faces
+		int attributes[ATTR_COUNT];			// vertex property of each attribute, or -1
+		size_t offsets[ATTR_COUNT];			// byte offset of each attribute in binary vertices
+		size_t vertexSize;
+		long long firstLines[2];			// first line of the vertices and faces in ASCII files
+	};
+
+	int PlyTypeOf(const std::string & name)
+	{
+		static const char * const names[] = { "char", "int8", "uchar", "uint8", "short", "int16", "ushort", "uint16",
+			"int", "int32", "uint", "uint32", "float", "float32", "double", "float64" };
+		for (int i = 0; i < 16; i++)
+			if (name == names[i]) return PLY_INT8 + i / 2;
+		return PLY_NONE;
+	}
+
+	void Tokenize(const char * p, const char * end, std::vector<std::string> & tokens)
+	{
+		tokens.clear();
+		while (true)
+		{
+			p = SkipSpaces(p, end);
+			if (p == end) break;
+			const char * start = p;
+			p = SkipToken(p, end);
+			tokens.push_back(std::string(start, p));
+		}
+	}
+
+	bool ReadPlyHeader(const char * data, size_t size, PlyHeader & header)
+	{
+		const char * p = data, * end = data + size;
+		std::vector<std::string> tokens;
+		bool hasFormat = false;
+		for (int line = 0; p < end; line++)
+		{
+			const char * lineEnd = LineEnd(p, end);
+			Tokenize(p, lineEnd, tokens);
+			p = lineEnd + 1;
+			if (line == 0)
+			{
+				if (tokens.size() != 1 || tokens[0] != "ply") return false;
+				continue;
+			}
+			if (tokens.empty() || tokens[0] == "comment" || tokens[0] == "obj_info") continue;
+
+			if (tokens[0] == "format" && tokens.size() >= 2)
+			{
+				if (tokens[1] == "ascii") header.encoding = PLY_ASCII;
+				else if (tokens[1] == "binary_little_endian") header.encoding = PLY_LITTLEENDIAN;
+				else if (tokens[1] == "binary_big_endian") header.encoding = PLY_BIGENDIAN;
+				else return false;
+				hasFormat = true;
+			}
+			else if (tokens[0] == "element" && tokens.size() == 3)
+			{
+				PlyElement element;
+				element.name = tokens[1];
+				element.count = strtoll(tokens[2].c_str(), 0, 10);
+				if (element.count < 0) return false;
+				header.elements.push_back(element);
+			}
+			else if (tokens[0] == "property" && !header.elements.empty())
+			{
+				PlyProperty property;
+				if (tokens.size() == 5 && tokens[1] == "list")
+				{
+					property.countType = PlyTypeOf(tokens[2]);
+					property.type = PlyTypeOf(tokens[3]);
+					property.name = tokens[4];
+					if (property.countType == PLY_NONE || property.countType >= PLY_FLOAT32) return false;
+				}
+				else if (tokens.size() == 3)
+				{
+					property.countType = PLY_NONE;
+					property.type = PlyTypeOf(tokens[1]);
+					property.name = tokens[2];
+				}
+				else
+					return false;
+				if (property.type == PLY_NONE) return false;
+				header.elements.back().properties.push_back(property);
+			}
+			else if (tokens[0] == "end_header")
+			{
+				header.dataStart = (size_t)(lineEnd - data) + (lineEnd < end ? 1 : 0);
+				return hasFormat;
+			}
+			else
+				return false;
+		}
+		return false;
+	}
+
+	// Finds the vertex and face elements and the properties read from them
+	bool ReadPlyLayout(PlyHeader & header)
+	{
+		header.vertexElement = header.faceElement = header.indexProperty = -1;
+		for (int e = 0; e < (int)header.elements.size(); e++)
+		{
+			if (header.elements[e].name == "vertex" && header.vertexElement < 0) header.vertexElement = e;
+			if (header.elements[e].name == "face" && header.faceElement < 0) header.faceElement = e;
+		}
+		if (header.vertexElement < 0) return false;
+
+		// Vertices cannot have lists, so each attribute is at a fixed offset
+		const PlyElement & vertices = header.elements[header.vertexElement];
+		for (int a = 0; a < ATTR_COUNT; a++)
+			header.attributes[a] = -1;
+		header.vertexSize = 0;
+		for (int i = 0; i < (int)vertices.properties.size(); i++)
+		{
+			const PlyProperty & property = vertices.properties[i];
+			if (property.countType != PLY_NONE) return false;
+			for (int a = 0; a < ATTR_COUNT; a++)
+			{
+				if (property.name != AttributeNames[a] || header.attributes[a] >= 0) continue;
+				header.attributes[a] = i;
+				header.offsets[a] = header.vertexSize;
+			}
+			header.vertexSize += PlySizes[property.type];
+		}
+		if (header.attributes[ATTR_X] < 0 || header.attributes[ATTR_Y] < 0 || header.attributes[ATTR_Z] < 0) return false;
+
+		if (header.faceElement >= 0)
+		{
+			const PlyElement & faces = header.elements[header.faceElement];
+			for (int i = 0; i < (int)faces.properties.size() && header.indexProperty < 0; i++)
+			{
+				const PlyProperty & property = faces.properties[i];
+				if (property.countType != PLY_NONE && property.type < PLY_FLOAT32 && (property.name == "vertex_indices" || property.name == "vertex_index"))
+					header.indexProperty = i;
+			}
+			if (header.indexProperty < 0) return false;
+		}
+		return true;
+	}
+
+	inline bool HasNormals(const PlyHeader & header)
+	{
+		return (header.attributes[ATTR_NX] >= 0 && header.attributes[ATTR_NY] >= 0 && header.attributes[ATTR_NZ] >= 0);
+	}
+
+	inline bool HasColors(const PlyHeader & header)
+	{
+		return (header.attributes[ATTR_RED] >= 0 && header.attributes[ATTR_GREEN] >= 0 && header.attributes[ATTR_BLUE] >= 0);
+	}
+
+	double ReadValue(const unsigned char * p, int type, bool swap)
+	{
+		unsigned char b[8];
+		int size = PlySizes[type];
+		for (int i = 0; i < size; i++)
+			b[i] = p[swap ? size - 1 - i : i];
+		switch (type)
+		{
+		case PLY_INT8: return (double)(signed char)b[0];
+		case PLY_UINT8: return (double)b[0];
+		case PLY_INT16: { short v; memcpy(&v, b, 2); return (double)v; }
+		case PLY_UINT16: { unsigned short v; memcpy(&v, b, 2); return (double)v; }
+		case PLY_INT32: { int v; memcpy(&v, b, 4); return (double)v; }
+		case PLY_UINT32: { unsigned int v; memcpy(&v, b, 4); return (double)v; }
+		case PLY_FLOAT32: { float v; memcpy(&v, b, 4); return (double)v; }
+		default: { double v; memcpy(&v, b, 8); return v; }
+		}
+	}
+
+	inline int ToIndex(double value)
+	{
+		return (value >= 0.0 && value <= 2147483647.0 ? (int)value : -1);
+	}
+
+	// Colors given as floats range from 0 to 1, integer colors from 0 to 255
+	inline unsigned int ToColorByte(double value, int type)
+	{
+		if (type >= PLY_FLOAT32) value *= 255.0;
+		value = floor(value + 0.5);
+		return (value <= 0.0 ? 0 : (value >= 255.0 ? 255 : (unsigned int)value));
+	}
+
+	// Stores the attributes of a vertex, given in the order of VertexAttribute
+	void StoreVertex(MeshData & mesh, const PlyHeader & header, int index, const double * values)
+	{
+		float * p = &mesh.positions[(size_t)index * 3];
+		p[0] = (float)values[ATTR_X];
+		p[1] = (float)values[ATTR_Y];
+		p[2] = (float)values[ATTR_Z];
+		if (!mesh.normals.empty())
+		{
+			float * n = &mesh.normals[(size_t)index * 3];
+			n[0] = (float)values[ATTR_NX];
+			n[1] = (float)values[ATTR_NY];
+			n[2] = (float)values[ATTR_NZ];
+		}
+		if (!mesh.colors.empty())
+		{
+			const PlyProperty * properties = &header.elements[header.vertexElement].properties[0];
+			unsigned int alpha = (header.attributes[ATTR_ALPHA] >= 0 ? ToColorByte(values[ATTR_ALPHA], properties[header.attributes[ATTR_ALPHA]].type) : 255);
+			mesh.colors[index] = ToColorByte(values[ATTR_RED], properties[header.attributes[ATTR_RED]].type) |
+				(ToColorByte(values[ATTR_GREEN], properties[header.attributes[ATTR_GREEN]].type) << 8) |
+				(ToColorByte(values[ATTR_BLUE], properties[header.attributes[ATTR_BLUE]].type) << 16) | (alpha << 24);
+		}
+	}
+
+	// Adds a polygon as a fan of triangles
+	bool AddPolygon(std::vector<int> & corners, const std::vector<int> & polygon)
+	{
+		if (polygon.size() < 3) return false;
+		for (size_t k = 1; k + 1 < polygon.size(); k++)
+		{
+			corners.push_back(polygon[0]);
+			corners.push_back(polygon[k]);
+			corners.push_back(polygon[k + 1]);
+		}
+		return true;
+	}
+
+	// Reads the vertex and face lines of ASCII PLY files. Each line is assigned to an
+	// element by its number; lines of other elements are skipped.
+	void ParsePlyChunks(void * context, int begin, int end, int)
+	{
+		TextJob * job = (TextJob *)context;
+		const PlyHeader & header = *job->header;
+		const PlyElement & vertices = header.elements[header.vertexElement];
+		std::vector<int> polygon;
+		for (int chunk = begin; chunk < end; chunk++)
+		{
+			TextPart & part = (*job->parts)[chunk];
+			const char * p = ChunkStart(job, chunk), * last = ChunkStart(job, chunk + 1);
+			for (long long line = part.firstLine; p < last && !part.failed; line++)
+			{
+				const char * lineEnd = LineEnd(p, last);
+				long long vertex = line - header.firstLines[0], face = line - header.firstLines[1];
+				if (vertex >= 0 && vertex < vertices.count)
+				{
+					double values[ATTR_COUNT] = { 0 };
+					for (int i = 0; i < (int)vertices.properties.size(); i++)
+					{
+						float value;
+						if (!ParseFloat(p, lineEnd, value))
+						{
+							part.failed = true;
+							break;
+						}
+						for (int a = 0; a < ATTR_COUNT; a++)
+							if (header.attributes[a] == i) values[a] = value;
+					}
+					StoreVertex(*job->mesh, header, (int)vertex, values);
+				}
+				else if (header.faceElement >= 0 && face >= 0 && face < header.elements[header.faceElement].count)
+				{
+					const std::vector<PlyProperty> & properties = header.elements[header.faceElement].properties;
+					for (int i = 0; i < (int)properties.size() && !part.failed; i++)
+					{
+						if (properties[i].countType == PLY_NONE)
+						{
+							p = SkipToken(p, lineEnd);
+							continue;
+						}
+						long long count;
+						if (!ParseInt(p, lineEnd, count) || count < 0)
+						{
+							part.failed = true;
+							break;
+						}
+						polygon.clear();
+						for (long long k = 0; k < count; k++)
+						{
+							long long index;
+							if (i != header.indexProperty)
+								p = SkipToken(p, lineEnd);
+							else if (ParseInt(p, lineEnd, index))
+								polygon.push_back(index >= 0 && index <= 0x7FFFFFFF ? (int)index : -1);
+							else
+								part.failed = true;
+						}
+						if (i == header.indexProperty && !AddPolygon(part.corners, polygon)) part.failed = true;
+					}
+				}
+				p = lineEnd + 1;
+			}
+		}
+	}
+
+	// Returns the end of the items of a binary element, or 0 if the data ends early
+	const unsigned char * SkipItems(const PlyElement & element, const unsigned char * p, const unsigned char * end, bool swap)
+	{
+		for (long long i = 0; i < element.count; i++)
+		{
+			for (size_t j = 0; j < element.properties.size(); j++)
+			{
+				const PlyProperty & property = element.properties[j];
+				size_t count = 1;
+				if (property.countType != PLY_NONE)
+				{
+					if ((size_t)(end - p) < (size_t)PlySizes[property.countType]) return 0;
+					double n = ReadValue(p, property.countType, swap);
+					if (n < 0.0) return 0;
+					p += PlySizes[property.countType];
+					count = (size_t)n;
+				}
+				if ((size_t)(end - p) / PlySizes[property.type] < count) return 0;
+				p += count * PlySizes[property.type];
+			}
+		}
+		return p;
+	}
+
+	struct BinaryPlyJob
+	{
+		const PlyHeader * header;
+		const unsigned char * data;
+		bool swap;
+		size_t stride;
+		size_t countOffset;		// offset of the index count in a face
+		MeshData * mesh;
+		std::atomic<int> failed;
+	};
+
+	void ReadPlyVertices(void * context, int begin, int end, int)
+	{
+		BinaryPlyJob * job = (BinaryPlyJob *)context;
+		const PlyHeader & header = *job->header;
+		const PlyProperty * properties = &header.elements[header.vertexElement].properties[0];
+		for (int i = begin; i < end; i++)
+		{
+			const unsigned char * p = job->data + (size_t)i * header.vertexSize;
+			double values[ATTR_COUNT] = { 0 };
+			for (int a = 0; a < ATTR_COUNT; a++)
+				if (header.attributes[a] >= 0) values[a] = ReadValue(p + header.offsets[a], properties[header.attributes[a]].type, job->swap);
+			StoreVertex(*job->mesh, header, i, values);
+		}
+	}
+
+	// Reads faces of exactly three corners at a fixed stride
+	void ReadPlyTriangles(void * context, int begin, int end, int)
+	{
+		BinaryPlyJob * job = (BinaryPlyJob *)context;
+		const PlyProperty & list = job->header->elements[job->header->faceElement].properties[job->header->indexProperty];
+		int * corners = &job->mesh->corners[0];
+		for (int i = begin; i < end; i++)
+		{
+			const unsigned char * p = job->data + (size_t)i * job->stride + job->countOffset;
+			if (ReadValue(p, list.countType, job->swap) != 3.0)
+			{
+				job->failed.store(1);
+				return;
+			}
+			p += PlySizes[list.countType];
+			for (int k = 0; k < 3; k++, p += PlySizes[list.type])
+				corners[(size_t)i * 3 + k] = ToIndex(ReadValue(p, list.type, job->swap));
+		}
+	}
+
+	int ReadPlyFaces(const PlyHeader & header, const unsigned char * p, const unsigned char * end, bool swap, JobSystem * jobs, MeshData & mesh)
+	{
+		const PlyElement & faces = header.elements[header.faceElement];
+		const PlyProperty & list = faces.properties[header.indexProperty];
+
+		// Faces are usually all triangles and have no other lists, so that they can be
+		// read in parallel at a fixed stride. Otherwise they are read one by one.
+		size_t before = 0, after = 0;
+		bool fixed = true;
+		for (int i = 0; i < (int)faces.properties.size(); i++)
+		{
+			if (i == header.indexProperty) continue;
+			if (faces.properties[i].countType != PLY_NONE) fixed = false;
+			(i < header.indexProperty ? before : after) += PlySizes[faces.properties[i].type];
+		}
+		size_t stride = before + PlySizes[list.countType] + 3 * PlySizes[list.type] + after;
+		if (faces.count > MaxTriangles) return MESHIMPORT_TOOLARGE;
+		if (fixed && faces.count > 0 && (size_t)(end - p) / stride >= (size_t)faces.count)
+		{
+			mesh.corners.resize((size_t)faces.count * 3);
+			BinaryPlyJob job;
+			job.header = &header;
+			job.data = p;
+			job.swap = swap;
+			job.stride = stride;
+			job.countOffset = before;
+			job.mesh = &mesh;
+			job.failed.store(0);
+			_ParallelFor(jobs, (int)faces.count, ItemChunk, ReadPlyTriangles, &job);
+			if (job.failed.load() == 0) return MESHIMPORT_OK;
+			mesh.corners.clear();
+		}
+
+		std::vector<int> polygon;
+		for (long long f = 0; f < faces.count; f++)
+		{
+			for (int i = 0; i < (int)faces.properties.size(); i++)
+			{
+				const PlyProperty & property = faces.properties[i];
+				size_t count = 1;
+				if (property.countType != PLY_NONE)
+				{
+					if ((size_t)(end - p) < (size_t)PlySizes[property.countType]) return MESHIMPORT_BADFORMAT;
+					double n = ReadValue(p, property.countType, swap);
+					if (n < 0.0) return MESHIMPORT_BADFORMAT;
+					p += PlySizes[property.countType];
+					count = (size_t)n;
+				}
+				if ((size_t)(end - p) / PlySizes[property.type] < count) return MESHIMPORT_BADFORMAT;
+				if (i == header.indexProperty)
+				{
+					polygon.clear();
+					for (size_t k = 0; k < count; k++)
+						polygon.push_back(ToIndex(ReadValue(p + k * PlySizes[property.type], property.type, swap)));
+					if (!AddPolygon(mesh.corners, polygon)) return MESHIMPORT_BADFORMAT;
+					if (mesh.corners.size() > (size_t)MaxTriangles * 3) return MESHIMPORT_TOOLARGE;
+				}
+				p += count * PlySizes[property.type];
+			}
+		}
+		return MESHIMPORT_OK;
+	}
+
+	int ParsePly(const char * data, size_t size, JobSystem * jobs, MeshData & mesh, MemoryTally & memory)
+	{
+		PlyHeader header;
+		if (!ReadPlyHeader(data, size, header) || !ReadPlyLayout(header)) return MESHIMPORT_BADFORMAT;
+
+		long long vertexCount = header.elements[header.vertexElement].count;
+		if (vertexCount > 0x7FFFFFFF) return MESHIMPORT_TOOLARGE;
+		mesh.positions.resize((size_t)vertexCount * 3);
+		if (HasNormals(header)) mesh.normals.resize((size_t)vertexCount * 3);
+		if (HasColors(header)) mesh.colors.resize((size_t)vertexCount);
+		memory.Add(mesh.Size());
+
+		const char * body = data + header.dataStart;
+		size_t bodySize = size - header.dataStart;
+		if (header.encoding == PLY_ASCII)
+		{
+			// Each item of an element is on its own line
+			long long line = 0;
+			header.firstLines[0] = header.firstLines[1] = -1;
+			for (int e = 0; e < (int)header.elements.size(); e++)
+			{
+				if (e == header.vertexElement) header.firstLines[0] = line;
+				if (e == header.faceElement) header.firstLines[1] = line;
+				line += header.elements[e].count;
+			}
+			long long lines = 0;
+			int result = ParseText(body, bodySize, &header, ParsePlyChunks, jobs, mesh, memory, &lines);
+
+			// Missing lines leave vertices or faces unread
+			return (result == MESHIMPORT_OK && lines < line ? MESHIMPORT_BADFORMAT : result);
+		}
+
+		// Binary elements are located one after the other
+		bool swap = (header.encoding == PLY_BIGENDIAN);
+		const unsigned char * p = (const unsigned char *)body, * end = p + bodySize;
+		const unsigned char * vertices = 0, * faces = 0;
+		for (int e = 0; e < (int)header.elements.size(); e++)
+		{
+			if (e == header.vertexElement) vertices = p;
+			if (e == header.faceElement) faces = p;
+			if (vertices != 0 && (faces != 0 || header.faceElement < 0)) break;
+			p = SkipItems(header.elements[e], p, end, swap);
+			if (p == 0) return MESHIMPORT_BADFORMAT;
+		}
+		if ((size_t)(end - vertices) / header.vertexSize < (size_t)vertexCount) return MESHIMPORT_BADFORMAT;
+
+		BinaryPlyJob job;
+		job.header = &header;
+		job.data = vertices;
+		job.swap = swap;
+		job.stride = header.vertexSize;
+		job.countOffset = 0;
+		job.mesh = &mesh;
+		job.failed.store(0);
+		_ParallelFor(jobs, (int)vertexCount, ItemChunk, ReadPlyVertices, &job);
+		if (faces == 0) return MESHIMPORT_OK;
+
+		int result = ReadPlyFaces(header, faces, end, swap, jobs, mesh);
+		memory.Add(Bytes(mesh.corners));
+		return result;
+	}
+
+	// Vertex merging
+
+	// Grid cell of a coordinate, or its bits for exact merging. Negative zero is
+	// merged with positive zero.
+	inline long long CellOf(float v, double scale)
+	{
+		if (scale == 0.0)
+		{
+			if (v == 0.0f) v = 0.0f;
+			int bits;
+			memcpy(&bits, &v, sizeof(bits));
+			return bits;
+		}
+		double cell = floor((double)v * scale + 0.5);
+		return (long long)(cell < -4e18 ? -4e18 : (cell > 4e18 ? 4e18 : cell));
+	}
+
+	inline unsigned int HashCell(const float * p, double scale)
+	{
+		unsigned long long h = (unsigned long long)CellOf(p[0], scale) * 0x9E3779B97F4A7C15ULL;
+		h ^= (unsigned long long)CellOf(p[1], scale) * 0xC2B2AE3D27D4EB4FULL + (h >> 29);
+		h ^= (unsigned long long)CellOf(p[2], scale) * 0x165667B19E3779F9ULL + (h >> 31);
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 33;
+		return (unsigned int)h;
+	}
+
+	inline bool SameCell(const float * a, const float * b, double scale)
+	{
+		return (CellOf(a[0], scale) == CellOf(b[0], scale) && CellOf(a[1], scale) == CellOf(b[1], scale) && CellOf(a[2], scale) == CellOf(b[2], scale));
+	}
+
+	struct WeldJob
+	{
+		const float * positions;
+		int count;
+		double scale;
+		std::vector<unsigned int> hashes;
+		std::vector<int> first;				// first vertex in the same cell
+		std::vector<int> order;				// vertices grouped by partition, then the new index of each vertex
+		std::vector<int> offsets;			// next slot of each partition in each chunk
+		std::vector<int> partitions;		// first slot of each partition
+		std::vector<int> uniqueOffsets;		// first new index of each chunk
+		std::vector<std::vector<int> > tables;
+	};
+
+	void HashVertices(void * context, int begin, int end, int)
+	{
+		WeldJob * job = (WeldJob *)context;
+		int * counts = &job->offsets[(size_t)(begin / ItemChunk) * PartitionCount];
+		for (int i = begin; i < end; i++)
+		{
+			unsigned int h = HashCell(job->positions + (size_t)i * 3, job->scale);
+			job->hashes[i] = h;
+			counts[h >> (32 - PartitionBits)]++;
+		}
+	}
+
+	// Vertices keep their order within each partition
+	void ScatterVertices(void * context, int begin, int end, int)
+	{
+		WeldJob * job = (WeldJob *)context;
+		int * offsets = &job->offsets[(size_t)(begin / ItemChunk) * PartitionCount];
+		for (int i = begin; i < end; i++)
+			job->order[offsets[job->hashes[i] >> (32 - PartitionBits)]++] = i;
+	}
+
+	// Merges each partition with an open addressing table, so that every vertex
+	// points to the first vertex in its cell
+	void MergePartitions(void * context, int begin, int end, int worker)
+	{
+		WeldJob * job = (WeldJob *)context;
+		std::vector<int> & table = job->tables[worker];
+		for (int partition = begin; partition < end; partition++)
+		{
+			int start = job->partitions[partition], count = job->partitions[partition + 1] - start;
+			if (count == 0) continue;
+			size_t size = 16;
+			while (size < (size_t)count * 2) size *= 2;
+			table.assign(size, -1);
+			size_t mask = size - 1;
+			for (int k = start; k < start + count; k++)
+			{
+				int v = job->order[k];
+				unsigned int h = job->hashes[v];
+				for (size_t slot = h & mask;; slot = (slot + 1) & mask)
+				{
+					int other = table[slot];
+					if (other < 0)
+					{
+						table[slot] = v;
+						job->first[v] = v;
+						break;
+					}
+					if (job->hashes[other] == h && SameCell(job->positions + (size_t)v * 3, job->positions + (size_t)other * 3, job->scale))
+					{
+						job->first[v] = other;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	void CountUnique(void * context, int begin, int end, int)
+	{
+		WeldJob * job = (WeldJob *)context;
+		int count = 0;
+		for (int i = begin; i < end; i++)
+			if (job->first[i] == i) count++;
+		job->uniqueOffsets[begin / ItemChunk] = count;
+	}
+
+	// New indices follow the order in which vertices first appear
+	void NumberUnique(void * context, int begin, int end, int)
+	{
+		WeldJob * job = (WeldJob *)context;
+		int next = job->uniqueOffsets[begin / ItemChunk];
+		for (int i = begin; i < end; i++)
+			if (job->first[i] == i) job->order[i] = next++;
+	}
+
+	void NumberDuplicates(void * context, int begin, int end, int)
+	{
+		WeldJob * job = (WeldJob *)context;
+		for (int i = begin; i < end; i++)
+			if (job->first[i] != i) job->order[i] = job->order[job->first[i]];
+	}
+
+	// Finds the new index of each vertex; returns the number of distinct vertices
+	int Weld(const MeshData & mesh, float tolerance, JobSystem * jobs, WeldJob & job, MemoryTally & memory)
+	{
+		int count = (int)(mesh.positions.size() / 3);
+		int chunks = (count + ItemChunk - 1) / ItemChunk;
+		job.positions = (count != 0 ? &mesh.positions[0] : 0);
+		job.count = count;
+		job.scale = (tolerance > 0.0f ? 1.0 / (double)tolerance : 0.0);
+		job.hashes.resize(count);
+		job.first.resize(count);
+		job.order.resize(count);
+		job.offsets.assign((size_t)chunks * PartitionCount, 0);
+		job.partitions.resize(PartitionCount + 1);
+		job.uniqueOffsets.resize(chunks);
+		job.tables.resize(_JobThreadCount(jobs));
+		if (count == 0) return 0;
+		_ParallelFor(jobs, count, ItemChunk, HashVertices, &job);
+
+		// Partitions are laid out one after the other, with the vertices of each
+		// chunk in chunk order
+		int slot = 0;
+		for (int partition = 0; partition < PartitionCount; partition++)
+		{
+			job.partitions[partition] = slot;
+			for (int chunk = 0; chunk < chunks; chunk++)
+			{
+				int & offset = job.offsets[(size_t)chunk * PartitionCount + partition];
+				int n = offset;
+				offset = slot;
+				slot += n;
+			}
+		}
+		job.partitions[PartitionCount] = slot;
+		_ParallelFor(jobs, count, ItemChunk, ScatterVertices, &job);
+		_ParallelFor(jobs, PartitionCount, PartitionChunk, MergePartitions, &job);
+
+		long long tableBytes = 0;
+		for (size_t i = 0; i < job.tables.size(); i++)
+			tableBytes += Bytes(job.tables[i]);
+		memory.Add(Bytes(job.hashes) + Bytes(job.first) + Bytes(job.order) + Bytes(job.offsets) + tableBytes);
+
+		_ParallelFor(jobs, count, ItemChunk, CountUnique, &job);
+		int unique = 0;
+		for (int chunk = 0; chunk < chunks; chunk++)
+		{
+			int n = job.uniqueOffsets[chunk];
+			job.uniqueOffsets[chunk] = unique;
+			unique += n;
+		}
+		_ParallelFor(jobs, count, ItemChunk, NumberUnique, &job);
+		_ParallelFor(jobs, count, ItemChunk, NumberDuplicates, &job);
+
+		memory.Remove(Bytes(job.hashes) + Bytes(job.offsets) + tableBytes);
+		Release(job.hashes);
+		Release(job.offsets);
+		Release(job.tables);
+		return unique;
+	}
+
+	// Mesh building
+
+	struct BuildJob
+	{
+		const MeshData * mesh;
+		const WeldJob * weld;
+		LitVertex * vertices;
+		unsigned int * indices;
+		int vertexCount;
+		std::atomic<int> failed;
+	};
+
+	void BuildVertices(void * context, int begin, int end, int)
+	{
+		BuildJob * job = (BuildJob *)context;
+		const MeshData & mesh = *job->mesh;
+		for (int i = begin; i < end; i++)
+		{
+			if (job->weld->first[i] != i) continue;
+			LitVertex & v = job->vertices[job->weld->order[i]];
+			const float * p = &mesh.positions[(size_t)i * 3];
+			v.x = p[0];
+			v.y = p[1];
+			v.z = p[2];
+			if (!mesh.normals.empty())
+			{
+				const float * n = &mesh.normals[(size_t)i * 3];
+				v.nx = n[0];
+				v.ny = n[1];
+				v.nz = n[2];
+			}
+			v.color = (mesh.colors.empty() ? 0xFFFFFFFF : mesh.colors[i]);
+		}
+	}
+
+	void BuildIndices(void * context, int begin, int end, int)
+	{
+		BuildJob * job = (BuildJob *)context;
+		const int * corners = (job->mesh->corners.empty() ? 0 : &job->mesh->corners[0]);
+		const int * remap = (job->weld->order.empty() ? 0 : &job->weld->order[0]);
+		for (int i = begin; i < end; i++)
+		{
+			int corner = (corners != 0 ? corners[i] : i);
+			if (corner < 0 || corner >= job->vertexCount)
+			{
+				job->failed.store(1);
+				return;
+			}
+			job->indices[i] = (unsigned int)remap[corner];
+		}
+	}
+
+	int FormatOfContents(const char * data, size_t size)
+	{
+		if (size >= 4 && memcmp(data, "ply", 3) == 0 && (data[3] == '\n' || data[3] == '\r')) return MESHFILE_PLY;
+		if (IsBinaryStl(data, size) || IsAsciiStl(data, size)) return MESHFILE_STL;
+		return MESHFILE_OBJ;
+	}
+
+	int FormatOfPath(const wchar_t * path)
+	{
+		const wchar_t * dot = wcsrchr(path, L'.');
+		if (dot == 0) return MESHFILE_AUTO;
+		if (_wcsicmp(dot, L".stl") == 0) return MESHFILE_STL;
+		if (_wcsicmp(dot, L".obj") == 0) return MESHFILE_OBJ;
+		if (_wcsicmp(dot, L".ply") == 0) return MESHFILE_PLY;
+		return MESHFILE_AUTO;
+	}
+}
+
+int _ImportMesh3D(const wchar_t * path, int format, float tolerance, JobSystem * jobs, Mesh3D * mesh, MeshImportInfo * info)
+{
+	Clock::time_point start = Clock::now();
+	HANDLE file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE) return MESHIMPORT_OPENFAILED;
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return MESHIMPORT_OPENFAILED;
+	}
+
+	// The whole file is mapped at once; empty files cannot be mapped
+	HANDLE mapping = 0;
+	const char * data = 0;
+	if (size.QuadPart != 0)
+	{
+		if ((unsigned long long)size.QuadPart <= (size_t)-1) mapping = CreateFileMappingW(file, 0, PAGE_READONLY, 0, 0, 0);
+		if (mapping != 0) data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data == 0)
+		{
+			if (mapping != 0) CloseHandle(mapping);
+			CloseHandle(file);
+			return MESHIMPORT_TOOLARGE;
+		}
+	}
+	double mapTime = Milliseconds(start, Clock::now());
+
+	if (format == MESHFILE_AUTO) format = FormatOfPath(path);
+	int result = _ParseMesh3D(data, (size_t)size.QuadPart, format, tolerance, jobs, mesh, info);
+
+	if (data != 0) UnmapViewOfFile(data);
+	if (mapping != 0) CloseHandle(mapping);
+	CloseHandle(file);
+	// The info is only filled in when the import succeeds
+	if (info != 0 && result == MESHIMPORT_OK)
+	{
+		info->parseTime += mapTime;
+		info->totalTime += mapTime;
+	}
+	return result;
+}
+
+int _ParseMesh3D(const char * data, size_t size, int format, float tolerance, JobSystem * jobs, Mesh3D * mesh, MeshImportInfo * info)
+{
+	Clock::time_point start = Clock::now();
+	MemoryTally memory = { 0, 0 };
+	MeshData input;
+	if (format == MESHFILE_AUTO) format = FormatOfContents(data, size);
+
+	int result = MESHIMPORT_BADFORMAT;
+	if (format == MESHFILE_STL) result = ParseStl(data, size, jobs, input, memory);
+	else if (format == MESHFILE_OBJ) result = ParseText(data, size, 0, ParseObjChunks, jobs, input, memory);
+	else if (format == MESHFILE_PLY) result = ParsePly(data, size, jobs, input, memory);
+	if (result != MESHIMPORT_OK) return result;
+	Clock::time_point parsed = Clock::now();
+
+	WeldJob weld;
+	int vertexCount = Weld(input, tolerance, jobs, weld, memory);
+	Clock::time_point welded = Clock::now();
+
+	// The mesh arrays are allocated at their final size and filled in parallel
+	int fileVertexCount = (int)(input.positions.size() / 3);
+	int indexCount = (input.corners.empty() ? fileVertexCount : (int)input.corners.size());
+	if (indexCount % 3 != 0) return MESHIMPORT_BADFORMAT;
+	BuildJob build;
+	build.mesh = &input;
+	build.weld = &weld;
+	build.vertices = (LitVertex *)_Allocate((size_t)(vertexCount > 0 ? vertexCount : 1) * sizeof(LitVertex));
+	build.indices = (unsigned int *)_Allocate((size_t)(indexCount > 0 ? indexCount : 1) * sizeof(unsigned int));
+	build.vertexCount = fileVertexCount;
+	build.failed.store(0);
+	memory.Add((long long)vertexCount * (long long)sizeof(LitVertex) + (long long)indexCount * (long long)sizeof(unsigned int));
+	_ParallelFor(jobs, fileVertexCount, ItemChunk, BuildVertices, &build);
+	_ParallelFor(jobs, indexCount, ItemChunk, BuildIndices, &build);
+	if (build.failed.load() != 0)
+	{
+		_Free(build.vertices);
+		_Free(build.indices);
+		return MESHIMPORT_BADFORMAT;
+	}
+
+	_Free(mesh->vertices);
+	_Free(mesh->indices);
+	mesh->vertices = build.vertices;
+	mesh->vertexCount = mesh->vertexCapacity = vertexCount;
+	mesh->indices = build.indices;
+	mesh->indexCount = mesh->indexCapacity = indexCount;
+	mesh->edgeCount = 0;
+	mesh->hasEdges = false;
+	if (input.normals.empty()) _SmoothNormals3D(mesh->vertices, vertexCount, mesh->indices, indexCount);
+	mesh->hasBounds = _StridedBounds(mesh->vertices, vertexCount, sizeof(LitVertex), 3, mesh->bounds, mesh->bounds + 3);
+	Clock::time_point built = Clock::now();
+
+	if (info != 0 && result == MESHIMPORT_OK)
+	{
+		info->format = format;
+		info->fileSize = (long long)size;
+		info->fileVertexCount = fileVertexCount;
+		info->triangleCount = indexCount / 3;
+		info->vertexCount = vertexCount;
+		info->parseTime = Milliseconds(start, parsed);
+		info->weldTime = Milliseconds(parsed, welded);
+		info->buildTime = Milliseconds(welded, built);
+		info->totalTime = Milliseconds(start, built);
+		info->peakMemory = memory.peak;
+	}
+	return MESHIMPORT_OK;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+// Native importer of triangle meshes from STL, OBJ and PLY files. Files are mapped
+// into memory and parsed in parallel chunks; vertices at the same position are merged
+// with a hash grid and the result is written into a Mesh3D ready to be uploaded. The
+// implementation is compiled without /clr.
+
+#include "JobSystem.h"
+#include "Mesh3D.h"
+
+#include <stddef.h>
+
+/// <summary>
+/// Mesh file formats.
+/// </summary>
+enum MeshFileFormat
+{
+	MESHFILE_AUTO,		// chosen from the file extension or contents
+	MESHFILE_STL,		// binary or ASCII stereolithography
+	MESHFILE_OBJ,		// Wavefront OBJ
+	MESHFILE_PLY		// ASCII or binary polygon file
+};
+
+/// <summary>
+/// Results of a mesh import.
+/// </summary>
+enum MeshImportResult
+{
+	MESHIMPORT_OK,
+	MESHIMPORT_OPENFAILED,	// the file could not be opened
+	MESHIMPORT_BADFORMAT,	// the contents do not match the format
+	MESHIMPORT_TOOLARGE		// the file does not fit in the address space or has too many triangles
+};
+
+/// <summary>
+/// Describes a mesh import. Times are in milliseconds; memory is the largest number
+/// of bytes held by the importer at once, not counting the mapped file.
+/// </summary>
+struct MeshImportInfo
+{
+	int format;
+	long long fileSize;
+	int fileVertexCount;	// vertices before merging; three per triangle for STL
+	int triangleCount;
+	int vertexCount;		// vertices after merging
+	double parseTime;
+	double weldTime;
+	double buildTime;
+	double totalTime;
+	long long peakMemory;
+};
+
+/// <summary>
+/// Imports a mesh file into mesh, replacing its data. Vertices whose coordinates
+/// round to the same multiples of tolerance are merged; a tolerance of zero merges
+/// vertices at exactly the same position. Normals are read from PLY files that have
+/// them and computed otherwise. Returns one of the MeshImportResult values; the mesh
+/// is only changed on success.
+/// </summary>
+int _ImportMesh3D(const wchar_t * path, int format, float tolerance, JobSystem * jobs, Mesh3D * mesh, MeshImportInfo * info);
+/// <summary>
+/// Imports mesh data held in memory. With MESHFILE_AUTO, STL and PLY data are
+/// recognized by their contents and other data is read as OBJ.
+/// </summary>
+int _ParseMesh3D(const char * data, size_t size, int format, float tolerance, JobSystem * jobs, Mesh3D * mesh, MeshImportInfo * info);
@@ -0,0 +1,38 @@
+// Native code, compiled without /clr.
+
+#include "NativeMemory.h"
+
+#include <atomic>
+#include <stdlib.h>
+
+namespace
+{
+	std::atomic<long long> gAllocations(0);
+}
+
+void * _Allocate(size_t size)
+{
+	gAllocations.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size);
+}
+
+void * _Reallocate(void * memory, size_t size)
+{
+	gAllocations.fetch_add(1, std::memory_order_relaxed);
+	return realloc(memory, size);
+}
+
+void _Free(void * memory)
+{
+	free(memory);
+}
+
+void _CountAllocation()
+{
+	gAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+long long _NativeAllocationCount()
+{
+	return gAllocations.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Native heap functions used by the native buffers. All allocations are counted
+// so that render statistics can show whether a frame allocated memory.
+
+#include <stddef.h>
+
+/// <summary>
+/// Allocates a block of memory.
+/// </summary>
+void * _Allocate(size_t size);
+/// <summary>
+/// Resizes a block of memory allocated with _Allocate. Existing contents are preserved.
+/// </summary>
+void * _Reallocate(void * memory, size_t size);
+/// <summary>
+/// Releases a block of memory allocated with _Allocate.
+/// </summary>
+void _Free(void * memory);
+/// <summary>
+/// Counts an allocation made by a container that does not use _Allocate.
+/// </summary>
+void _CountAllocation();
+/// <summary>
+/// Returns the number of native allocations made since the process started.
+/// </summary>
+long long _NativeAllocationCount();
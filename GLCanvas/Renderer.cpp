@@ -0,0 +1,861 @@
+// Native code, compiled without /clr.
+
+#include "Renderer.h"
+#include "GLExtensions.h"
+#include "NativeMemory.h"
+
+#include <windows.h>
+#include <GL/gl.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	// OpenGL 3.3 definitions missing from the OpenGL 1.1 headers
+	typedef char GLchar;
+	typedef ptrdiff_t GLsizeiptr;
+	typedef ptrdiff_t GLintptr;
+	const GLenum ArrayBuffer = 0x8892;
+	const GLenum ElementArrayBuffer = 0x8893;
+	const GLenum StreamDraw = 0x88E0;
+	const GLenum StaticDraw = 0x88E4;
+	const GLenum FragmentShader = 0x8B30;
+	const GLenum VertexShader = 0x8B31;
+	const GLenum CompileStatus = 0x8B81;
+	const GLenum LinkStatus = 0x8B82;
+
+	typedef void (APIENTRY * GenVertexArraysFunction)(GLsizei n, GLuint * arrays);
+	typedef void (APIENTRY * BindVertexArrayFunction)(GLuint array);
+	typedef void (APIENTRY * DeleteVertexArraysFunction)(GLsizei n, const GLuint * arrays);
+	typedef void (APIENTRY * GenBuffersFunction)(GLsizei n, GLuint * buffers);
+	typedef void (APIENTRY * BindBufferFunction)(GLenum target, GLuint buffer);
+	typedef void (APIENTRY * BufferDataFunction)(GLenum target, GLsizeiptr size, const void * data, GLenum usage);
+	typedef void (APIENTRY * BufferSubDataFunction)(GLenum target, GLintptr offset, GLsizeiptr size, const void * data);
+	typedef void (APIENTRY * DeleteBuffersFunction)(GLsizei n, const GLuint * buffers);
+	typedef GLuint (APIENTRY * CreateShaderFunction)(GLenum type);
+	typedef void (APIENTRY * ShaderSourceFunction)(GLuint shader, GLsizei count, const GLchar * const * string, const GLint * length);
+	typedef void (APIENTRY * CompileShaderFunction)(GLuint shader);
+	typedef void (APIENTRY * GetShaderivFunction)(GLuint shader, GLenum pname, GLint * params);
+	typedef void (APIENTRY * DeleteShaderFunction)(GLuint shader);
+	typedef GLuint (APIENTRY * CreateProgramFunction)(void);
+	typedef void (APIENTRY * AttachShaderFunction)(GLuint program, GLuint shader);
+	typedef void (APIENTRY * LinkProgramFunction)(GLuint program);
+	typedef void (APIENTRY * GetProgramivFunction)(GLuint program, GLenum pname, GLint * params);
+	typedef void (APIENTRY * DeleteProgramFunction)(GLuint program);
+	typedef void (APIENTRY * UseProgramFunction)(GLuint program);
+	typedef GLint (APIENTRY * GetUniformLocationFunction)(GLuint program, const GLchar * name);
+	typedef void (APIENTRY * Uniform1iFunction)(GLint location, GLint v0);
+	typedef void (APIENTRY * Uniform3fFunction)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+	typedef void (APIENTRY * Uniform4fFunction)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+	typedef void (APIENTRY * UniformMatrix4fvFunction)(GLint location, GLsizei count, GLboolean transpose, const GLfloat * value);
+	typedef void (APIENTRY * EnableVertexAttribArrayFunction)(GLuint index);
+	typedef void (APIENTRY * VertexAttribPointerFunction)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void * pointer);
+	typedef void (APIENTRY * VertexAttribDivisorFunction)(GLuint index, GLuint divisor);
+	typedef void (APIENTRY * DrawArraysInstancedFunction)(GLenum mode, GLint first, GLsizei count, GLsizei instancecount);
+
+	struct CoreFunctions
+	{
+		GenVertexArraysFunction GenVertexArrays;
+		BindVertexArrayFunction BindVertexArray;
+		DeleteVertexArraysFunction DeleteVertexArrays;
+		GenBuffersFunction GenBuffers;
+		BindBufferFunction BindBuffer;
+		BufferDataFunction BufferData;
+		BufferSubDataFunction BufferSubData;
+		DeleteBuffersFunction DeleteBuffers;
+		CreateShaderFunction CreateShader;
+		ShaderSourceFunction ShaderSource;
+		CompileShaderFunction CompileShader;
+		GetShaderivFunction GetShaderiv;
+		DeleteShaderFunction DeleteShader;
+		CreateProgramFunction CreateProgram;
+		AttachShaderFunction AttachShader;
+		LinkProgramFunction LinkProgram;
+		GetProgramivFunction GetProgramiv;
+		DeleteProgramFunction DeleteProgram;
+		UseProgramFunction UseProgram;
+		GetUniformLocationFunction GetUniformLocation;
+		Uniform1iFunction Uniform1i;
+		Uniform3fFunction Uniform3f;
+		Uniform4fFunction Uniform4f;
+		UniformMatrix4fvFunction UniformMatrix4fv;
+		EnableVertexAttribArrayFunction EnableVertexAttribArray;
+		VertexAttribPointerFunction VertexAttribPointer;
+		VertexAttribDivisorFunction VertexAttribDivisor;
+		DrawArraysInstancedFunction DrawArraysInstanced;
+	};
+
+	bool gLoaded = false;
+	bool gSupported = false;
+	bool gBuffersLoaded = false;
+	bool gBuffersSupported = false;
+	CoreFunctions gl;
+
+	// Vertex attribute locations of the programmable backend
+	const GLuint PositionAttribute = 0;
+	const GLuint ColorAttribute = 1;
+	const GLuint NormalAttribute = 2;
+	const GLuint TransformAttribute = 3;	// three rows, 3 to 5
+	const GLuint InstanceColorAttribute = 6;
+
+	// Colors are lit per vertex like the fixed function pipeline with one directional
+	// light, the default global ambient light and color material. Instanced draws
+	// take the transform and the color of each instance from per instance attributes.
+	const char * VertexSource =
+		"#version 330 core\n"
+		"uniform mat4 projection;\n"
+		"uniform mat4 modelview;\n"
+		"uniform vec3 light;\n"
+		"uniform int lit;\n"
+		"uniform int instanced;\n"
+		"uniform int solid;\n"
+		"uniform vec4 solidColor;\n"
+		"layout(location = 0) in vec3 position;\n"
+		"layout(location = 1) in vec4 color;\n"
+		"layout(location = 2) in vec3 normal;\n"
+		"layout(location = 3) in vec4 row0;\n"
+		"layout(location = 4) in vec4 row1;\n"
+		"layout(location = 5) in vec4 row2;\n"
+		"layout(location = 6) in vec4 instanceColor;\n"
+		"out vec4 vColor;\n"
+		"void main()\n"
+		"{\n"
+		"	vec3 p = position;\n"
+		"	vec3 m = normal;\n"
+		"	vColor = color;\n"
+		"	if (instanced != 0)\n"
+		"	{\n"
+		"		p = vec3(dot(row0, vec4(position, 1.0)), dot(row1, vec4(position, 1.0)), dot(row2, vec4(position, 1.0)));\n"
+		"		m = vec3(dot(row0.xyz, normal), dot(row1.xyz, normal), dot(row2.xyz, normal));\n"
+		"		vColor = instanceColor;\n"
+		"	}\n"
+		"	if (solid != 0) vColor = solidColor;\n"
+		"	gl_Position = projection * (modelview * vec4(p, 1.0));\n"
+		"	if (lit != 0)\n"
+		"	{\n"
+		"		vec3 n = mat3(modelview) * m;\n"
+		"		float length2 = dot(n, n);\n"
+		"		float diffuse = (length2 > 0.0 ? max(dot(n, light), 0.0) * inversesqrt(length2) : 0.0);\n"
+		"		vColor.rgb = min(vColor.rgb * (0.2 + diffuse), vec3(1.0));\n"
+		"	}\n"
+		"}\n";
+
+	const char * FragmentSource =
+		"#version 330 core\n"
+		"in vec4 vColor;\n"
+		"out vec4 fragColor;\n"
+		"void main()\n"
+		"{\n"
+		"	fragColor = vColor;\n"
+		"}\n";
+
+	template <class T> bool Load(T & function, const char * name)
+	{
+		function = (T)_GetGLFunction(name);
+		return function != 0;
+	}
+
+	// Returns true if the OpenGL version of the current context is at least the given one
+	bool HasVersion(int requiredMajor, int requiredMinor)
+	{
+		const char * version = (const char *)glGetString(GL_VERSION);
+		if (version == 0) return false;
+		int major = atoi(version);
+		const char * dot = strchr(version, '.');
+		int minor = (dot != 0 ? atoi(dot + 1) : 0);
+		return major > requiredMajor || (major == requiredMajor && minor >= requiredMinor);
+	}
+
+	// Returns true if the current context is OpenGL 3.3 or later and provides the
+	// functions of the programmable backend
+	bool LoadFunctions()
+	{
+		if (!HasVersion(3, 3)) return false;
+
+		if (gLoaded) return gSupported;
+		gLoaded = true;
+		gSupported = Load(gl.GenVertexArrays, "glGenVertexArrays") && Load(gl.BindVertexArray, "glBindVertexArray") &&
+			Load(gl.DeleteVertexArrays, "glDeleteVertexArrays") && Load(gl.GenBuffers, "glGenBuffers") &&
+			Load(gl.BindBuffer, "glBindBuffer") && Load(gl.BufferData, "glBufferData") &&
+			Load(gl.BufferSubData, "glBufferSubData") && Load(gl.DeleteBuffers, "glDeleteBuffers") &&
+			Load(gl.CreateShader, "glCreateShader") && Load(gl.ShaderSource, "glShaderSource") &&
+			Load(gl.CompileShader, "glCompileShader") && Load(gl.GetShaderiv, "glGetShaderiv") &&
+			Load(gl.DeleteShader, "glDeleteShader") && Load(gl.CreateProgram, "glCreateProgram") &&
+			Load(gl.AttachShader, "glAttachShader") && Load(gl.LinkProgram, "glLinkProgram") &&
+			Load(gl.GetProgramiv, "glGetProgramiv") && Load(gl.DeleteProgram, "glDeleteProgram") &&
+			Load(gl.UseProgram, "glUseProgram") && Load(gl.GetUniformLocation, "glGetUniformLocation") &&
+			Load(gl.Uniform1i, "glUniform1i") && Load(gl.Uniform3f, "glUniform3f") && Load(gl.Uniform4f, "glUniform4f") &&
+			Load(gl.UniformMatrix4fv, "glUniformMatrix4fv") &&
+			Load(gl.EnableVertexAttribArray, "glEnableVertexAttribArray") &&
+			Load(gl.VertexAttribPointer, "glVertexAttribPointer") &&
+			Load(gl.VertexAttribDivisor, "glVertexAttribDivisor") &&
+			Load(gl.DrawArraysInstanced, "glDrawArraysInstanced");
+		return gSupported;
+	}
+
+	// Returns true if the current context is OpenGL 1.5 or later and provides the
+	// vertex buffer object functions used by the fixed function backend
+	bool LoadBufferFunctions()
+	{
+		if (!HasVersion(1, 5)) return false;
+
+		if (gBuffersLoaded) return gBuffersSupported;
+		gBuffersLoaded = true;
+		gBuffersSupported = Load(gl.GenBuffers, "glGenBuffers") && Load(gl.BindBuffer, "glBindBuffer") &&
+			Load(gl.BufferData, "glBufferData") && Load(gl.BufferSubData, "glBufferSubData") &&
+			Load(gl.DeleteBuffers, "glDeleteBuffers");
+		return gBuffersSupported;
+	}
+
+	GLuint Compile(GLenum type, const char * source)
+	{
+		GLuint shader = gl.CreateShader(type);
+		gl.ShaderSource(shader, 1, &source, 0);
+		gl.CompileShader(shader);
+		GLint status = 0;
+		gl.GetShaderiv(shader, CompileStatus, &status);
+		if (status == 0)
+		{
+			gl.DeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+
+	GLuint Link(GLuint vertex, GLuint fragment)
+	{
+		GLuint program = gl.CreateProgram();
+		gl.AttachShader(program, vertex);
+		gl.AttachShader(program, fragment);
+		gl.LinkProgram(program);
+		GLint status = 0;
+		gl.GetProgramiv(program, LinkStatus, &status);
+		if (status == 0)
+		{
+			gl.DeleteProgram(program);
+			return 0;
+		}
+		return program;
+	}
+}
+
+/// <summary>
+/// Backend entry points. Each backend provides one table.
+/// </summary>
+struct RendererFunctions
+{
+	void (* destroy)(Renderer * renderer);
+	void (* setTransform)(Renderer * renderer, const float * projection, const float * modelview);
+	void (* setLighting)(Renderer * renderer, bool enabled, const float * direction);
+	void (* drawColor)(Renderer * renderer, GLenum mode, const ColorVertex * vertices, int count, const StripList * strips);
+	void (* drawLit)(Renderer * renderer, GLenum mode, const LitVertex * vertices, int count);
+	void (* drawInstances)(Renderer * renderer, GLenum mode, const LitVertex * vertices, int count, const MeshInstance * instances, int instanceCount);
+	void (* drawGeometry)(Renderer * renderer, const RenderGeometry * geometry, int parts, const float * transform, bool recolor, unsigned int color);
+};
+
+struct Renderer
+{
+	const RendererFunctions * functions;
+	int backend;
+	bool lighting;
+
+	// Programmable backend objects; one streamed vertex buffer for each vertex format
+	GLuint program;
+	GLint projectionLocation, modelviewLocation, lightLocation, litLocation, instancedLocation;
+	GLint solidLocation, solidColorLocation;
+	float modelview[16];
+	GLuint colorArray, colorBuffer;
+	GLuint litArray, litBuffer;
+	GLuint meshArray, meshBuffer, instanceBuffer;
+	size_t colorCapacity, litCapacity, meshCapacity, instanceCapacity;
+};
+
+struct RenderGeometry
+{
+	// Vertex buffer object holding the triangles followed by the lines, or 0 if the
+	// vertices are kept in native memory
+	GLuint buffer;
+	// Vertex array object of the programmable backend
+	GLuint array;
+	LitVertex * vertices;
+	// Indexed geometry keeps the triangle indices followed by the line indices in an
+	// element buffer object, or in native memory along with the vertices
+	bool indexed;
+	GLuint elements;
+	unsigned int * indices;
+	// Numbers of vertices, or of indices for indexed geometry
+	int triangleCount, lineCount;
+};
+
+namespace
+{
+	// Draws the selected parts of geometry whose buffers are bound. Offsets are relative
+	// to the native copies if the geometry has no buffer objects.
+	void DrawParts(const RenderGeometry * geometry, int parts)
+	{
+		if (geometry->indexed)
+		{
+			const unsigned int * indices = (geometry->elements != 0 ? 0 : geometry->indices);
+			if ((parts & RENDERGEOMETRY_TRIANGLES) != 0 && geometry->triangleCount != 0)
+				glDrawElements(GL_TRIANGLES, geometry->triangleCount, GL_UNSIGNED_INT, indices);
+			if ((parts & RENDERGEOMETRY_LINES) != 0 && geometry->lineCount != 0)
+				glDrawElements(GL_LINES, geometry->lineCount, GL_UNSIGNED_INT, indices + geometry->triangleCount);
+			return;
+		}
+		if ((parts & RENDERGEOMETRY_TRIANGLES) != 0 && geometry->triangleCount != 0)
+			glDrawArrays(GL_TRIANGLES, 0, geometry->triangleCount);
+		if ((parts & RENDERGEOMETRY_LINES) != 0 && geometry->lineCount != 0)
+			glDrawArrays(GL_LINES, geometry->triangleCount, geometry->lineCount);
+	}
+
+	// Fixed function backend
+
+	void FixedDestroy(Renderer *)
+	{
+	}
+
+	void FixedSetTransform(Renderer *, const float * projection, const float * modelview)
+	{
+		glMatrixMode(GL_PROJECTION);
+		glLoadMatrixf(projection);
+		glMatrixMode(GL_MODELVIEW);
+		glLoadMatrixf(modelview);
+	}
+
+	void FixedSetLighting(Renderer * renderer, bool enabled, const float * direction)
+	{
+		renderer->lighting = enabled;
+		if (!enabled)
+		{
+			glDisable(GL_LIGHTING);
+			return;
+		}
+
+		// Light positions are transformed by the modelview matrix when they are set
+		GLfloat position[4] = { direction[0], direction[1], direction[2], 0.0f };
+		glMatrixMode(GL_MODELVIEW);
+		glPushMatrix();
+		glLoadIdentity();
+		glLightfv(GL_LIGHT0, GL_POSITION, position);
+		glPopMatrix();
+		glEnable(GL_LIGHTING);
+		glEnable(GL_LIGHT0);
+		glEnable(GL_COLOR_MATERIAL);
+		glEnable(GL_NORMALIZE);
+	}
+
+	void FixedDrawColor(Renderer * renderer, GLenum mode, const ColorVertex * vertices, int count, const StripList * strips)
+	{
+		if (renderer->lighting) glDisable(GL_LIGHTING);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glVertexPointer(3, GL_FLOAT, sizeof(ColorVertex), &vertices->x);
+		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ColorVertex), &vertices->color);
+		if (strips != 0)
+			_MultiDrawArrays(mode, strips->firsts, strips->counts, strips->count);
+		else
+			glDrawArrays(mode, 0, count);
+		if (renderer->lighting) glEnable(GL_LIGHTING);
+	}
+
+	void FixedDrawLit(Renderer *, GLenum mode, const LitVertex * vertices, int count)
+	{
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glVertexPointer(3, GL_FLOAT, sizeof(LitVertex), &vertices->x);
+		glNormalPointer(GL_FLOAT, sizeof(LitVertex), &vertices->nx);
+		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(LitVertex), &vertices->color);
+		glDrawArrays(mode, 0, count);
+		glDisableClientState(GL_NORMAL_ARRAY);
+	}
+
+	void FixedDrawInstances(Renderer *, GLenum mode, const LitVertex * vertices, int count, const MeshInstance * instances, int instanceCount)
+	{
+		// The mesh arrays are set once; each instance sets its matrix and color
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glDisableClientState(GL_COLOR_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glVertexPointer(3, GL_FLOAT, sizeof(LitVertex), &vertices->x);
+		glNormalPointer(GL_FLOAT, sizeof(LitVertex), &vertices->nx);
+		glMatrixMode(GL_MODELVIEW);
+		for (int i = 0; i < instanceCount; i++)
+		{
+			const float * t = instances[i].transform;
+			const GLfloat matrix[16] =
+			{
+				t[0], t[4], t[8], 0.0f,
+				t[1], t[5], t[9], 0.0f,
+				t[2], t[6], t[10], 0.0f,
+				t[3], t[7], t[11], 1.0f
+			};
+			glPushMatrix();
+			glMultMatrixf(matrix);
+			glColor4ubv((const GLubyte *)&instances[i].color);
+			glDrawArrays(mode, 0, count);
+			glPopMatrix();
+		}
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+	}
+
+	void FixedDrawGeometry(Renderer *, const RenderGeometry * geometry, int parts, const float * transform, bool recolor, unsigned int color)
+	{
+		glMatrixMode(GL_MODELVIEW);
+		glPushMatrix();
+		glMultMatrixf(transform);
+
+		// Pointers are offsets into the vertex buffer object if there is one
+		const char * base = (const char *)geometry->vertices;
+		if (geometry->buffer != 0) gl.BindBuffer(ArrayBuffer, geometry->buffer);
+		if (geometry->elements != 0) gl.BindBuffer(ElementArrayBuffer, geometry->elements);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glVertexPointer(3, GL_FLOAT, sizeof(LitVertex), base + offsetof(LitVertex, x));
+		glNormalPointer(GL_FLOAT, sizeof(LitVertex), base + offsetof(LitVertex, nx));
+		if (recolor)
+		{
+			glDisableClientState(GL_COLOR_ARRAY);
+			glColor4ubv((const GLubyte *)&color);
+		}
+		else
+		{
+			glEnableClientState(GL_COLOR_ARRAY);
+			glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(LitVertex), base + offsetof(LitVertex, color));
+		}
+		DrawParts(geometry, parts);
+		if (geometry->buffer != 0) gl.BindBuffer(ArrayBuffer, 0);
+		if (geometry->elements != 0) gl.BindBuffer(ElementArrayBuffer, 0);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+
+		glPopMatrix();
+	}
+
+	const RendererFunctions FixedFunctions =
+	{
+		FixedDestroy, FixedSetTransform, FixedSetLighting, FixedDrawColor, FixedDrawLit, FixedDrawInstances, FixedDrawGeometry
+	};
+
+	// Programmable backend
+
+	void CoreDestroy(Renderer * renderer)
+	{
+		gl.DeleteVertexArrays(1, &renderer->colorArray);
+		gl.DeleteVertexArrays(1, &renderer->litArray);
+		gl.DeleteBuffers(1, &renderer->colorBuffer);
+		gl.DeleteBuffers(1, &renderer->litBuffer);
+		gl.DeleteVertexArrays(1, &renderer->meshArray);
+		gl.DeleteBuffers(1, &renderer->meshBuffer);
+		gl.DeleteBuffers(1, &renderer->instanceBuffer);
+		gl.DeleteProgram(renderer->program);
+	}
+
+	void CoreSetTransform(Renderer * renderer, const float * projection, const float * modelview)
+	{
+		gl.UseProgram(renderer->program);
+		gl.UniformMatrix4fv(renderer->projectionLocation, 1, GL_FALSE, projection);
+		gl.UniformMatrix4fv(renderer->modelviewLocation, 1, GL_FALSE, modelview);
+		gl.UseProgram(0);
+		memcpy(renderer->modelview, modelview, sizeof(renderer->modelview));
+	}
+
+	void CoreSetLighting(Renderer * renderer, bool enabled, const float * direction)
+	{
+		renderer->lighting = enabled;
+		float x = direction[0], y = direction[1], z = direction[2];
+		float length = sqrtf(x * x + y * y + z * z);
+		if (length > 0) { x /= length; y /= length; z /= length; }
+		gl.UseProgram(renderer->program);
+		gl.Uniform3f(renderer->lightLocation, x, y, z);
+		gl.UseProgram(0);
+	}
+
+	// Replaces the contents of the bound vertex buffer. The old storage is orphaned so
+	// that the driver does not wait for draws still reading it.
+	void Upload(size_t & capacity, const void * data, size_t size)
+	{
+		if (size > capacity)
+		{
+			capacity *= 2;
+			if (capacity < 65536) capacity = 65536;
+			if (capacity < size) capacity = size;
+		}
+		gl.BufferData(ArrayBuffer, (GLsizeiptr)capacity, 0, StreamDraw);
+		gl.BufferSubData(ArrayBuffer, 0, (GLsizeiptr)size, data);
+	}
+
+	void CoreDrawColor(Renderer * renderer, GLenum mode, const ColorVertex * vertices, int count, const StripList * strips)
+	{
+		gl.UseProgram(renderer->program);
+		gl.Uniform1i(renderer->litLocation, 0);
+		gl.BindVertexArray(renderer->colorArray);
+		gl.BindBuffer(ArrayBuffer, renderer->colorBuffer);
+		Upload(renderer->colorCapacity, vertices, (size_t)count * sizeof(ColorVertex));
+		if (strips != 0)
+			_MultiDrawArrays(mode, strips->firsts, strips->counts, strips->count);
+		else
+			glDrawArrays(mode, 0, count);
+
+		// Leave the default bindings for code still using client vertex arrays
+		gl.BindBuffer(ArrayBuffer, 0);
+		gl.BindVertexArray(0);
+		gl.UseProgram(0);
+	}
+
+	void CoreDrawLit(Renderer * renderer, GLenum mode, const LitVertex * vertices, int count)
+	{
+		gl.UseProgram(renderer->program);
+		gl.Uniform1i(renderer->litLocation, renderer->lighting ? 1 : 0);
+		gl.BindVertexArray(renderer->litArray);
+		gl.BindBuffer(ArrayBuffer, renderer->litBuffer);
+		Upload(renderer->litCapacity, vertices, (size_t)count * sizeof(LitVertex));
+		glDrawArrays(mode, 0, count);
+		gl.BindBuffer(ArrayBuffer, 0);
+		gl.BindVertexArray(0);
+		gl.UseProgram(0);
+	}
+
+	void CoreDrawInstances(Renderer * renderer, GLenum mode, const LitVertex * vertices, int count, const MeshInstance * instances, int instanceCount)
+	{
+		gl.UseProgram(renderer->program);
+		gl.Uniform1i(renderer->litLocation, renderer->lighting ? 1 : 0);
+		gl.Uniform1i(renderer->instancedLocation, 1);
+		gl.BindVertexArray(renderer->meshArray);
+		gl.BindBuffer(ArrayBuffer, renderer->meshBuffer);
+		Upload(renderer->meshCapacity, vertices, (size_t)count * sizeof(LitVertex));
+		gl.BindBuffer(ArrayBuffer, renderer->instanceBuffer);
+		Upload(renderer->instanceCapacity, instances, (size_t)instanceCount * sizeof(MeshInstance));
+		gl.DrawArraysInstanced(mode, 0, count, instanceCount);
+		gl.Uniform1i(renderer->instancedLocation, 0);
+		gl.BindBuffer(ArrayBuffer, 0);
+		gl.BindVertexArray(0);
+		gl.UseProgram(0);
+	}
+
+	// Multiplies two column-major 4x4 matrices
+	void Multiply(float * result, const float * a, const float * b)
+	{
+		for (int column = 0; column < 4; column++)
+			for (int row = 0; row < 4; row++)
+				result[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] +
+					a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+	}
+
+	void CoreDrawGeometry(Renderer * renderer, const RenderGeometry * geometry, int parts, const float * transform, bool recolor, unsigned int color)
+	{
+		float modelview[16];
+		Multiply(modelview, renderer->modelview, transform);
+		gl.UseProgram(renderer->program);
+		gl.Uniform1i(renderer->litLocation, renderer->lighting ? 1 : 0);
+		gl.UniformMatrix4fv(renderer->modelviewLocation, 1, GL_FALSE, modelview);
+		if (recolor)
+		{
+			const unsigned char * c = (const unsigned char *)&color;
+			gl.Uniform1i(renderer->solidLocation, 1);
+			gl.Uniform4f(renderer->solidColorLocation, c[0] / 255.0f, c[1] / 255.0f, c[2] / 255.0f, c[3] / 255.0f);
+		}
+		gl.BindVertexArray(geometry->array);
+		DrawParts(geometry, parts);
+		gl.BindVertexArray(0);
+
+		// Restore the camera transform for streamed draws
+		gl.UniformMatrix4fv(renderer->modelviewLocation, 1, GL_FALSE, renderer->modelview);
+		if (recolor) gl.Uniform1i(renderer->solidLocation, 0);
+		gl.UseProgram(0);
+	}
+
+	// Records the lit vertex format of the bound vertex buffer in the bound vertex array
+	void SetLitFormat()
+	{
+		gl.EnableVertexAttribArray(PositionAttribute);
+		gl.EnableVertexAttribArray(ColorAttribute);
+		gl.EnableVertexAttribArray(NormalAttribute);
+		gl.VertexAttribPointer(PositionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(LitVertex), (const void *)offsetof(LitVertex, x));
+		gl.VertexAttribPointer(ColorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LitVertex), (const void *)offsetof(LitVertex, color));
+		gl.VertexAttribPointer(NormalAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(LitVertex), (const void *)offsetof(LitVertex, nx));
+	}
+
+	const RendererFunctions CoreFunctionTable =
+	{
+		CoreDestroy, CoreSetTransform, CoreSetLighting, CoreDrawColor, CoreDrawLit, CoreDrawInstances, CoreDrawGeometry
+	};
+
+	// Compiles the program and creates the vertex arrays of the programmable backend
+	bool CreateCore(Renderer * renderer)
+	{
+		if (!LoadFunctions()) return false;
+
+		GLuint vertex = Compile(VertexShader, VertexSource);
+		GLuint fragment = Compile(FragmentShader, FragmentSource);
+		if (vertex != 0 && fragment != 0) renderer->program = Link(vertex, fragment);
+		if (vertex != 0) gl.DeleteShader(vertex);
+		if (fragment != 0) gl.DeleteShader(fragment);
+		if (renderer->program == 0) return false;
+
+		renderer->projectionLocation = gl.GetUniformLocation(renderer->program, "projection");
+		renderer->modelviewLocation = gl.GetUniformLocation(renderer->program, "modelview");
+		renderer->lightLocation = gl.GetUniformLocation(renderer->program, "light");
+		renderer->litLocation = gl.GetUniformLocation(renderer->program, "lit");
+		renderer->instancedLocation = gl.GetUniformLocation(renderer->program, "instanced");
+		renderer->solidLocation = gl.GetUniformLocation(renderer->program, "solid");
+		renderer->solidColorLocation = gl.GetUniformLocation(renderer->program, "solidColor");
+
+		// Vertex formats are recorded in the vertex arrays once; draws only upload data
+		gl.GenVertexArrays(1, &renderer->colorArray);
+		gl.GenBuffers(1, &renderer->colorBuffer);
+		gl.BindVertexArray(renderer->colorArray);
+		gl.BindBuffer(ArrayBuffer, renderer->colorBuffer);
+		gl.EnableVertexAttribArray(PositionAttribute);
+		gl.EnableVertexAttribArray(ColorAttribute);
+		gl.VertexAttribPointer(PositionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(ColorVertex), (const void *)offsetof(ColorVertex, x));
+		gl.VertexAttribPointer(ColorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ColorVertex), (const void *)offsetof(ColorVertex, color));
+
+		gl.GenVertexArrays(1, &renderer->litArray);
+		gl.GenBuffers(1, &renderer->litBuffer);
+		gl.BindVertexArray(renderer->litArray);
+		gl.BindBuffer(ArrayBuffer, renderer->litBuffer);
+		SetLitFormat();
+
+		// Instanced meshes read positions and normals from the mesh buffer and the
+		// transform and color from the instance buffer, advancing once per instance
+		gl.GenVertexArrays(1, &renderer->meshArray);
+		gl.GenBuffers(1, &renderer->meshBuffer);
+		gl.GenBuffers(1, &renderer->instanceBuffer);
+		gl.BindVertexArray(renderer->meshArray);
+		gl.BindBuffer(ArrayBuffer, renderer->meshBuffer);
+		gl.EnableVertexAttribArray(PositionAttribute);
+		gl.EnableVertexAttribArray(NormalAttribute);
+		gl.VertexAttribPointer(PositionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(LitVertex), (const void *)offsetof(LitVertex, x));
+		gl.VertexAttribPointer(NormalAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(LitVertex), (const void *)offsetof(LitVertex, nx));
+		gl.BindBuffer(ArrayBuffer, renderer->instanceBuffer);
+		for (GLuint i = 0; i < 3; i++)
+		{
+			gl.EnableVertexAttribArray(TransformAttribute + i);
+			gl.VertexAttribPointer(TransformAttribute + i, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (const void *)(offsetof(MeshInstance, transform) + i * 4 * sizeof(float)));
+			gl.VertexAttribDivisor(TransformAttribute + i, 1);
+		}
+		gl.EnableVertexAttribArray(InstanceColorAttribute);
+		gl.VertexAttribPointer(InstanceColorAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(MeshInstance), (const void *)offsetof(MeshInstance, color));
+		gl.VertexAttribDivisor(InstanceColorAttribute, 1);
+
+		gl.BindBuffer(ArrayBuffer, 0);
+		gl.BindVertexArray(0);
+
+		// Start with the light the canvases use
+		const float light[3] = { 1.0f, 1.0f, 1.0f };
+		CoreSetLighting(renderer, false, light);
+		return true;
+	}
+}
+
+Renderer * _CreateRenderer(int backend)
+{
+	Renderer * renderer = (Renderer *)_Allocate(sizeof(Renderer));
+	memset(renderer, 0, sizeof(Renderer));
+	renderer->backend = backend;
+	if (backend == RENDERBACKEND_PROGRAMMABLE)
+	{
+		renderer->functions = &CoreFunctionTable;
+		if (!CreateCore(renderer))
+		{
+			if (renderer->program != 0) gl.DeleteProgram(renderer->program);
+			_Free(renderer);
+			return 0;
+		}
+	}
+	else
+		renderer->functions = &FixedFunctions;
+	return renderer;
+}
+
+void _DestroyRenderer(Renderer * renderer)
+{
+	if (renderer == 0) return;
+	renderer->functions->destroy(renderer);
+	_Free(renderer);
+}
+
+int _GetRenderBackend(const Renderer * renderer)
+{
+	return renderer->backend;
+}
+
+void _SetRenderTransform(Renderer * renderer, const float * projection, const float * modelview)
+{
+	renderer->functions->setTransform(renderer, projection, modelview);
+}
+
+void _OrthoMatrix(float * matrix, float left, float right, float bottom, float top, float zNear, float zFar)
+{
+	memset(matrix, 0, 16 * sizeof(float));
+	matrix[0] = 2.0f / (right - left);
+	matrix[5] = 2.0f / (top - bottom);
+	matrix[10] = -2.0f / (zFar - zNear);
+	matrix[12] = -(right + left) / (right - left);
+	matrix[13] = -(top + bottom) / (top - bottom);
+	matrix[14] = -(zFar + zNear) / (zFar - zNear);
+	matrix[15] = 1.0f;
+}
+
+void _FrustumMatrix(float * matrix, float left, float right, float bottom, float top, float zNear, float zFar)
+{
+	memset(matrix, 0, 16 * sizeof(float));
+	matrix[0] = 2.0f * zNear / (right - left);
+	matrix[5] = 2.0f * zNear / (top - bottom);
+	matrix[8] = (right + left) / (right - left);
+	matrix[9] = (top + bottom) / (top - bottom);
+	matrix[10] = -(zFar + zNear) / (zFar - zNear);
+	matrix[11] = -1.0f;
+	matrix[14] = -2.0f * zFar * zNear / (zFar - zNear);
+}
+
+void _LookAtMatrix(float * matrix, const float * eye, const float * target, const float * up)
+{
+	// Forward, side and recomputed up axes, normalized as gluLookAt does
+	float f[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+	float length = sqrtf(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+	if (length > 0.0f) { f[0] /= length; f[1] /= length; f[2] /= length; }
+	float s[3] = { f[1] * up[2] - f[2] * up[1], f[2] * up[0] - f[0] * up[2], f[0] * up[1] - f[1] * up[0] };
+	length = sqrtf(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+	if (length > 0.0f) { s[0] /= length; s[1] /= length; s[2] /= length; }
+	float u[3] = { s[1] * f[2] - s[2] * f[1], s[2] * f[0] - s[0] * f[2], s[0] * f[1] - s[1] * f[0] };
+
+	memset(matrix, 0, 16 * sizeof(float));
+	for (int i = 0; i < 3; i++)
+	{
+		matrix[i * 4] = s[i];
+		matrix[i * 4 + 1] = u[i];
+		matrix[i * 4 + 2] = -f[i];
+	}
+	matrix[12] = -(s[0] * eye[0] + s[1] * eye[1] + s[2] * eye[2]);
+	matrix[13] = -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+	matrix[14] = f[0] * eye[0] + f[1] * eye[1] + f[2] * eye[2];
+	matrix[15] = 1.0f;
+}
+
+void _SetRenderLighting(Renderer * renderer, bool enabled, const float * direction)
+{
+	renderer->functions->setLighting(renderer, enabled, direction);
+}
+
+void _RenderColorVertices(Renderer * renderer, unsigned int mode, const ColorVertex * vertices, int count, const StripList * strips)
+{
+	if (count <= 0 || (strips != 0 && strips->count == 0)) return;
+	renderer->functions->drawColor(renderer, mode, vertices, count, strips);
+}
+
+void _RenderLitVertices(Renderer * renderer, unsigned int mode, const LitVertex * vertices, int count)
+{
+	if (count <= 0) return;
+	renderer->functions->drawLit(renderer, mode, vertices, count);
+}
+
+void _RenderInstances(Renderer * renderer, unsigned int mode, const LitVertex * vertices, int count, const MeshInstance * instances, int instanceCount)
+{
+	if (count <= 0 || instanceCount <= 0) return;
+	renderer->functions->drawInstances(renderer, mode, vertices, count, instances, instanceCount);
+}
+
+RenderGeometry * _CreateRenderGeometry(Renderer * renderer, const LitVertex * triangles, int triangleCount, const LitVertex * lines, int lineCount)
+{
+	RenderGeometry * geometry = (RenderGeometry *)_Allocate(sizeof(RenderGeometry));
+	memset(geometry, 0, sizeof(RenderGeometry));
+	geometry->triangleCount = triangleCount;
+	geometry->lineCount = lineCount;
+	size_t triangleSize = (size_t)triangleCount * sizeof(LitVertex), lineSize = (size_t)lineCount * sizeof(LitVertex);
+
+	bool programmable = (renderer->backend == RENDERBACKEND_PROGRAMMABLE);
+	if (!programmable && !LoadBufferFunctions())
+	{
+		geometry->vertices = (LitVertex *)_Allocate(triangleSize + lineSize);
+		if (triangleSize != 0) memcpy(geometry->vertices, triangles, triangleSize);
+		if (lineSize != 0) memcpy(geometry->vertices + triangleCount, lines, lineSize);
+		return geometry;
+	}
+
+	if (programmable)
+	{
+		gl.GenVertexArrays(1, &geometry->array);
+		gl.BindVertexArray(geometry->array);
+	}
+	gl.GenBuffers(1, &geometry->buffer);
+	gl.BindBuffer(ArrayBuffer, geometry->buffer);
+	gl.BufferData(ArrayBuffer, (GLsizeiptr)(triangleSize + lineSize), 0, StaticDraw);
+	if (triangleSize != 0) gl.BufferSubData(ArrayBuffer, 0, (GLsizeiptr)triangleSize, triangles);
+	if (lineSize != 0) gl.BufferSubData(ArrayBuffer, (GLintptr)triangleSize, (GLsizeiptr)lineSize, lines);
+	if (programmable)
+	{
+		SetLitFormat();
+		gl.BindVertexArray(0);
+	}
+	gl.BindBuffer(ArrayBuffer, 0);
+	return geometry;
+}
+
+RenderGeometry * _CreateIndexedGeometry(Renderer * renderer, const LitVertex * vertices, int vertexCount,
+	const unsigned int * triangles, int triangleCount, const unsigned int * lines, int lineCount)
+{
+	RenderGeometry * geometry = (RenderGeometry *)_Allocate(sizeof(RenderGeometry));
+	memset(geometry, 0, sizeof(RenderGeometry));
+	geometry->indexed = true;
+	geometry->triangleCount = triangleCount;
+	geometry->lineCount = lineCount;
+	size_t vertexSize = (size_t)vertexCount * sizeof(LitVertex);
+	size_t triangleSize = (size_t)triangleCount * sizeof(unsigned int), lineSize = (size_t)lineCount * sizeof(unsigned int);
+
+	bool programmable = (renderer->backend == RENDERBACKEND_PROGRAMMABLE);
+	if (!programmable && !LoadBufferFunctions())
+	{
+		geometry->vertices = (LitVertex *)_Allocate(vertexSize);
+		geometry->indices = (unsigned int *)_Allocate(triangleSize + lineSize);
+		if (vertexSize != 0) memcpy(geometry->vertices, vertices, vertexSize);
+		if (triangleSize != 0) memcpy(geometry->indices, triangles, triangleSize);
+		if (lineSize != 0) memcpy(geometry->indices + triangleCount, lines, lineSize);
+		return geometry;
+	}
+
+	// The element buffer binding is recorded in the vertex array object, so it stays
+	// bound until the vertex array is unbound
+	if (programmable)
+	{
+		gl.GenVertexArrays(1, &geometry->array);
+		gl.BindVertexArray(geometry->array);
+	}
+	gl.GenBuffers(1, &geometry->buffer);
+	gl.BindBuffer(ArrayBuffer, geometry->buffer);
+	gl.BufferData(ArrayBuffer, (GLsizeiptr)vertexSize, vertices, StaticDraw);
+	gl.GenBuffers(1, &geometry->elements);
+	gl.BindBuffer(ElementArrayBuffer, geometry->elements);
+	gl.BufferData(ElementArrayBuffer, (GLsizeiptr)(triangleSize + lineSize), 0, StaticDraw);
+	if (triangleSize != 0) gl.BufferSubData(ElementArrayBuffer, 0, (GLsizeiptr)triangleSize, triangles);
+	if (lineSize != 0) gl.BufferSubData(ElementArrayBuffer, (GLintptr)triangleSize, (GLsizeiptr)lineSize, lines);
+	if (programmable)
+	{
+		SetLitFormat();
+		gl.BindVertexArray(0);
+	}
+	else
+		gl.BindBuffer(ElementArrayBuffer, 0);
+	gl.BindBuffer(ArrayBuffer, 0);
+	return geometry;
+}
+
+void _DestroyRenderGeometry(RenderGeometry * geometry)
+{
+	if (geometry == 0) return;
+	if (geometry->array != 0) gl.DeleteVertexArrays(1, &geometry->array);
+	if (geometry->buffer != 0) gl.DeleteBuffers(1, &geometry->buffer);
+	if (geometry->elements != 0) gl.DeleteBuffers(1, &geometry->elements);
+	_Free(geometry->vertices);
+	_Free(geometry->indices);
+	_Free(geometry);
+}
+
+void _RenderGeometry(Renderer * renderer, const RenderGeometry * geometry, int parts, const float * transform, bool recolor, unsigned int color)
+{
+	if (geometry->triangleCount + geometry->lineCount == 0) return;
+	renderer->functions->drawGeometry(renderer, geometry, parts, transform, recolor, color);
+}
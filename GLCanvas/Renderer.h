@@ -0,0 +1,114 @@
+#pragma once
+
+// Native renderer backends drawing the vertex buffers of the canvases. The fixed
+// function backend uses OpenGL 1.1 client vertex arrays and fixed function lighting;
+// the programmable backend uses only OpenGL 3.3 core profile features: vertex buffer
+// objects, vertex array objects and GLSL 3.30 shaders. The implementation is compiled
+// without /clr.
+
+#include "VertexBuffer.h"
+
+struct Renderer;
+struct RenderGeometry;
+
+/// <summary>
+/// Renderer backends.
+/// </summary>
+enum RenderBackend
+{
+	RENDERBACKEND_FIXEDFUNCTION,	// OpenGL 1.1 vertex arrays, fixed function transform and lighting
+	RENDERBACKEND_PROGRAMMABLE		// OpenGL 3.3 core vertex buffers, vertex array objects and shaders
+};
+
+/// <summary>
+/// Parts of retained geometry.
+/// </summary>
+enum RenderGeometryParts
+{
+	RENDERGEOMETRY_TRIANGLES = 1,
+	RENDERGEOMETRY_LINES = 2,
+	RENDERGEOMETRY_ALL = 3
+};
+
+/// <summary>
+/// Creates a renderer with the given backend in the current rendering context.
+/// Returns null if the context does not support the backend. A renderer can only
+/// be used while the context it was created in is current.
+/// </summary>
+Renderer * _CreateRenderer(int backend);
+/// <summary>
+/// Releases a renderer and the OpenGL objects it created. The context the renderer
+/// was created in must be current.
+/// </summary>
+void _DestroyRenderer(Renderer * renderer);
+/// <summary>
+/// Returns the backend of a renderer, one of RenderBackend.
+/// </summary>
+int _GetRenderBackend(const Renderer * renderer);
+/// <summary>
+/// Sets the projection and modelview matrices used by following draws. Matrices are
+/// given in column-major order, as loaded with glLoadMatrixf.
+/// </summary>
+void _SetRenderTransform(Renderer * renderer, const float * projection, const float * modelview);
+/// <summary>
+/// Computes the column-major matrix glOrtho multiplies with, so that transforms can
+/// be kept on the CPU instead of being read back from the context.
+/// </summary>
+void _OrthoMatrix(float * matrix, float left, float right, float bottom, float top, float zNear, float zFar);
+/// <summary>
+/// Computes the column-major matrix glFrustum multiplies with.
+/// </summary>
+void _FrustumMatrix(float * matrix, float left, float right, float bottom, float top, float zNear, float zFar);
+/// <summary>
+/// Computes the column-major matrix gluLookAt multiplies with. eye, target and up are
+/// given as x, y, z.
+/// </summary>
+void _LookAtMatrix(float * matrix, const float * eye, const float * target, const float * up);
+/// <summary>
+/// Enables or disables lighting of lit vertices. direction is the direction towards
+/// the light in eye coordinates. Lit colors are scaled by the ambient term 0.2 plus
+/// the diffuse term, as with the default fixed function light model.
+/// </summary>
+void _SetRenderLighting(Renderer * renderer, bool enabled, const float * direction);
+/// <summary>
+/// Draws count colored vertices with the given primitive mode. Lighting does not
+/// apply to colored vertices. If strips is not null, its ranges are drawn instead of
+/// the whole buffer. mode must be a core profile mode; quads and polygons are not.
+/// </summary>
+void _RenderColorVertices(Renderer * renderer, unsigned int mode, const ColorVertex * vertices, int count, const StripList * strips);
+/// <summary>
+/// Draws count lit vertices with the given primitive mode. mode must be a core profile mode.
+/// </summary>
+void _RenderLitVertices(Renderer * renderer, unsigned int mode, const LitVertex * vertices, int count);
+/// <summary>
+/// Draws count lit vertices once for each of the given instances, transformed and
+/// colored by the instance. The programmable backend draws all instances with a
+/// single instanced call; the fixed function backend loads the mesh arrays once
+/// and multiplies the modelview matrix for each instance.
+/// </summary>
+void _RenderInstances(Renderer * renderer, unsigned int mode, const LitVertex * vertices, int count, const MeshInstance * instances, int instanceCount);
+/// <summary>
+/// Copies lit triangles and lines into geometry kept by OpenGL between frames. The
+/// programmable backend stores them in a static vertex buffer object with its own
+/// vertex array object. The fixed function backend uses a vertex buffer object where
+/// OpenGL 1.5 is available, and a copy in native memory otherwise.
+/// </summary>
+RenderGeometry * _CreateRenderGeometry(Renderer * renderer, const LitVertex * triangles, int triangleCount, const LitVertex * lines, int lineCount);
+/// <summary>
+/// Copies lit vertices and the indices of triangles and lines connecting them into
+/// geometry kept by OpenGL between frames. Indices are stored in an element buffer
+/// object next to the vertex buffer object, or in native memory where the fixed
+/// function backend has no buffer objects. Counts are numbers of indices.
+/// </summary>
+RenderGeometry * _CreateIndexedGeometry(Renderer * renderer, const LitVertex * vertices, int vertexCount,
+	const unsigned int * triangles, int triangleCount, const unsigned int * lines, int lineCount);
+/// <summary>
+/// Releases geometry. The context the geometry was created in must be current.
+/// </summary>
+void _DestroyRenderGeometry(RenderGeometry * geometry);
+/// <summary>
+/// Draws the given parts of geometry created by the same renderer. transform is a
+/// column-major model matrix applied before the modelview matrix. If recolor is true,
+/// all vertices are drawn with the given color instead of their own.
+/// </summary>
+void _RenderGeometry(Renderer * renderer, const RenderGeometry * geometry, int parts, const float * transform, bool recolor, unsigned int color);
@@ -0,0 +1,197 @@
+// Native code, compiled without /clr.
+
+#include "ShapeShader.h"
+#include "GLExtensions.h"
+
+#include <windows.h>
+#include <GL/gl.h>
+#include <stddef.h>
+
+namespace
+{
+	// OpenGL 2.0 definitions missing from the OpenGL 1.1 headers
+	typedef char GLchar;
+	const GLenum FragmentShader = 0x8B30;
+	const GLenum VertexShader = 0x8B31;
+	const GLenum CompileStatus = 0x8B81;
+	const GLenum LinkStatus = 0x8B82;
+
+	typedef GLuint (APIENTRY * CreateShaderFunction)(GLenum type);
+	typedef void (APIENTRY * ShaderSourceFunction)(GLuint shader, GLsizei count, const GLchar * const * string, const GLint * length);
+	typedef void (APIENTRY * CompileShaderFunction)(GLuint shader);
+	typedef void (APIENTRY * GetShaderivFunction)(GLuint shader, GLenum pname, GLint * params);
+	typedef void (APIENTRY * DeleteShaderFunction)(GLuint shader);
+	typedef GLuint (APIENTRY * CreateProgramFunction)(void);
+	typedef void (APIENTRY * AttachShaderFunction)(GLuint program, GLuint shader);
+	typedef void (APIENTRY * BindAttribLocationFunction)(GLuint program, GLuint index, const GLchar * name);
+	typedef void (APIENTRY * LinkProgramFunction)(GLuint program);
+	typedef void (APIENTRY * GetProgramivFunction)(GLuint program, GLenum pname, GLint * params);
+	typedef void (APIENTRY * DeleteProgramFunction)(GLuint program);
+	typedef void (APIENTRY * UseProgramFunction)(GLuint program);
+	typedef GLint (APIENTRY * GetUniformLocationFunction)(GLuint program, const GLchar * name);
+	typedef void (APIENTRY * Uniform1fFunction)(GLint location, GLfloat v0);
+	typedef void (APIENTRY * EnableVertexAttribArrayFunction)(GLuint index);
+	typedef void (APIENTRY * DisableVertexAttribArrayFunction)(GLuint index);
+	typedef void (APIENTRY * VertexAttribPointerFunction)(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void * pointer);
+
+	struct ShaderFunctions
+	{
+		CreateShaderFunction CreateShader;
+		ShaderSourceFunction ShaderSource;
+		CompileShaderFunction CompileShader;
+		GetShaderivFunction GetShaderiv;
+		DeleteShaderFunction DeleteShader;
+		CreateProgramFunction CreateProgram;
+		AttachShaderFunction AttachShader;
+		BindAttribLocationFunction BindAttribLocation;
+		LinkProgramFunction LinkProgram;
+		GetProgramivFunction GetProgramiv;
+		DeleteProgramFunction DeleteProgram;
+		UseProgramFunction UseProgram;
+		GetUniformLocationFunction GetUniformLocation;
+		Uniform1fFunction Uniform1f;
+		EnableVertexAttribArrayFunction EnableVertexAttribArray;
+		DisableVertexAttribArrayFunction DisableVertexAttribArray;
+		VertexAttribPointerFunction VertexAttribPointer;
+	};
+
+	bool gLoaded = false;
+	bool gSupported = false;
+	ShaderFunctions gl;
+
+	// Attribute indices; index 0 aliases the vertex position on some drivers
+	const GLuint ShapeAttribute = 1;
+	const GLuint CornerAttribute = 2;
+
+	const char * VertexSource =
+		"attribute vec4 shape;\n"
+		"attribute vec2 corner;\n"
+		"varying vec4 vShape;\n"
+		"varying vec2 vCorner;\n"
+		"void main()\n"
+		"{\n"
+		"	gl_Position = ftransform();\n"
+		"	gl_FrontColor = gl_Color;\n"
+		"	vShape = shape;\n"
+		"	vCorner = corner;\n"
+		"}\n";
+
+	// Coverage is computed from the signed distance to the edge of the shape in pixels.
+	// The distance to an ellipse is estimated from its implicit function and gradient,
+	// which is accurate near the edge where coverage is fractional.
+	const char * FragmentSource =
+		"uniform float pixelSize;\n"
+		"uniform float lineWidth;\n"
+		"varying vec4 vShape;\n"
+		"varying vec2 vCorner;\n"
+		"void main()\n"
+		"{\n"
+		"	vec2 p = abs(vShape.xy);\n"
+		"	vec2 h = max(vShape.zw, vec2(1.0e-20));\n"
+		"	float d;\n"
+		"	if (vCorner.x < 0.0)\n"
+		"	{\n"
+		"		vec2 q = p / h;\n"
+		"		d = (dot(q, q) - 1.0) / max(length(2.0 * q / h), 1.0e-20);\n"
+		"	}\n"
+		"	else\n"
+		"	{\n"
+		"		vec2 q = p - h + vCorner.x;\n"
+		"		d = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - vCorner.x;\n"
+		"	}\n"
+		"	d /= pixelSize;\n"
+		"	float coverage = (vCorner.y > 0.0 ? 0.5 * lineWidth + 0.5 - abs(d) : 0.5 - d);\n"
+		"	coverage = clamp(coverage, 0.0, 1.0);\n"
+		"	if (coverage <= 0.0) discard;\n"
+		"	gl_FragColor = vec4(gl_Color.rgb, gl_Color.a * coverage);\n"
+		"}\n";
+
+	template <class T> bool Load(T & function, const char * name)
+	{
+		function = (T)_GetGLFunction(name);
+		return function != 0;
+	}
+
+	bool LoadFunctions()
+	{
+		if (gLoaded) return gSupported;
+		gLoaded = true;
+		gSupported = Load(gl.CreateShader, "glCreateShader") && Load(gl.ShaderSource, "glShaderSource") &&
+			Load(gl.CompileShader, "glCompileShader") && Load(gl.GetShaderiv, "glGetShaderiv") &&
+			Load(gl.DeleteShader, "glDeleteShader") && Load(gl.CreateProgram, "glCreateProgram") &&
+			Load(gl.AttachShader, "glAttachShader") && Load(gl.BindAttribLocation, "glBindAttribLocation") &&
+			Load(gl.LinkProgram, "glLinkProgram") && Load(gl.GetProgramiv, "glGetProgramiv") &&
+			Load(gl.DeleteProgram, "glDeleteProgram") && Load(gl.UseProgram, "glUseProgram") &&
+			Load(gl.GetUniformLocation, "glGetUniformLocation") && Load(gl.Uniform1f, "glUniform1f") &&
+			Load(gl.EnableVertexAttribArray, "glEnableVertexAttribArray") &&
+			Load(gl.DisableVertexAttribArray, "glDisableVertexAttribArray") &&
+			Load(gl.VertexAttribPointer, "glVertexAttribPointer");
+		return gSupported;
+	}
+
+	GLuint Compile(GLenum type, const char * source)
+	{
+		GLuint shader = gl.CreateShader(type);
+		gl.ShaderSource(shader, 1, &source, 0);
+		gl.CompileShader(shader);
+		GLint status = 0;
+		gl.GetShaderiv(shader, CompileStatus, &status);
+		if (status == 0)
+		{
+			gl.DeleteShader(shader);
+			return 0;
+		}
+		return shader;
+	}
+}
+
+unsigned int _CreateShapeProgram()
+{
+	if (!LoadFunctions()) return 0;
+
+	GLuint vertex = Compile(VertexShader, VertexSource);
+	GLuint fragment = Compile(FragmentShader, FragmentSource);
+	GLuint program = 0;
+	if (vertex != 0 && fragment != 0)
+	{
+		program = gl.CreateProgram();
+		gl.AttachShader(program, vertex);
+		gl.AttachShader(program, fragment);
+		gl.BindAttribLocation(program, ShapeAttribute, "shape");
+		gl.BindAttribLocation(program, CornerAttribute, "corner");
+		gl.LinkProgram(program);
+		GLint status = 0;
+		gl.GetProgramiv(program, LinkStatus, &status);
+		if (status == 0)
+		{
+			gl.DeleteProgram(program);
+			program = 0;
+		}
+	}
+
+	// Shaders are deleted with the program they are attached to
+	if (vertex != 0) gl.DeleteShader(vertex);
+	if (fragment != 0) gl.DeleteShader(fragment);
+	return program;
+}
+
+void _DrawShapes(unsigned int program, const ShapeBuffer * shapes, float pixelSize, float lineWidth)
+{
+	if (program == 0 || shapes->count == 0) return;
+
+	const ShapeVertex * v = shapes->data;
+	gl.UseProgram(program);
+	gl.Uniform1f(gl.GetUniformLocation(program, "pixelSize"), pixelSize);
+	gl.Uniform1f(gl.GetUniformLocation(program, "lineWidth"), lineWidth);
+	glLoadIdentity();
+	glVertexPointer(3, GL_FLOAT, sizeof(ShapeVertex), &v->x);
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ShapeVertex), &v->color);
+	gl.EnableVertexAttribArray(ShapeAttribute);
+	gl.EnableVertexAttribArray(CornerAttribute);
+	gl.VertexAttribPointer(ShapeAttribute, 4, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex), &v->u);
+	gl.VertexAttribPointer(CornerAttribute, 2, GL_FLOAT, GL_FALSE, sizeof(ShapeVertex), &v->radius);
+	glDrawArrays(GL_QUADS, 0, shapes->count);
+	gl.DisableVertexAttribArray(ShapeAttribute);
+	gl.DisableVertexAttribArray(CornerAttribute);
+	gl.UseProgram(0);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+// Native OpenGL 2.0 program drawing ellipses and rounded rectangles with analytic,
+// anti-aliased coverage. The implementation is compiled without /clr.
+
+#include "VertexBuffer.h"
+
+/// <summary>
+/// Compiles and links the shape program in the current rendering context.
+/// Returns 0 if the context does not support OpenGL 2.0 shaders. The program is
+/// released with the rendering context.
+/// </summary>
+unsigned int _CreateShapeProgram();
+/// <summary>
+/// Draws the quads in the shape buffer with the shape program. pixelSize is the size
+/// of a pixel in world coordinates and lineWidth the width of outlines in pixels.
+/// The vertex and color array client states must be enabled.
+/// </summary>
+void _DrawShapes(unsigned int program, const ShapeBuffer * shapes, float pixelSize, float lineWidth);
@@ -0,0 +1,176 @@
+// Native code, compiled without /clr.
+
+#include "Simplifier.h"
+#include "NativeMemory.h"
+
+#include <vector>
+
+struct Simplifier
+{
+	std::vector<float> reduced;		// points left after the distance filter
+	std::vector<char> keep;			// points kept by Douglas-Peucker
+	std::vector<int> stack;			// pending ranges
+	std::vector<float> simplified;
+};
+
+namespace
+{
+	inline float DistanceSquared(const float * p, const float * q)
+	{
+		float dx = q[0] - p[0];
+		float dy = q[1] - p[1];
+		return dx * dx + dy * dy;
+	}
+
+	// Squared distance of p from the segment a, b
+	inline float SegmentDistanceSquared(const float * p, const float * a, const float * b)
+	{
+		float x = a[0], y = a[1];
+		float dx = b[0] - x, dy = b[1] - y;
+		if (dx != 0 || dy != 0)
+		{
+			float t = ((p[0] - x) * dx + (p[1] - y) * dy) / (dx * dx + dy * dy);
+			if (t > 1)
+			{
+				x = b[0];
+				y = b[1];
+			}
+			else if (t > 0)
+			{
+				x += dx * t;
+				y += dy * t;
+			}
+		}
+		dx = p[0] - x;
+		dy = p[1] - y;
+		return dx * dx + dy * dy;
+	}
+
+	// Marks the points of [first, last] kept by the Douglas-Peucker algorithm
+	void DouglasPeucker(Simplifier * s, int first, int last, float tolerance2)
+	{
+		const float * pt = &s->reduced[0];
+		s->keep[first] = 1;
+		s->keep[last] = 1;
+		s->stack.push_back(first);
+		s->stack.push_back(last);
+		while (!s->stack.empty())
+		{
+			last = s->stack.back();
+			s->stack.pop_back();
+			first = s->stack.back();
+			s->stack.pop_back();
+
+			float maxDistance = tolerance2;
+			int index = -1;
+			for (int i = first + 1; i < last; i++)
+			{
+				float d = SegmentDistanceSquared(pt + i * 2, pt + first * 2, pt + last * 2);
+				if (d > maxDistance)
+				{
+					index = i;
+					maxDistance = d;
+				}
+			}
+			if (index != -1)
+			{
+				s->keep[index] = 1;
+				s->stack.push_back(first);
+				s->stack.push_back(index);
+				s->stack.push_back(index);
+				s->stack.push_back(last);
+			}
+		}
+	}
+}
+
+Simplifier * _CreateSimplifier()
+{
+	Simplifier * simplifier = new Simplifier();
+	_CountAllocation();
+	return simplifier;
+}
+
+void _DestroySimplifier(Simplifier * simplifier)
+{
+	delete simplifier;
+}
+
+int _Simplify(Simplifier * simplifier, const float * points, int count, float tolerance, bool closed, const float ** simplified)
+{
+	Simplifier * s = simplifier;
+	*simplified = points;
+	if (count <= (closed ? 3 : 2) || !(tolerance > 0)) return count;
+
+	size_t capacity = s->reduced.capacity() + s->keep.capacity() + s->stack.capacity() + s->simplified.capacity();
+	float tolerance2 = tolerance * tolerance;
+
+	// Drop points closer than the tolerance to the previous point first; this is
+	// linear and removes most points of dense lines before Douglas-Peucker runs
+	s->reduced.clear();
+	s->reduced.push_back(points[0]);
+	s->reduced.push_back(points[1]);
+	const float * last = points;
+	for (int i = 1; i < count; i++)
+	{
+		const float * p = points + i * 2;
+		if (DistanceSquared(p, last) > tolerance2 || (i == count - 1 && !closed))
+		{
+			s->reduced.push_back(p[0]);
+			s->reduced.push_back(p[1]);
+			last = p;
+		}
+	}
+	int n = (int)s->reduced.size() / 2;
+
+	// A closed ring is split at the point farthest from the first point, and the
+	// first point is repeated at the end so that both halves are open polylines
+	if (closed)
+	{
+		if (n < 3)
+		{
+			s->simplified.assign(s->reduced.begin(), s->reduced.end());
+			*simplified = &s->simplified[0];
+			return n;
+		}
+		s->reduced.push_back(s->reduced[0]);
+		s->reduced.push_back(s->reduced[1]);
+	}
+	int end = (int)s->reduced.size() / 2 - 1;
+
+	s->keep.assign(end + 1, 0);
+	if (closed)
+	{
+		int farthest = 1;
+		float maxDistance = 0;
+		for (int i = 1; i < end; i++)
+		{
+			float d = DistanceSquared(&s->reduced[0], &s->reduced[i * 2]);
+			if (d > maxDistance)
+			{
+				farthest = i;
+				maxDistance = d;
+			}
+		}
+		DouglasPeucker(s, 0, farthest, tolerance2);
+		DouglasPeucker(s, farthest, end, tolerance2);
+	}
+	else
+	{
+		DouglasPeucker(s, 0, end, tolerance2);
+	}
+
+	// The repeated first point of a closed ring is not copied
+	s->simplified.clear();
+	int copied = (closed ? end : end + 1);
+	for (int i = 0; i < copied; i++)
+	{
+		if (!s->keep[i]) continue;
+		s->simplified.push_back(s->reduced[i * 2]);
+		s->simplified.push_back(s->reduced[i * 2 + 1]);
+	}
+
+	if (s->reduced.capacity() + s->keep.capacity() + s->stack.capacity() + s->simplified.capacity() != capacity) _CountAllocation();
+	*simplified = &s->simplified[0];
+	return (int)s->simplified.size() / 2;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Native polyline simplification. The implementation is compiled without /clr.
+
+struct Simplifier;
+
+/// <summary>
+/// Creates a simplifier. A simplifier keeps its working memory between calls,
+/// so it should be reused. A simplifier must not be used by two threads at once.
+/// </summary>
+Simplifier * _CreateSimplifier();
+/// <summary>
+/// Releases a simplifier.
+/// </summary>
+void _DestroySimplifier(Simplifier * simplifier);
+/// <summary>
+/// Simplifies a polyline or a closed ring given as x, y pairs with the Douglas-Peucker
+/// algorithm. Points within tolerance of the previous point are dropped first, so a
+/// removed point may be up to twice the tolerance from the result. A closed ring smaller
+/// than the tolerance is returned with fewer than three points. Returns the number of
+/// points written to simplified. The points remain valid until the next call with the
+/// same simplifier.
+/// </summary>
+int _Simplify(Simplifier * simplifier, const float * points, int count, float tolerance, bool closed, const float ** simplified);
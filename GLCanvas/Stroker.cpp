@@ -0,0 +1,286 @@
+// Native code, compiled without /clr.
+
+#include "Stroker.h"
+#include "NativeMemory.h"
+
+#include <math.h>
+#include <vector>
+
+namespace
+{
+	// A point of the polyline with its half width
+	struct StrokePoint
+	{
+		float x, y, hw;
+	};
+
+	// A segment of the polyline: unit direction, left normal and length
+	struct StrokeSegment
+	{
+		float dx, dy, nx, ny, length;
+	};
+
+	// The left (+normal) and right (-normal) corners of the stroke at one end of a segment
+	struct StrokeEnds
+	{
+		float lx, ly, rx, ry;
+	};
+
+	// Turns closer to straight than this are not joined
+	const float StraightCosine = 0.99999f;
+}
+
+struct Stroker
+{
+	std::vector<StrokePoint> points;
+	std::vector<StrokeSegment> segments;
+};
+
+namespace
+{
+	inline void Push(VertexBuffer * buffer, float x, float y, float z, unsigned int color)
+	{
+		if (buffer->count == buffer->capacity) _ReserveVertices(buffer, buffer->count + 1);
+		ColorVertex & v = buffer->data[buffer->count++];
+		v.x = x;
+		v.y = y;
+		v.z = z;
+		v.color = color;
+	}
+
+	inline float Min(float a, float b) { return a < b ? a : b; }
+
+	inline StrokeEnds Ends(const StrokePoint & p, float nx, float ny)
+	{
+		StrokeEnds e = { p.x + nx * p.hw, p.y + ny * p.hw, p.x - nx * p.hw, p.y - ny * p.hw };
+		return e;
+	}
+
+	// Emits the two triangles between the ends of a segment
+	void EmitSegment(VertexBuffer * triangles, const StrokeEnds & start, const StrokeEnds & end, float z, unsigned int color)
+	{
+		Push(triangles, start.lx, start.ly, z, color);
+		Push(triangles, start.rx, start.ry, z, color);
+		Push(triangles, end.rx, end.ry, z, color);
+		Push(triangles, end.rx, end.ry, z, color);
+		Push(triangles, end.lx, end.ly, z, color);
+		Push(triangles, start.lx, start.ly, z, color);
+	}
+
+	// Emits a triangle fan from center to the arc of radius r around (x, y) between the
+	// unit directions (ax, ay) and (bx, by). The directions are at most a quarter turn
+	// apart; arc points are found by normalizing interpolated directions.
+	void EmitArcFan(VertexBuffer * triangles, float cx, float cy, float x, float y, float r,
+		float ax, float ay, float bx, float by, int steps, float z, unsigned int color)
+	{
+		float px = x + ax * r, py = y + ay * r;
+		for (int i = 1; i <= steps; i++)
+		{
+			float qx = bx, qy = by;
+			if (i < steps)
+			{
+				float t = (float)i / (float)steps;
+				qx = ax + (bx - ax) * t;
+				qy = ay + (by - ay) * t;
+				float length = sqrtf(qx * qx + qy * qy);
+				qx /= length;
+				qy /= length;
+			}
+			qx = x + qx * r;
+			qy = y + qy * r;
+			Push(triangles, cx, cy, z, color);
+			Push(triangles, px, py, z, color);
+			Push(triangles, qx, qy, z, color);
+			px = qx;
+			py = qy;
+		}
+	}
+
+	// Emits a round join or cap between the unit directions a and b, turning through
+	// the unit direction (mx, my) halfway. steps is the number of segments of a half turn.
+	void EmitRound(VertexBuffer * triangles, float cx, float cy, float x, float y, float r,
+		float ax, float ay, float mx, float my, float bx, float by, int steps, float z, unsigned int color)
+	{
+		// The chord between two unit directions a quarter turn apart is sqrt(2) long and
+		// needs half of the steps; shorter turns are divided in proportion to their chord
+		float first = ceilf((float)steps * 0.35f * sqrtf((ax - mx) * (ax - mx) + (ay - my) * (ay - my)));
+		float second = ceilf((float)steps * 0.35f * sqrtf((mx - bx) * (mx - bx) + (my - by) * (my - by)));
+		EmitArcFan(triangles, cx, cy, x, y, r, ax, ay, mx, my, first < 1 ? 1 : (int)first, z, color);
+		EmitArcFan(triangles, cx, cy, x, y, r, mx, my, bx, by, second < 1 ? 1 : (int)second, z, color);
+	}
+
+	// Joins segments a and b at point p. Returns the end corners of a in end and the
+	// start corners of b in start, and emits the triangles filling the outside of the turn.
+	void Join(const StrokePoint & p, const StrokeSegment & a, const StrokeSegment & b, const StrokeStyle2D & style,
+		float z, unsigned int color, VertexBuffer * triangles, StrokeEnds & end, StrokeEnds & start)
+	{
+		float c = a.nx * b.nx + a.ny * b.ny;
+		float cross = a.dx * b.dy - a.dy * b.dx;
+		// Zero-width points have no outside to fill, and the miter ratio below would
+		// divide by zero
+		if (c > StraightCosine || p.hw == 0.0f)
+		{
+			end = start = Ends(p, b.nx, b.ny);
+			return;
+		}
+
+		// The miter offset (na + nb) hw / (1 + cos) lies on both offset lines; its length
+		// is hw / sin(phi / 2), phi being the angle between the segments
+		float k = (c > -StraightCosine ? p.hw / (1.0f + c) : 0.0f);
+		float mx = (a.nx + b.nx) * k, my = (a.ny + b.ny) * k;
+		float miter2 = (mx * mx + my * my) / (p.hw * p.hw);
+
+		// The inner corner is valid if it lies within both segments
+		float reach2 = (mx * mx + my * my) - p.hw * p.hw;
+		float shorter = Min(a.length, b.length);
+		bool inner = (k > 0 && reach2 <= shorter * shorter);
+		bool miter = (style.join == LINEJOIN_MITER && k > 0 && miter2 <= style.miterLimit * style.miterLimit);
+		if (inner && miter)
+		{
+			StrokeEnds e = { p.x + mx, p.y + my, p.x - mx, p.y - my };
+			end = start = e;
+			return;
+		}
+
+		// Left turns have the inner corner on the left
+		float side = (cross > 0 ? 1.0f : -1.0f);
+		float ax = -side * a.nx, ay = -side * a.ny;
+		float bx = -side * b.nx, by = -side * b.ny;
+		float cx = p.x, cy = p.y;
+		if (inner)
+		{
+			cx = p.x + side * mx;
+			cy = p.y + side * my;
+		}
+		end = Ends(p, a.nx, a.ny);
+		start = Ends(p, b.nx, b.ny);
+		if (inner)
+		{
+			if (side > 0) { end.lx = start.lx = cx; end.ly = start.ly = cy; }
+			else { end.rx = start.rx = cx; end.ry = start.ry = cy; }
+		}
+
+		// Fill the outside of the turn from the outer corner of a to the outer corner of b
+		float oax = p.x + ax * p.hw, oay = p.y + ay * p.hw;
+		float obx = p.x + bx * p.hw, oby = p.y + by * p.hw;
+		if (style.join == LINEJOIN_ROUND)
+		{
+			float hx = ax + bx, hy = ay + by;
+			float length = sqrtf(hx * hx + hy * hy);
+			if (length > 1.0e-6f) { hx /= length; hy /= length; }
+			else { hx = a.dx; hy = a.dy; }
+			EmitRound(triangles, cx, cy, p.x, p.y, p.hw, ax, ay, hx, hy, bx, by, style.roundSegments / 2, z, color);
+		}
+		else if (miter)
+		{
+			Push(triangles, cx, cy, z, color);
+			Push(triangles, oax, oay, z, color);
+			Push(triangles, p.x - side * mx, p.y - side * my, z, color);
+			Push(triangles, cx, cy, z, color);
+			Push(triangles, p.x - side * mx, p.y - side * my, z, color);
+			Push(triangles, obx, oby, z, color);
+		}
+		else
+		{
+			Push(triangles, cx, cy, z, color);
+			Push(triangles, oax, oay, z, color);
+			Push(triangles, obx, oby, z, color);
+		}
+	}
+
+	// Returns the corners at the start (sign = -1) or end (sign = 1) of an open
+	// polyline and emits round caps
+	StrokeEnds Cap(const StrokePoint & p, const StrokeSegment & s, float sign, const StrokeStyle2D & style,
+		float z, unsigned int color, VertexBuffer * triangles)
+	{
+		StrokeEnds e = Ends(p, s.nx, s.ny);
+		if (style.cap == LINECAP_SQUARE)
+		{
+			float ex = sign * s.dx * p.hw, ey = sign * s.dy * p.hw;
+			e.lx += ex; e.ly += ey;
+			e.rx += ex; e.ry += ey;
+		}
+		else if (style.cap == LINECAP_ROUND && p.hw > 0.0f)
+		{
+			EmitRound(triangles, p.x, p.y, p.x, p.y, p.hw, s.nx, s.ny, sign * s.dx, sign * s.dy, -s.nx, -s.ny,
+				style.roundSegments / 2, z, color);
+		}
+		return e;
+	}
+}
+
+Stroker * _CreateStroker()
+{
+	Stroker * stroker = new Stroker();
+	_CountAllocation();
+	return stroker;
+}
+
+void _DestroyStroker(Stroker * stroker)
+{
+	delete stroker;
+}
+
+void _StrokePolyline(Stroker * stroker, const float * points, const float * widths, float width, int count,
+	const StrokeStyle2D & style, float z, unsigned int color, VertexBuffer * triangles)
+{
+	Stroker * s = stroker;
+	size_t capacity = s->points.capacity() + s->segments.capacity();
+
+	// Drop repeated points, which have no direction
+	s->points.clear();
+	for (int i = 0; i < count; i++)
+	{
+		StrokePoint p = { points[i * 2], points[i * 2 + 1], fabsf(widths != 0 ? widths[i] : width) / 2 };
+		if (!s->points.empty() && p.x == s->points.back().x && p.y == s->points.back().y) continue;
+		s->points.push_back(p);
+	}
+	bool closed = style.closed;
+	if (closed && s->points.size() > 1 && s->points.front().x == s->points.back().x && s->points.front().y == s->points.back().y)
+		s->points.pop_back();
+	int n = (int)s->points.size();
+	if (closed && n < 3) closed = false;
+	if (n < 2)
+	{
+		if (s->points.capacity() + s->segments.capacity() != capacity) _CountAllocation();
+		return;
+	}
+
+	int segmentCount = (closed ? n : n - 1);
+	s->segments.resize(segmentCount);
+	if (s->points.capacity() + s->segments.capacity() != capacity) _CountAllocation();
+	const StrokePoint * pt = &s->points[0];
+	StrokeSegment * seg = &s->segments[0];
+	for (int i = 0; i < segmentCount; i++)
+	{
+		const StrokePoint & p = pt[i];
+		const StrokePoint & q = pt[i + 1 < n ? i + 1 : 0];
+		float dx = q.x - p.x, dy = q.y - p.y;
+		float length = sqrtf(dx * dx + dy * dy);
+		seg[i].dx = dx / length;
+		seg[i].dy = dy / length;
+		seg[i].nx = -seg[i].dy;
+		seg[i].ny = seg[i].dx;
+		seg[i].length = length;
+	}
+
+	// Each segment is drawn from the start corners left by the previous join
+	// to the end corners of the next join, so segments do not overlap
+	StrokeEnds start, end, first;
+	if (closed)
+		Join(pt[0], seg[segmentCount - 1], seg[0], style, z, color, triangles, first, start);
+	else
+		start = Cap(pt[0], seg[0], -1.0f, style, z, color, triangles);
+	for (int i = 1; i < segmentCount; i++)
+	{
+		StrokeEnds next;
+		Join(pt[i], seg[i - 1], seg[i], style, z, color, triangles, end, next);
+		EmitSegment(triangles, start, end, z, color);
+		start = next;
+	}
+	if (closed)
+		end = first;
+	else
+		end = Cap(pt[n - 1], seg[segmentCount - 1], 1.0f, style, z, color, triangles);
+	EmitSegment(triangles, start, end, z, color);
+}
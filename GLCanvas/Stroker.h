@@ -0,0 +1,58 @@
+#pragma once
+
+// Native stroking of thick polylines into triangles. The implementation is compiled without /clr.
+
+#include "VertexBuffer.h"
+
+struct Stroker;
+
+/// <summary>
+/// Shapes drawn where two segments of a stroked polyline meet.
+/// </summary>
+enum LineJoin2D
+{
+	LINEJOIN_MITER,		// outer edges are extended until they meet
+	LINEJOIN_BEVEL,		// outer corners are connected by a straight edge
+	LINEJOIN_ROUND		// outer corners are connected by a circular arc
+};
+
+/// <summary>
+/// Shapes drawn at the ends of an open stroked polyline.
+/// </summary>
+enum LineCap2D
+{
+	LINECAP_FLAT,		// the stroke ends at the end point
+	LINECAP_SQUARE,		// the stroke is extended by half its width
+	LINECAP_ROUND		// the stroke ends with a half circle
+};
+
+/// <summary>
+/// Contains the parameters of a stroke.
+/// </summary>
+struct StrokeStyle2D
+{
+	int join;				// one of LineJoin2D
+	int cap;				// one of LineCap2D; not used for closed polylines
+	float miterLimit;		// largest ratio of miter length to stroke width; sharper miter joins are beveled
+	bool closed;			// the last point is connected to the first
+	int roundSegments;		// number of segments a full circle of round joins and caps is made of
+};
+
+/// <summary>
+/// Creates a stroker. A stroker keeps its working memory between calls,
+/// so it should be reused. A stroker must not be used by two threads at once.
+/// </summary>
+Stroker * _CreateStroker();
+/// <summary>
+/// Releases a stroker.
+/// </summary>
+void _DestroyStroker(Stroker * stroker);
+/// <summary>
+/// Strokes a polyline given as count x, y pairs and appends the outline as triangles.
+/// Consecutive segments share their join vertices, so the stroke covers each pixel once
+/// except inside joins sharper than the adjacent segments are long. widths holds the
+/// stroke width at each point, or is null to use width for all points. No trigonometric
+/// functions are evaluated.
+/// </summary>
+void _StrokePolyline(Stroker * stroker, const float * points, const float * widths, float width, int count,
+	const StrokeStyle2D & style, float z, unsigned int color, VertexBuffer * triangles);
@@ -0,0 +1,954 @@
+// Native code, compiled without /clr.
+
+#include "Tessellator2D.h"
+#include "Curves.h"
+#include "JobSystem.h"
+#include "NativeMemory.h"
+#include "Simplifier.h"
+#include "Stroker.h"
+#include "Triangulator.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// Per-thread working memory for simplifying, clipping, triangulating and stroking polygons
+struct ThreadScratch
+{
+	Simplifier * simplifier;
+	Triangulator * triangulator;
+	Stroker * stroker;
+	std::vector<float> clip[2];
+	std::vector<float> curve;
+};
+
+// Per-chunk output buffers. These are kept with the batch so that
+// tessellating a frame does not allocate once the buffers have grown.
+struct TessellatorScratch
+{
+	std::vector<VertexBuffer> lines;
+	std::vector<VertexBuffer> strips;
+	std::vector<StripList> stripLists;
+	std::vector<VertexBuffer> triangles;
+	std::vector<ShapeBuffer> shapes;
+	std::vector<int> visible;
+	std::vector<int> lineOffsets;
+	std::vector<int> stripOffsets;
+	std::vector<int> stripListOffsets;
+	std::vector<int> triangleOffsets;
+	std::vector<int> shapeOffsets;
+	std::vector<int> depthOffsets;
+	std::vector<ThreadScratch *> threads;
+};
+
+namespace
+{
+	// Number of primitives tessellated by a single job
+	const int ChunkSize = 1024;
+	// Largest number of line segments a single curve is flattened into
+	const int MaxCurveSegments = 4096;
+	const float Pi = 3.14159265358979f;
+
+	inline void Push(VertexBuffer * buffer, float x, float y, float z, unsigned int color)
+	{
+		if (buffer->count == buffer->capacity) _ReserveVertices(buffer, buffer->count + 1);
+		ColorVertex & v = buffer->data[buffer->count++];
+		v.x = x;
+		v.y = y;
+		v.z = z;
+		v.color = color;
+	}
+
+	inline float Min(float a, float b) { return a < b ? a : b; }
+	inline float Max(float a, float b) { return a > b ? a : b; }
+
+	// Returns the Cohen-Sutherland region code of the point: one bit for each side
+	// of the clip rectangle (xmin, ymin, xmax, ymax) the point is outside of
+	inline int OutCode(float x, float y, const float * clip)
+	{
+		return (x < clip[0] ? 1 : 0) | (y < clip[1] ? 2 : 0) | (x > clip[2] ? 4 : 0) | (y > clip[3] ? 8 : 0);
+	}
+
+	// Appends the segment from a to b to the line strip starting at vertex first
+	inline void StripSegment(VertexBuffer * strips, int first, const float * a, const float * b, float z, unsigned int color)
+	{
+		if (strips->count == first) Push(strips, a[0], a[1], z, color);
+		Push(strips, b[0], b[1], z, color);
+	}
+
+	// Ends the line strip starting at vertex first and returns the first vertex of the next strip
+	inline int BreakStrip(VertexBuffer * strips, StripList * stripList, int first)
+	{
+		_EndStrip(strips, stripList, first);
+		return strips->count;
+	}
+
+	// Clips a polygon to the sides of the clip rectangle selected by sides with the
+	// Sutherland-Hodgman algorithm. Concave polygons may produce overlapping edges
+	// along the clip rectangle, which the triangulator removes as zero area corners.
+	// Returns the number of points in the clipped polygon.
+	int ClipPolygon(const float * points, int count, const float * clip, int sides, ThreadScratch * thread, const float ** clipped)
+	{
+		const float * in = points;
+		int inCount = count;
+		int buffer = 0;
+		for (int side = 0; side < 4; side++)
+		{
+			if ((sides & (1 << side)) == 0) continue;
+
+			std::vector<float> & out = thread->clip[buffer];
+			size_t capacity = out.capacity();
+			out.clear();
+			int axis = side & 1;			// 0 for x, 1 for y
+			float edge = clip[side];
+			bool lower = (side < 2);		// the point must be above the edge
+			for (int i = 0; i < inCount; i++)
+			{
+				const float * cur = in + i * 2;
+				const float * prev = in + (i == 0 ? inCount - 1 : i - 1) * 2;
+				bool curIn = lower ? cur[axis] >= edge : cur[axis] <= edge;
+				bool prevIn = lower ? prev[axis] >= edge : prev[axis] <= edge;
+				if (curIn != prevIn)
+				{
+					float t = (edge - prev[axis]) / (cur[axis] - prev[axis]);
+					float x = (axis == 0 ? edge : prev[0] + t * (cur[0] - prev[0]));
+					float y = (axis == 1 ? edge : prev[1] + t * (cur[1] - prev[1]));
+					out.push_back(x);
+					out.push_back(y);
+				}
+				if (curIn)
+				{
+					out.push_back(cur[0]);
+					out.push_back(cur[1]);
+				}
+			}
+			if (out.capacity() != capacity) _CountAllocation();
+
+			inCount = (int)out.size() / 2;
+			if (inCount < 3) return 0;
+			in = &out[0];
+			buffer = 1 - buffer;
+		}
+		*clipped = in;
+		return inCount;
+	}
+
+	// Computes the bounding box of the block bounds transformed by m
+	void TransformBounds(const Block2D & block, const float * m, float & xmin, float & ymin, float & xmax, float & ymax)
+	{
+		const float x[4] = { block.xmin, block.xmax, block.xmin, block.xmax };
+		const float y[4] = { block.ymin, block.ymin, block.ymax, block.ymax };
+		for (int i = 0; i < 4; i++)
+		{
+			float tx = m[0] * x[i] + m[2] * y[i] + m[4];
+			float ty = m[1] * x[i] + m[3] * y[i] + m[5];
+			if (i == 0) { xmin = xmax = tx; ymin = ymax = ty; }
+			xmin = Min(xmin, tx); xmax = Max(xmax, tx);
+			ymin = Min(ymin, ty); ymax = Max(ymax, ty);
+		}
+	}
+
+	// Computes the bounding box of a primitive
+	void GetBounds(const Primitive2D & prim, const Batch2D & batch, float & xmin, float & ymin, float & xmax, float & ymax)
+	{
+		const float * p = prim.p;
+		const float * points = batch.points;
+		switch (prim.type)
+		{
+		case PRIMITIVE_ARC:
+		case PRIMITIVE_PIE:
+		case PRIMITIVE_ELLIPSE:
+		case PRIMITIVE_FILLELLIPSE:
+			xmin = p[0] - fabsf(p[2]) / 2; xmax = p[0] + fabsf(p[2]) / 2;
+			ymin = p[1] - fabsf(p[3]) / 2; ymax = p[1] + fabsf(p[3]) / 2;
+			break;
+		case PRIMITIVE_TRIANGLE:
+		case PRIMITIVE_FILLTRIANGLE:
+			xmin = Min(Min(p[0], p[2]), p[4]); xmax = Max(Max(p[0], p[2]), p[4]);
+			ymin = Min(Min(p[1], p[3]), p[5]); ymax = Max(Max(p[1], p[3]), p[5]);
+			break;
+		case PRIMITIVE_POLYGON:
+		case PRIMITIVE_FILLPOLYGON:
+		case PRIMITIVE_TRIANGLELIST:
+		case PRIMITIVE_POLYLINE:
+		case PRIMITIVE_BEZIER:
+		case PRIMITIVE_QUADRATICBEZIER:
+		case PRIMITIVE_BSPLINE:
+			{
+				// Curves lie within the convex hull of their control points
+				const float * pt = points + prim.first * 2;
+				xmin = xmax = pt[0];
+				ymin = ymax = pt[1];
+				for (int i = 1; i < prim.count; i++)
+				{
+					xmin = Min(xmin, pt[i * 2]); xmax = Max(xmax, pt[i * 2]);
+					ymin = Min(ymin, pt[i * 2 + 1]); ymax = Max(ymax, pt[i * 2 + 1]);
+				}
+			}
+			break;
+		case PRIMITIVE_STROKE:
+			{
+				// Miter joins reach out to the miter limit times the half width,
+				// other joins and square caps to the half diagonal of the stroke
+				const float * pt = points + prim.first * 2;
+				float width = p[0];
+				if (p[5] != 0)
+				{
+					const float * widths = pt + prim.count * 2;
+					for (int i = 0; i < prim.count; i++) width = Max(width, fabsf(widths[i]));
+				}
+				float extent = fabsf(width) / 2 * Max(p[1] == LINEJOIN_MITER ? p[3] : 0.0f, 1.5f);
+				xmin = xmax = pt[0];
+				ymin = ymax = pt[1];
+				for (int i = 1; i < prim.count; i++)
+				{
+					xmin = Min(xmin, pt[i * 2]); xmax = Max(xmax, pt[i * 2]);
+					ymin = Min(ymin, pt[i * 2 + 1]); ymax = Max(ymax, pt[i * 2 + 1]);
+				}
+				xmin -= extent; xmax += extent;
+				ymin -= extent; ymax += extent;
+			}
+			break;
+		case PRIMITIVE_BLOCK:
+			TransformBounds(*batch.blocks[prim.first], p, xmin, ymin, xmax, ymax);
+			break;
+		default:
+			xmin = Min(p[0], p[2]); xmax = Max(p[0], p[2]);
+			ymin = Min(p[1], p[3]); ymax = Max(p[1], p[3]);
+			break;
+		}
+	}
+
+	// Emits the tessellated primitives of a block transformed by the reference matrix.
+	// Block vertices hold their rank within the block, which is added to z.
+	void EmitBlock(const Primitive2D & prim, const Block2D & block, float z, VertexBuffer * lines,
+		VertexBuffer * strips, StripList * stripList, VertexBuffer * triangles)
+	{
+		// Line strips of the block follow the strips already emitted
+		const StripList & blockList = *block.stripList;
+		if (stripList->count + blockList.count > stripList->capacity) _ReserveStrips(stripList, stripList->count + blockList.count);
+		for (int i = 0; i < blockList.count; i++)
+		{
+			stripList->firsts[stripList->count + i] = strips->count + blockList.firsts[i];
+			stripList->counts[stripList->count + i] = blockList.counts[i];
+		}
+		stripList->count += blockList.count;
+
+		const float * m = prim.p;
+		const VertexBuffer * sources[3] = { block.lines, block.strips, block.triangles };
+		VertexBuffer * targets[3] = { lines, strips, triangles };
+		for (int k = 0; k < 3; k++)
+		{
+			const VertexBuffer * source = sources[k];
+			VertexBuffer * target = targets[k];
+			if (target->count + source->count > target->capacity) _ReserveVertices(target, target->count + source->count);
+			ColorVertex * out = target->data + target->count;
+			for (int i = 0; i < source->count; i++)
+			{
+				const ColorVertex & v = source->data[i];
+				out[i].x = m[0] * v.x + m[2] * v.y + m[4];
+				out[i].y = m[1] * v.x + m[3] * v.y + m[5];
+				out[i].z = z + v.z;
+				out[i].color = (prim.count != 0 ? prim.color : v.color);
+			}
+			target->count += source->count;
+		}
+	}
+
+	// Draws a primitive smaller than the level of detail size as a one pixel dash at its center
+	void EmitDot(VertexBuffer * lines, float xmin, float ymin, float xmax, float ymax, const View2D & view, float z, unsigned int color)
+	{
+		float x = (xmin + xmax) / 2;
+		float y = (ymin + ymax) / 2;
+		Push(lines, x, y, z, color);
+		Push(lines, x + view.pixelSize, y, z, color);
+	}
+
+	// Emits an elliptic arc as the points of a line strip or as a triangle fan around the center.
+	// Points are advanced by rotating the unit vector, so only one sin/cos pair is evaluated.
+	void EmitArc(VertexBuffer * buffer, bool fill, float x, float y, float rx, float ry,
+		float startAngle, float sweepAngle, int segments, bool closed, float z, unsigned int color)
+	{
+		float da = sweepAngle / (float)segments;
+		float cd = cosf(da), sd = sinf(da);
+		float c = cosf(startAngle), s = sinf(startAngle);
+		float x0 = x + rx * c, y0 = y + ry * s;
+		float xv = x0, yv = y0;
+		if (!fill) Push(buffer, x0, y0, z, color);
+		for (int i = 0; i < segments; i++)
+		{
+			float cn = c * cd - s * sd;
+			s = s * cd + c * sd;
+			c = cn;
+			float xend = x + rx * c, yend = y + ry * s;
+			if (closed && i == segments - 1) { xend = x0; yend = y0; }
+
+			if (fill)
+			{
+				Push(buffer, x, y, z, color);
+				Push(buffer, xv, yv, z, color);
+			}
+			Push(buffer, xend, yend, z, color);
+			xv = xend;
+			yv = yend;
+		}
+	}
+
+	// Emits the corner arcs of a rounded rectangle as the points of a line strip going
+	// around the rectangle, or as triangle fans
+	void EmitCorners(VertexBuffer * buffer, bool fill, float x1, float y1, float x2, float y2,
+		float rx, float ry, int segments, float z, unsigned int color)
+	{
+		// Each quarter turn uses the corner center in the same quadrant
+		float cx[4] = { x2 - rx, x1 + rx, x1 + rx, x2 - rx };
+		float cy[4] = { y2 - ry, y2 - ry, y1 + ry, y1 + ry };
+		int quarter = segments / 4;
+		float da = 2.0f * Pi / (float)segments;
+		float cd = cosf(da), sd = sinf(da);
+		float c = 1.0f, s = 0.0f;
+		for (int q = 0; q < 4; q++)
+		{
+			// Consecutive corners are joined by the straight sides of the strip
+			if (!fill) Push(buffer, cx[q] + rx * c, cy[q] + ry * s, z, color);
+			for (int i = 0; i < quarter; i++)
+			{
+				float cn = c * cd - s * sd;
+				float sn = s * cd + c * sd;
+				if (fill)
+				{
+					Push(buffer, cx[q], cy[q], z, color);
+					Push(buffer, cx[q] + rx * c, cy[q] + ry * s, z, color);
+				}
+				Push(buffer, cx[q] + rx * cn, cy[q] + ry * sn, z, color);
+				c = cn;
+				s = sn;
+			}
+		}
+	}
+
+	// Emits the quad of an analytic ellipse (radius < 0) or rounded rectangle centered at
+	// (x, y) with the given half size. The quad is larger than the shape by margin, so that
+	// anti-aliased edges and outlines are not cut off.
+	void EmitShape(ShapeBuffer * shapes, float x, float y, float hx, float hy, float radius, bool outline,
+		float margin, float z, unsigned int color)
+	{
+		if (shapes->count + 4 > shapes->capacity) _ReserveShapes(shapes, shapes->count + 4);
+		ShapeVertex * v = shapes->data + shapes->count;
+		const float su[4] = { -1.0f, 1.0f, 1.0f, -1.0f };
+		const float sv[4] = { -1.0f, -1.0f, 1.0f, 1.0f };
+		for (int i = 0; i < 4; i++)
+		{
+			v[i].u = su[i] * (hx + margin);
+			v[i].v = sv[i] * (hy + margin);
+			v[i].x = x + v[i].u;
+			v[i].y = y + v[i].v;
+			v[i].z = z;
+			v[i].color = color;
+			v[i].hx = hx;
+			v[i].hy = hy;
+			v[i].radius = radius;
+			v[i].outline = (outline ? 1.0f : 0.0f);
+		}
+		shapes->count += 4;
+	}
+
+	void EmitQuad(VertexBuffer * buffer, float x1, float y1, float x2, float y2, float z, unsigned int color)
+	{
+		Push(buffer, x1, y1, z, color);
+		Push(buffer, x2, y1, z, color);
+		Push(buffer, x2, y2, z, color);
+		Push(buffer, x2, y2, z, color);
+		Push(buffer, x1, y2, z, color);
+		Push(buffer, x1, y1, z, color);
+	}
+
+	// Tessellates a primitive. Polygons and triangle lists are also clipped to the clip
+	// rectangle, which is the view enlarged by a guard band. Outlines and curves are
+	// emitted as line strips, so that consecutive segments share their vertices.
+	void Tessellate(const Primitive2D & prim, const Batch2D & batch, const View2D & view, const float * clip, float z,
+		VertexBuffer * lines, VertexBuffer * strips, StripList * stripList, VertexBuffer * triangles, ShapeBuffer * shapes,
+		ThreadScratch * thread)
+	{
+		const float * p = prim.p;
+		const float * points = batch.points;
+		unsigned int color = prim.color;
+		int first = strips->count;
+		switch (prim.type)
+		{
+		case PRIMITIVE_LINE:
+			Push(lines, p[0], p[1], z, color);
+			Push(lines, p[2], p[3], z, color);
+			break;
+		case PRIMITIVE_THICKLINE:
+			{
+				// Offset the end points along the line normal
+				float dx = p[2] - p[0], dy = p[3] - p[1];
+				float length = sqrtf(dx * dx + dy * dy);
+				float c = 1.0f, s = 0.0f;
+				if (length > 0) { c = dx / length; s = dy / length; }
+				float s1 = p[4] / 2 * s, c1 = p[4] / 2 * c;
+				float s2 = p[5] / 2 * s, c2 = p[5] / 2 * c;
+				Push(triangles, p[0] + s1, p[1] - c1, z, color);
+				Push(triangles, p[2] + s2, p[3] - c2, z, color);
+				Push(triangles, p[2] - s2, p[3] + c2, z, color);
+				Push(triangles, p[2] - s2, p[3] + c2, z, color);
+				Push(triangles, p[0] - s1, p[1] + c1, z, color);
+				Push(triangles, p[0] + s1, p[1] - c1, z, color);
+			}
+			break;
+		case PRIMITIVE_ARC:
+			EmitArc(strips, false, p[0], p[1], p[2] / 2, p[3] / 2, p[4], p[5],
+				_CirclePrecision(Max(p[2], p[3]), view.pixelSize), false, z, color);
+			_EndStrip(strips, stripList, first);
+			break;
+		case PRIMITIVE_PIE:
+			EmitArc(triangles, true, p[0], p[1], p[2] / 2, p[3] / 2, p[4], p[5],
+				_CirclePrecision(Max(p[2], p[3]), view.pixelSize), false, z, color);
+			break;
+		case PRIMITIVE_ELLIPSE:
+			if (view.shapeMargin > 0)
+			{
+				EmitShape(shapes, p[0], p[1], fabsf(p[2]) / 2, fabsf(p[3]) / 2, -1.0f, true, view.shapeMargin, z, color);
+				break;
+			}
+			EmitArc(strips, false, p[0], p[1], p[2] / 2, p[3] / 2, 0.0f, 2.0f * Pi,
+				_CirclePrecision(Max(p[2], p[3]), view.pixelSize), true, z, color);
+			_EndStrip(strips, stripList, first);
+			break;
+		case PRIMITIVE_FILLELLIPSE:
+			if (view.shapeMargin > 0)
+			{
+				EmitShape(shapes, p[0], p[1], fabsf(p[2]) / 2, fabsf(p[3]) / 2, -1.0f, false, view.shapeMargin, z, color);
+				break;
+			}
+			EmitArc(triangles, true, p[0], p[1], p[2] / 2, p[3] / 2, 0.0f, 2.0f * Pi,
+				_CirclePrecision(Max(p[2], p[3]), view.pixelSize), true, z, color);
+			break;
+		case PRIMITIVE_TRIANGLE:
+			Push(strips, p[0], p[1], z, color);
+			Push(strips, p[2], p[3], z, color);
+			Push(strips, p[4], p[5], z, color);
+			Push(strips, p[0], p[1], z, color);
+			_EndStrip(strips, stripList, first);
+			break;
+		case PRIMITIVE_FILLTRIANGLE:
+			Push(triangles, p[0], p[1], z, color);
+			Push(triangles, p[2], p[3], z, color);
+			Push(triangles, p[4], p[5], z, color);
+			break;
+		case PRIMITIVE_RECTANGLE:
+			Push(strips, p[0], p[1], z, color);
+			Push(strips, p[2], p[1], z, color);
+			Push(strips, p[2], p[3], z, color);
+			Push(strips, p[0], p[3], z, color);
+			Push(strips, p[0], p[1], z, color);
+			_EndStrip(strips, stripList, first);
+			break;
+		case PRIMITIVE_FILLRECTANGLE:
+			EmitQuad(triangles, p[0], p[1], p[2], p[3], z, color);
+			break;
+		case PRIMITIVE_ROUNDEDRECTANGLE:
+		case PRIMITIVE_FILLROUNDEDRECTANGLE:
+			{
+				float x1 = p[0], y1 = p[1], x2 = p[2], y2 = p[3], rx = p[4], ry = p[5];
+				if (view.shapeMargin > 0 && rx == ry)
+				{
+					// Analytic rounded rectangles have circular corners
+					float hx = fabsf(x2 - x1) / 2, hy = fabsf(y2 - y1) / 2;
+					EmitShape(shapes, (x1 + x2) / 2, (y1 + y2) / 2, hx, hy, Min(fabsf(rx), Min(hx, hy)),
+						prim.type == PRIMITIVE_ROUNDEDRECTANGLE, view.shapeMargin, z, color);
+					break;
+				}
+				// Make precision divisable by 4 so that each corner gets the same number of segments
+				int segments = (_CirclePrecision(Max(rx, ry) * 2.0f, view.pixelSize) | 3) + 1;
+				if (prim.type == PRIMITIVE_ROUNDEDRECTANGLE)
+				{
+					EmitCorners(strips, false, x1, y1, x2, y2, rx, ry, segments, z, color);
+					ColorVertex start = strips->data[first];
+					Push(strips, start.x, start.y, z, color);
+					_EndStrip(strips, stripList, first);
+				}
+				else
+				{
+					EmitQuad(triangles, x1, y1 + ry, x2, y2 - ry, z, color);		// center
+					EmitQuad(triangles, x1 + rx, y2 - ry, x2 - rx, y2, z, color);	// top
+					EmitQuad(triangles, x1 + rx, y1, x2 - rx, y1 + ry, z, color);	// bottom
+					EmitCorners(triangles, true, x1, y1, x2, y2, rx, ry, segments, z, color);
+				}
+			}
+			break;
+		case PRIMITIVE_BEZIER:
+		case PRIMITIVE_QUADRATICBEZIER:
+		case PRIMITIVE_BSPLINE:
+			{
+				// Flatten each curve span separately, so that the number of segments follows
+				// the curvature of the span. B-spline spans are converted to cubic Bezier curves.
+				const float * pt = points + prim.first * 2;
+				int degree = (prim.type == PRIMITIVE_QUADRATICBEZIER ? 2 : 3);
+				int spans = (prim.type == PRIMITIVE_BSPLINE ? prim.count - 3 : (prim.count - 1) / degree);
+				for (int s = 0; s < spans; s++)
+				{
+					float bezier[8];
+					const float * cp = pt + s * degree * 2;
+					if (prim.type == PRIMITIVE_BSPLINE)
+					{
+						_BSplineToBezier(pt + s * 2, bezier);
+						cp = bezier;
+					}
+
+					// Skip spans whose control points lie outside one side of the clip rectangle
+					int code = OutCode(cp[0], cp[1], clip);
+					for (int k = 1; k <= degree; k++) code &= OutCode(cp[k * 2], cp[k * 2 + 1], clip);
+					if (code != 0)
+					{
+						first = BreakStrip(strips, stripList, first);
+						continue;
+					}
+
+					int segments = _BezierSegments(cp, degree, view.flatness, MaxCurveSegments);
+					if ((int)thread->curve.size() < (segments + 1) * 2)
+					{
+						thread->curve.resize((MaxCurveSegments + 1) * 2);
+						_CountAllocation();
+					}
+					float * curve = &thread->curve[0];
+					_FlattenBezier(cp, degree, segments, curve);
+
+					code = OutCode(curve[0], curve[1], clip);
+					for (int i = 1; i <= segments; i++)
+					{
+						int next = OutCode(curve[i * 2], curve[i * 2 + 1], clip);
+						if ((code & next) == 0)
+							StripSegment(strips, first, curve + i * 2 - 2, curve + i * 2, z, color);
+						else
+							first = BreakStrip(strips, stripList, first);
+						code = next;
+					}
+				}
+				_EndStrip(strips, stripList, first);
+			}
+			break;
+		case PRIMITIVE_STROKE:
+			{
+				// Strokes of constant width are simplified to the level of detail. Round
+				// joins and caps get the precision of a circle as wide as the stroke.
+				const float * pt = points + prim.first * 2;
+				const float * widths = (p[5] != 0 ? pt + prim.count * 2 : 0);
+				int count = prim.count;
+				float width = p[0];
+				if (widths != 0)
+				{
+					for (int i = 0; i < count; i++) width = Max(width, fabsf(widths[i]));
+				}
+				else
+				{
+					count = _Simplify(thread->simplifier, pt, count, view.lodSize, p[4] != 0, &pt);
+				}
+				StrokeStyle2D style;
+				style.join = (int)p[1];
+				style.cap = (int)p[2];
+				style.miterLimit = p[3];
+				style.closed = (p[4] != 0);
+				style.roundSegments = _CirclePrecision(width, view.pixelSize);
+				_StrokePolyline(thread->stroker, pt, widths, p[0], count, style, z, color, triangles);
+			}
+			break;
+		case PRIMITIVE_POLYLINE:
+			{
+				// Polylines are already reduced to the pixel grid by their producer;
+				// only segments outside one side of the clip rectangle are skipped
+				const float * pt = points + prim.first * 2;
+				int code = OutCode(pt[0], pt[1], clip);
+				for (int i = 1; i < prim.count; i++)
+				{
+					int next = OutCode(pt[i * 2], pt[i * 2 + 1], clip);
+					if ((code & next) == 0)
+						StripSegment(strips, first, pt + i * 2 - 2, pt + i * 2, z, color);
+					else
+						first = BreakStrip(strips, stripList, first);
+					code = next;
+				}
+				_EndStrip(strips, stripList, first);
+			}
+			break;
+		case PRIMITIVE_POLYGON:
+			{
+				// Simplify the outline to the level of detail, then skip edges lying
+				// entirely on the outside of one side of the clip rectangle
+				const float * pt = points + prim.first * 2;
+				int count = _Simplify(thread->simplifier, pt, prim.count, view.lodSize, true, &pt);
+				int code = OutCode(pt[0], pt[1], clip);
+				for (int i = 0; i < count; i++)
+				{
+					int j = (i == count - 1 ? 0 : i + 1);
+					int next = OutCode(pt[j * 2], pt[j * 2 + 1], clip);
+					if ((code & next) == 0)
+						StripSegment(strips, first, pt + i * 2, pt + j * 2, z, color);
+					else
+						first = BreakStrip(strips, stripList, first);
+					code = next;
+				}
+				_EndStrip(strips, stripList, first);
+			}
+			break;
+		case PRIMITIVE_FILLPOLYGON:
+			{
+				// Polygons are simplified to the level of detail, and polygons crossing
+				// the clip rectangle are clipped before they are triangulated
+				const float * pt = points + prim.first * 2;
+				int count = _Simplify(thread->simplifier, pt, prim.count, view.lodSize, true, &pt);
+				if (count < 3) break;
+				int sides = 0;
+				for (int i = 0; i < count; i++)
+					sides |= OutCode(pt[i * 2], pt[i * 2 + 1], clip);
+				if (sides != 0)
+				{
+					count = ClipPolygon(pt, count, clip, sides, thread, &pt);
+					if (count == 0) break;
+				}
+
+				// Polygons may be concave, so they are triangulated by ear clipping
+				const int * indices;
+				count = _Triangulate(thread->triangulator, pt, &count, 1, &indices);
+				for (int i = 0; i < count; i++)
+					Push(triangles, pt[indices[i] * 2], pt[indices[i] * 2 + 1], z, color);
+			}
+			break;
+		case PRIMITIVE_TRIANGLELIST:
+			{
+				// Skip triangles lying entirely on the outside of one side of the clip rectangle
+				const float * pt = points + prim.first * 2;
+				for (int i = 0; i + 2 < prim.count; i += 3, pt += 6)
+				{
+					if ((OutCode(pt[0], pt[1], clip) & OutCode(pt[2], pt[3], clip) & OutCode(pt[4], pt[5], clip)) != 0)
+						continue;
+					Push(triangles, pt[0], pt[1], z, color);
+					Push(triangles, pt[2], pt[3], z, color);
+					Push(triangles, pt[4], pt[5], z, color);
+				}
+			}
+			break;
+		}
+	}
+
+	struct TessellateJob
+	{
+		Batch2D * batch;
+		const View2D * view;
+		VertexBuffer * lines;
+		VertexBuffer * strips;
+		StripList * stripList;
+		VertexBuffer * triangles;
+		ShapeBuffer * shapes;
+		float clip[4];
+	};
+
+	// Culls and tessellates a chunk of primitives into the chunk's own buffers.
+	// The z coordinate holds the rank of the primitive among the visible primitives
+	// of the chunk until the chunks are merged.
+	void TessellateChunk(void * context, int begin, int end, int worker)
+	{
+		TessellateJob * job = (TessellateJob *)context;
+		TessellatorScratch * scratch = job->batch->scratch;
+		ThreadScratch * thread = scratch->threads[worker];
+		int chunk = begin / ChunkSize;
+		VertexBuffer * lines = &scratch->lines[chunk];
+		VertexBuffer * strips = &scratch->strips[chunk];
+		StripList * stripList = &scratch->stripLists[chunk];
+		VertexBuffer * triangles = &scratch->triangles[chunk];
+		ShapeBuffer * shapes = &scratch->shapes[chunk];
+		shapes->count = 0;
+		lines->count = 0;
+		strips->count = 0;
+		stripList->count = 0;
+		triangles->count = 0;
+
+		const View2D & view = *job->view;
+		const Batch2D & batch = *job->batch;
+		int visible = 0;
+		for (int i = begin; i < end; i++)
+		{
+			const Primitive2D & prim = batch.primitives[i];
+			float xmin, ymin, xmax, ymax;
+			GetBounds(prim, batch, xmin, ymin, xmax, ymax);
+			if (!(xmin < view.xmax && view.xmin < xmax && ymin < view.ymax && view.ymin < ymax)) continue;
+
+			if (xmax - xmin < view.lodSize && ymax - ymin < view.lodSize)
+			{
+				EmitDot(lines, xmin, ymin, xmax, ymax, view, (float)visible, prim.color);
+				visible++;
+			}
+			else if (prim.type == PRIMITIVE_BLOCK)
+			{
+				// A block reference takes one depth step for each primitive of the block
+				const Block2D & block = *batch.blocks[prim.first];
+				EmitBlock(prim, block, (float)visible, lines, strips, stripList, triangles);
+				visible += Max(block.rankCount, 1);
+			}
+			else
+			{
+				Tessellate(prim, batch, view, job->clip, (float)visible, lines, strips, stripList, triangles, shapes, thread);
+				visible++;
+			}
+		}
+		scratch->visible[chunk] = visible;
+	}
+
+	void CopyChunk(const VertexBuffer & source, VertexBuffer * target, int offset, int depthOffset, const View2D & view)
+	{
+		ColorVertex * out = target->data + offset;
+		for (int i = 0; i < source.count; i++)
+		{
+			out[i] = source.data[i];
+			out[i].z = view.depth + ((float)depthOffset + source.data[i].z) * view.depthStep;
+		}
+	}
+
+	void CopyChunk(const ShapeBuffer & source, ShapeBuffer * target, int offset, int depthOffset, const View2D & view)
+	{
+		ShapeVertex * out = target->data + offset;
+		for (int i = 0; i < source.count; i++)
+		{
+			out[i] = source.data[i];
+			out[i].z = view.depth + ((float)depthOffset + source.data[i].z) * view.depthStep;
+		}
+	}
+
+	// Copies chunk outputs to their final place and converts ranks to depths
+	void MergeChunks(void * context, int begin, int end, int)
+	{
+		TessellateJob * job = (TessellateJob *)context;
+		TessellatorScratch * scratch = job->batch->scratch;
+		for (int chunk = begin; chunk < end; chunk++)
+		{
+			CopyChunk(scratch->lines[chunk], job->lines, scratch->lineOffsets[chunk], scratch->depthOffsets[chunk], *job->view);
+			CopyChunk(scratch->strips[chunk], job->strips, scratch->stripOffsets[chunk], scratch->depthOffsets[chunk], *job->view);
+			CopyChunk(scratch->triangles[chunk], job->triangles, scratch->triangleOffsets[chunk], scratch->depthOffsets[chunk], *job->view);
+			if (job->shapes != 0)
+				CopyChunk(scratch->shapes[chunk], job->shapes, scratch->shapeOffsets[chunk], scratch->depthOffsets[chunk], *job->view);
+
+			// Strip ranges move with the strip vertices of the chunk
+			const StripList & source = scratch->stripLists[chunk];
+			int offset = scratch->stripOffsets[chunk];
+			int * firsts = job->stripList->firsts + scratch->stripListOffsets[chunk];
+			int * counts = job->stripList->counts + scratch->stripListOffsets[chunk];
+			for (int i = 0; i < source.count; i++)
+			{
+				firsts[i] = source.firsts[i] + offset;
+				counts[i] = source.counts[i];
+			}
+		}
+	}
+}
+
+Batch2D * _CreateBatch2D()
+{
+	Batch2D * batch = (Batch2D *)_Allocate(sizeof(Batch2D));
+	memset(batch, 0, sizeof(Batch2D));
+	batch->scratch = new TessellatorScratch();
+	_CountAllocation();
+	return batch;
+}
+
+void _DestroyBatch2D(Batch2D * batch)
+{
+	if (batch == 0) return;
+	TessellatorScratch * scratch = batch->scratch;
+	for (size_t i = 0; i < scratch->lines.size(); i++)
+	{
+		_Free(scratch->lines[i].data);
+		_Free(scratch->strips[i].data);
+		_Free(scratch->stripLists[i].firsts);
+		_Free(scratch->stripLists[i].counts);
+		_Free(scratch->triangles[i].data);
+		_Free(scratch->shapes[i].data);
+	}
+	for (size_t i = 0; i < scratch->threads.size(); i++)
+	{
+		_DestroySimplifier(scratch->threads[i]->simplifier);
+		_DestroyTriangulator(scratch->threads[i]->triangulator);
+		_DestroyStroker(scratch->threads[i]->stroker);
+		delete scratch->threads[i];
+	}
+	delete scratch;
+	_Free(batch->primitives);
+	_Free(batch->points);
+	_Free(batch->blocks);
+	_Free(batch);
+}
+
+void _ReservePrimitives(Batch2D * batch, int capacity)
+{
+	if (capacity <= batch->primitiveCapacity) return;
+	int grown = Max(Max(batch->primitiveCapacity * 2, 1024), capacity);
+	batch->primitives = (Primitive2D *)_Reallocate(batch->primitives, grown * sizeof(Primitive2D));
+	batch->primitiveCapacity = grown;
+}
+
+void _ReservePoints(Batch2D * batch, int capacity)
+{
+	if (capacity <= batch->pointCapacity) return;
+	int grown = Max(Max(batch->pointCapacity * 2, 1024), capacity);
+	batch->points = (float *)_Reallocate(batch->points, grown * 2 * sizeof(float));
+	batch->pointCapacity = grown;
+}
+
+int _AddBlock(Batch2D * batch, const Block2D * block)
+{
+	if (batch->blockCount == batch->blockCapacity)
+	{
+		int grown = Max(batch->blockCapacity * 2, 64);
+		batch->blocks = (const Block2D **)_Reallocate(batch->blocks, grown * sizeof(const Block2D *));
+		batch->blockCapacity = grown;
+	}
+	batch->blocks[batch->blockCount] = block;
+	return batch->blockCount++;
+}
+
+Block2D * _CreateBlock2D()
+{
+	Block2D * block = (Block2D *)_Allocate(sizeof(Block2D));
+	memset(block, 0, sizeof(Block2D));
+	block->definition = _CreateBatch2D();
+	block->lines = _CreateVertexBuffer();
+	block->strips = _CreateVertexBuffer();
+	block->stripList = _CreateStripList();
+	block->triangles = _CreateVertexBuffer();
+	return block;
+}
+
+void _DestroyBlock2D(Block2D * block)
+{
+	if (block == 0) return;
+	_DestroyBatch2D(block->definition);
+	_DestroyVertexBuffer(block->lines);
+	_DestroyVertexBuffer(block->strips);
+	_DestroyStripList(block->stripList);
+	_DestroyVertexBuffer(block->triangles);
+	_Free(block);
+}
+
+void _TessellateBlock2D(Block2D * block, float pixelSize)
+{
+	const Batch2D & batch = *block->definition;
+	block->xmin = block->ymin = block->xmax = block->ymax = 0;
+	for (int i = 0; i < batch.primitiveCount; i++)
+	{
+		float xmin, ymin, xmax, ymax;
+		GetBounds(batch.primitives[i], batch, xmin, ymin, xmax, ymax);
+		if (i == 0) { block->xmin = xmin; block->ymin = ymin; block->xmax = xmax; block->ymax = ymax; }
+		block->xmin = Min(block->xmin, xmin); block->xmax = Max(block->xmax, xmax);
+		block->ymin = Min(block->ymin, ymin); block->ymax = Max(block->ymax, ymax);
+	}
+
+	block->lines->count = 0;
+	block->strips->count = 0;
+	block->stripList->count = 0;
+	block->triangles->count = 0;
+	block->rankCount = 0;
+	block->pixelSize = pixelSize;
+	if (!(pixelSize > 0)) return;
+
+	// Tessellate the whole block without culling or level of detail; vertices
+	// receive the rank of their primitive as z
+	float margin = Max(block->xmax - block->xmin, block->ymax - block->ymin) + pixelSize;
+	View2D view;
+	view.xmin = block->xmin - margin;
+	view.ymin = block->ymin - margin;
+	view.xmax = block->xmax + margin;
+	view.ymax = block->ymax + margin;
+	view.pixelSize = pixelSize;
+	view.depth = 0;
+	view.depthStep = 1;
+	view.lodSize = 0;
+	view.flatness = pixelSize * 0.25f;
+	view.shapeMargin = 0;
+	block->rankCount = _Tessellate2D(block->definition, view, 0, block->lines, block->strips, block->stripList, block->triangles, 0);
+}
+
+int _CirclePrecision(float featureSize, float pixelSize)
+{
+	// Try to represent curved features by at most 4 pixels.
+	float pixels = pixelSize > 0 ? featureSize / pixelSize : 0.0f;
+	if (!(pixels > 0)) pixels = 0;
+	if (pixels > 1.0e8f) pixels = 1.0e8f;
+	return (int)(sqrtf(floorf(pixels)) * 3.0f) + 4;
+}
+
+int _Tessellate2D(Batch2D * batch, const View2D & view, JobSystem * jobs, VertexBuffer * lines,
+	VertexBuffer * strips, StripList * stripList, VertexBuffer * triangles, ShapeBuffer * shapes)
+{
+	int count = batch->primitiveCount;
+	if (count == 0) return 0;
+
+	TessellatorScratch * scratch = batch->scratch;
+	int chunks = (count + ChunkSize - 1) / ChunkSize;
+	if ((int)scratch->lines.size() < chunks)
+	{
+		VertexBuffer empty = { 0, 0, 0 };
+		StripList emptyList = { 0, 0, 0, 0 };
+		ShapeBuffer emptyShapes = { 0, 0, 0 };
+		scratch->lines.resize(chunks, empty);
+		scratch->strips.resize(chunks, empty);
+		scratch->stripLists.resize(chunks, emptyList);
+		scratch->triangles.resize(chunks, empty);
+		scratch->shapes.resize(chunks, emptyShapes);
+		scratch->visible.resize(chunks);
+		scratch->lineOffsets.resize(chunks);
+		scratch->stripOffsets.resize(chunks);
+		scratch->stripListOffsets.resize(chunks);
+		scratch->triangleOffsets.resize(chunks);
+		scratch->shapeOffsets.resize(chunks);
+		scratch->depthOffsets.resize(chunks);
+		_CountAllocation();
+	}
+	while ((int)scratch->threads.size() < _JobThreadCount(jobs))
+	{
+		ThreadScratch * thread = new ThreadScratch();
+		_CountAllocation();
+		thread->simplifier = _CreateSimplifier();
+		thread->triangulator = _CreateTriangulator();
+		thread->stroker = _CreateStroker();
+		scratch->threads.push_back(thread);
+	}
+
+	// Geometry is clipped to the view enlarged by half its size on each side, so that
+	// clipped edges stay well outside the visible area
+	float band = Max(view.xmax - view.xmin, view.ymax - view.ymin) * 0.5f;
+	TessellateJob job = { batch, &view, lines, strips, stripList, triangles, shapes,
+		{ view.xmin - band, view.ymin - band, view.xmax + band, view.ymax + band } };
+	_ParallelFor(jobs, count, ChunkSize, TessellateChunk, &job);
+
+	// Place chunk outputs one after the other in draw order
+	int lineCount = lines->count, stripCount = strips->count, stripListCount = stripList->count;
+	int triangleCount = triangles->count, shapeCount = (shapes != 0 ? shapes->count : 0), visible = 0;
+	for (int chunk = 0; chunk < chunks; chunk++)
+	{
+		scratch->lineOffsets[chunk] = lineCount;
+		scratch->stripOffsets[chunk] = stripCount;
+		scratch->stripListOffsets[chunk] = stripListCount;
+		scratch->triangleOffsets[chunk] = triangleCount;
+		scratch->shapeOffsets[chunk] = shapeCount;
+		scratch->depthOffsets[chunk] = visible;
+		lineCount += scratch->lines[chunk].count;
+		stripCount += scratch->strips[chunk].count;
+		stripListCount += scratch->stripLists[chunk].count;
+		triangleCount += scratch->triangles[chunk].count;
+		shapeCount += scratch->shapes[chunk].count;
+		visible += scratch->visible[chunk];
+	}
+	_ReserveVertices(lines, lineCount);
+	_ReserveVertices(strips, stripCount);
+	_ReserveStrips(stripList, stripListCount);
+	_ReserveVertices(triangles, triangleCount);
+	if (shapes != 0) _ReserveShapes(shapes, shapeCount);
+
+	_ParallelFor(jobs, chunks, 1, MergeChunks, &job);
+	lines->count = lineCount;
+	strips->count = stripCount;
+	stripList->count = stripListCount;
+	triangles->count = triangleCount;
+	if (shapes != 0) shapes->count = shapeCount;
+
+	return visible;
+}
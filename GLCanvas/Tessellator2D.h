@@ -0,0 +1,155 @@
+#pragma once
+
+// Native 2D tessellator. GLGraphics2D records compact primitive descriptions
+// into a Batch2D; at render time the batch is culled and tessellated in parallel
+// chunks and the chunk outputs are merged in draw order.
+
+#include "VertexBuffer.h"
+
+struct Block2D;
+struct JobSystem;
+struct TessellatorScratch;
+
+/// <summary>
+/// Primitive types. Parameters are stored in Primitive2D::p in the order given.
+/// </summary>
+enum PrimitiveType2D
+{
+	PRIMITIVE_LINE,					// x1, y1, x2, y2
+	PRIMITIVE_THICKLINE,			// x1, y1, x2, y2, start thickness, end thickness
+	PRIMITIVE_ARC,					// x, y, width, height, start angle, sweep angle
+	PRIMITIVE_PIE,					// x, y, width, height, start angle, sweep angle
+	PRIMITIVE_TRIANGLE,				// x1, y1, x2, y2, x3, y3
+	PRIMITIVE_FILLTRIANGLE,			// x1, y1, x2, y2, x3, y3
+	PRIMITIVE_RECTANGLE,			// x1, y1, x2, y2
+	PRIMITIVE_FILLRECTANGLE,		// x1, y1, x2, y2
+	PRIMITIVE_ROUNDEDRECTANGLE,		// x1, y1, x2, y2, rx, ry
+	PRIMITIVE_FILLROUNDEDRECTANGLE,	// x1, y1, x2, y2, rx, ry
+	PRIMITIVE_ELLIPSE,				// x, y, width, height
+	PRIMITIVE_FILLELLIPSE,			// x, y, width, height
+	PRIMITIVE_POLYGON,				// points [first, first + count)
+	PRIMITIVE_FILLPOLYGON,			// points [first, first + count)
+	PRIMITIVE_TRIANGLELIST,			// triangle corner points [first, first + count)
+	PRIMITIVE_POLYLINE,				// open polyline through points [first, first + count)
+	PRIMITIVE_BLOCK,				// m11, m12, m21, m22, dx, dy; first indexes Batch2D::blocks,
+									// count is nonzero if color replaces the block colors
+	PRIMITIVE_BEZIER,				// connected cubic Bezier curves through control points [first, first + count)
+	PRIMITIVE_QUADRATICBEZIER,		// connected quadratic Bezier curves through control points [first, first + count)
+	PRIMITIVE_BSPLINE,				// uniform cubic B-spline with control points [first, first + count)
+	PRIMITIVE_STROKE				// thick polyline through points [first, first + count); width, join,
+									// cap, miter limit, closed, and nonzero if the points are followed
+									// by the width at each point, padded to whole points
+};
+
+/// <summary>
+/// Represents a recorded 2D primitive.
+/// </summary>
+struct Primitive2D
+{
+	int type;
+	unsigned int color;
+	int first, count;
+	float p[6];
+};
+
+/// <summary>
+/// Represents the primitives recorded for one frame. Polygon corner points
+/// are stored as x, y pairs in a shared point pool. Blocks referenced by
+/// PRIMITIVE_BLOCK primitives are listed in blocks.
+/// </summary>
+struct Batch2D
+{
+	Primitive2D * primitives;
+	int primitiveCount;
+	int primitiveCapacity;
+	float * points;
+	int pointCount;
+	int pointCapacity;
+	const Block2D ** blocks;
+	int blockCount;
+	int blockCapacity;
+	TessellatorScratch * scratch;
+};
+
+/// <summary>
+/// Represents a block definition: primitives tessellated once in block coordinates
+/// and emitted with a transform for each reference. The z coordinate of block vertices
+/// holds the rank of their primitive within the block.
+/// </summary>
+struct Block2D
+{
+	Batch2D * definition;		// primitives of the block
+	VertexBuffer * lines;		// tessellated lines
+	VertexBuffer * strips;		// tessellated line strips
+	StripList * stripList;		// vertex ranges of the line strips
+	VertexBuffer * triangles;	// tessellated triangles
+	float pixelSize;			// pixel size the block was tessellated for; zero if not tessellated
+	int rankCount;				// number of depth ranks used by the block
+	float xmin, ymin, xmax, ymax;	// bounding box in block coordinates
+};
+
+/// <summary>
+/// Contains the view parameters for tessellation.
+/// </summary>
+struct View2D
+{
+	float xmin, ymin, xmax, ymax;	// visible area in world coordinates
+	float pixelSize;				// size of a pixel in world coordinates
+	float depth;					// depth of the first visible primitive
+	float depthStep;				// depth increment between visible primitives
+	float lodSize;					// primitives smaller than this are drawn as dots and polygons
+									// are simplified with this tolerance; zero disables level of detail
+	float flatness;					// largest distance between a curve and its flattened polyline
+	float shapeMargin;				// margin around the quads of analytic shapes; zero tessellates
+									// ellipses and rounded rectangles instead
+};
+
+/// <summary>
+/// Creates an empty batch.
+/// </summary>
+Batch2D * _CreateBatch2D();
+/// <summary>
+/// Releases a batch and its tessellation buffers.
+/// </summary>
+void _DestroyBatch2D(Batch2D * batch);
+/// <summary>
+/// Makes room for at least capacity primitives.
+/// </summary>
+void _ReservePrimitives(Batch2D * batch, int capacity);
+/// <summary>
+/// Makes room for at least capacity points in the point pool.
+/// </summary>
+void _ReservePoints(Batch2D * batch, int capacity);
+/// <summary>
+/// Adds a block to the block list of the batch and returns its index.
+/// </summary>
+int _AddBlock(Batch2D * batch, const Block2D * block);
+/// <summary>
+/// Creates an empty block definition.
+/// </summary>
+Block2D * _CreateBlock2D();
+/// <summary>
+/// Releases a block definition and its tessellation.
+/// </summary>
+void _DestroyBlock2D(Block2D * block);
+/// <summary>
+/// Tessellates the primitives of a block for the given pixel size in block coordinates
+/// and computes the bounding box of the block. A pixel size of zero only computes the
+/// bounding box.
+/// </summary>
+void _TessellateBlock2D(Block2D * block, float pixelSize);
+/// <summary>
+/// Returns the number of segments required to approximate a curve with the given
+/// feature size so that each segment is at most a few pixels long.
+/// </summary>
+int _CirclePrecision(float featureSize, float pixelSize);
+/// <summary>
+/// Culls and tessellates the primitives in the batch, appending line vertices to lines,
+/// outlines and curves as line strips to strips and stripList, triangle vertices to
+/// triangles, and ellipses and rounded rectangles to shapes as analytic shape quads
+/// if view.shapeMargin is nonzero, in draw order. shapes may be null if view.shapeMargin
+/// is zero. Returns the number of depth steps used, which is the number of visible
+/// primitives plus the additional primitives of visible block references.
+/// </summary>
+int _Tessellate2D(Batch2D * batch, const View2D & view, JobSystem * jobs, VertexBuffer * lines,
+	VertexBuffer * strips, StripList * stripList, VertexBuffer * triangles, ShapeBuffer * shapes);
@@ -0,0 +1,206 @@
+// Native code, compiled without /clr.
+
+#include "TimeSeries.h"
+#include "NativeMemory.h"
+
+#include <math.h>
+
+// Level k of the pyramid holds the smallest and largest sample of each aligned
+// block of 2^k samples, for k = 1 to log2(capacity). Blocks are stored in ring
+// order like the samples and are written from their two halves when their last
+// sample is appended, so appending costs two block merges per sample on average.
+// The minimum and maximum of a range of samples are found by covering the range
+// with the largest complete aligned blocks that fit into it.
+
+namespace
+{
+	// Levels above this are not needed for any practical capacity
+	const int MaxLevels = 30;
+}
+
+struct TimeSeries
+{
+	int capacity;
+	int levels;						// log2(capacity)
+	long long count;				// samples appended
+	float * values;					// ring buffer of samples
+	float * minmax[MaxLevels + 1];	// smallest and largest sample of each block of level k
+};
+
+namespace
+{
+	// Finds the smallest and largest sample in [first, last); the range must lie
+	// within the retained samples
+	void RangeMinMax(const TimeSeries * s, long long first, long long last, float & lower, float & upper)
+	{
+		long long mask = s->capacity - 1;
+		lower = upper = s->values[first & mask];
+		while (first < last)
+		{
+			int k = 0;
+			while (k < s->levels && (first & ((2LL << k) - 1)) == 0 && first + (2LL << k) <= last) k++;
+
+			float lo, hi;
+			if (k == 0)
+			{
+				lo = hi = s->values[first & mask];
+			}
+			else
+			{
+				const float * mm = s->minmax[k] + ((first >> k) & (mask >> k)) * 2;
+				lo = mm[0];
+				hi = mm[1];
+			}
+			if (lo < lower) lower = lo;
+			if (hi > upper) upper = hi;
+			first += 1LL << k;
+		}
+	}
+
+	// Returns the first sample at or after x, limited to [lower, upper]
+	long long SampleAt(double x, double origin, double interval, long long lower, long long upper)
+	{
+		double i = ceil((x - origin) / interval);
+		if (i < (double)lower) return lower;
+		if (i > (double)upper) return upper;
+		return (long long)i;
+	}
+}
+
+TimeSeries * _CreateTimeSeries(int capacity)
+{
+	TimeSeries * series = (TimeSeries *)_Allocate(sizeof(TimeSeries));
+	series->capacity = 2;
+	series->levels = 1;
+	while (series->capacity < capacity && series->levels < MaxLevels)
+	{
+		series->capacity *= 2;
+		series->levels++;
+	}
+	series->count = 0;
+	series->values = (float *)_Allocate(series->capacity * sizeof(float));
+	series->minmax[0] = 0;
+	for (int k = 1; k <= series->levels; k++)
+		series->minmax[k] = (float *)_Allocate((series->capacity >> k) * 2 * sizeof(float));
+	return series;
+}
+
+void _DestroyTimeSeries(TimeSeries * series)
+{
+	if (series == 0) return;
+	_Free(series->values);
+	for (int k = 1; k <= series->levels; k++)
+		_Free(series->minmax[k]);
+	_Free(series);
+}
+
+int _TimeSeriesCapacity(const TimeSeries * series)
+{
+	return series->capacity;
+}
+
+long long _TimeSeriesCount(const TimeSeries * series)
+{
+	return series->count;
+}
+
+void _ClearTimeSeries(TimeSeries * series)
+{
+	series->count = 0;
+}
+
+void _AppendSamples(TimeSeries * series, const float * values, int count)
+{
+	long long mask = series->capacity - 1;
+	long long index = series->count;
+	for (int i = 0; i < count; i++, index++)
+	{
+		series->values[index & mask] = values[i];
+
+		// Write the blocks completed by this sample
+		for (int k = 1; k <= series->levels && ((index + 1) & ((1LL << k) - 1)) == 0; k++)
+		{
+			float * mm = series->minmax[k] + ((index >> k) & (mask >> k)) * 2;
+			float lo1, hi1, lo2, hi2;
+			if (k == 1)
+			{
+				lo1 = hi1 = series->values[(index - 1) & mask];
+				lo2 = hi2 = series->values[index & mask];
+			}
+			else
+			{
+				const float * half = series->minmax[k - 1] + ((index >> (k - 1)) & (mask >> (k - 1))) * 2;
+				const float * other = series->minmax[k - 1] + (((index >> (k - 1)) - 1) & (mask >> (k - 1))) * 2;
+				lo1 = other[0]; hi1 = other[1];
+				lo2 = half[0]; hi2 = half[1];
+			}
+			mm[0] = (lo1 < lo2 ? lo1 : lo2);
+			mm[1] = (hi1 > hi2 ? hi1 : hi2);
+		}
+	}
+	series->count = index;
+}
+
+bool _TimeSeriesRange(const TimeSeries * series, float * lower, float * upper)
+{
+	if (series->count == 0) return false;
+	long long first = (series->count > series->capacity ? series->count - series->capacity : 0);
+	RangeMinMax(series, first, series->count, *lower, *upper);
+	return true;
+}
+
+int _DecimatedPointCount(int columns)
+{
+	return columns * 2 + 2;
+}
+
+int _DecimateTimeSeries(const TimeSeries * series, double origin, double interval,
+	float xmin, float xmax, int columns, float * points)
+{
+	if (series->count == 0 || columns < 1 || !(interval > 0)) return 0;
+
+	// Find the retained samples covering the range, with one sample on either side
+	long long oldest = (series->count > series->capacity ? series->count - series->capacity : 0);
+	long long newest = series->count - 1;
+	double f0 = floor(((double)xmin - origin) / interval);
+	double f1 = ceil(((double)xmax - origin) / interval);
+	if (f1 < (double)oldest || f0 > (double)newest) return 0;
+	long long first = (f0 < (double)oldest ? oldest : (long long)f0);
+	long long last = (f1 > (double)newest ? newest : (long long)f1);
+
+	long long mask = series->capacity - 1;
+	int n = 0;
+	if (last - first + 1 <= (long long)columns * 2)
+	{
+		// Few enough samples to draw them all
+		for (long long i = first; i <= last; i++)
+		{
+			points[n * 2] = (float)(origin + (double)i * interval);
+			points[n * 2 + 1] = series->values[i & mask];
+			n++;
+		}
+		return n;
+	}
+
+	// Draw each column as a vertical segment, starting at the end nearer
+	// to the previous column so that the line does not zig-zag
+	double columnSize = ((double)xmax - (double)xmin) / (double)columns;
+	long long begin = first;
+	for (int c = 0; c < columns; c++)
+	{
+		long long end = (c == columns - 1 ? last + 1 : SampleAt((double)xmin + (c + 1) * columnSize, origin, interval, begin, last + 1));
+		if (end <= begin) continue;
+
+		float lower, upper;
+		RangeMinMax(series, begin, end, lower, upper);
+		float x = (float)((double)xmin + (c + 0.5) * columnSize);
+		bool down = (n != 0 && fabsf(points[n * 2 - 1] - upper) < fabsf(points[n * 2 - 1] - lower));
+		points[n * 2] = x;
+		points[n * 2 + 1] = (down ? upper : lower);
+		points[n * 2 + 2] = x;
+		points[n * 2 + 3] = (down ? lower : upper);
+		n += 2;
+		begin = end;
+	}
+	return n;
+}
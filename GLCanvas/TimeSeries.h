@@ -0,0 +1,55 @@
+#pragma once
+
+// Native streaming time series. Samples are kept in a ring buffer together with a
+// min/max pyramid, so that any range of samples can be reduced to one vertical
+// segment per pixel column in time proportional to the number of columns.
+// The implementation is compiled without /clr.
+
+struct TimeSeries;
+
+/// <summary>
+/// Creates an empty time series holding the last capacity samples. Capacity is
+/// rounded up to a power of two.
+/// </summary>
+TimeSeries * _CreateTimeSeries(int capacity);
+/// <summary>
+/// Releases a time series.
+/// </summary>
+void _DestroyTimeSeries(TimeSeries * series);
+/// <summary>
+/// Returns the number of samples the time series holds.
+/// </summary>
+int _TimeSeriesCapacity(const TimeSeries * series);
+/// <summary>
+/// Returns the number of samples appended since the time series was created or cleared.
+/// Only the last capacity samples are retained.
+/// </summary>
+long long _TimeSeriesCount(const TimeSeries * series);
+/// <summary>
+/// Removes all samples.
+/// </summary>
+void _ClearTimeSeries(TimeSeries * series);
+/// <summary>
+/// Appends count samples. Only the ring buffer slots of the new samples and the
+/// pyramid blocks containing them are written.
+/// </summary>
+void _AppendSamples(TimeSeries * series, const float * values, int count);
+/// <summary>
+/// Computes the smallest and largest retained sample. Returns false if there are no samples.
+/// </summary>
+bool _TimeSeriesRange(const TimeSeries * series, float * lower, float * upper);
+/// <summary>
+/// Returns the largest number of points _DecimateTimeSeries writes for the given number of columns.
+/// </summary>
+int _DecimatedPointCount(int columns);
+/// <summary>
+/// Reduces the retained samples between xmin and xmax to a polyline written to points as
+/// x, y pairs. Sample i lies at x = origin + i * interval. The range is divided into the
+/// given number of columns. If there are more than two samples per column, each column is
+/// drawn as a vertical segment from its smallest to its largest sample; otherwise the
+/// samples are written unchanged. One sample on either side of the range is included so
+/// that the line continues to the edges. points must hold _DecimatedPointCount(columns)
+/// points. Returns the number of points written.
+/// </summary>
+int _DecimateTimeSeries(const TimeSeries * series, double origin, double interval,
+	float xmin, float xmax, int columns, float * points);
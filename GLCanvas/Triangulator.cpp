@@ -0,0 +1,645 @@
+// Native code, compiled without /clr.
+
+#include "Triangulator.h"
+#include "NativeMemory.h"
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+// Polygons are triangulated by ear clipping on a doubly linked list of vertices.
+// Holes are joined to the outer ring with bridge edges first. Only reflex vertices
+// can lie inside an ear, so for large polygons the reflex vertices are hashed to
+// their position on a z-order (Morton) curve and sorted, and the ear test only
+// visits the reflex vertices whose hash lies in the range covered by the ear.
+
+namespace
+{
+	// Polygons with more vertices than this use the z-order index
+	const int HashThreshold = 80;
+	// Number of nodes allocated at once
+	const int BlockSize = 4096;
+
+	struct Node
+	{
+		int i;					// index of the vertex in the input
+		double x, y;
+		Node * prev;
+		Node * next;
+		int stamp;				// index generation the vertex belongs to; 0 once removed
+		bool steiner;
+	};
+
+	struct ZEntry
+	{
+		unsigned int z;			// z-order curve value
+		unsigned short qx, qy;	// scaled coordinates
+		Node * node;
+	};
+}
+
+struct Triangulator
+{
+	std::vector<Node *> blocks;
+	int used;					// nodes used in the current call
+	std::vector<int> indices;
+	std::vector<Node *> holes;
+	std::vector<ZEntry> reflex;	// reflex vertices sorted by z-order value
+	int clipped;				// vertices clipped since the index was compacted
+	int stamp;					// current index generation
+	bool hashed;				// whether the z-order index is used
+	double minX, minY, invSize;
+};
+
+namespace
+{
+	Node * NewNode(Triangulator * t, int i, double x, double y)
+	{
+		int block = t->used / BlockSize;
+		if (block == (int)t->blocks.size())
+		{
+			t->blocks.push_back((Node *)_Allocate(BlockSize * sizeof(Node)));
+		}
+		Node * p = &t->blocks[block][t->used % BlockSize];
+		t->used++;
+		p->i = i;
+		p->x = x;
+		p->y = y;
+		p->prev = 0;
+		p->next = 0;
+		p->stamp = 0;
+		p->steiner = false;
+		return p;
+	}
+
+	// Signed area of the triangle p, q, r. Negative for a convex corner of a ring
+	// in the working orientation.
+	inline double Area(const Node * p, const Node * q, const Node * r)
+	{
+		return (q->y - p->y) * (r->x - q->x) - (q->x - p->x) * (r->y - q->y);
+	}
+
+	inline bool Equals(const Node * p, const Node * q)
+	{
+		return p->x == q->x && p->y == q->y;
+	}
+
+	inline int Sign(double v)
+	{
+		return (v > 0) - (v < 0);
+	}
+
+	inline bool OnSegment(const Node * p, const Node * q, const Node * r)
+	{
+		return q->x <= std::max(p->x, r->x) && q->x >= std::min(p->x, r->x) &&
+			q->y <= std::max(p->y, r->y) && q->y >= std::min(p->y, r->y);
+	}
+
+	bool Intersects(const Node * p1, const Node * q1, const Node * p2, const Node * q2)
+	{
+		int o1 = Sign(Area(p1, q1, p2));
+		int o2 = Sign(Area(p1, q1, q2));
+		int o3 = Sign(Area(p2, q2, p1));
+		int o4 = Sign(Area(p2, q2, q1));
+
+		if (o1 != o2 && o3 != o4) return true;
+		if (o1 == 0 && OnSegment(p1, p2, q1)) return true;
+		if (o2 == 0 && OnSegment(p1, q2, q1)) return true;
+		if (o3 == 0 && OnSegment(p2, p1, q2)) return true;
+		if (o4 == 0 && OnSegment(p2, q1, q2)) return true;
+		return false;
+	}
+
+	inline bool PointInTriangle(double ax, double ay, double bx, double by, double cx, double cy, double px, double py)
+	{
+		return (cx - px) * (ay - py) >= (ax - px) * (cy - py) &&
+			(ax - px) * (by - py) >= (bx - px) * (ay - py) &&
+			(bx - px) * (cy - py) >= (cx - px) * (by - py);
+	}
+
+	Node * InsertNode(Triangulator * t, int i, double x, double y, Node * last)
+	{
+		Node * p = NewNode(t, i, x, y);
+		if (last == 0)
+		{
+			p->prev = p;
+			p->next = p;
+		}
+		else
+		{
+			p->next = last->next;
+			p->prev = last;
+			last->next->prev = p;
+			last->next = p;
+		}
+		return p;
+	}
+
+	void RemoveNode(Node * p)
+	{
+		p->next->prev = p->prev;
+		p->prev->next = p->next;
+		p->stamp = 0;
+	}
+
+	// Creates a ring from the points [start, end) in the given orientation
+	Node * LinkedList(Triangulator * t, const float * points, int start, int end, bool clockwise)
+	{
+		double sum = 0;
+		for (int i = start, j = end - 1; i < end; j = i++)
+			sum += ((double)points[j * 2] - points[i * 2]) * ((double)points[i * 2 + 1] + points[j * 2 + 1]);
+
+		Node * last = 0;
+		if (clockwise == (sum > 0))
+		{
+			for (int i = start; i < end; i++)
+				last = InsertNode(t, i, points[i * 2], points[i * 2 + 1], last);
+		}
+		else
+		{
+			for (int i = end - 1; i >= start; i--)
+				last = InsertNode(t, i, points[i * 2], points[i * 2 + 1], last);
+		}
+
+		if (last != 0 && Equals(last, last->next))
+		{
+			RemoveNode(last);
+			last = last->next;
+		}
+		return last;
+	}
+
+	// Removes duplicate and collinear vertices
+	Node * FilterPoints(Node * start, Node * end = 0)
+	{
+		if (start == 0) return start;
+		if (end == 0) end = start;
+
+		Node * p = start;
+		bool again;
+		do
+		{
+			again = false;
+			if (!p->steiner && (Equals(p, p->next) || Area(p->prev, p, p->next) == 0))
+			{
+				RemoveNode(p);
+				p = end = p->prev;
+				if (p == p->next) break;
+				again = true;
+			}
+			else
+			{
+				p = p->next;
+			}
+		} while (again || p != end);
+
+		return end;
+	}
+
+	// Interleaves the bits of the scaled coordinates
+	unsigned int Interleave(unsigned int x, unsigned int y)
+	{
+		x = (x | (x << 8)) & 0x00FF00FF;
+		x = (x | (x << 4)) & 0x0F0F0F0F;
+		x = (x | (x << 2)) & 0x33333333;
+		x = (x | (x << 1)) & 0x55555555;
+
+		y = (y | (y << 8)) & 0x00FF00FF;
+		y = (y | (y << 4)) & 0x0F0F0F0F;
+		y = (y | (y << 2)) & 0x33333333;
+		y = (y | (y << 1)) & 0x55555555;
+
+		return x | (y << 1);
+	}
+
+	inline unsigned int Scale(double v, double min, double invSize)
+	{
+		return (unsigned int)((v - min) * invSize);
+	}
+
+	bool CompareZ(const ZEntry & a, const ZEntry & b)
+	{
+		return a.z < b.z;
+	}
+
+	// Builds the z-order index of the reflex vertices of the ring. Vertices of earlier
+	// indices are told apart by their stamp.
+	void IndexCurve(Triangulator * t, Node * start)
+	{
+		double minX = start->x, minY = start->y;
+		double maxX = minX, maxY = minY;
+		Node * p = start;
+		do
+		{
+			if (p->x < minX) minX = p->x;
+			if (p->y < minY) minY = p->y;
+			if (p->x > maxX) maxX = p->x;
+			if (p->y > maxY) maxY = p->y;
+			p = p->next;
+		} while (p != start);
+
+		double size = std::max(maxX - minX, maxY - minY);
+		t->minX = minX;
+		t->minY = minY;
+		t->invSize = (size != 0 ? 32767.0 / size : 0);
+		t->stamp++;
+		t->reflex.clear();
+
+		p = start;
+		do
+		{
+			p->stamp = t->stamp;
+			if (Area(p->prev, p, p->next) >= 0)
+			{
+				unsigned int qx = Scale(p->x, t->minX, t->invSize);
+				unsigned int qy = Scale(p->y, t->minY, t->invSize);
+				ZEntry entry = { Interleave(qx, qy), (unsigned short)qx, (unsigned short)qy, p };
+				t->reflex.push_back(entry);
+			}
+			p = p->next;
+		} while (p != start);
+
+		std::sort(t->reflex.begin(), t->reflex.end(), CompareZ);
+		t->clipped = 0;
+	}
+
+	// Drops clipped vertices and vertices that became convex from the index.
+	// The order of the remaining entries is kept, so they need not be sorted again.
+	void CompactIndex(Triangulator * t)
+	{
+		size_t count = 0;
+		for (size_t i = 0; i < t->reflex.size(); i++)
+		{
+			const Node * n = t->reflex[i].node;
+			if (n->stamp == t->stamp && Area(n->prev, n, n->next) >= 0)
+				t->reflex[count++] = t->reflex[i];
+		}
+		t->reflex.resize(count);
+		t->clipped = 0;
+	}
+
+	// Tests whether the corner at ear can be clipped by checking that no other vertex is inside it
+	bool IsEar(Node * ear)
+	{
+		const Node * a = ear->prev;
+		const Node * b = ear;
+		const Node * c = ear->next;
+		if (Area(a, b, c) >= 0) return false;
+
+		Node * p = ear->next->next;
+		while (p != ear->prev)
+		{
+			if (PointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, p->x, p->y) && Area(p->prev, p, p->next) >= 0)
+				return false;
+			p = p->next;
+		}
+		return true;
+	}
+
+	// Same as IsEar, but only visits the reflex vertices whose z-order value lies in the
+	// range spanned by the bounding box of the ear
+	bool IsEarHashed(const Triangulator * t, Node * ear)
+	{
+		const Node * a = ear->prev;
+		const Node * b = ear;
+		const Node * c = ear->next;
+		if (Area(a, b, c) >= 0) return false;
+
+		double x0 = std::min(a->x, std::min(b->x, c->x));
+		double y0 = std::min(a->y, std::min(b->y, c->y));
+		double x1 = std::max(a->x, std::max(b->x, c->x));
+		double y1 = std::max(a->y, std::max(b->y, c->y));
+		unsigned int qx0 = Scale(x0, t->minX, t->invSize), qx1 = Scale(x1, t->minX, t->invSize);
+		unsigned int qy0 = Scale(y0, t->minY, t->invSize), qy1 = Scale(y1, t->minY, t->invSize);
+		unsigned int minZ = Interleave(qx0, qy0);
+		unsigned int maxZ = Interleave(qx1, qy1);
+
+		if (t->reflex.empty()) return true;
+		const ZEntry * end = &t->reflex[0] + t->reflex.size();
+		ZEntry key = { minZ, 0, 0, 0 };
+		const ZEntry * e = std::lower_bound(&t->reflex[0], end, key, CompareZ);
+		while (e != end && e->z <= maxZ)
+		{
+			if (e->qx < qx0 || e->qx > qx1 || e->qy < qy0 || e->qy > qy1) { e++; continue; }
+			const Node * n = e->node;
+			if (n->stamp == t->stamp && n != a && n != c &&
+				PointInTriangle(a->x, a->y, b->x, b->y, c->x, c->y, n->x, n->y) &&
+				Area(n->prev, n, n->next) >= 0)
+				return false;
+			e++;
+		}
+		return true;
+	}
+
+	inline void AddTriangle(Triangulator * t, const Node * a, const Node * b, const Node * c)
+	{
+		t->indices.push_back(a->i);
+		t->indices.push_back(b->i);
+		t->indices.push_back(c->i);
+	}
+
+	bool LocallyInside(const Node * a, const Node * b)
+	{
+		return Area(a->prev, a, a->next) < 0 ?
+			Area(a, b, a->next) >= 0 && Area(a, a->prev, b) >= 0 :
+			Area(a, b, a->prev) < 0 || Area(a, a->next, b) < 0;
+	}
+
+	bool MiddleInside(const Node * a, const Node * b)
+	{
+		const Node * p = a;
+		bool inside = false;
+		double px = (a->x + b->x) / 2;
+		double py = (a->y + b->y) / 2;
+		do
+		{
+			if (((p->y > py) != (p->next->y > py)) && p->next->y != p->y &&
+				(px < (p->next->x - p->x) * (py - p->y) / (p->next->y - p->y) + p->x))
+				inside = !inside;
+			p = p->next;
+		} while (p != a);
+		return inside;
+	}
+
+	bool IntersectsPolygon(const Node * a, const Node * b)
+	{
+		const Node * p = a;
+		do
+		{
+			if (p->i != a->i && p->next->i != a->i && p->i != b->i && p->next->i != b->i &&
+				Intersects(p, p->next, a, b))
+				return true;
+			p = p->next;
+		} while (p != a);
+		return false;
+	}
+
+	bool IsValidDiagonal(const Node * a, const Node * b)
+	{
+		return a->next->i != b->i && a->prev->i != b->i && !IntersectsPolygon(a, b) &&
+			((LocallyInside(a, b) && LocallyInside(b, a) && MiddleInside(a, b) &&
+			(Area(a->prev, a, b->prev) != 0 || Area(a, b->prev, b) != 0)) ||
+			(Equals(a, b) && Area(a->prev, a, a->next) > 0 && Area(b->prev, b, b->next) > 0));
+	}
+
+	// Splits the ring into two by connecting a and b with a pair of edges. Returns the copy of b.
+	Node * SplitPolygon(Triangulator * t, Node * a, Node * b)
+	{
+		Node * a2 = NewNode(t, a->i, a->x, a->y);
+		Node * b2 = NewNode(t, b->i, b->x, b->y);
+		Node * an = a->next;
+		Node * bp = b->prev;
+
+		a->next = b;
+		b->prev = a;
+
+		a2->next = an;
+		an->prev = a2;
+
+		b2->next = a2;
+		a2->prev = b2;
+
+		bp->next = b2;
+		b2->prev = bp;
+
+		return b2;
+	}
+
+	// Clips the ears of self intersecting corners
+	Node * CureLocalIntersections(Triangulator * t, Node * start)
+	{
+		Node * p = start;
+		do
+		{
+			Node * a = p->prev;
+			Node * b = p->next->next;
+			if (!Equals(a, b) && Intersects(a, p, p->next, b) && LocallyInside(a, b) && LocallyInside(b, a))
+			{
+				AddTriangle(t, a, p, b);
+				RemoveNode(p);
+				RemoveNode(p->next);
+				p = start = b;
+			}
+			p = p->next;
+		} while (p != start);
+
+		return FilterPoints(p);
+	}
+
+	void EarcutLinked(Triangulator * t, Node * ear, int pass);
+
+	// Splits the ring along a valid diagonal and triangulates both halves
+	void SplitEarcut(Triangulator * t, Node * start)
+	{
+		Node * a = start;
+		do
+		{
+			Node * b = a->next->next;
+			while (b != a->prev)
+			{
+				if (a->i != b->i && IsValidDiagonal(a, b))
+				{
+					Node * c = SplitPolygon(t, a, b);
+					a = FilterPoints(a, a->next);
+					c = FilterPoints(c, c->next);
+					EarcutLinked(t, a, 0);
+					EarcutLinked(t, c, 0);
+					return;
+				}
+				b = b->next;
+			}
+			a = a->next;
+		} while (a != start);
+	}
+
+	void EarcutLinked(Triangulator * t, Node * ear, int pass)
+	{
+		if (ear == 0) return;
+		// The index is rebuilt for each pass, since the later passes can turn convex vertices into reflex ones
+		bool hashed = t->hashed;
+		if (hashed) IndexCurve(t, ear);
+
+		Node * stop = ear;
+		while (ear->prev != ear->next)
+		{
+			Node * prev = ear->prev;
+			Node * next = ear->next;
+
+			if (hashed ? IsEarHashed(t, ear) : IsEar(ear))
+			{
+				AddTriangle(t, prev, ear, next);
+				RemoveNode(ear);
+				if (hashed && ++t->clipped * 4 > (int)t->reflex.size()) CompactIndex(t);
+
+				// Skipping the next vertex leads to fewer sliver triangles
+				ear = next->next;
+				stop = next->next;
+				continue;
+			}
+
+			ear = next;
+
+			// No ear was found in a full pass; try to recover
+			if (ear == stop)
+			{
+				if (pass == 0)
+				{
+					EarcutLinked(t, FilterPoints(ear), 1);
+				}
+				else if (pass == 1)
+				{
+					ear = CureLocalIntersections(t, FilterPoints(ear));
+					EarcutLinked(t, ear, 2);
+				}
+				else if (pass == 2)
+				{
+					SplitEarcut(t, ear);
+				}
+				break;
+			}
+		}
+	}
+
+	Node * GetLeftmost(Node * start)
+	{
+		Node * p = start;
+		Node * leftmost = start;
+		do
+		{
+			if (p->x < leftmost->x || (p->x == leftmost->x && p->y < leftmost->y)) leftmost = p;
+			p = p->next;
+		} while (p != start);
+		return leftmost;
+	}
+
+	bool SectorContainsSector(const Node * m, const Node * p)
+	{
+		return Area(m->prev, m, p->prev) < 0 && Area(p->next, m, m->next) < 0;
+	}
+
+	// Finds a vertex of the outer ring that can be connected to the leftmost vertex of the hole
+	Node * FindHoleBridge(Node * hole, Node * outerNode)
+	{
+		Node * p = outerNode;
+		double hx = hole->x;
+		double hy = hole->y;
+		double qx = -1e300;
+		Node * m = 0;
+
+		// Find the segment to the left of the hole vertex which is closest to it
+		do
+		{
+			if (hy <= p->y && hy >= p->next->y && p->next->y != p->y)
+			{
+				double x = p->x + (hy - p->y) * (p->next->x - p->x) / (p->next->y - p->y);
+				if (x <= hx && x > qx)
+				{
+					qx = x;
+					m = (p->x < p->next->x ? p : p->next);
+					if (x == hx) return m;
+				}
+			}
+			p = p->next;
+		} while (p != outerNode);
+
+		if (m == 0) return 0;
+
+		// Look for vertices inside the triangle formed by the hole vertex, the intersection point
+		// and the segment end; if there are any, connect to the one with the smallest angle instead
+		Node * stop = m;
+		double mx = m->x;
+		double my = m->y;
+		double tanMin = 1e300;
+
+		p = m;
+		do
+		{
+			if (hx >= p->x && p->x >= mx && hx != p->x &&
+				PointInTriangle(hy < my ? hx : qx, hy, mx, my, hy < my ? qx : hx, hy, p->x, p->y))
+			{
+				double tan = fabs(hy - p->y) / (hx - p->x);
+				if (LocallyInside(p, hole) &&
+					(tan < tanMin || (tan == tanMin && (p->x > m->x || (p->x == m->x && SectorContainsSector(m, p))))))
+				{
+					m = p;
+					tanMin = tan;
+				}
+			}
+			p = p->next;
+		} while (p != stop);
+
+		return m;
+	}
+
+	bool CompareX(const Node * a, const Node * b)
+	{
+		return a->x < b->x;
+	}
+
+	Node * EliminateHoles(Triangulator * t, const float * points, const int * ringEnds, int ringCount, Node * outerNode)
+	{
+		t->holes.clear();
+		for (int r = 1; r < ringCount; r++)
+		{
+			Node * list = LinkedList(t, points, ringEnds[r - 1], ringEnds[r], false);
+			if (list == 0) continue;
+			if (list == list->next) list->steiner = true;
+			t->holes.push_back(GetLeftmost(list));
+		}
+		std::sort(t->holes.begin(), t->holes.end(), CompareX);
+
+		// Join holes from left to right
+		for (size_t h = 0; h < t->holes.size(); h++)
+		{
+			Node * hole = t->holes[h];
+			Node * bridge = FindHoleBridge(hole, outerNode);
+			if (bridge == 0) continue;
+
+			Node * bridgeReverse = SplitPolygon(t, bridge, hole);
+			FilterPoints(bridgeReverse, bridgeReverse->next);
+			outerNode = FilterPoints(bridge, bridge->next);
+		}
+		return outerNode;
+	}
+}
+
+Triangulator * _CreateTriangulator()
+{
+	Triangulator * triangulator = new Triangulator();
+	_CountAllocation();
+	triangulator->used = 0;
+	triangulator->stamp = 0;
+	triangulator->hashed = false;
+	return triangulator;
+}
+
+void _DestroyTriangulator(Triangulator * triangulator)
+{
+	if (triangulator == 0) return;
+	for (size_t i = 0; i < triangulator->blocks.size(); i++)
+		_Free(triangulator->blocks[i]);
+	delete triangulator;
+}
+
+int _Triangulate(Triangulator * triangulator, const float * points, const int * ringEnds, int ringCount, const int ** indices)
+{
+	Triangulator * t = triangulator;
+	t->used = 0;
+	t->indices.clear();
+	*indices = 0;
+	if (ringCount <= 0) return 0;
+
+	Node * outerNode = LinkedList(t, points, 0, ringEnds[0], true);
+	if (outerNode == 0 || outerNode->next == outerNode->prev) return 0;
+
+	if (ringCount > 1) outerNode = EliminateHoles(t, points, ringEnds, ringCount, outerNode);
+
+	t->hashed = (ringEnds[ringCount - 1] > HashThreshold);
+
+	size_t capacity = t->indices.capacity();
+	EarcutLinked(t, outerNode, 0);
+	if (t->indices.capacity() != capacity) _CountAllocation();
+
+	*indices = (t->indices.empty() ? 0 : &t->indices[0]);
+	return (int)t->indices.size();
+}
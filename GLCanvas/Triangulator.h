@@ -0,0 +1,24 @@
+#pragma once
+
+// Native polygon triangulator. Polygons may be concave and may contain holes.
+// The implementation is compiled without /clr.
+
+struct Triangulator;
+
+/// <summary>
+/// Creates a triangulator. A triangulator keeps its working memory between calls,
+/// so it should be reused. A triangulator must not be used by two threads at once.
+/// </summary>
+Triangulator * _CreateTriangulator();
+/// <summary>
+/// Releases a triangulator.
+/// </summary>
+void _DestroyTriangulator(Triangulator * triangulator);
+/// <summary>
+/// Triangulates a polygon with ear clipping. points holds x, y pairs. The polygon is made
+/// of ringCount rings; ring i ends before point ringEnds[i]. The first ring is the outer
+/// boundary and the remaining rings are holes. Ring orientation does not matter.
+/// Returns the number of indices written to indices, which is a multiple of 3. Indices
+/// refer to points and remain valid until the next call with the same triangulator.
+/// </summary>
+int _Triangulate(Triangulator * triangulator, const float * points, const int * ringEnds, int ringCount, const int ** indices);
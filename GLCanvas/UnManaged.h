@@ -1,4 +0,0 @@
-#pragma once
-
-void _DrawCylinder(float radius, float length, bool wire, int slices, int stacks);
-void _DrawSphere(float radius, bool wire, int slices, int stacks);
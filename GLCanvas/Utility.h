@@ -1,5 +1,9 @@
 #pragma once
 
+#include <windows.h>
+#include <GL/gl.h>
+#include <vcclr.h>
+
 namespace GLCanvas
 {
 	private ref class Utility abstract sealed
@@ -31,7 +35,27 @@ namespace GLCanvas
 		{
 			v[0] = y1 * z2 - z1 * y2;
 			v[1] = z1 * x2 - x1 * z2;
-			v[2] = x1 * y2 - y1 * x1;
+			v[2] = x1 * y2 - y1 * x2;
+		}
+		/// <summary>
+		/// Draws the given text with the current display list base. The text is converted
+		/// to the ANSI code page in the given buffer, which is reused between calls and
+		/// only reallocated when a longer text is drawn.
+		/// </summary>
+		/// <param name="text">Text to draw</param>
+		/// <param name="buffer">Conversion buffer</param>
+		static void CallLists(System::String ^ text, array<System::Byte> ^% buffer)
+		{
+			if (System::String::IsNullOrEmpty(text)) return;
+
+			int size = text->Length * 2;
+			if (buffer == nullptr || buffer->Length < size)
+				buffer = gcnew array<System::Byte>(System::Math::Max(size, 256));
+
+			pin_ptr<const wchar_t> chars = PtrToStringChars(text);
+			pin_ptr<System::Byte> bytes = &buffer[0];
+			int count = WideCharToMultiByte(CP_ACP, 0, chars, text->Length, (LPSTR)bytes, buffer->Length, NULL, NULL);
+			glCallLists(count, GL_UNSIGNED_BYTE, (GLvoid *)bytes);
 		}
 	};
 }
\ No newline at end of file
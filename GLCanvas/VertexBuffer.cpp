@@ -0,0 +1,130 @@
+// Native code, compiled without /clr.
+
+#include "VertexBuffer.h"
+#include "NativeMemory.h"
+
+VertexBuffer * _CreateVertexBuffer()
+{
+	VertexBuffer * buffer = (VertexBuffer *)_Allocate(sizeof(VertexBuffer));
+	buffer->data = 0;
+	buffer->count = 0;
+	buffer->capacity = 0;
+	return buffer;
+}
+
+void _DestroyVertexBuffer(VertexBuffer * buffer)
+{
+	if (buffer == 0) return;
+	_Free(buffer->data);
+	_Free(buffer);
+}
+
+void _ReserveVertices(VertexBuffer * buffer, int capacity)
+{
+	if (capacity <= buffer->capacity) return;
+
+	// Grow geometrically so that repeated appends are amortized
+	int grown = buffer->capacity * 2;
+	if (grown < 256) grown = 256;
+	if (grown < capacity) grown = capacity;
+	buffer->data = (ColorVertex *)_Reallocate(buffer->data, grown * sizeof(ColorVertex));
+	buffer->capacity = grown;
+}
+
+LitBuffer * _CreateLitBuffer()
+{
+	LitBuffer * buffer = (LitBuffer *)_Allocate(sizeof(LitBuffer));
+	buffer->data = 0;
+	buffer->count = 0;
+	buffer->capacity = 0;
+	return buffer;
+}
+
+void _DestroyLitBuffer(LitBuffer * buffer)
+{
+	if (buffer == 0) return;
+	_Free(buffer->data);
+	_Free(buffer);
+}
+
+void _ReserveLitVertices(LitBuffer * buffer, int capacity)
+{
+	if (capacity <= buffer->capacity) return;
+
+	int grown = buffer->capacity * 2;
+	if (grown < 256) grown = 256;
+	if (grown < capacity) grown = capacity;
+	buffer->data = (LitVertex *)_Reallocate(buffer->data, grown * sizeof(LitVertex));
+	buffer->capacity = grown;
+}
+
+StripList * _CreateStripList()
+{
+	StripList * list = (StripList *)_Allocate(sizeof(StripList));
+	list->firsts = 0;
+	list->counts = 0;
+	list->count = 0;
+	list->capacity = 0;
+	return list;
+}
+
+void _DestroyStripList(StripList * list)
+{
+	if (list == 0) return;
+	_Free(list->firsts);
+	_Free(list->counts);
+	_Free(list);
+}
+
+void _ReserveStrips(StripList * list, int capacity)
+{
+	if (capacity <= list->capacity) return;
+
+	int grown = list->capacity * 2;
+	if (grown < 64) grown = 64;
+	if (grown < capacity) grown = capacity;
+	list->firsts = (int *)_Reallocate(list->firsts, grown * sizeof(int));
+	list->counts = (int *)_Reallocate(list->counts, grown * sizeof(int));
+	list->capacity = grown;
+}
+
+void _EndStrip(VertexBuffer * buffer, StripList * list, int first)
+{
+	int count = buffer->count - first;
+	if (count < 2)
+	{
+		buffer->count = first;
+		return;
+	}
+	if (list->count == list->capacity) _ReserveStrips(list, list->count + 1);
+	list->firsts[list->count] = first;
+	list->counts[list->count] = count;
+	list->count++;
+}
+
+ShapeBuffer * _CreateShapeBuffer()
+{
+	ShapeBuffer * buffer = (ShapeBuffer *)_Allocate(sizeof(ShapeBuffer));
+	buffer->data = 0;
+	buffer->count = 0;
+	buffer->capacity = 0;
+	return buffer;
+}
+
+void _DestroyShapeBuffer(ShapeBuffer * buffer)
+{
+	if (buffer == 0) return;
+	_Free(buffer->data);
+	_Free(buffer);
+}
+
+void _ReserveShapes(ShapeBuffer * buffer, int capacity)
+{
+	if (capacity <= buffer->capacity) return;
+
+	int grown = buffer->capacity * 2;
+	if (grown < 256) grown = 256;
+	if (grown < capacity) grown = capacity;
+	buffer->data = (ShapeVertex *)_Reallocate(buffer->data, grown * sizeof(ShapeVertex));
+	buffer->capacity = grown;
+}
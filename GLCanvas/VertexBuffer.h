@@ -0,0 +1,147 @@
+#pragma once
+
+// Native vertex storage shared by the managed drawing classes and the native
+// tessellators. Buffers keep their capacity between frames.
+
+/// <summary>
+/// Represents a colored vertex. The color is packed as R, G, B, A bytes
+/// so that it can be passed directly to glColorPointer.
+/// </summary>
+struct ColorVertex
+{
+	float x, y, z;
+	unsigned int color;
+};
+
+/// <summary>
+/// Represents a growable array of colored vertices.
+/// </summary>
+struct VertexBuffer
+{
+	ColorVertex * data;
+	int count;
+	int capacity;
+};
+
+/// <summary>
+/// Represents a colored vertex with a normal, used by lit 3D geometry.
+/// </summary>
+struct LitVertex
+{
+	float x, y, z;
+	float nx, ny, nz;
+	unsigned int color;
+};
+
+/// <summary>
+/// Represents a growable array of lit vertices.
+/// </summary>
+struct LitBuffer
+{
+	LitVertex * data;
+	int count;
+	int capacity;
+};
+
+/// <summary>
+/// Represents an instance of a mesh. transform holds the rows of a 3x4 affine
+/// matrix taking mesh coordinates to world coordinates; the color replaces the
+/// colors of the mesh vertices.
+/// </summary>
+struct MeshInstance
+{
+	float transform[12];
+	unsigned int color;
+};
+
+/// <summary>
+/// Represents the vertex ranges of strips, such as line strips, stored one after
+/// the other in a vertex buffer. Strip i is made of the vertices
+/// [firsts[i], firsts[i] + counts[i]).
+/// </summary>
+struct StripList
+{
+	int * firsts;
+	int * counts;
+	int count;
+	int capacity;
+};
+
+/// <summary>
+/// Represents a corner of a quad covering an analytic shape. The shape is evaluated
+/// per pixel from the position relative to its center, its half size and its corner
+/// radius, so the quad has four corners regardless of the size of the shape.
+/// </summary>
+struct ShapeVertex
+{
+	float x, y, z;
+	unsigned int color;
+	float u, v;					// position relative to the center of the shape
+	float hx, hy;				// half width and half height of the shape
+	float radius;				// corner radius of a rounded rectangle; negative for an ellipse
+	float outline;				// nonzero if only the outline is drawn
+};
+
+/// <summary>
+/// Represents a growable array of shape vertices, four for each shape.
+/// </summary>
+struct ShapeBuffer
+{
+	ShapeVertex * data;
+	int count;
+	int capacity;
+};
+
+/// <summary>
+/// Creates an empty vertex buffer.
+/// </summary>
+VertexBuffer * _CreateVertexBuffer();
+/// <summary>
+/// Releases a vertex buffer.
+/// </summary>
+void _DestroyVertexBuffer(VertexBuffer * buffer);
+/// <summary>
+/// Makes room for at least capacity vertices. Existing vertices are preserved.
+/// </summary>
+void _ReserveVertices(VertexBuffer * buffer, int capacity);
+/// <summary>
+/// Creates an empty lit vertex buffer.
+/// </summary>
+LitBuffer * _CreateLitBuffer();
+/// <summary>
+/// Releases a lit vertex buffer.
+/// </summary>
+void _DestroyLitBuffer(LitBuffer * buffer);
+/// <summary>
+/// Makes room for at least capacity lit vertices. Existing vertices are preserved.
+/// </summary>
+void _ReserveLitVertices(LitBuffer * buffer, int capacity);
+/// <summary>
+/// Creates an empty strip list.
+/// </summary>
+StripList * _CreateStripList();
+/// <summary>
+/// Releases a strip list.
+/// </summary>
+void _DestroyStripList(StripList * list);
+/// <summary>
+/// Makes room for at least capacity strips. Existing strips are preserved.
+/// </summary>
+void _ReserveStrips(StripList * list, int capacity);
+/// <summary>
+/// Ends the strip made of the vertices added to buffer since vertex first. Strips
+/// of a single vertex are removed from the buffer.
+/// </summary>
+void _EndStrip(VertexBuffer * buffer, StripList * list, int first);
+/// <summary>
+/// Creates an empty shape buffer.
+/// </summary>
+ShapeBuffer * _CreateShapeBuffer();
+/// <summary>
+/// Releases a shape buffer.
+/// </summary>
+void _DestroyShapeBuffer(ShapeBuffer * buffer);
+/// <summary>
+/// Makes room for at least capacity shape vertices. Existing vertices are preserved.
+/// </summary>
+void _ReserveShapes(ShapeBuffer * buffer, int capacity);
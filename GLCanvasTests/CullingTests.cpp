@@ -0,0 +1,236 @@
+// Native code, compiled without /clr.
+
+#include "Tests.h"
+#include "Culling3D.h"
+#include "GeometryKernels.h"
+
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	// Camera looking down -z from the origin; the buffer has the aspect of the view
+	const int Width = 64, Height = 32;
+	const float Aspect = 2.0f;
+	const float TanHalfFov = 0.57735027f;	// 60 degrees vertical field of view
+	const float NearPlane = 1.0f, FarPlane = 100.0f;
+	// Pixel centers closer than this to a triangle edge, in barycentric units, or to
+	// the near plane are not compared with the reference
+	const float EdgeMargin = 1e-3f;
+
+	void Projection(float * m)
+	{
+		for (int i = 0; i < 16; i++)
+			m[i] = 0.0f;
+		m[0] = 1.0f / (TanHalfFov * Aspect);
+		m[5] = 1.0f / TanHalfFov;
+		m[10] = (FarPlane + NearPlane) / (NearPlane - FarPlane);
+		m[11] = -1.0f;
+		m[14] = 2.0f * FarPlane * NearPlane / (NearPlane - FarPlane);
+	}
+
+	void Identity(float * m)
+	{
+		for (int i = 0; i < 16; i++)
+			m[i] = (i % 5 == 0 ? 1.0f : 0.0f);
+	}
+
+	LitVertex Vertex(float x, float y, float z)
+	{
+		LitVertex v = { x, y, z, 0.0f, 0.0f, 1.0f, 0xFFFFFFFFu };
+		return v;
+	}
+
+	// Two triangles of the quad a, b, c, d
+	void AddQuad(std::vector<LitVertex> & vertices, const LitVertex & a, const LitVertex & b, const LitVertex & c, const LitVertex & d)
+	{
+		vertices.push_back(a); vertices.push_back(b); vertices.push_back(c);
+		vertices.push_back(a); vertices.push_back(c); vertices.push_back(d);
+	}
+
+	// Results of casting the ray through a pixel center at the occluder
+	enum RayResult
+	{
+		RAY_MISS,		// the pixel must keep the far depth
+		RAY_HIT,		// the pixel must hold the depth of the hit
+		RAY_UNSURE		// the ray passes too close to an edge or the near plane to tell
+	};
+
+	// Intersects the ray from the eye through a pixel center with triangles given in
+	// eye coordinates, without clipping or rasterizing, and returns the nearest hit
+	// as a normalized device depth
+	int CastRay(const std::vector<LitVertex> & triangles, int px, int py, float * depth)
+	{
+		float ndcX = ((float)px + 0.5f) / Width * 2.0f - 1.0f;
+		float ndcY = ((float)py + 0.5f) / Height * 2.0f - 1.0f;
+		float dir[3] = { ndcX * TanHalfFov * Aspect, ndcY * TanHalfFov, -1.0f };
+
+		int result = RAY_MISS;
+		float nearest = 3.4e38f;
+		for (size_t i = 0; i + 2 < triangles.size(); i += 3)
+		{
+			const LitVertex & a = triangles[i], & b = triangles[i + 1], & c = triangles[i + 2];
+			float e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z }, e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+			float p[3] = { dir[1] * e2[2] - dir[2] * e2[1], dir[2] * e2[0] - dir[0] * e2[2], dir[0] * e2[1] - dir[1] * e2[0] };
+			float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+			if (fabsf(det) < 1e-12f) continue;
+			float s[3] = { -a.x, -a.y, -a.z };
+			float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+			float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+			float v = (dir[0] * q[0] + dir[1] * q[1] + dir[2] * q[2]) / det;
+			float t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+
+			// The ray reaches eye depth -t; hits in front of the near plane are clipped
+			float inside = fminf(u, fminf(v, 1.0f - u - v));
+			float clipped = NearPlane - t;
+			if (inside < -EdgeMargin || clipped > EdgeMargin) continue;
+			if (inside <= EdgeMargin || clipped >= -EdgeMargin)
+			{
+				result = RAY_UNSURE;
+				continue;
+			}
+			if (result == RAY_UNSURE) continue;
+
+			// Normalized device depth of the eye depth -t
+			float z = ((FarPlane + NearPlane) / (NearPlane - FarPlane) * -t + 2.0f * FarPlane * NearPlane / (NearPlane - FarPlane)) / t;
+			nearest = fminf(nearest, z);
+			result = RAY_HIT;
+		}
+		*depth = nearest;
+		return result;
+	}
+
+	// Compares the rasterized depth buffer with the ray cast reference, returning the
+	// number of pixels the occluder covers
+	int CompareWithRayCast(const DepthBuffer3D * buffer, const std::vector<LitVertex> & eyeTriangles)
+	{
+		int covered = 0, mismatches = 0;
+		for (int y = 0; y < Height; y++)
+		{
+			for (int x = 0; x < Width; x++)
+			{
+				float expected;
+				int result = CastRay(eyeTriangles, x, y, &expected);
+				float depth = buffer->depth[y * buffer->width + x];
+				if (result == RAY_HIT)
+				{
+					covered++;
+					if (!Near(depth, expected, 1e-4f)) mismatches++;
+				}
+				else if (result == RAY_MISS && depth != 1.0f)
+					mismatches++;
+			}
+		}
+		CHECK(mismatches == 0);
+		return covered;
+	}
+
+	bool IsBoxOccluded(const DepthBuffer3D * buffer, float x1, float y1, float z1, float x2, float y2, float z2)
+	{
+		const float bounds[6] = { x1, y1, z1, x2, y2, z2 };
+		return _IsOccluded3D(buffer, bounds);
+	}
+
+	void TestOccluderQuad()
+	{
+		float projection[16], modelview[16], transform[16];
+		Projection(projection);
+		Identity(modelview);
+
+		DepthBuffer3D * buffer = _CreateDepthBuffer3D(Width - 2, Height);
+		CHECK(buffer->width == Width && buffer->height == Height);
+		_ClearDepthBuffer3D(buffer, projection, modelview);
+
+		// A unit quad scaled to 6 by 4 and moved 10 units in front of the camera
+		std::vector<LitVertex> local, eye;
+		AddQuad(local, Vertex(-1, -1, 0), Vertex(1, -1, 0), Vertex(1, 1, 0), Vertex(-1, 1, 0));
+		Identity(transform);
+		transform[0] = 3.0f;
+		transform[5] = 2.0f;
+		transform[14] = -10.0f;
+		for (size_t i = 0; i < local.size(); i++)
+			eye.push_back(Vertex(local[i].x * 3.0f, local[i].y * 2.0f, local[i].z - 10.0f));
+
+		_RasterizeOccluder3D(buffer, transform, &local[0], (int)local.size());
+		int covered = CompareWithRayCast(buffer, eye);
+		CHECK(covered > Width * Height / 16 && covered < Width * Height);
+
+		// Fully behind, partly behind, in front of and crossing the occluder
+		CHECK(IsBoxOccluded(buffer, -1, -1, -21, 1, 1, -19));
+		CHECK(!IsBoxOccluded(buffer, 4, -1, -21, 8, 1, -19));
+		CHECK(!IsBoxOccluded(buffer, -0.5f, -0.5f, -6, 0.5f, 0.5f, -4));
+		CHECK(!IsBoxOccluded(buffer, -0.5f, -0.5f, -12, 0.5f, 0.5f, -8));
+		// Depth is compared closely: just behind is hidden, just in front is not
+		CHECK(IsBoxOccluded(buffer, -0.5f, -0.5f, -10.5f, 0.5f, 0.5f, -10.2f));
+		CHECK(!IsBoxOccluded(buffer, -0.5f, -0.5f, -9.99f, 0.5f, 0.5f, -9.95f));
+		// Boxes crossing the near plane are never occluded
+		CHECK(!IsBoxOccluded(buffer, -0.1f, -0.1f, -30, 0.1f, 0.1f, 0.5f));
+
+		// Hierarchy: eight boxes behind the quad are hidden, the rest stay visible
+		Bvh3D * bvh = _CreateBvh3D();
+		const float boxes[][6] = {
+			{ -2, -1, -30, -1, 0, -29 }, { -1, -1, -30, 0, 0, -29 }, { 0, -1, -30, 1, 0, -29 }, { 1, -1, -30, 2, 0, -29 },
+			{ -2, 0, -30, -1, 1, -29 }, { -1, 0, -30, 0, 1, -29 }, { 0, 0, -30, 1, 1, -29 }, { 1, 0, -30, 2, 1, -29 },
+			{ 10, 0, -30, 12, 1, -29 }, { -0.5f, -0.5f, -6, 0.5f, 0.5f, -4 }, { 2.5f, 0, -12, 3.5f, 1, -11 } };
+		int count = sizeof(boxes) / sizeof(boxes[0]);
+		_ReserveBvhItems3D(bvh, count);
+		for (int i = 0; i < count; i++)
+		{
+			memcpy(bvh->bounds + i * 6, boxes[i], sizeof(boxes[i]));
+			Identity(bvh->transforms + i * 16);
+			bvh->visible[i] = 1;
+		}
+		bvh->count = count;
+		_BuildBvh3D(bvh);
+		CHECK(_CullOccluded3D(buffer, bvh) == 8);
+		for (int i = 0; i < count; i++)
+			CHECK(bvh->visible[i] == (i < 8 ? 0 : 1));
+		// Items already hidden are not counted again
+		CHECK(_CullOccluded3D(buffer, bvh) == 0);
+
+		_DestroyBvh3D(bvh);
+		_DestroyDepthBuffer3D(buffer);
+	}
+
+	void TestNearPlaneOccluder()
+	{
+		float projection[16], modelview[16], transform[16];
+		Projection(projection);
+		Identity(modelview);
+		Identity(transform);
+
+		DepthBuffer3D * buffer = _CreateDepthBuffer3D(Width, Height);
+		_ClearDepthBuffer3D(buffer, projection, modelview);
+
+		// A floor below the eye reaching from behind the camera to 30 units in front;
+		// the part in front of the near plane is clipped and covers nothing
+		std::vector<LitVertex> floor;
+		AddQuad(floor, Vertex(-10, -0.3f, 5), Vertex(10, -0.3f, 5), Vertex(10, -0.3f, -30), Vertex(-10, -0.3f, -30));
+		_RasterizeOccluder3D(buffer, transform, &floor[0], (int)floor.size());
+		int covered = CompareWithRayCast(buffer, floor);
+		CHECK(covered > 0);
+
+		// The pixel rows below the near plane edge of the floor stay at the far plane
+		for (int x = 0; x < Width; x++)
+			CHECK(buffer->depth[x] == 1.0f);
+
+		// Below the floor is hidden, above it and below the clipped part is not
+		CHECK(IsBoxOccluded(buffer, -1, -1.5f, -15, 1, -1, -10));
+		CHECK(!IsBoxOccluded(buffer, -1, 0, -15, 1, 1, -10));
+		CHECK(!IsBoxOccluded(buffer, -0.2f, -1, -2.5f, 0.2f, -0.8f, -1.5f));
+
+		_DestroyDepthBuffer3D(buffer);
+	}
+}
+
+void _TestCulling()
+{
+	// Occluder vertices go through the transform kernel, so each level is tested
+	for (int level = SIMDLEVEL_SCALAR; level <= SIMDLEVEL_AVX; level++)
+	{
+		_SetSimdLevel(level);
+		if (_GetSimdLevel() != level) continue;
+		TestOccluderQuad();
+		TestNearPlaneOccluder();
+	}
+}
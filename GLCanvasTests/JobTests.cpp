@@ -0,0 +1,136 @@
+// Native code, compiled without /clr.
+
+#include "Tests.h"
+#include "JobSystem.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	// Records how a _ParallelFor call ran its chunks
+	struct Coverage
+	{
+		JobSystem * jobs;
+		int grain, slots;
+		std::vector<std::atomic<int> > runs;	// times each item was visited
+		std::vector<std::atomic<int> > busy;	// chunks running in each slot
+		std::atomic<int> badRanges, badWorkers, overlaps, nestedWorkers;
+		bool nest;
+
+		Coverage(JobSystem * jobs, int count, int grain, bool nest) :
+			jobs(jobs), grain(grain), slots(_JobThreadCount(jobs)), runs(count), busy(_JobThreadCount(jobs)), nest(nest)
+		{
+			for (size_t i = 0; i < runs.size(); i++) runs[i] = 0;
+			for (size_t i = 0; i < busy.size(); i++) busy[i] = 0;
+			badRanges = 0;
+			badWorkers = 0;
+			overlaps = 0;
+			nestedWorkers = 0;
+		}
+	};
+
+	struct Nested
+	{
+		int worker;
+		std::atomic<int> * mismatches;
+	};
+
+	void NestedChunk(void * context, int, int, int worker)
+	{
+		Nested * nested = (Nested *)context;
+		if (worker != nested->worker) (*nested->mismatches)++;
+	}
+
+	void CoverChunk(void * context, int begin, int end, int worker)
+	{
+		Coverage * coverage = (Coverage *)context;
+		int count = (int)coverage->runs.size();
+		if (begin % coverage->grain != 0 || end <= begin || end > count || (end - begin != coverage->grain && end != count))
+			coverage->badRanges++;
+		if (worker < 0 || worker >= coverage->slots)
+		{
+			coverage->badWorkers++;
+			return;
+		}
+		// Worker indices must be unique among the running chunks of one call
+		if (coverage->busy[worker].fetch_add(1) != 0) coverage->overlaps++;
+		for (int i = begin; i < end && i < count; i++)
+			coverage->runs[i]++;
+		// Nested calls run on the calling thread with its slot
+		if (coverage->nest)
+		{
+			Nested nested = { worker, &coverage->nestedWorkers };
+			_ParallelFor(coverage->jobs, 16, 1, NestedChunk, &nested);
+		}
+		for (volatile int spin = 0; spin < 200; spin++) { }
+		coverage->busy[worker]--;
+	}
+
+	// Runs one call and checks that every item was visited once
+	bool RunCovered(JobSystem * jobs, int count, int grain, bool nest)
+	{
+		Coverage coverage(jobs, count, grain, nest);
+		_ParallelFor(jobs, count, grain, CoverChunk, &coverage);
+		bool once = true;
+		for (int i = 0; i < count; i++)
+			once = once && coverage.runs[i] == 1;
+		return once && coverage.badRanges == 0 && coverage.badWorkers == 0 && coverage.overlaps == 0 && coverage.nestedWorkers == 0;
+	}
+
+	void TestChunks()
+	{
+		const int Counts[] = { 1, 2, 7, 64, 1000, 4097 };
+		const int Grains[] = { 1, 3, 64, 5000 };
+		const int ThreadCounts[] = { 1, 3, 7 };
+
+		// A null job system runs the chunks on the calling thread
+		CHECK(_JobThreadCount(0) == 1);
+		CHECK(RunCovered(0, 100, 7, false));
+
+		for (int t = 0; t < 3; t++)
+		{
+			JobSystem * jobs = _CreateJobSystem(ThreadCounts[t]);
+			CHECK(_JobThreadCount(jobs) == ThreadCounts[t] + 1);
+			for (int c = 0; c < 6; c++)
+			{
+				for (int g = 0; g < 4; g++)
+				{
+					CHECK(RunCovered(jobs, Counts[c], Grains[g], false));
+					CHECK(RunCovered(jobs, Counts[c], Grains[g], true));
+				}
+			}
+			_DestroyJobSystem(jobs);
+		}
+	}
+
+	void TestSubmitters()
+	{
+		// Several threads submit at once; each call must still visit its items once
+		// and keep its worker indices apart
+		JobSystem * jobs = _CreateJobSystem(3);
+		std::atomic<int> failures(0);
+		std::vector<std::thread> submitters;
+		for (int s = 0; s < 4; s++)
+		{
+			submitters.push_back(std::thread([jobs, s, &failures] {
+				for (int round = 0; round < 300; round++)
+				{
+					if (!RunCovered(jobs, 50 + (round * 7 + s) % 200, 1 + round % 4, round % 5 == 0))
+						failures++;
+				}
+			}));
+		}
+		for (size_t s = 0; s < submitters.size(); s++)
+			submitters[s].join();
+		CHECK(failures == 0);
+		_DestroyJobSystem(jobs);
+	}
+}
+
+void _TestJobs()
+{
+	TestChunks();
+	TestSubmitters();
+}
@@ -0,0 +1,470 @@
+// Native code, compiled without /clr.
+
+#include "Tests.h"
+#include "Batch3D.h"
+#include "GeometryKernels.h"
+
+#include <vector>
+
+namespace
+{
+	// Counts below, at and around the four and eight float vector widths, and a few
+	// larger odd counts that leave a scalar tail after the vector loops
+	const int Counts[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 255, 256, 257, 1001 };
+	const int CountCount = sizeof(Counts) / sizeof(Counts[0]);
+	const int MaxCount = 1001;
+
+	const int VectorLevels[] = { SIMDLEVEL_SSE, SIMDLEVEL_AVX };
+
+	// Selects an instruction set, returning false if the processor does not support it
+	bool SelectLevel(int level)
+	{
+		_SetSimdLevel(level);
+		return _GetSimdLevel() == level;
+	}
+
+	bool NearAll(const std::vector<float> & a, const std::vector<float> & b, float tolerance = 1e-5f)
+	{
+		if (a.size() != b.size()) return false;
+		for (size_t i = 0; i < a.size(); i++)
+			if (!Near(a[i], b[i], tolerance)) return false;
+		return true;
+	}
+
+	bool IsFinite(float value)
+	{
+		return value == value && value - value == 0.0f;
+	}
+
+	std::vector<char> RandomVertices(Random & random, int count, int stride)
+	{
+		std::vector<char> bytes((size_t)count * stride);
+		for (size_t i = 0; i + sizeof(float) <= bytes.size(); i += sizeof(float))
+			*(float *)&bytes[i] = random.Next(-100.0f, 100.0f);
+		return bytes;
+	}
+
+	std::vector<unsigned int> RandomIndices(Random & random, int count, int vertexCount)
+	{
+		std::vector<unsigned int> indices(count);
+		for (int i = 0; i < count; i++)
+			indices[i] = random.Next() % (unsigned int)vertexCount;
+		return indices;
+	}
+
+	void TestBounds()
+	{
+		// Layouts: packed 2D, packed 3D, ColorVertex and LitVertex
+		const int Strides[] = { 8, 12, (int)sizeof(ColorVertex), (int)sizeof(LitVertex) };
+		const int Components[] = { 2, 3, 3, 3 };
+		Random random(1);
+
+		float lower[3], upper[3];
+		CHECK(!_StridedBounds(0, 0, 12, 3, lower, upper));
+
+		for (int layout = 0; layout < 4; layout++)
+		{
+			int stride = Strides[layout], components = Components[layout];
+			std::vector<char> data = RandomVertices(random, MaxCount, stride);
+			for (int c = 0; c < CountCount; c++)
+			{
+				int count = Counts[c];
+				// The extremes of x are put on the last vertex so that the tail must be visited
+				float * last = (float *)&data[(size_t)(count - 1) * stride];
+				last[0] = 1000.0f + count;
+				if (count > 1) ((float *)&data[(size_t)(count - 2) * stride])[0] = -1000.0f - count;
+
+				SelectLevel(SIMDLEVEL_SCALAR);
+				float expectedLower[3], expectedUpper[3];
+				CHECK(_StridedBounds(&data[0], count, stride, components, expectedLower, expectedUpper));
+				CHECK(expectedUpper[0] == 1000.0f + count);
+				if (count > 1) CHECK(expectedLower[0] == -1000.0f - count);
+
+				for (int level : VectorLevels)
+				{
+					if (!SelectLevel(level)) continue;
+					CHECK(_StridedBounds(&data[0], count, stride, components, lower, upper));
+					for (int j = 0; j < components; j++)
+						CHECK(lower[j] == expectedLower[j] && upper[j] == expectedUpper[j]);
+				}
+
+				last[0] = random.Next(-100.0f, 100.0f);
+				if (count > 1) ((float *)&data[(size_t)(count - 2) * stride])[0] = random.Next(-100.0f, 100.0f);
+			}
+		}
+	}
+
+	void TestFaceNormals()
+	{
+		Random random(2);
+
+		// A counter-clockwise unit right triangle faces +z with twice its area as length
+		const float corners[9] = { 0, 0, 0, 1, 0, 0, 0, 1, 0 };
+		const unsigned int triangle[3] = { 0, 1, 2 };
+		for (int level = SIMDLEVEL_SCALAR; level <= SIMDLEVEL_AVX; level++)
+		{
+			if (!SelectLevel(level)) continue;
+			float normal[3];
+			_FaceNormals3D(corners, 3 * sizeof(float), triangle, 1, normal);
+			CHECK(normal[0] == 0.0f && normal[1] == 0.0f && normal[2] == 1.0f);
+		}
+
+		const int VertexCount = 64;
+		std::vector<char> positions = RandomVertices(random, VertexCount, sizeof(LitVertex));
+		const float * first = (const float *)&positions[0];
+		for (int c = 0; c < CountCount; c++)
+		{
+			int count = Counts[c];
+			std::vector<unsigned int> indices = RandomIndices(random, count * 3, VertexCount);
+			// The last triangle is degenerate and must get a zero normal
+			indices[count * 3 - 1] = indices[count * 3 - 2];
+
+			SelectLevel(SIMDLEVEL_SCALAR);
+			std::vector<float> expected(count * 3);
+			_FaceNormals3D(first, sizeof(LitVertex), &indices[0], count, &expected[0]);
+			CHECK(expected[count * 3 - 3] == 0.0f && expected[count * 3 - 2] == 0.0f && expected[count * 3 - 1] == 0.0f);
+
+			for (int level : VectorLevels)
+			{
+				if (!SelectLevel(level)) continue;
+				std::vector<float> normals(count * 3);
+				_FaceNormals3D(first, sizeof(LitVertex), &indices[0], count, &normals[0]);
+				CHECK(NearAll(normals, expected));
+			}
+		}
+	}
+
+	void TestBatchedFaceNormals()
+	{
+		// Filled triangles and quads are batched after vertices already in the buffer
+		// and take the normal (p1 - p2) x (p3 - p2) of their first three corners. More
+		// faces than a kernel chunk are batched.
+		Random random(7);
+		LitBuffer * triangles = _CreateLitBuffer();
+		FaceList * faces = _CreateFaceList();
+		for (int level = SIMDLEVEL_SCALAR; level <= SIMDLEVEL_AVX; level++)
+		{
+			if (!SelectLevel(level)) continue;
+			triangles->count = 0;
+			faces->count = 0;
+			for (int i = 0; i < 5; i++)
+				_AddLitVertex(triangles, random.Next(-1.0f, 1.0f), 0, 0, 0, 0, 7, 0);
+
+			std::vector<float> expected;
+			for (int shape = 0; shape < 400; shape++)
+			{
+				float p[4][3];
+				for (int k = 0; k < 4; k++)
+					for (int j = 0; j < 3; j++)
+						p[k][j] = random.Next(-100.0f, 100.0f);
+				float u[3] = { p[0][0] - p[1][0], p[0][1] - p[1][1], p[0][2] - p[1][2] };
+				float w[3] = { p[2][0] - p[1][0], p[2][1] - p[1][1], p[2][2] - p[1][2] };
+				float n[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+
+				// As GLGraphics3D::FillTriangle and FillQuad batch them
+				unsigned int face = (unsigned int)triangles->count;
+				int corners[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+				int halves = (shape % 3 == 0 ? 2 : 1);
+				for (int h = 0; h < halves; h++)
+				{
+					_AddFace3D(faces, face, face + 2, face + 1);
+					for (int k = 0; k < 3; k++)
+					{
+						const float * corner = p[corners[h][k]];
+						_AddLitVertex(triangles, corner[0], corner[1], corner[2], 0, 0, 0, 0);
+						expected.insert(expected.end(), n, n + 3);
+					}
+				}
+			}
+			_SetFaceNormals3D(triangles, faces);
+
+			std::vector<float> normals;
+			for (int i = 0; i < triangles->count; i++)
+			{
+				const LitVertex & v = triangles->data[i];
+				if (i < 5)
+					CHECK(v.nx == 0.0f && v.ny == 0.0f && v.nz == 7.0f);
+				else
+				{
+					normals.push_back(v.nx);
+					normals.push_back(v.ny);
+					normals.push_back(v.nz);
+				}
+			}
+			CHECK(NearAll(normals, expected, 1e-4f));
+		}
+		_DestroyFaceList(faces);
+		_DestroyLitBuffer(triangles);
+	}
+
+	std::vector<float> Normals(const std::vector<LitVertex> & vertices)
+	{
+		std::vector<float> normals;
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			normals.push_back(vertices[i].nx);
+			normals.push_back(vertices[i].ny);
+			normals.push_back(vertices[i].nz);
+		}
+		return normals;
+	}
+
+	void TestSmoothNormals()
+	{
+		Random random(3);
+		for (int c = 0; c < CountCount; c++)
+		{
+			int vertexCount = Counts[c];
+			// The last vertex is not used by any triangle when there is more than one
+			int used = (vertexCount > 1 ? vertexCount - 1 : 1);
+			std::vector<unsigned int> indices = RandomIndices(random, vertexCount * 3, used);
+			std::vector<LitVertex> source(vertexCount);
+			for (int i = 0; i < vertexCount; i++)
+			{
+				LitVertex & v = source[i];
+				v.x = random.Next(-10.0f, 10.0f);
+				v.y = random.Next(-10.0f, 10.0f);
+				v.z = random.Next(-10.0f, 10.0f);
+				v.nx = v.ny = v.nz = 5.0f;	// stale normals must be replaced
+				v.color = 0xFFFFFFFFu;
+			}
+
+			SelectLevel(SIMDLEVEL_SCALAR);
+			std::vector<LitVertex> expected = source;
+			_SmoothNormals3D(&expected[0], vertexCount, &indices[0], (int)indices.size());
+			if (vertexCount > 1)
+			{
+				const LitVertex & unused = expected[vertexCount - 1];
+				CHECK(unused.nx == 0.0f && unused.ny == 0.0f && unused.nz == 0.0f);
+			}
+			if (used >= 3)
+			{
+				const LitVertex & v = expected[indices[0]];
+				CHECK(Near(v.nx * v.nx + v.ny * v.ny + v.nz * v.nz, 1.0f, 1e-4f));
+			}
+
+			for (int level : VectorLevels)
+			{
+				if (!SelectLevel(level)) continue;
+				std::vector<LitVertex> vertices = source;
+				_SmoothNormals3D(&vertices[0], vertexCount, &indices[0], (int)indices.size());
+				CHECK(NearAll(Normals(vertices), Normals(expected)));
+			}
+		}
+	}
+
+	void TestTransform()
+	{
+		Random random(4);
+
+		// Perspective matrix with a nonzero bottom row, so that w is tested too
+		float matrix[16];
+		for (int i = 0; i < 16; i++)
+			matrix[i] = random.Next(-2.0f, 2.0f);
+
+		const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+		const int Strides[] = { 12, (int)sizeof(LitVertex) };
+		for (int stride : Strides)
+		{
+			std::vector<char> points = RandomVertices(random, MaxCount, stride);
+			const float * first = (const float *)&points[0];
+			for (int c = 0; c < CountCount; c++)
+			{
+				int count = Counts[c];
+				SelectLevel(SIMDLEVEL_SCALAR);
+				std::vector<float> expected(count * 4);
+				_TransformPoints3D(matrix, first, stride, count, &expected[0]);
+
+				for (int level = SIMDLEVEL_SCALAR; level <= SIMDLEVEL_AVX; level++)
+				{
+					if (!SelectLevel(level)) continue;
+					std::vector<float> result(count * 4);
+					_TransformPoints3D(matrix, first, stride, count, &result[0]);
+					CHECK(NearAll(result, expected));
+
+					// The identity keeps the points and gives w = 1
+					_TransformPoints3D(identity, first, stride, count, &result[0]);
+					const float * last = (const float *)&points[(size_t)(count - 1) * stride];
+					CHECK(result[count * 4 - 4] == last[0] && result[count * 4 - 3] == last[1] && result[count * 4 - 2] == last[2] && result[count * 4 - 1] == 1.0f);
+				}
+			}
+		}
+	}
+
+	std::vector<float> Coordinates(const VertexBuffer * buffer)
+	{
+		std::vector<float> coordinates;
+		for (int i = 0; i < buffer->count; i++)
+		{
+			coordinates.push_back(buffer->data[i].x);
+			coordinates.push_back(buffer->data[i].y);
+			coordinates.push_back(buffer->data[i].z);
+		}
+		return coordinates;
+	}
+
+	bool SameColors(const VertexBuffer * a, const VertexBuffer * b)
+	{
+		if (a->count != b->count) return false;
+		for (int i = 0; i < a->count; i++)
+			if (a->data[i].color != b->data[i].color) return false;
+		return true;
+	}
+
+	// Expands the lines after three existing vertices, which must be kept
+	VertexBuffer * Expand(const std::vector<ColorVertex> & vertices, int segmentCount, int step, float halfWidth)
+	{
+		VertexBuffer * buffer = _CreateVertexBuffer();
+		_ReserveVertices(buffer, 3);
+		for (int i = 0; i < 3; i++)
+		{
+			ColorVertex & v = buffer->data[i];
+			v.x = v.y = v.z = (float)i;
+			v.color = 0x12345678u;
+		}
+		buffer->count = 3;
+		_ExpandLines2D(&vertices[0], segmentCount, step, halfWidth, buffer);
+		return buffer;
+	}
+
+	void TestExpandLines()
+	{
+		Random random(5);
+
+		// A horizontal segment is widened by the half width above and below
+		std::vector<ColorVertex> segment(2);
+		segment[0].x = 0.0f; segment[0].y = 0.0f; segment[0].z = 0.5f; segment[0].color = 1;
+		segment[1].x = 2.0f; segment[1].y = 0.0f; segment[1].z = 0.5f; segment[1].color = 2;
+		for (int level = SIMDLEVEL_SCALAR; level <= SIMDLEVEL_AVX; level++)
+		{
+			if (!SelectLevel(level)) continue;
+			VertexBuffer * buffer = Expand(segment, 1, 2, 0.5f);
+			CHECK(buffer->count == 9);
+			const ColorVertex * quad = buffer->data + 3;
+			for (int k = 0; k < 6; k++)
+			{
+				CHECK(quad[k].y == 0.5f || quad[k].y == -0.5f);
+				CHECK(quad[k].x == (quad[k].color == 1 ? 0.0f : 2.0f) && quad[k].z == 0.5f);
+			}
+			CHECK(quad[0].y == -quad[1].y && quad[2].y == -quad[5].y);
+			_DestroyVertexBuffer(buffer);
+		}
+
+		const int Steps[] = { 1, 2 };
+		for (int step : Steps)
+		{
+			for (int c = 0; c < CountCount; c++)
+			{
+				int segmentCount = Counts[c];
+				int vertexCount = (step == 2 ? segmentCount * 2 : segmentCount + 1);
+				std::vector<ColorVertex> vertices(vertexCount);
+				for (int i = 0; i < vertexCount; i++)
+				{
+					vertices[i].x = random.Next(-50.0f, 50.0f);
+					vertices[i].y = random.Next(-50.0f, 50.0f);
+					vertices[i].z = random.Next(0.0f, 1.0f);
+					vertices[i].color = random.Next();
+				}
+				// Every fifth segment, and the last one, has zero length
+				for (int s = 0; s < segmentCount; s++)
+				{
+					if (s % 5 != 4 && s != segmentCount - 1) continue;
+					ColorVertex & p = vertices[s * step];
+					ColorVertex & q = vertices[s * step + 1];
+					q.x = p.x;
+					q.y = p.y;
+				}
+
+				SelectLevel(SIMDLEVEL_SCALAR);
+				VertexBuffer * expected = Expand(vertices, segmentCount, step, 1.5f);
+				CHECK(expected->count == 3 + segmentCount * 6);
+				CHECK(expected->data[2].x == 2.0f && expected->data[2].color == 0x12345678u);
+				const ColorVertex * empty = expected->data + 3 + (segmentCount - 1) * 6;
+				const ColorVertex & end = vertices[(segmentCount - 1) * step];
+				for (int k = 0; k < 6; k++)
+					CHECK(IsFinite(empty[k].x) && IsFinite(empty[k].y) && empty[k].x == end.x && empty[k].y == end.y);
+
+				for (int level : VectorLevels)
+				{
+					if (!SelectLevel(level)) continue;
+					VertexBuffer * buffer = Expand(vertices, segmentCount, step, 1.5f);
+					CHECK(NearAll(Coordinates(buffer), Coordinates(expected)));
+					CHECK(SameColors(buffer, expected));
+					_DestroyVertexBuffer(buffer);
+				}
+				_DestroyVertexBuffer(expected);
+			}
+		}
+	}
+
+	// Runs a kernel repeatedly at each supported level and prints the time per call
+	template<typename Kernel> void Benchmark(const char * name, int repeats, Kernel kernel)
+	{
+		double scalar = 0.0;
+		printf("%-18s", name);
+		for (int level = SIMDLEVEL_SCALAR; level <= SIMDLEVEL_AVX; level++)
+		{
+			if (!SelectLevel(level)) continue;
+			kernel();
+			double start = _Milliseconds();
+			for (int r = 0; r < repeats; r++)
+				kernel();
+			double time = (_Milliseconds() - start) / repeats;
+			if (level == SIMDLEVEL_SCALAR) scalar = time;
+			printf("  %s %8.3f ms (%.1fx)", _SimdLevelName(level), time, scalar / time);
+		}
+		printf("\n");
+	}
+}
+
+void _TestKernels()
+{
+	TestBounds();
+	TestFaceNormals();
+	TestBatchedFaceNormals();
+	TestSmoothNormals();
+	TestTransform();
+	TestExpandLines();
+}
+
+void _BenchmarkKernels()
+{
+	const int Count = 1 << 20;
+	const int Repeats = 20;
+	Random random(6);
+
+	std::vector<LitVertex> vertices(Count);
+	for (int i = 0; i < Count; i++)
+	{
+		LitVertex & v = vertices[i];
+		v.x = random.Next(-100.0f, 100.0f);
+		v.y = random.Next(-100.0f, 100.0f);
+		v.z = random.Next(-100.0f, 100.0f);
+		v.nx = v.ny = v.nz = 0.0f;
+		v.color = random.Next();
+	}
+	std::vector<ColorVertex> lines(Count);
+	for (int i = 0; i < Count; i++)
+	{
+		lines[i].x = vertices[i].x;
+		lines[i].y = vertices[i].y;
+		lines[i].z = 0.0f;
+		lines[i].color = vertices[i].color;
+	}
+	std::vector<unsigned int> indices = RandomIndices(random, Count * 3, Count);
+	std::vector<float> output((size_t)Count * 4);
+	float matrix[16];
+	for (int i = 0; i < 16; i++)
+		matrix[i] = random.Next(-2.0f, 2.0f);
+	VertexBuffer * triangles = _CreateVertexBuffer();
+	float lower[3], upper[3];
+
+	printf("%d items per call, %d calls\n", Count, Repeats);
+	Benchmark("StridedBounds", Repeats, [&] { _StridedBounds(&vertices[0], Count, sizeof(LitVertex), 3, lower, upper); });
+	Benchmark("FaceNormals3D", Repeats, [&] { _FaceNormals3D(&vertices[0].x, sizeof(LitVertex), &indices[0], Count, &output[0]); });
+	Benchmark("SmoothNormals3D", Repeats, [&] { _SmoothNormals3D(&vertices[0], Count, &indices[0], Count * 3); });
+	Benchmark("TransformPoints3D", Repeats, [&] { _TransformPoints3D(matrix, &vertices[0].x, sizeof(LitVertex), Count, &output[0]); });
+	Benchmark("ExpandLines2D", Repeats, [&] { triangles->count = 0; _ExpandLines2D(&lines[0], Count - 1, 1, 0.5f, triangles); });
+
+	_DestroyVertexBuffer(triangles);
+}
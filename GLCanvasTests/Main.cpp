@@ -0,0 +1,56 @@
+// Native code, compiled without /clr.
+
+#include "Tests.h"
+#include "GeometryKernels.h"
+
+#include <chrono>
+#include <string.h>
+
+int gFailures = 0;
+
+void _Fail(const char * file, int line, const char * expression)
+{
+	printf("%s(%d): check failed: %s\n", file, line, expression);
+	gFailures++;
+}
+
+const char * _SimdLevelName(int level)
+{
+	return (level == SIMDLEVEL_AVX ? "AVX" : (level == SIMDLEVEL_SSE ? "SSE" : "scalar"));
+}
+
+double _Milliseconds()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs the tests, or the benchmarks with /bench. Returns the number of failed checks.
+int main(int argc, char ** argv)
+{
+	int widest = _GetSimdLevel();
+	printf("Widest instruction set: %s\n", _SimdLevelName(widest));
+
+	if (argc > 1 && (strcmp(argv[1], "/bench") == 0 || strcmp(argv[1], "-bench") == 0))
+	{
+		_BenchmarkKernels();
+		_SetSimdLevel(widest);
+		return 0;
+	}
+
+	_TestKernels();
+	_SetSimdLevel(widest);
+	_TestCulling();
+	_SetSimdLevel(widest);
+	_TestJobs();
+	_TestPolygons();
+	_TestTimeSeries();
+	_TestStrokes();
+	_TestRenderers();
+	_TestMeshImport();
+
+	if (gFailures == 0)
+		printf("All tests passed.\n");
+	else
+		printf("%d checks failed.\n", gFailures);
+	return gFailures;
+}
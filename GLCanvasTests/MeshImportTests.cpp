@@ -0,0 +1,452 @@
+// Native code, compiled without /clr.
+
+#include "Tests.h"
+#include "MeshImport.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+	// A bent grid of n by n quads with one color per vertex. Each quad a, b, d, c is
+	// split into the triangles a, b, d and a, d, c, as the importers split polygons.
+	struct Grid
+	{
+		int n;
+		std::vector<float> positions;
+		std::vector<unsigned int> colors;
+		std::vector<int> quads;
+
+		int VertexCount() const { return (int)colors.size(); }
+		int TriangleCount() const { return (int)quads.size() / 2; }
+		int Corner(int triangle, int k) const
+		{
+			const int * q = &quads[(size_t)(triangle / 2) * 4];
+			const int Split[2][3] = { { 0, 1, 2 }, { 0, 2, 3 } };
+			return q[Split[triangle % 2][k]];
+		}
+	};
+
+	Grid MakeGrid(int n)
+	{
+		Grid grid;
+		grid.n = n;
+		for (int j = 0; j <= n; j++)
+		{
+			for (int i = 0; i <= n; i++)
+			{
+				float u = (float)i / (float)n * 6.0f, v = (float)j / (float)n * 3.0f;
+				grid.positions.push_back(cosf(u) * (2.0f + v));
+				grid.positions.push_back(sinf(u) * (2.0f + v));
+				grid.positions.push_back(v * 0.7f + 0.01f * (float)i);
+				grid.colors.push_back(0xFF000000u | (unsigned int)(i & 255) | ((unsigned int)(j & 255) << 8) | ((unsigned int)((i + j) & 255) << 16));
+			}
+		}
+		for (int j = 0; j < n; j++)
+		{
+			for (int i = 0; i < n; i++)
+			{
+				int a = j * (n + 1) + i, b = a + 1, c = a + n + 1, d = c + 1;
+				int quad[4] = { a, b, d, c };
+				grid.quads.insert(grid.quads.end(), quad, quad + 4);
+			}
+		}
+		return grid;
+	}
+
+	void Print(std::string & text, const char * format, ...)
+	{
+		char line[256];
+		va_list args;
+		va_start(args, format);
+		vsnprintf(line, sizeof(line), format, args);
+		va_end(args);
+		text += line;
+	}
+
+	// Appends a binary value in little or big endian order
+	template <typename T>
+	void Put(std::string & data, T value, bool bigEndian = false)
+	{
+		char bytes[sizeof(T)];
+		memcpy(bytes, &value, sizeof(T));
+		for (size_t i = 0; i < sizeof(T); i++)
+			data += bytes[bigEndian ? sizeof(T) - 1 - i : i];
+	}
+
+	std::string BinaryStl(const Grid & grid)
+	{
+		// The header starts with "solid", as some exporters write it
+		std::string data("solid but binary");
+		data.resize(80, ' ');
+		Put(data, (unsigned int)grid.TriangleCount());
+		for (int t = 0; t < grid.TriangleCount(); t++)
+		{
+			Put(data, 0.0f); Put(data, 0.0f); Put(data, 1.0f);
+			for (int k = 0; k < 3; k++)
+				for (int a = 0; a < 3; a++)
+					Put(data, grid.positions[(size_t)grid.Corner(t, k) * 3 + a]);
+			Put(data, (unsigned short)0);
+		}
+		return data;
+	}
+
+	std::string AsciiStl(const Grid & grid)
+	{
+		std::string text("solid grid\r\n");
+		for (int t = 0; t < grid.TriangleCount(); t++)
+		{
+			text += "  facet normal 0 0 1\r\n    outer loop\r\n";
+			for (int k = 0; k < 3; k++)
+			{
+				const float * p = &grid.positions[(size_t)grid.Corner(t, k) * 3];
+				Print(text, "      vertex %.9g %.9g %.9e\r\n", p[0], p[1], p[2]);
+			}
+			text += "    endloop\r\n  endfacet\r\n";
+		}
+		// No line break at the end
+		text += "endsolid grid";
+		return text;
+	}
+
+	// Quads with plain, texture and normal indices, and relative indices counted back
+	// from the last vertex
+	std::string Obj(const Grid & grid)
+	{
+		std::string text("# grid\nmtllib grid.mtl\no grid\n");
+		int count = grid.VertexCount();
+		for (int i = 0; i < count; i++)
+		{
+			const float * p = &grid.positions[(size_t)i * 3];
+			Print(text, "v %.9g %.9g %.9g\n", p[0], p[1], p[2]);
+			if (i % 7 == 0) text += "vn 0 0 1\nvt 0.5 0.5\n";
+		}
+		text += "usemtl grid\ns off\n";
+		for (size_t q = 0; q < grid.quads.size(); q += 4)
+		{
+			const int * v = &grid.quads[q];
+			switch ((q / 4) % 3)
+			{
+			case 0: Print(text, "f %d %d %d %d\n", v[0] + 1, v[1] + 1, v[2] + 1, v[3] + 1); break;
+			case 1: Print(text, "f %d/1/1 %d/1/1 %d/1/1\t%d/1/1 # quad\n", v[0] + 1, v[1] + 1, v[2] + 1, v[3] + 1); break;
+			default: Print(text, "f %d//1 %d//1 %d//1 %d//1\n", v[0] - count, v[1] - count, v[2] - count, v[3] - count); break;
+			}
+		}
+		return text;
+	}
+
+	enum PlyEncoding { PLY_ASCII, PLY_LITTLE, PLY_BIG };
+
+	// Vertices with normals and colors between elements and properties the importer
+	// skips, and faces that are quads or triangles
+	std::string Ply(const Grid & grid, int encoding, bool quads)
+	{
+		const char * Encodings[] = { "ascii", "binary_little_endian", "binary_big_endian" };
+		bool big = (encoding == PLY_BIG);
+		int faces = (quads ? (int)grid.quads.size() / 4 : grid.TriangleCount());
+		std::string data;
+		Print(data, "ply\nformat %s 1.0\ncomment grid\nelement material 2\nproperty list uchar float values\nproperty int id\n", Encodings[encoding]);
+		Print(data, "element vertex %d\nproperty double x\nproperty float y\nproperty float z\nproperty float nx\nproperty float ny\nproperty float nz\n", grid.VertexCount());
+		data += "property uchar red\nproperty uchar green\nproperty uchar blue\nproperty uchar alpha\n";
+		Print(data, "element face %d\nproperty uchar flags\nproperty list uchar int vertex_indices\nproperty short tag\nend_header\n", faces);
+
+		for (int m = 0; m < 2; m++)
+		{
+			if (encoding == PLY_ASCII)
+			{
+				Print(data, "%d", m + 1);
+				for (int k = 0; k <= m; k++) data += " 0.5";
+				Print(data, " %d\n", m);
+			}
+			else
+			{
+				Put(data, (unsigned char)(m + 1));
+				for (int k = 0; k <= m; k++) Put(data, 0.5f, big);
+				Put(data, m, big);
+			}
+		}
+		for (int i = 0; i < grid.VertexCount(); i++)
+		{
+			const float * p = &grid.positions[(size_t)i * 3];
+			unsigned int color = grid.colors[i];
+			if (encoding == PLY_ASCII)
+			{
+				Print(data, "%.17g %.9g %.9g 0 0 1 %u %u %u %u\n", (double)p[0], p[1], p[2], color & 255, (color >> 8) & 255, (color >> 16) & 255, color >> 24);
+			}
+			else
+			{
+				Put(data, (double)p[0], big); Put(data, p[1], big); Put(data, p[2], big);
+				Put(data, 0.0f, big); Put(data, 0.0f, big); Put(data, 1.0f, big);
+				for (int c = 0; c < 4; c++) Put(data, (unsigned char)(color >> (c * 8)));
+			}
+		}
+		for (int f = 0; f < faces; f++)
+		{
+			int triangle[3];
+			const int * v = triangle;
+			int count = (quads ? 4 : 3);
+			if (quads)
+				v = &grid.quads[(size_t)f * 4];
+			else
+				for (int k = 0; k < 3; k++) triangle[k] = grid.Corner(f, k);
+			if (encoding == PLY_ASCII)
+			{
+				Print(data, "7 %d", count);
+				for (int k = 0; k < count; k++) Print(data, " %d", v[k]);
+				data += " -3\n";
+			}
+			else
+			{
+				Put(data, (unsigned char)7);
+				Put(data, (unsigned char)count);
+				for (int k = 0; k < count; k++) Put(data, v[k], big);
+				Put(data, (short)-3, big);
+			}
+		}
+		return data;
+	}
+
+	int Parse(const std::string & data, int format, JobSystem * jobs, Mesh3D * mesh, MeshImportInfo * info)
+	{
+		return _ParseMesh3D(data.data(), data.size(), format, 0.0f, jobs, mesh, info);
+	}
+
+	// Checks that the triangles have the grid corners and that shared corners were merged
+	bool SameTriangles(const Mesh3D * mesh, const Grid & grid, bool colors)
+	{
+		if (mesh->indexCount != grid.TriangleCount() * 3 || mesh->vertexCount != grid.VertexCount())
+			return false;
+		for (int i = 0; i < mesh->indexCount; i++)
+		{
+			if (mesh->indices[i] >= (unsigned int)mesh->vertexCount)
+				return false;
+			const LitVertex & v = mesh->vertices[mesh->indices[i]];
+			int corner = grid.Corner(i / 3, i % 3);
+			const float * p = &grid.positions[(size_t)corner * 3];
+			if (v.x != p[0] || v.y != p[1] || v.z != p[2])
+				return false;
+			if (colors && v.color != grid.colors[corner])
+				return false;
+		}
+		return true;
+	}
+
+	bool UnitNormals(const Mesh3D * mesh)
+	{
+		for (int i = 0; i < mesh->vertexCount; i++)
+		{
+			const LitVertex & v = mesh->vertices[i];
+			if (!Near(v.nx * v.nx + v.ny * v.ny + v.nz * v.nz, 1.0f, 1e-4f))
+				return false;
+		}
+		return true;
+	}
+
+	bool SameMesh(const Mesh3D * a, const Mesh3D * b)
+	{
+		return a->vertexCount == b->vertexCount && a->indexCount == b->indexCount &&
+			memcmp(a->vertices, b->vertices, (size_t)a->vertexCount * sizeof(LitVertex)) == 0 &&
+			memcmp(a->indices, b->indices, (size_t)a->indexCount * sizeof(unsigned int)) == 0 &&
+			memcmp(a->bounds, b->bounds, sizeof(a->bounds)) == 0;
+	}
+
+	void TestFormats()
+	{
+		Grid grid = MakeGrid(9);
+		struct Fixture { const char * name; std::string data; int format; bool ply; };
+		Fixture fixtures[] =
+		{
+			{ "binary STL", BinaryStl(grid), MESHFILE_STL, false },
+			{ "ASCII STL", AsciiStl(grid), MESHFILE_STL, false },
+			{ "OBJ", Obj(grid), MESHFILE_OBJ, false },
+			{ "ASCII PLY", Ply(grid, PLY_ASCII, false), MESHFILE_PLY, true },
+			{ "little endian PLY", Ply(grid, PLY_LITTLE, false), MESHFILE_PLY, true },
+			{ "big endian PLY", Ply(grid, PLY_BIG, false), MESHFILE_PLY, true },
+			{ "ASCII PLY quads", Ply(grid, PLY_ASCII, true), MESHFILE_PLY, true },
+			{ "binary PLY quads", Ply(grid, PLY_LITTLE, true), MESHFILE_PLY, true },
+		};
+
+		Mesh3D * mesh = _CreateMesh3D();
+		for (int f = 0; f < 8; f++)
+		{
+			// Given and detected formats
+			for (int detect = 0; detect < 2; detect++)
+			{
+				MeshImportInfo info;
+				int result = Parse(fixtures[f].data, detect ? MESHFILE_AUTO : fixtures[f].format, 0, mesh, &info);
+				if (result != MESHIMPORT_OK) printf("  %s: result %d\n", fixtures[f].name, result);
+				CHECK(result == MESHIMPORT_OK);
+				CHECK(SameTriangles(mesh, grid, fixtures[f].ply));
+				CHECK(UnitNormals(mesh));
+				// PLY normals are read, not computed
+				if (fixtures[f].ply) CHECK(mesh->vertices[0].nx == 0.0f && mesh->vertices[0].ny == 0.0f && mesh->vertices[0].nz == 1.0f);
+				CHECK(mesh->hasBounds);
+				CHECK(info.format == fixtures[f].format && info.fileSize == (long long)fixtures[f].data.size());
+				CHECK(info.triangleCount == grid.TriangleCount() && info.vertexCount == grid.VertexCount());
+				CHECK(info.fileVertexCount == (fixtures[f].format == MESHFILE_STL ? grid.TriangleCount() * 3 : grid.VertexCount()));
+			}
+		}
+
+		// Negative indices count back from the last vertex read so far
+		const char * relative = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -3 -2 -1\nv 1 1 0\nf -3 -1 -2";
+		CHECK(_ParseMesh3D(relative, strlen(relative), MESHFILE_AUTO, 0.0f, 0, mesh, 0) == MESHIMPORT_OK);
+		CHECK(mesh->indexCount == 6 && mesh->vertexCount == 4 && UnitNormals(mesh));
+		CHECK(mesh->vertices[mesh->indices[4]].x == 1.0f && mesh->vertices[mesh->indices[4]].y == 1.0f);
+		CHECK(mesh->vertices[mesh->indices[5]].x == 0.0f && mesh->vertices[mesh->indices[5]].y == 1.0f);
+		_DestroyMesh3D(mesh);
+	}
+
+	void TestBadInput()
+	{
+		Grid grid = MakeGrid(5);
+		Mesh3D * mesh = _CreateMesh3D();
+		const char * triangle = "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 3\n";
+		CHECK(_ParseMesh3D(triangle, strlen(triangle), MESHFILE_OBJ, 0.0f, 0, mesh, 0) == MESHIMPORT_OK);
+
+		// Failures leave the mesh and the info as they were
+		MeshImportInfo info, before;
+		memset(&info, 0, sizeof(info));
+		before = info;
+		struct Bad { int format; std::string data; };
+		std::vector<Bad> bad;
+		std::string binaryStl = BinaryStl(grid), asciiStl = AsciiStl(grid);
+		std::string asciiPly = Ply(grid, PLY_ASCII, true), binaryPly = Ply(grid, PLY_BIG, true);
+		Bad truncated[] =
+		{
+			{ MESHFILE_STL, binaryStl.substr(0, binaryStl.size() - 1) },
+			{ MESHFILE_STL, binaryStl.substr(0, 84 + 50 * 3 + 20) },
+			{ MESHFILE_STL, asciiStl.substr(0, asciiStl.size() / 2) },
+			{ MESHFILE_PLY, asciiPly.substr(0, asciiPly.size() - 6) },
+			{ MESHFILE_PLY, binaryPly.substr(0, binaryPly.size() - 1) },
+			{ MESHFILE_PLY, binaryPly.substr(0, binaryPly.find("end_header") + 11 + 40) },
+			{ MESHFILE_PLY, binaryPly.substr(0, binaryPly.find("end_header")) },
+			{ MESHFILE_STL, std::string() },
+			{ MESHFILE_PLY, std::string() },
+		};
+		bad.insert(bad.end(), truncated, truncated + 9);
+
+		// Corrupted counts, indices and numbers
+		std::string corrupted = binaryStl;
+		corrupted[80] = (char)0xFF;
+		Bad corrupt[] =
+		{
+			{ MESHFILE_STL, corrupted },
+			{ MESHFILE_STL, "solid x\nfacet normal 0 0 1\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nendloop\nendfacet\nendsolid\n" },
+			{ MESHFILE_STL, "solid x\nfacet normal 0 0 1\nouter loop\nvertex 0 0 0\nvertex 1 0 0\nvertex 0 1 x\nendloop\nendfacet\nendsolid\n" },
+			{ MESHFILE_OBJ, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 4\n" },
+			{ MESHFILE_OBJ, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 0 1 2\n" },
+			{ MESHFILE_OBJ, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf -4 -2 -1\n" },
+			{ MESHFILE_OBJ, "f -1 -2 -3\nv 0 0 0\nv 1 0 0\nv 0 1 0\n" },
+			{ MESHFILE_OBJ, "v 0 0 0\nv 1 0 x\nv 0 1 0\nf 1 2 3\n" },
+			{ MESHFILE_OBJ, "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2\n" },
+			{ MESHFILE_PLY, "ply\nformat ascii 1.0\nelement vertex 3\nproperty float x\nproperty float y\nproperty float z\nelement face 1\nproperty list uchar int vertex_index\nend_header\n0 0 0\n1 0 0\n0 1 0\n3 0 1 3\n" },
+			{ MESHFILE_PLY, "ply\nformat ascii 1.0\nelement vertex 3\nproperty float x\nproperty float y\nproperty float z\nelement face 1\nproperty list uchar int vertex_index\nend_header\n0 0 0\n1 0 0\n0 1 0\n" },
+			{ MESHFILE_PLY, "ply\nformat binary_middle_endian 1.0\nelement vertex 0\nend_header\n" },
+			{ MESHFILE_PLY, "ply\nformat ascii 1.0\nelement vertex 3\nproperty float x\nproperty float y\nend_header\n0 0\n1 0\n0 1\n" },
+		};
+		bad.insert(bad.end(), corrupt, corrupt + 13);
+
+		for (size_t i = 0; i < bad.size(); i++)
+		{
+			int result = Parse(bad[i].data, bad[i].format, 0, mesh, &info);
+			if (result != MESHIMPORT_BADFORMAT) printf("  bad input %d: result %d\n", (int)i, result);
+			CHECK(result == MESHIMPORT_BADFORMAT);
+		}
+		CHECK(memcmp(&info, &before, sizeof(info)) == 0);
+		CHECK(mesh->indexCount == 3 && mesh->vertexCount == 3);
+
+		// Random damage either fails or gives triangles that index the vertices
+		Random random(23);
+		std::string fixtures[] = { binaryStl, asciiStl, Obj(grid), asciiPly, binaryPly, Ply(grid, PLY_LITTLE, false) };
+		bool valid = true;
+		for (int f = 0; f < 6; f++)
+		{
+			for (int round = 0; round < 40; round++)
+			{
+				std::string damaged = fixtures[f];
+				for (int k = 0; k < 4; k++)
+					damaged[random.Next() % (unsigned int)damaged.size()] = (char)random.Next();
+				if (round % 4 == 0) damaged.resize(random.Next() % (unsigned int)damaged.size());
+				if (Parse(damaged, MESHFILE_AUTO, 0, mesh, 0) != MESHIMPORT_OK) continue;
+				valid = valid && mesh->indexCount % 3 == 0;
+				for (int i = 0; i < mesh->indexCount; i++)
+					valid = valid && mesh->indices[i] < (unsigned int)mesh->vertexCount;
+			}
+		}
+		CHECK(valid);
+		_DestroyMesh3D(mesh);
+	}
+
+	void TestParallel()
+	{
+		// Large enough for several text chunks and item chunks
+		Grid grid = MakeGrid(200);
+		std::string fixtures[] = { BinaryStl(grid), AsciiStl(grid), Obj(grid), Ply(grid, PLY_ASCII, true), Ply(grid, PLY_LITTLE, false) };
+		const int ThreadCounts[] = { 1, 3 };
+		for (int t = 0; t < 2; t++)
+		{
+			JobSystem * jobs = _CreateJobSystem(ThreadCounts[t]);
+			for (int f = 0; f < 5; f++)
+			{
+				Mesh3D * serial = _CreateMesh3D();
+				Mesh3D * parallel = _CreateMesh3D();
+				MeshImportInfo serialInfo, parallelInfo;
+				CHECK(Parse(fixtures[f], MESHFILE_AUTO, 0, serial, &serialInfo) == MESHIMPORT_OK);
+				CHECK(Parse(fixtures[f], MESHFILE_AUTO, jobs, parallel, &parallelInfo) == MESHIMPORT_OK);
+				CHECK(SameTriangles(parallel, grid, f >= 3));
+				CHECK(SameMesh(serial, parallel));
+				CHECK(serialInfo.fileVertexCount == parallelInfo.fileVertexCount && serialInfo.vertexCount == parallelInfo.vertexCount);
+				_DestroyMesh3D(parallel);
+				_DestroyMesh3D(serial);
+			}
+			_DestroyJobSystem(jobs);
+		}
+	}
+
+	bool WriteFile(const char * path, const std::string & data)
+	{
+		FILE * file = fopen(path, "wb");
+		if (file == 0) return false;
+		bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+		return fclose(file) == 0 && written;
+	}
+
+	void TestFiles()
+	{
+		// The format is chosen from the extension; the mapping time is only added to
+		// the info of a successful import
+		Grid grid = MakeGrid(4);
+		std::string obj = Obj(grid);
+		Mesh3D * mesh = _CreateMesh3D();
+		MeshImportInfo info;
+		CHECK(WriteFile("MeshImportTest.obj", obj));
+		CHECK(_ImportMesh3D(L"MeshImportTest.obj", MESHFILE_AUTO, 0.0f, 0, mesh, &info) == MESHIMPORT_OK);
+		CHECK(SameTriangles(mesh, grid, false));
+		CHECK(info.format == MESHFILE_OBJ && info.fileSize == (long long)obj.size());
+		CHECK(info.parseTime >= 0.0 && info.totalTime >= info.parseTime + info.weldTime + info.buildTime - 1e-9);
+
+		memset(&info, 0, sizeof(info));
+		MeshImportInfo before = info;
+		CHECK(WriteFile("MeshImportTest.obj", obj.substr(0, obj.find("\nf ") + 1) + "f 1 2 0\n"));
+		CHECK(_ImportMesh3D(L"MeshImportTest.obj", MESHFILE_AUTO, 0.0f, 0, mesh, &info) == MESHIMPORT_BADFORMAT);
+		CHECK(WriteFile("MeshImportTest.stl", std::string()));
+		CHECK(_ImportMesh3D(L"MeshImportTest.stl", MESHFILE_AUTO, 0.0f, 0, mesh, &info) == MESHIMPORT_BADFORMAT);
+		remove("MeshImportTest.obj");
+		remove("MeshImportTest.stl");
+		CHECK(_ImportMesh3D(L"MeshImportTest.obj", MESHFILE_AUTO, 0.0f, 0, mesh, &info) == MESHIMPORT_OPENFAILED);
+		CHECK(memcmp(&info, &before, sizeof(info)) == 0);
+		CHECK(SameTriangles(mesh, grid, false));
+		_DestroyMesh3D(mesh);
+	}
+}
+
+void _TestMeshImport()
+{
+	TestFormats();
+	TestBadInput();
+	TestParallel();
+	TestFiles();
+}
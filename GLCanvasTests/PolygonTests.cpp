@@ -0,0 +1,330 @@
+// Native code, compiled without /clr.
+
+#include "Tests.h"
+#include "Simplifier.h"
+#include "Triangulator.h"
+
+#include <vector>
+
+namespace
+{
+	const float Pi = 3.14159265f;
+
+	// Polygon given as rings of x, y pairs, the first ring being the outer boundary
+	struct Polygon
+	{
+		std::vector<float> points;
+		std::vector<int> ringEnds;
+
+		int PointCount() const { return (int)points.size() / 2; }
+
+		void EndRing() { ringEnds.push_back(PointCount()); }
+
+		void Add(float x, float y)
+		{
+			points.push_back(x);
+			points.push_back(y);
+		}
+
+		// Adds a ring around (cx, cy) with count corners at the given radius, or at
+		// radii between radius and inner when random is given
+		void AddCircle(float cx, float cy, float radius, int count, bool clockwise, Random * random = 0, float inner = 0.0f)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				float angle = 2.0f * Pi * (float)(clockwise ? count - i : i) / (float)count;
+				float r = (random != 0 ? random->Next(inner, radius) : radius);
+				Add(cx + r * cosf(angle), cy + r * sinf(angle));
+			}
+			EndRing();
+		}
+	};
+
+	double SignedArea(const float * points, int first, int end)
+	{
+		double area = 0.0;
+		for (int i = first, j = end - 1; i < end; j = i++)
+			area += (double)points[j * 2] * points[i * 2 + 1] - (double)points[i * 2] * points[j * 2 + 1];
+		return area / 2.0;
+	}
+
+	double Abs(double value)
+	{
+		return value < 0.0 ? -value : value;
+	}
+
+	// Area of the outer ring minus the areas of the holes
+	double ExpectedArea(const Polygon & polygon)
+	{
+		double area = 0.0;
+		for (size_t r = 0; r < polygon.ringEnds.size(); r++)
+		{
+			double ring = Abs(SignedArea(&polygon.points[0], (r == 0 ? 0 : polygon.ringEnds[r - 1]), polygon.ringEnds[r]));
+			area += (r == 0 ? ring : -ring);
+		}
+		return area;
+	}
+
+	// Triangulates a polygon and checks that the indices are valid, that all triangles
+	// have the same orientation and that they cover the area of the polygon. Returns the
+	// number of triangles.
+	int CheckTriangulation(Triangulator * triangulator, const Polygon & polygon)
+	{
+		const int * indices;
+		int count = _Triangulate(triangulator, &polygon.points[0], &polygon.ringEnds[0], (int)polygon.ringEnds.size(), &indices);
+		CHECK(count % 3 == 0);
+
+		bool valid = true;
+		double area = 0.0, positive = 0.0, negative = 0.0;
+		for (int i = 0; i + 2 < count; i += 3)
+		{
+			float triangle[6];
+			for (int k = 0; k < 3; k++)
+			{
+				int index = indices[i + k];
+				valid = valid && index >= 0 && index < polygon.PointCount();
+				if (!valid) break;
+				triangle[k * 2] = polygon.points[index * 2];
+				triangle[k * 2 + 1] = polygon.points[index * 2 + 1];
+			}
+			if (!valid) break;
+			double a = SignedArea(triangle, 0, 3);
+			area += Abs(a);
+			if (a > 0.0) positive += a; else negative -= a;
+		}
+		CHECK(valid);
+
+		double expected = ExpectedArea(polygon);
+		CHECK(Abs(area - expected) <= 1e-4 * (expected > 1.0 ? expected : 1.0));
+		// Triangles of opposite orientation would overlap or fold over the outline
+		CHECK((positive <= 1e-6 * area) || (negative <= 1e-6 * area));
+		return count / 3;
+	}
+
+	void TestTriangulation()
+	{
+		Triangulator * triangulator = _CreateTriangulator();
+
+		// A convex and a concave polygon in both orientations
+		for (int clockwise = 0; clockwise < 2; clockwise++)
+		{
+			Polygon square;
+			square.AddCircle(0, 0, 1, 4, clockwise != 0);
+			CHECK(CheckTriangulation(triangulator, square) == 2);
+
+			Polygon comb;
+			const float teeth[][2] = { { 0, 0 }, { 5, 0 }, { 5, 3 }, { 4, 3 }, { 4, 1 }, { 3, 1 }, { 3, 3 }, { 2, 3 }, { 2, 1 }, { 1, 1 }, { 1, 3 }, { 0, 3 } };
+			for (int i = 0; i < 12; i++)
+			{
+				int k = (clockwise ? 11 - i : i);
+				comb.Add(teeth[k][0], teeth[k][1]);
+			}
+			comb.EndRing();
+			CHECK(CheckTriangulation(triangulator, comb) == 10);
+		}
+
+		// Holes of either orientation; without collinear points, a polygon of n points
+		// and h holes gives n - 2 + 2h triangles
+		for (int clockwise = 0; clockwise < 2; clockwise++)
+		{
+			Polygon holes;
+			holes.AddCircle(0, 0, 10, 12, false);
+			holes.AddCircle(-4, 0, 2, 5, clockwise != 0);
+			holes.AddCircle(4, 0, 2, 6, clockwise == 0);
+			holes.AddCircle(0, 5, 1.5f, 3, clockwise != 0);
+			CHECK(CheckTriangulation(triangulator, holes) == 26 - 2 + 6);
+		}
+
+		// Star shaped polygons with random radii, below and above the size at which
+		// reflex vertices are looked up by their z-order hash
+		Random random(7);
+		const int Sizes[] = { 10, 79, 80, 81, 200, 2000 };
+		for (int s = 0; s < 6; s++)
+		{
+			Polygon star;
+			star.AddCircle(0, 0, 100, Sizes[s], (s % 2) != 0, &random, 40);
+			CHECK(CheckTriangulation(triangulator, star) == Sizes[s] - 2);
+
+			// The same outline with holes inside the inner radius
+			Polygon holes = star;
+			holes.AddCircle(-15, 0, 10, 7 + s, false, &random, 5);
+			holes.AddCircle(15, 0, 10, 30 + s * 20, true, &random, 5);
+			holes.AddCircle(0, 20, 5, 4, false);
+			CHECK(CheckTriangulation(triangulator, holes) == holes.PointCount() - 2 + 2 * 3);
+		}
+
+		// Combs whose reflex corners lie inside many candidate ears, on both paths
+		for (int teeth = 10; teeth <= 50; teeth += 40)
+		{
+			Polygon comb;
+			comb.Add(0, 0);
+			comb.Add((float)teeth * 2, 0);
+			for (int i = teeth - 1; i >= 0; i--)
+			{
+				float x = (float)i * 2;
+				comb.Add(x + 2, 10);
+				comb.Add(x + 1, 10);
+				comb.Add(x + 1, 1 + 0.1f * (float)i);
+				comb.Add(x, 1 + 0.1f * (float)i);
+			}
+			comb.EndRing();
+			CHECK(CheckTriangulation(triangulator, comb) == comb.PointCount() - 2);
+		}
+
+		// Points on straight edges and repeated points change nothing but the triangle count
+		Polygon collinear;
+		for (int i = 0; i < 10; i++) collinear.Add((float)i, 0);
+		for (int i = 0; i < 10; i++) collinear.Add(10, (float)i);
+		collinear.Add(10, 10);
+		collinear.Add(10, 10);
+		collinear.Add(0, 10);
+		collinear.Add(0, 10);
+		collinear.Add(0, 5);
+		collinear.EndRing();
+		CHECK(CheckTriangulation(triangulator, collinear) >= 2);
+
+		// The same with more than enough points for the hashed path
+		Polygon dense;
+		for (int side = 0; side < 4; side++)
+		{
+			for (int i = 0; i < 30; i++)
+			{
+				float t = (float)i / 30.0f;
+				const float x[] = { t, 1, 1 - t, 0 }, y[] = { 0, t, 1, 1 - t };
+				dense.Add(x[side] * 100.0f, y[side] * 100.0f);
+			}
+		}
+		dense.EndRing();
+		dense.AddCircle(50, 50, 20, 90, true);
+		CHECK(CheckTriangulation(triangulator, dense) >= 2);
+
+		// Degenerate input gives no triangles
+		const int * indices;
+		CHECK(_Triangulate(triangulator, 0, 0, 0, &indices) == 0);
+		Polygon two;
+		two.Add(0, 0);
+		two.Add(1, 1);
+		two.EndRing();
+		CHECK(_Triangulate(triangulator, &two.points[0], &two.ringEnds[0], 1, &indices) == 0);
+		Polygon line;
+		for (int i = 0; i < 100; i++) line.Add((float)i, (float)i * 0.5f);
+		line.EndRing();
+		CHECK(CheckTriangulation(triangulator, line) == 0);
+		Polygon point;
+		for (int i = 0; i < 5; i++) point.Add(3, 3);
+		point.EndRing();
+		CHECK(CheckTriangulation(triangulator, point) == 0);
+
+		// A hole that is a single point or a line does not remove any area
+		Polygon slit;
+		slit.AddCircle(0, 0, 10, 8, false);
+		slit.Add(0, 0);
+		slit.EndRing();
+		slit.Add(-2, 1);
+		slit.Add(2, 1);
+		slit.EndRing();
+		CheckTriangulation(triangulator, slit);
+
+		_DestroyTriangulator(triangulator);
+	}
+
+	// Squared distance of p from the segment a, b
+	float SegmentDistanceSquared(const float * p, const float * a, const float * b)
+	{
+		float dx = b[0] - a[0], dy = b[1] - a[1];
+		float length2 = dx * dx + dy * dy;
+		float t = (length2 > 0 ? ((p[0] - a[0]) * dx + (p[1] - a[1]) * dy) / length2 : 0);
+		t = (t < 0 ? 0 : (t > 1 ? 1 : t));
+		float x = a[0] + dx * t - p[0], y = a[1] + dy * t - p[1];
+		return x * x + y * y;
+	}
+
+	// Returns the largest distance of a point from the simplified line
+	float Deviation(const float * points, int count, const float * simplified, int simplifiedCount, bool closed)
+	{
+		float deviation = 0;
+		int segments = (closed ? simplifiedCount : simplifiedCount - 1);
+		for (int i = 0; i < count; i++)
+		{
+			float nearest = 3.4e38f;
+			for (int k = 0; k < segments; k++)
+			{
+				float d = SegmentDistanceSquared(points + i * 2, simplified + k * 2, simplified + ((k + 1) % simplifiedCount) * 2);
+				nearest = (d < nearest ? d : nearest);
+			}
+			deviation = (nearest > deviation ? nearest : deviation);
+		}
+		return sqrtf(deviation);
+	}
+
+	// Returns true if the simplified points are a subsequence of the points
+	bool IsSubsequence(const float * points, int count, const float * simplified, int simplifiedCount)
+	{
+		int k = 0;
+		for (int i = 0; i < count && k < simplifiedCount; i++)
+			if (points[i * 2] == simplified[k * 2] && points[i * 2 + 1] == simplified[k * 2 + 1]) k++;
+		return k == simplifiedCount;
+	}
+
+	void TestSimplification()
+	{
+		Simplifier * simplifier = _CreateSimplifier();
+		const float * simplified;
+
+		// Closed rings of three points or less, open lines of two points or less and
+		// tolerances that are zero or not positive return the input
+		const float triangle[] = { 0, 0, 0.01f, 0, 0, 0.01f };
+		for (int count = 0; count <= 3; count++)
+		{
+			CHECK(_Simplify(simplifier, triangle, count, 1.0f, true, &simplified) == count);
+			CHECK(simplified == triangle);
+		}
+		for (int count = 0; count <= 2; count++)
+		{
+			CHECK(_Simplify(simplifier, triangle, count, 1.0f, false, &simplified) == count);
+			CHECK(simplified == triangle);
+		}
+
+		Polygon circle;
+		Random random(3);
+		circle.AddCircle(0, 0, 100, 1000, false, &random, 99);
+		const float * points = &circle.points[0];
+		const float Tolerances[] = { 0.0f, -1.0f, sqrtf(-1.0f) };
+		for (int t = 0; t < 3; t++)
+		{
+			CHECK(_Simplify(simplifier, points, 1000, Tolerances[t], true, &simplified) == 1000);
+			CHECK(simplified == points);
+		}
+
+		// Real simplification keeps a subsequence of the points and both ends of open
+		// lines. Points are first dropped when they are within the tolerance of the
+		// previous point, so the result may be up to twice the tolerance away. A ring
+		// smaller than the tolerance shrinks to fewer than three points.
+		const float Steps[] = { 0.01f, 0.5f, 2.0f, 20.0f, 1000.0f };
+		for (int t = 0; t < 5; t++)
+		{
+			float tolerance = Steps[t];
+			for (int closed = 0; closed < 2; closed++)
+			{
+				int count = _Simplify(simplifier, points, 1000, tolerance, closed != 0, &simplified);
+				CHECK(count >= (closed ? 1 : 2) && count < 1000);
+				CHECK((count >= 3) == (tolerance < 100.0f));
+				CHECK(IsSubsequence(points, 1000, simplified, count));
+				CHECK(Deviation(points, 1000, simplified, count, closed != 0) <= 2.0f * tolerance * 1.001f);
+				if (!closed)
+				{
+					CHECK(simplified[0] == points[0] && simplified[1] == points[1]);
+					CHECK(simplified[count * 2 - 2] == points[1998] && simplified[count * 2 - 1] == points[1999]);
+				}
+			}
+		}
+
+		_DestroySimplifier(simplifier);
+	}
+}
+
+void _TestPolygons()
+{
+	TestTriangulation();
+	TestSimplification();
+}
@@ -0,0 +1,412 @@
+// Native code, compiled without /clr.
+
+#include "Tests.h"
+#include "GLExtensions.h"
+#include "Renderer.h"
+
+#include <windows.h>
+#include <GL/gl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+	const int Width = 64, Height = 64;
+
+	// OpenGL 3.3 definitions missing from the OpenGL 1.1 headers
+	const GLenum Framebuffer = 0x8D40;
+	const GLenum Renderbuffer = 0x8D41;
+	const GLenum ColorAttachment0 = 0x8CE0;
+	const GLenum DepthAttachment = 0x8D00;
+	const GLenum FramebufferComplete = 0x8CD5;
+	const GLenum DepthComponent24 = 0x81A6;
+	const GLenum ContextProfileMask = 0x9126;
+	const GLint ContextCoreProfileBit = 0x0001;
+
+	typedef void (APIENTRY * GenFramebuffersFunction)(GLsizei n, GLuint * framebuffers);
+	typedef void (APIENTRY * BindFramebufferFunction)(GLenum target, GLuint framebuffer);
+	typedef void (APIENTRY * DeleteFramebuffersFunction)(GLsizei n, const GLuint * framebuffers);
+	typedef GLenum (APIENTRY * CheckFramebufferStatusFunction)(GLenum target);
+	typedef void (APIENTRY * FramebufferRenderbufferFunction)(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
+	typedef void (APIENTRY * GenRenderbuffersFunction)(GLsizei n, GLuint * renderbuffers);
+	typedef void (APIENTRY * BindRenderbufferFunction)(GLenum target, GLuint renderbuffer);
+	typedef void (APIENTRY * DeleteRenderbuffersFunction)(GLsizei n, const GLuint * renderbuffers);
+	typedef void (APIENTRY * RenderbufferStorageFunction)(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
+
+	// A hidden window with a rendering context. Pixels of a hidden window are not owned
+	// by the context, so drawing goes to a framebuffer object.
+	struct TestContext
+	{
+		HWND window;
+		HDC dc;
+		HGLRC context;
+		GLuint framebuffer;
+		GLuint renderbuffers[2];
+	};
+
+	void DestroyTestContext(TestContext & test)
+	{
+		if (test.framebuffer != 0)
+		{
+			((DeleteFramebuffersFunction)_GetGLFunction("glDeleteFramebuffers"))(1, &test.framebuffer);
+			((DeleteRenderbuffersFunction)_GetGLFunction("glDeleteRenderbuffers"))(2, test.renderbuffers);
+		}
+		wglMakeCurrent(0, 0);
+		if (test.context != 0) wglDeleteContext(test.context);
+		if (test.dc != 0) ReleaseDC(test.window, test.dc);
+		if (test.window != 0) DestroyWindow(test.window);
+	}
+
+	// Creates an OpenGL 3.3 core or compatibility profile context with the pixel format
+	// of the canvases and makes it current. Returns false if the driver has no such
+	// context or no framebuffer objects.
+	bool CreateTestContext(TestContext & test, bool core)
+	{
+		memset(&test, 0, sizeof(TestContext));
+
+		static bool registered = false;
+		if (!registered)
+		{
+			WNDCLASSW windowClass;
+			memset(&windowClass, 0, sizeof(windowClass));
+			windowClass.style = CS_OWNDC;
+			windowClass.lpfnWndProc = DefWindowProcW;
+			windowClass.hInstance = GetModuleHandleW(0);
+			windowClass.lpszClassName = L"GLCanvasTests";
+			registered = (RegisterClassW(&windowClass) != 0);
+		}
+		test.window = CreateWindowW(L"GLCanvasTests", L"GLCanvasTests", WS_POPUP, 0, 0, Width, Height, 0, 0, GetModuleHandleW(0), 0);
+		if (test.window == 0) return false;
+		test.dc = GetDC(test.window);
+
+		PIXELFORMATDESCRIPTOR pfd;
+		memset(&pfd, 0, sizeof(pfd));
+		pfd.nSize = sizeof(PIXELFORMATDESCRIPTOR);
+		pfd.nVersion = 1;
+		pfd.dwFlags = PFD_DRAW_TO_WINDOW | PFD_SUPPORT_OPENGL | PFD_DOUBLEBUFFER;
+		pfd.iPixelType = PFD_TYPE_RGBA;
+		pfd.cColorBits = 32;
+		pfd.cDepthBits = 24;
+		pfd.iLayerType = PFD_MAIN_PLANE;
+		SetPixelFormat(test.dc, ChoosePixelFormat(test.dc, &pfd), &pfd);
+
+		test.context = (HGLRC)_CreateGLContext(test.dc, core);
+		if (test.context == 0 || !wglMakeCurrent(test.dc, test.context))
+		{
+			DestroyTestContext(test);
+			return false;
+		}
+
+		GenFramebuffersFunction genFramebuffers = (GenFramebuffersFunction)_GetGLFunction("glGenFramebuffers");
+		BindFramebufferFunction bindFramebuffer = (BindFramebufferFunction)_GetGLFunction("glBindFramebuffer");
+		CheckFramebufferStatusFunction checkFramebufferStatus = (CheckFramebufferStatusFunction)_GetGLFunction("glCheckFramebufferStatus");
+		FramebufferRenderbufferFunction framebufferRenderbuffer = (FramebufferRenderbufferFunction)_GetGLFunction("glFramebufferRenderbuffer");
+		GenRenderbuffersFunction genRenderbuffers = (GenRenderbuffersFunction)_GetGLFunction("glGenRenderbuffers");
+		BindRenderbufferFunction bindRenderbuffer = (BindRenderbufferFunction)_GetGLFunction("glBindRenderbuffer");
+		RenderbufferStorageFunction renderbufferStorage = (RenderbufferStorageFunction)_GetGLFunction("glRenderbufferStorage");
+		if (genFramebuffers == 0 || bindFramebuffer == 0 || checkFramebufferStatus == 0 || framebufferRenderbuffer == 0 ||
+			genRenderbuffers == 0 || bindRenderbuffer == 0 || renderbufferStorage == 0 || _GetGLFunction("glDeleteFramebuffers") == 0)
+		{
+			DestroyTestContext(test);
+			return false;
+		}
+
+		genRenderbuffers(2, test.renderbuffers);
+		bindRenderbuffer(Renderbuffer, test.renderbuffers[0]);
+		renderbufferStorage(Renderbuffer, GL_RGBA8, Width, Height);
+		bindRenderbuffer(Renderbuffer, test.renderbuffers[1]);
+		renderbufferStorage(Renderbuffer, DepthComponent24, Width, Height);
+		bindRenderbuffer(Renderbuffer, 0);
+		genFramebuffers(1, &test.framebuffer);
+		bindFramebuffer(Framebuffer, test.framebuffer);
+		framebufferRenderbuffer(Framebuffer, ColorAttachment0, Renderbuffer, test.renderbuffers[0]);
+		framebufferRenderbuffer(Framebuffer, DepthAttachment, Renderbuffer, test.renderbuffers[1]);
+		if (checkFramebufferStatus(Framebuffer) != FramebufferComplete)
+		{
+			DestroyTestContext(test);
+			return false;
+		}
+
+		glViewport(0, 0, Width, Height);
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LEQUAL);
+		if (!core)
+		{
+			// The fixed function state GLCanvas3D starts with
+			glShadeModel(GL_SMOOTH);
+			glEnable(GL_COLOR_MATERIAL);
+			GLfloat black[] = { 0, 0, 0, 1 };
+			GLfloat white[] = { 1, 1, 1, 1 };
+			glLightfv(GL_LIGHT0, GL_AMBIENT, black);
+			glLightfv(GL_LIGHT0, GL_DIFFUSE, white);
+			glLightfv(GL_LIGHT0, GL_SPECULAR, white);
+			glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
+			glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, black);
+			glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, black);
+		}
+		return true;
+	}
+
+	void Identity(float * m)
+	{
+		for (int i = 0; i < 16; i++)
+			m[i] = (i % 5 == 0 ? 1.0f : 0.0f);
+	}
+
+	// Transforms a point by a column-major matrix and divides by w
+	void Project(const float * m, float x, float y, float z, float * result)
+	{
+		float w = m[3] * x + m[7] * y + m[11] * z + m[15];
+		for (int i = 0; i < 3; i++)
+			result[i] = (m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i]) / w;
+	}
+
+	bool NearPoint(const float * p, float x, float y, float z)
+	{
+		return Near(p[0], x, 1e-4f) && Near(p[1], y, 1e-4f) && Near(p[2], z, 1e-4f);
+	}
+
+	void TestMatrices()
+	{
+		// Corners of the view volume map to the corners of the unit cube
+		float m[16], p[3];
+		_OrthoMatrix(m, -3, 5, -1, 2, 0.5f, 10);
+		Project(m, -3, -1, -0.5f, p);
+		CHECK(NearPoint(p, -1, -1, -1));
+		Project(m, 5, 2, -10, p);
+		CHECK(NearPoint(p, 1, 1, 1));
+
+		_FrustumMatrix(m, -2, 1, -1, 3, 1, 100);
+		Project(m, -2, -1, -1, p);
+		CHECK(NearPoint(p, -1, -1, -1));
+		Project(m, 100, 300, -100, p);
+		CHECK(NearPoint(p, 1, 1, 1));
+
+		// The eye goes to the origin and the target onto the negative z axis, with
+		// the up vector in the upper half of the yz plane
+		Random random(3);
+		for (int i = 0; i < 100; i++)
+		{
+			float eye[3], target[3], up[3];
+			for (int k = 0; k < 3; k++)
+			{
+				eye[k] = random.Next(-10.0f, 10.0f);
+				target[k] = random.Next(-10.0f, 10.0f);
+				up[k] = random.Next(-1.0f, 1.0f);
+			}
+			float d[3] = { target[0] - eye[0], target[1] - eye[1], target[2] - eye[2] };
+			float distance = sqrtf(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+			_LookAtMatrix(m, eye, target, up);
+			Project(m, eye[0], eye[1], eye[2], p);
+			CHECK(NearPoint(p, 0, 0, 0));
+			Project(m, target[0], target[1], target[2], p);
+			CHECK(NearPoint(p, 0, 0, -distance));
+			Project(m, eye[0] + up[0], eye[1] + up[1], eye[2] + up[2], p);
+			CHECK(Near(p[0], 0.0f, 1e-4f) && p[1] >= 0.0f);
+			// The rotation part is orthonormal
+			for (int a = 0; a < 3; a++)
+			{
+				for (int b = 0; b < 3; b++)
+				{
+					float dot = m[a * 4] * m[b * 4] + m[a * 4 + 1] * m[b * 4 + 1] + m[a * 4 + 2] * m[b * 4 + 2];
+					CHECK(Near(dot, (a == b ? 1.0f : 0.0f), 1e-4f));
+				}
+			}
+		}
+	}
+
+	// Compares the matrices with the ones glOrtho and glFrustum load in a
+	// compatibility profile context
+	void TestFixedFunctionMatrices()
+	{
+		float expected[16], actual[16];
+		glMatrixMode(GL_PROJECTION);
+		glLoadIdentity();
+		glOrtho(-3, 5, -1, 2, 0.5f, 10);
+		glGetFloatv(GL_PROJECTION_MATRIX, expected);
+		_OrthoMatrix(actual, -3, 5, -1, 2, 0.5f, 10);
+		for (int i = 0; i < 16; i++)
+			CHECK(Near(actual[i], expected[i]));
+
+		glLoadIdentity();
+		glFrustum(-2, 1, -1, 3, 1, 100000);
+		glGetFloatv(GL_PROJECTION_MATRIX, expected);
+		_FrustumMatrix(actual, -2, 1, -1, 3, 1, 100000);
+		for (int i = 0; i < 16; i++)
+			CHECK(Near(actual[i], expected[i]));
+		glLoadIdentity();
+		glMatrixMode(GL_MODELVIEW);
+	}
+
+	LitVertex Lit(float x, float y, float z, float nx, float ny, float nz, unsigned int color)
+	{
+		LitVertex v = { x, y, z, nx, ny, nz, color };
+		return v;
+	}
+
+	// Draws colored, lit, instanced and retained geometry with every entry point of
+	// the renderer and reads back the framebuffer
+	void DrawScene(Renderer * renderer, std::vector<unsigned char> & pixels)
+	{
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClearDepth(1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		float projection[16], modelview[16], transform[16];
+		_OrthoMatrix(projection, -2, 2, -2, 2, -10, 10);
+		Identity(modelview);
+		_SetRenderTransform(renderer, projection, modelview);
+		const float light[3] = { 0.3f, 0.4f, 1.0f };
+		_SetRenderLighting(renderer, false, light);
+
+		// Colored triangles and two line strips
+		const ColorVertex triangles[] = {
+			{ -2.0f, -2.0f, 0.0f, 0xFF0000FFu }, { 0.0f, -2.0f, 0.0f, 0xFF00FF00u }, { -2.0f, 0.0f, 0.0f, 0xFFFF0000u },
+			{ 1.0f, 1.0f, 0.5f, 0xFFFFFFFFu }, { 2.0f, 1.0f, 0.5f, 0xFF808080u }, { 2.0f, 2.0f, 0.5f, 0xFFFFFFFFu } };
+		_RenderColorVertices(renderer, GL_TRIANGLES, triangles, 6, 0);
+		const ColorVertex lines[] = {
+			{ -1.9f, 1.5f, 0.0f, 0xFF00FFFFu }, { -0.5f, 1.5f, 0.0f, 0xFF00FFFFu }, { -0.5f, 0.5f, 0.0f, 0xFF00FFFFu },
+			{ 0.5f, -1.5f, 0.0f, 0xFFFF00FFu }, { 1.9f, -1.5f, 0.0f, 0xFFFF00FFu } };
+		int firsts[] = { 0, 3 }, counts[] = { 3, 2 };
+		StripList strips = { firsts, counts, 2, 2 };
+		_RenderColorVertices(renderer, GL_LINE_STRIP, lines, 5, &strips);
+
+		// Lit triangles facing the light at different angles
+		_SetRenderLighting(renderer, true, light);
+		modelview[12] = 0.5f;
+		modelview[13] = 0.5f;
+		_SetRenderTransform(renderer, projection, modelview);
+		const LitVertex lit[] = {
+			Lit(0, 0, 0, 0, 0, 1, 0xFF8080C0u), Lit(1, 0, 0, 0, 0, 1, 0xFF8080C0u), Lit(1, -1, 0, 0, 0, 1, 0xFF8080C0u),
+			Lit(0.5f, -1.8f, 0, 1, 0, 1, 0xFFFFFFFFu), Lit(1.5f, -1.8f, 0, 1, 0, 1, 0xFFFFFFFFu), Lit(1.5f, -1.2f, 0, 1, 0, 1, 0xFFFFFFFFu) };
+		_RenderLitVertices(renderer, GL_TRIANGLES, lit, 6);
+
+		// Instances of a small triangle, moved, scaled and colored by each instance
+		Identity(modelview);
+		_SetRenderTransform(renderer, projection, modelview);
+		const LitVertex mesh[] = { Lit(0, 0, 0, 0, 0, 1, 0), Lit(0.3f, 0, 0, 0, 0, 1, 0), Lit(0, 0.3f, 0, 0, 1, 1, 0) };
+		const MeshInstance instances[] = {
+			{ { 1, 0, 0, -1.8f, 0, 1, 0, -0.6f, 0, 0, 1, 0 }, 0xFF00FF00u },
+			{ { 2, 0, 0, -1.2f, 0, 1, 0, -0.6f, 0, 0, 1, 0 }, 0xFF0080FFu },
+			{ { 0, -1, 0, -0.4f, 1, 0, 0, -0.6f, 0, 0, 1, 0 }, 0xFFFF8000u } };
+		_RenderInstances(renderer, GL_TRIANGLES, mesh, 3, instances, 3);
+
+		// Retained geometry, drawn with its own colors and recolored with a transform
+		const LitVertex quad[] = {
+			Lit(0, 0, 0, 0, 0, 1, 0xFF40C0C0u), Lit(0.5f, 0, 0, 0, 0, 1, 0xFF40C0C0u), Lit(0.5f, 0.5f, 0, 0, 0, 1, 0xFFC040C0u),
+			Lit(0, 0, 0, 0, 0, 1, 0xFF40C0C0u), Lit(0.5f, 0.5f, 0, 0, 0, 1, 0xFFC040C0u), Lit(0, 0.5f, 0, 0, 0, 1, 0xFFC040C0u) };
+		const LitVertex edges[] = { Lit(0, -0.1f, 0, 0, 0, 1, 0xFFFFFFFFu), Lit(0.5f, -0.1f, 0, 0, 0, 1, 0xFFFFFFFFu) };
+		RenderGeometry * geometry = _CreateRenderGeometry(renderer, quad, 6, edges, 2);
+		Identity(transform);
+		transform[12] = -1.5f;
+		transform[13] = 0.1f;
+		_RenderGeometry(renderer, geometry, RENDERGEOMETRY_ALL, transform, false, 0);
+		transform[12] = -0.8f;
+		_RenderGeometry(renderer, geometry, RENDERGEOMETRY_TRIANGLES, transform, true, 0xFF2020FFu);
+		_DestroyRenderGeometry(geometry);
+
+		const unsigned int indices[] = { 0, 1, 2, 0, 2, 3 }, edgeIndices[] = { 0, 1, 1, 2 };
+		const LitVertex corners[] = {
+			Lit(0, 0, 0.2f, 0, 0, 1, 0xFFFFFF00u), Lit(0.6f, 0, 0.2f, 0, 0, 1, 0xFFFFFF00u),
+			Lit(0.6f, 0.4f, 0.2f, 0, 1, 1, 0xFF00FFFFu), Lit(0, 0.4f, 0.2f, 0, 1, 1, 0xFF00FFFFu) };
+		RenderGeometry * indexed = _CreateIndexedGeometry(renderer, corners, 4, indices, 6, edgeIndices, 4);
+		transform[12] = 0.2f;
+		transform[13] = -0.9f;
+		_RenderGeometry(renderer, indexed, RENDERGEOMETRY_ALL, transform, false, 0);
+		_DestroyRenderGeometry(indexed);
+		_SetRenderLighting(renderer, false, light);
+
+		pixels.assign((size_t)Width * Height * 4, 0);
+		glFinish();
+		glReadPixels(0, 0, Width, Height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+	}
+
+	// Returns the number of pixels which differ by more than a few steps in any
+	// channel, to allow for interpolation differences between the pipelines
+	int CountDifferences(const std::vector<unsigned char> & a, const std::vector<unsigned char> & b)
+	{
+		int differences = 0;
+		for (size_t i = 0; i < a.size(); i += 4)
+		{
+			bool same = true;
+			for (size_t k = 0; k < 3; k++)
+				same = same && abs((int)a[i + k] - (int)b[i + k]) <= 3;
+			if (!same) differences++;
+		}
+		return differences;
+	}
+
+	int CountCovered(const std::vector<unsigned char> & pixels)
+	{
+		int covered = 0;
+		for (size_t i = 0; i < pixels.size(); i += 4)
+		{
+			if (pixels[i] != 0 || pixels[i + 1] != 0 || pixels[i + 2] != 0)
+				covered++;
+		}
+		return covered;
+	}
+
+	void TestBackends()
+	{
+		// The reference image is drawn by the fixed function backend, and the
+		// programmable backend draws it again in the same context
+		TestContext test;
+		if (!CreateTestContext(test, false))
+		{
+			printf("No OpenGL 3.3 compatibility profile context; renderer tests skipped.\n");
+			return;
+		}
+		TestFixedFunctionMatrices();
+
+		std::vector<unsigned char> reference, pixels;
+		Renderer * fixed = _CreateRenderer(RENDERBACKEND_FIXEDFUNCTION);
+		DrawScene(fixed, reference);
+		CHECK(glGetError() == GL_NO_ERROR);
+		CHECK(CountCovered(reference) > Width * Height / 4);
+
+		Renderer * programmable = _CreateRenderer(RENDERBACKEND_PROGRAMMABLE);
+		CHECK(programmable != 0);
+		if (programmable != 0)
+		{
+			DrawScene(programmable, pixels);
+			CHECK(glGetError() == GL_NO_ERROR);
+			CHECK(CountDifferences(reference, pixels) <= Width * Height / 100);
+			_DestroyRenderer(programmable);
+
+			// Fixed function draws are not disturbed by the programmable backend
+			DrawScene(fixed, pixels);
+			CHECK(CountDifferences(reference, pixels) == 0);
+		}
+		_DestroyRenderer(fixed);
+		DestroyTestContext(test);
+
+		// A core profile context has no fixed function pipeline, so any use of it by
+		// the programmable backend raises an error or changes the image
+		if (!CreateTestContext(test, true))
+		{
+			printf("No OpenGL 3.3 core profile context; core renderer test skipped.\n");
+			return;
+		}
+		GLint profile = 0;
+		glGetIntegerv(ContextProfileMask, &profile);
+		CHECK((profile & ContextCoreProfileBit) != 0);
+		programmable = _CreateRenderer(RENDERBACKEND_PROGRAMMABLE);
+		CHECK(programmable != 0);
+		if (programmable != 0)
+		{
+			DrawScene(programmable, pixels);
+			CHECK(glGetError() == GL_NO_ERROR);
+			CHECK(CountDifferences(reference, pixels) <= Width * Height / 100);
+			_DestroyRenderer(programmable);
+		}
+		DestroyTestContext(test);
+	}
+}
+
+void _TestRenderers()
+{
+	TestMatrices();
+	TestBackends();
+}
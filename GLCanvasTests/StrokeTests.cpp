@@ -0,0 +1,186 @@
+// Native code, compiled without /clr.
+
+#include "Tests.h"
+#include "Stroker.h"
+
+#include <vector>
+
+namespace
+{
+	const int RoundSegments = 16;
+
+	bool IsFinite(float value)
+	{
+		return value == value && value - value == 0.0f;
+	}
+
+	StrokeStyle2D Style(int join, int cap, float miterLimit, bool closed)
+	{
+		StrokeStyle2D style = { join, cap, miterLimit, closed, RoundSegments };
+		return style;
+	}
+
+	// Results of stroking a polyline
+	struct Stroke
+	{
+		int triangles;
+		double area;		// sum of the unsigned triangle areas
+		bool finite;
+	};
+
+	Stroke StrokeLine(Stroker * stroker, VertexBuffer * buffer, const float * points, const float * widths, float width, int count, const StrokeStyle2D & style)
+	{
+		buffer->count = 0;
+		_StrokePolyline(stroker, points, widths, width, count, style, 0.5f, 0xFF0000FFu, buffer);
+		CHECK(buffer->count % 3 == 0);
+
+		Stroke stroke = { buffer->count / 3, 0.0, true };
+		for (int i = 0; i + 2 < buffer->count; i += 3)
+		{
+			const ColorVertex * v = buffer->data + i;
+			for (int k = 0; k < 3; k++)
+				stroke.finite = stroke.finite && IsFinite(v[k].x) && IsFinite(v[k].y) && v[k].z == 0.5f && v[k].color == 0xFF0000FFu;
+			double a = ((double)v[1].x - v[0].x) * ((double)v[2].y - v[0].y) - ((double)v[2].x - v[0].x) * ((double)v[1].y - v[0].y);
+			stroke.area += (a < 0 ? -a : a) / 2.0;
+		}
+		return stroke;
+	}
+
+	void TestCaps()
+	{
+		Stroker * stroker = _CreateStroker();
+		VertexBuffer * buffer = _CreateVertexBuffer();
+
+		// One segment 10 long and 2 wide. Flat and square caps add no triangles; a round
+		// cap is two quarter turns of ceil(8 * 0.35 * sqrt(2)) = 4 triangles each.
+		const float segment[] = { 0, 0, 10, 0 };
+		Stroke flat = StrokeLine(stroker, buffer, segment, 0, 2, 2, Style(LINEJOIN_MITER, LINECAP_FLAT, 4, false));
+		CHECK(flat.finite && flat.triangles == 2 && Near((float)flat.area, 20.0f));
+		Stroke square = StrokeLine(stroker, buffer, segment, 0, 2, 2, Style(LINEJOIN_MITER, LINECAP_SQUARE, 4, false));
+		CHECK(square.finite && square.triangles == 2 && Near((float)square.area, 24.0f));
+		Stroke round = StrokeLine(stroker, buffer, segment, 0, 2, 2, Style(LINEJOIN_MITER, LINECAP_ROUND, 4, false));
+		CHECK(round.finite && round.triangles == 2 + 2 * 8);
+		CHECK(round.area > 20.0 + 3.0 && round.area < 20.0 + 3.1416);
+
+		// Repeated points are dropped; fewer than two distinct points draw nothing
+		const float repeated[] = { 0, 0, 0, 0, 10, 0, 10, 0 };
+		CHECK(StrokeLine(stroker, buffer, repeated, 0, 2, 4, Style(LINEJOIN_MITER, LINECAP_FLAT, 4, false)).triangles == 2);
+		CHECK(StrokeLine(stroker, buffer, repeated, 0, 2, 2, Style(LINEJOIN_MITER, LINECAP_ROUND, 4, false)).triangles == 0);
+		CHECK(StrokeLine(stroker, buffer, repeated, 0, 2, 0, Style(LINEJOIN_MITER, LINECAP_ROUND, 4, true)).triangles == 0);
+
+		// Zero-width ends have no round cap
+		const float widths[] = { 0, 0 };
+		Stroke thin = StrokeLine(stroker, buffer, segment, widths, 2, 2, Style(LINEJOIN_ROUND, LINECAP_ROUND, 4, false));
+		CHECK(thin.finite && thin.triangles == 2 && thin.area == 0.0);
+
+		_DestroyVertexBuffer(buffer);
+		_DestroyStroker(stroker);
+	}
+
+	void TestJoins()
+	{
+		Stroker * stroker = _CreateStroker();
+		VertexBuffer * buffer = _CreateVertexBuffer();
+
+		// A right angle of two segments 10 long, 2 wide with flat caps. The union of
+		// the two rectangles is 40; a bevel cuts off half a unit square and a round join
+		// a polygon inside the quarter circle. A right angle miter is sqrt(2) times the
+		// stroke width, so it is beveled below that limit.
+		const float corner[] = { 0, 0, 10, 0, 10, 10 };
+		Stroke miter = StrokeLine(stroker, buffer, corner, 0, 2, 3, Style(LINEJOIN_MITER, LINECAP_FLAT, 1.5f, false));
+		CHECK(miter.finite && miter.triangles == 4 && Near((float)miter.area, 40.0f));
+		Stroke limited = StrokeLine(stroker, buffer, corner, 0, 2, 3, Style(LINEJOIN_MITER, LINECAP_FLAT, 1.4f, false));
+		CHECK(limited.finite && limited.triangles == 5 && Near((float)limited.area, 39.5f));
+		Stroke bevel = StrokeLine(stroker, buffer, corner, 0, 2, 3, Style(LINEJOIN_BEVEL, LINECAP_FLAT, 10, false));
+		CHECK(bevel.finite && bevel.triangles == 5 && Near((float)bevel.area, 39.5f));
+		// Two eighth turns of ceil(8 * 0.35 * 2 sin(22.5 degrees)) = 3 triangles each
+		Stroke round = StrokeLine(stroker, buffer, corner, 0, 2, 3, Style(LINEJOIN_ROUND, LINECAP_FLAT, 10, false));
+		CHECK(round.finite && round.triangles == 4 + 6);
+		CHECK(round.area > 39.75 && round.area < 40.0 - 1.0 + 3.14159265 / 4.0 + 1e-4);
+
+		// Segments shorter than the inner corner reaches fall back to the point itself as
+		// the inner corner, so the segments keep their square ends and the outside of
+		// the turn is filled from the point: a miter with two triangles, a bevel with one
+		const float shortCorner[] = { 0, 0, 0.5f, 0, 0.5f, 0.5f };
+		Stroke fallback = StrokeLine(stroker, buffer, shortCorner, 0, 2, 3, Style(LINEJOIN_MITER, LINECAP_FLAT, 10, false));
+		CHECK(fallback.finite && fallback.triangles == 4 + 2);
+		Stroke bevelFallback = StrokeLine(stroker, buffer, shortCorner, 0, 2, 3, Style(LINEJOIN_BEVEL, LINECAP_FLAT, 10, false));
+		CHECK(bevelFallback.finite && bevelFallback.triangles == 4 + 1);
+		Stroke roundFallback = StrokeLine(stroker, buffer, shortCorner, 0, 2, 3, Style(LINEJOIN_ROUND, LINECAP_FLAT, 10, false));
+		CHECK(roundFallback.finite && roundFallback.triangles == 4 + 6);
+
+		// Straight continuations are not joined, whatever the style
+		const float straight[] = { 0, 0, 5, 0, 10, 0 };
+		for (int join = LINEJOIN_MITER; join <= LINEJOIN_ROUND; join++)
+		{
+			Stroke s = StrokeLine(stroker, buffer, straight, 0, 2, 3, Style(join, LINECAP_FLAT, 4, false));
+			CHECK(s.finite && s.triangles == 4 && Near((float)s.area, 20.0f));
+		}
+
+		// A full reversal has no miter and is beveled or rounded
+		const float reversal[] = { 0, 0, 10, 0, 0, 0 };
+		CHECK(StrokeLine(stroker, buffer, reversal, 0, 2, 3, Style(LINEJOIN_MITER, LINECAP_FLAT, 100, false)).triangles == 5);
+		Stroke turn = StrokeLine(stroker, buffer, reversal, 0, 2, 3, Style(LINEJOIN_ROUND, LINECAP_FLAT, 100, false));
+		CHECK(turn.finite && turn.triangles == 4 + 8);
+
+		// A closed square has four joins and no caps; miters fill the corners exactly
+		const float square[] = { 0, 0, 10, 0, 10, 10, 0, 10 };
+		Stroke closedMiter = StrokeLine(stroker, buffer, square, 0, 2, 4, Style(LINEJOIN_MITER, LINECAP_ROUND, 4, true));
+		CHECK(closedMiter.finite && closedMiter.triangles == 8 && Near((float)closedMiter.area, 12.0f * 12.0f - 8.0f * 8.0f));
+		Stroke closedBevel = StrokeLine(stroker, buffer, square, 0, 2, 4, Style(LINEJOIN_BEVEL, LINECAP_ROUND, 4, true));
+		CHECK(closedBevel.finite && closedBevel.triangles == 12 && Near((float)closedBevel.area, 80.0f - 2.0f));
+		// Repeating the first point at the end does not add a segment
+		const float repeatedSquare[] = { 0, 0, 10, 0, 10, 10, 0, 10, 0, 0 };
+		CHECK(StrokeLine(stroker, buffer, repeatedSquare, 0, 2, 5, Style(LINEJOIN_MITER, LINECAP_FLAT, 4, true)).triangles == 8);
+
+		// Zero-width points have no join, and the segments meet at the point
+		const float widths[] = { 2, 0, 2 };
+		for (int join = LINEJOIN_MITER; join <= LINEJOIN_ROUND; join++)
+		{
+			Stroke s = StrokeLine(stroker, buffer, corner, widths, 2, 3, Style(join, LINECAP_FLAT, 4, false));
+			CHECK(s.finite && s.triangles == 4 && Near((float)s.area, 20.0f));
+		}
+
+		_DestroyVertexBuffer(buffer);
+		_DestroyStroker(stroker);
+	}
+
+	void TestRandomStrokes()
+	{
+		// Random polylines with sharp turns, tiny segments and widths down to zero
+		// must give finite triangles for every style
+		Stroker * stroker = _CreateStroker();
+		VertexBuffer * buffer = _CreateVertexBuffer();
+		Random random(17);
+		std::vector<float> points, widths;
+		bool finite = true;
+		for (int round = 0; round < 200; round++)
+		{
+			int count = 1 + (int)(random.Next() % 30u);
+			points.resize((size_t)count * 2);
+			widths.resize((size_t)count);
+			float scale = (round % 4 == 0 ? 1e-3f : 10.0f);
+			for (int i = 0; i < count; i++)
+			{
+				points[i * 2] = random.Next(-scale, scale);
+				points[i * 2 + 1] = random.Next(-scale, scale);
+				widths[i] = (random.Next() % 4u == 0 ? 0.0f : random.Next(0.0f, 3.0f));
+				// Points are sometimes repeated or put back on the previous segment
+				if (i > 0 && random.Next() % 8u == 0) { points[i * 2] = points[i * 2 - 2]; points[i * 2 + 1] = points[i * 2 - 1]; }
+			}
+			StrokeStyle2D style = Style((int)(random.Next() % 3u), (int)(random.Next() % 3u), random.Next(1.0f, 10.0f), random.Next() % 2u == 0);
+			style.roundSegments = 3 + (int)(random.Next() % 40u);
+			finite = finite && StrokeLine(stroker, buffer, &points[0], (round % 2 == 0 ? &widths[0] : 0), random.Next(0.0f, 3.0f), count, style).finite;
+		}
+		CHECK(finite);
+		_DestroyVertexBuffer(buffer);
+		_DestroyStroker(stroker);
+	}
+}
+
+void _TestStrokes()
+{
+	TestCaps();
+	TestJoins();
+	TestRandomStrokes();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Minimal test support for the native test console. Failed checks are printed
+// and counted; the program exits with the number of failures.
+
+#include <math.h>
+#include <stdio.h>
+
+/// <summary>
+/// Counts the failed checks of the test run.
+/// </summary>
+extern int gFailures;
+
+/// <summary>
+/// Prints and counts a failed check.
+/// </summary>
+void _Fail(const char * file, int line, const char * expression);
+
+#define CHECK(expression) ((expression) ? (void)0 : _Fail(__FILE__, __LINE__, #expression))
+
+/// <summary>
+/// Returns true if two floats differ by no more than tolerance times the larger of
+/// one and their magnitudes.
+/// </summary>
+inline bool Near(float a, float b, float tolerance = 1e-5f)
+{
+	float scale = fabsf(a) > fabsf(b) ? fabsf(a) : fabsf(b);
+	return fabsf(a - b) <= tolerance * (scale > 1.0f ? scale : 1.0f);
+}
+
+/// <summary>
+/// Returns repeatable pseudo-random floats in [lower, upper).
+/// </summary>
+struct Random
+{
+	unsigned int state;
+
+	Random(unsigned int seed) : state(seed) { }
+
+	unsigned int Next()
+	{
+		state = state * 1664525u + 1013904223u;
+		return state;
+	}
+
+	float Next(float lower, float upper)
+	{
+		return lower + (upper - lower) * (float)(Next() >> 8) / 16777216.0f;
+	}
+};
+
+/// <summary>
+/// Returns the name of an instruction set level.
+/// </summary>
+const char * _SimdLevelName(int level);
+/// <summary>
+/// Returns the current time in milliseconds.
+/// </summary>
+double _Milliseconds();
+
+// Test suites, run in the order they are declared
+void _TestKernels();
+void _TestCulling();
+void _TestJobs();
+void _TestPolygons();
+void _TestTimeSeries();
+void _TestStrokes();
+void _TestRenderers();
+void _TestMeshImport();
+
+// Benchmarks, run with the /bench argument
+void _BenchmarkKernels();
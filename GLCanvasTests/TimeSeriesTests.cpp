@@ -0,0 +1,195 @@
+// Native code, compiled without /clr.
+
+#include "Tests.h"
+#include "TimeSeries.h"
+
+#include <math.h>
+#include <vector>
+
+namespace
+{
+	// Marks the points past the end of the decimation output
+	const float Guard = 12345.0f;
+
+	// All samples appended to a time series, for comparison with the pyramid
+	struct Reference
+	{
+		std::vector<float> samples;
+		long long capacity;
+
+		long long Oldest() const { return (long long)samples.size() > capacity ? (long long)samples.size() - capacity : 0; }
+
+		void MinMax(long long first, long long end, float & lower, float & upper) const
+		{
+			lower = upper = samples[(size_t)first];
+			for (long long i = first + 1; i < end; i++)
+			{
+				float value = samples[(size_t)i];
+				if (value < lower) lower = value;
+				if (value > upper) upper = value;
+			}
+		}
+	};
+
+	// Decimates a range and compares each column with the samples it covers. The
+	// columns are split at the first sample at or after each column boundary.
+	void CheckDecimation(const TimeSeries * series, const Reference & reference, double origin, double interval, float xmin, float xmax, int columns)
+	{
+		int bound = _DecimatedPointCount(columns);
+		std::vector<float> points((size_t)(bound + 4) * 2, Guard);
+		int n = _DecimateTimeSeries(series, origin, interval, xmin, xmax, columns, &points[0]);
+		CHECK(n >= 0 && n <= bound);
+		for (size_t i = (size_t)bound * 2; i < points.size(); i++)
+			CHECK(points[i] == Guard);
+
+		// The retained samples covering the range, with one on either side
+		long long oldest = reference.Oldest(), newest = (long long)reference.samples.size() - 1;
+		double f0 = floor(((double)xmin - origin) / interval), f1 = ceil(((double)xmax - origin) / interval);
+		if (newest < 0 || f1 < (double)oldest || f0 > (double)newest)
+		{
+			CHECK(n == 0);
+			return;
+		}
+		long long first = (f0 < (double)oldest ? oldest : (long long)f0);
+		long long last = (f1 > (double)newest ? newest : (long long)f1);
+
+		if (last - first + 1 <= (long long)columns * 2)
+		{
+			// Every sample is written unchanged
+			CHECK(n == (int)(last - first + 1));
+			bool same = true;
+			for (long long i = first; i <= last && i - first < n; i++)
+			{
+				int k = (int)(i - first);
+				same = same && points[k * 2] == (float)(origin + (double)i * interval) && points[k * 2 + 1] == reference.samples[(size_t)i];
+			}
+			CHECK(same);
+			return;
+		}
+
+		double columnSize = ((double)xmax - (double)xmin) / (double)columns;
+		long long begin = first;
+		int k = 0;
+		bool same = true;
+		for (int c = 0; c < columns; c++)
+		{
+			long long end = last + 1;
+			if (c < columns - 1)
+			{
+				double boundary = ceil(((double)xmin + (c + 1) * columnSize - origin) / interval);
+				end = (boundary < (double)begin ? begin : (boundary > (double)(last + 1) ? last + 1 : (long long)boundary));
+			}
+			if (end <= begin) continue;
+
+			float lower, upper;
+			reference.MinMax(begin, end, lower, upper);
+			float x = (float)((double)xmin + (c + 0.5) * columnSize);
+			if (k + 2 > n) { same = false; break; }
+			const float * p = &points[k * 2];
+			same = same && p[0] == x && p[2] == x;
+			same = same && ((p[1] == lower && p[3] == upper) || (p[1] == upper && p[3] == lower));
+			k += 2;
+			begin = end;
+		}
+		CHECK(same);
+		CHECK(k == n);
+	}
+
+	void TestPyramid()
+	{
+		Random random(11);
+		const int Capacities[] = { 1, 2, 3, 5, 8, 31, 64, 100, 257, 1000, 4096 };
+		for (int t = 0; t < 11; t++)
+		{
+			TimeSeries * series = _CreateTimeSeries(Capacities[t]);
+			int capacity = _TimeSeriesCapacity(series);
+			CHECK(capacity >= Capacities[t] && capacity >= 2 && (capacity & (capacity - 1)) == 0);
+			CHECK(capacity < 2 * Capacities[t] || capacity == 2);
+
+			Reference reference;
+			reference.capacity = capacity;
+			float lower, upper;
+			CHECK(!_TimeSeriesRange(series, &lower, &upper));
+
+			// Batches of random sizes until the ring has wrapped around a few times
+			std::vector<float> batch;
+			while ((long long)reference.samples.size() < 3LL * capacity + 7)
+			{
+				int size = (int)(random.Next() % (unsigned int)(capacity + 3));
+				batch.resize((size_t)size + 1);
+				for (int i = 0; i < size; i++)
+				{
+					batch[i] = random.Next(-1000.0f, 1000.0f);
+					reference.samples.push_back(batch[i]);
+				}
+				_AppendSamples(series, &batch[0], size);
+				CHECK(_TimeSeriesCount(series) == (long long)reference.samples.size());
+
+				if (reference.samples.empty()) continue;
+				float expectedLower, expectedUpper;
+				reference.MinMax(reference.Oldest(), (long long)reference.samples.size(), expectedLower, expectedUpper);
+				CHECK(_TimeSeriesRange(series, &lower, &upper));
+				CHECK(lower == expectedLower && upper == expectedUpper);
+
+				// Windows at random positions and sizes, reaching past both ends of the
+				// retained samples, with few and many samples per column
+				for (int w = 0; w < 8; w++)
+				{
+					double origin = random.Next(-100.0f, 100.0f);
+					double interval = random.Next(0.1f, 3.0f);
+					double span = (double)capacity * 1.5;
+					double start = (double)reference.Oldest() - capacity * 0.25 + random.Next(0.0f, 1.0f) * span;
+					double width = 1.0 + random.Next(0.0f, 1.0f) * span;
+					float xmin = (float)(origin + start * interval), xmax = (float)(origin + (start + width) * interval);
+					int columns = 1 + (int)(random.Next() % 40u);
+					CheckDecimation(series, reference, origin, interval, xmin, xmax, columns);
+				}
+			}
+
+			_ClearTimeSeries(series);
+			CHECK(_TimeSeriesCount(series) == 0);
+			CHECK(!_TimeSeriesRange(series, &lower, &upper));
+			float points[8];
+			CHECK(_DecimateTimeSeries(series, 0, 1, 0, 100, 3, points) == 0);
+			_DestroyTimeSeries(series);
+		}
+	}
+
+	void TestAlignedRanges()
+	{
+		// Every range of a wrapped series in a single column, so that ranges start and
+		// end at each offset within the pyramid blocks
+		TimeSeries * series = _CreateTimeSeries(64);
+		Reference reference;
+		reference.capacity = 64;
+		Random random(5);
+		for (int i = 0; i < 64 + 37; i++)
+		{
+			float value = random.Next(-1.0f, 1.0f);
+			reference.samples.push_back(value);
+			_AppendSamples(series, &value, 1);
+		}
+		long long oldest = reference.Oldest();
+		bool same = true;
+		for (long long first = oldest; first < (long long)reference.samples.size(); first++)
+		{
+			for (long long last = first + 2; last < (long long)reference.samples.size(); last++)
+			{
+				// Sample i lies at x = i, so the column holds the samples first to last
+				float points[4];
+				int n = _DecimateTimeSeries(series, 0, 1, (float)first, (float)last, 1, points);
+				float lower, upper;
+				reference.MinMax(first, last + 1, lower, upper);
+				same = same && n == 2 && fminf(points[1], points[3]) == lower && fmaxf(points[1], points[3]) == upper;
+			}
+		}
+		CHECK(same);
+		_DestroyTimeSeries(series);
+	}
+}
+
+void _TestTimeSeries()
+{
+	TestPyramid();
+	TestAlignedRanges();
+}